@@ -0,0 +1,344 @@
+// Headless benchmark for the render and voice engines. Builds a synthetic project (sampler, beat
+// and optionally SF2 tracks, plus long audio clips), bounces it with BackendHost::renderToWav and
+// then drives the live mixer directly for the same song length without an audio device.
+//
+//   BackendBench [--tracks N] [--notes-per-second M] [--voices K] [--seconds S] [--clips C]
+//                [--clip-seconds L] [--sf2 <file>] [--quality linear|sinc] [--json <file>]
+//
+// The result is one JSON object: written to --json if given, and printed on stdout as the line
+// "BENCH_RESULT <json>" (other stdout lines are the backend's own events).
+
+#include <juce_gui_basics/juce_gui_basics.h>
+
+#include "../src/BackendHost.h"
+#include "../src/EventOutput.h"
+
+#include <algorithm>
+#include <cmath>
+#include <iostream>
+
+#if JUCE_WINDOWS
+ #include <windows.h>
+ #include <psapi.h>
+ #pragma comment(lib, "psapi.lib")
+#else
+ #include <sys/resource.h>
+#endif
+
+namespace {
+
+struct Workload {
+    int tracks = 8;               // of each kind: sampler, beat and (with --sf2) SF2
+    double notesPerSecond = 8.0;  // per track
+    int voices = 16;              // notes sounding at once per sampler/SF2 track
+    double seconds = 30.0;        // song length
+    int clips = 2;                // long audio clips on the timeline
+    double clipSeconds = 60.0;
+    juce::File soundFont;
+    Resampler::Quality quality = Resampler::Quality::linear;
+    juce::File jsonFile;
+};
+
+constexpr double benchRate = 44100.0;
+constexpr int liveBlockSize = 512;
+
+juce::int64 getPeakRssBytes() {
+#if JUCE_WINDOWS
+    PROCESS_MEMORY_COUNTERS counters {};
+    if (!GetProcessMemoryInfo(GetCurrentProcess(), &counters, sizeof(counters))) return -1;
+    return (juce::int64)counters.PeakWorkingSetSize;
+#else
+    rusage usage {};
+    if (getrusage(RUSAGE_SELF, &usage) != 0) return -1;
+   #if JUCE_MAC
+    return (juce::int64)usage.ru_maxrss;        // bytes on macOS
+   #else
+    return (juce::int64)usage.ru_maxrss * 1024; // kilobytes elsewhere
+   #endif
+#endif
+}
+
+bool parseArguments(const juce::StringArray& args, Workload& workload, juce::String& error) {
+    for (int i = 0; i < args.size(); ++i) {
+        const juce::String& arg = args[i];
+        const juce::String value = args[i + 1];
+        const bool hasValue = i + 1 < args.size();
+
+        if (arg == "--tracks" && hasValue) workload.tracks = juce::jmax(1, value.getIntValue());
+        else if (arg == "--notes-per-second" && hasValue) workload.notesPerSecond = juce::jmax(0.1, value.getDoubleValue());
+        else if (arg == "--voices" && hasValue) workload.voices = juce::jmax(1, value.getIntValue());
+        else if (arg == "--seconds" && hasValue) workload.seconds = juce::jmax(1.0, value.getDoubleValue());
+        else if (arg == "--clips" && hasValue) workload.clips = juce::jmax(0, value.getIntValue());
+        else if (arg == "--clip-seconds" && hasValue) workload.clipSeconds = juce::jmax(1.0, value.getDoubleValue());
+        else if (arg == "--sf2" && hasValue) workload.soundFont = juce::File(value);
+        else if (arg == "--quality" && hasValue) {
+            workload.quality = value == "sinc" ? Resampler::Quality::sinc : Resampler::Quality::linear;
+        } else if (arg == "--json" && hasValue) workload.jsonFile = juce::File(value);
+        else {
+            error = "unknown or incomplete argument: " + arg;
+            return false;
+        }
+        ++i;
+    }
+    return true;
+}
+
+// Writes a stereo 16-bit WAV produced by generator(channel, sampleIndex)
+template <typename Generator>
+bool writeWav(const juce::File& file, double seconds, Generator&& generator) {
+    file.deleteFile();
+    std::unique_ptr<juce::FileOutputStream> stream(file.createOutputStream());
+    if (stream == nullptr) return false;
+
+    juce::WavAudioFormat wav;
+    std::unique_ptr<juce::AudioFormatWriter> writer(wav.createWriterFor(stream.get(), benchRate, 2, 16, {}, 0));
+    if (writer == nullptr) return false;
+    stream.release();
+
+    const auto totalSamples = (juce::int64)(seconds * benchRate);
+    juce::AudioBuffer<float> block(2, 8192);
+    for (juce::int64 start = 0; start < totalSamples; start += block.getNumSamples()) {
+        const int count = (int)juce::jmin<juce::int64>(block.getNumSamples(), totalSamples - start);
+        for (int ch = 0; ch < 2; ++ch) {
+            for (int i = 0; i < count; ++i) block.setSample(ch, i, generator(ch, start + i));
+        }
+        if (!writer->writeFromAudioSampleBuffer(block, 0, count)) return false;
+    }
+    return true;
+}
+
+// Note n of a track: spread over three octaves so voices don't all share one pitch
+int noteFor(int track, int n) {
+    return 48 + (n * 7 + track * 5) % 36;
+}
+
+juce::String trackName(const char* kind, int index) {
+    return juce::String(kind) + juce::String(index);
+}
+
+class Stopwatch {
+public:
+    double elapsedSeconds() const {
+        return juce::Time::highResolutionTicksToSeconds(juce::Time::getHighResolutionTicks() - start);
+    }
+
+private:
+    const juce::int64 start = juce::Time::getHighResolutionTicks();
+};
+
+juce::var timingToVar(const TimingStats::Snapshot& timing) {
+    auto object = new juce::DynamicObject();
+    object->setProperty("count", timing.count);
+    object->setProperty("minUs", timing.minMicros);
+    object->setProperty("meanUs", timing.meanMicros);
+    object->setProperty("maxUs", timing.maxMicros);
+    juce::Array<juce::var> histogram;
+    for (auto bucket : timing.histogram) histogram.add((juce::int64)bucket);
+    object->setProperty("histogram", histogram);
+    return object;
+}
+
+// Fills result; returns the process exit code
+int runBench(const Workload& workload, juce::DynamicObject& result) {
+    auto stages = new juce::DynamicObject();
+    result.setProperty("stages", stages);
+
+    auto config = new juce::DynamicObject();
+    config->setProperty("tracks", workload.tracks);
+    config->setProperty("notesPerSecond", workload.notesPerSecond);
+    config->setProperty("voices", workload.voices);
+    config->setProperty("seconds", workload.seconds);
+    config->setProperty("clips", workload.clips);
+    config->setProperty("clipSeconds", workload.clipSeconds);
+    config->setProperty("sf2", workload.soundFont.getFullPathName());
+    config->setProperty("quality", workload.quality == Resampler::Quality::sinc ? "sinc" : "linear");
+    result.setProperty("config", config);
+
+    const auto workDir = juce::File::getSpecialLocation(juce::File::tempDirectory)
+                             .getChildFile("MelodyKitBench-" + juce::String::toHexString(juce::Random::getSystemRandom().nextInt()));
+    workDir.createDirectory();
+    auto fail = [&](const juce::String& error) {
+        result.setProperty("error", error);
+        workDir.deleteRecursively();
+        return 1;
+    };
+
+    // Synthetic material: a pitched sampler tone, a short drum-like hit and a long clip
+    Stopwatch filesTimer;
+    const auto tone = workDir.getChildFile("tone.wav");
+    const auto hit = workDir.getChildFile("hit.wav");
+    const auto clip = workDir.getChildFile("clip.wav");
+    juce::Random noise(1);
+    const bool written =
+        writeWav(tone, 4.0, [](int, juce::int64 i) {
+            const double t = (double)i / benchRate;
+            return (float)(0.5 * std::sin(2.0 * juce::MathConstants<double>::pi * 261.63 * t) * std::exp(-0.5 * t));
+        })
+        && writeWav(hit, 0.5, [&noise](int, juce::int64 i) {
+               return (noise.nextFloat() * 2.0f - 1.0f) * (float)std::exp(-(double)i / (0.05 * benchRate));
+           })
+        && writeWav(clip, workload.clipSeconds, [](int ch, juce::int64 i) {
+               const double t = (double)i / benchRate;
+               return (float)(0.25 * std::sin(2.0 * juce::MathConstants<double>::pi * (110.0 + 20.0 * t + ch) * t));
+           });
+    stages->setProperty("writeFilesSeconds", filesTimer.elapsedSeconds());
+    if (!written) return fail("could not write synthetic samples to " + workDir.getFullPathName());
+
+    // Headless: not even the SF2 loads open the machine's audio device, so its setup can't skew timings
+    BackendHost host(false);
+    const bool useSoundFont = workload.soundFont.existsAsFile();
+
+    Stopwatch loadTimer;
+    for (int t = 0; t < workload.tracks; ++t) {
+        juce::String error;
+        if (!host.loadSamplerSample(trackName("sampler", t), tone, error)
+            || !host.loadBeatSample(trackName("beat", t), "hit", hit, error)
+            || (useSoundFont && !host.loadSF2(trackName("sf2", t), workload.soundFont, error))) {
+            return fail("load failed: " + error);
+        }
+    }
+    stages->setProperty("loadSeconds", loadTimer.elapsedSeconds());
+
+    // The same timeline for the bounce and the live run
+    const double noteSeconds = workload.voices / workload.notesPerSecond;
+    const int notesPerTrack = (int)(workload.seconds * workload.notesPerSecond);
+    std::vector<MidiNoteEvent> notes;
+    std::vector<BeatRenderEvent> beats;
+    for (int t = 0; t < workload.tracks; ++t) {
+        for (int n = 0; n < notesPerTrack; ++n) {
+            const double start = n / workload.notesPerSecond;
+            notes.emplace_back(trackName("sampler", t), start, noteSeconds, noteFor(t, n), 0.8f);
+            if (useSoundFont) notes.emplace_back(trackName("sf2", t), start, noteSeconds, noteFor(t, n), 0.8f);
+            beats.push_back({trackName("beat", t), "hit", start, 0.8f});
+        }
+    }
+    std::stable_sort(notes.begin(), notes.end(), [](const MidiNoteEvent& a, const MidiNoteEvent& b) {
+        return a.startTimeSeconds < b.startTimeSeconds;
+    });
+    std::vector<AudioClipRenderEvent> clips;
+    for (int c = 0; c < workload.clips; ++c) {
+        clips.push_back({"clips", clip, c * 0.5, 0.5f});
+    }
+
+    // Offline bounce
+    {
+        const auto output = workDir.getChildFile("bounce.wav");
+        RenderOptions options;
+        options.resamplerQuality = workload.quality;
+        options.useStemCache = false; // every run renders from scratch, and the user's cache stays untouched
+
+        Stopwatch renderTimer;
+        juce::String error;
+        if (!host.renderToWav(notes, output, error, benchRate, 24, beats, clips, options)) {
+            return fail("render failed: " + error);
+        }
+        const double elapsed = renderTimer.elapsedSeconds();
+
+        double renderedSeconds = 0.0;
+        juce::WavAudioFormat wav;
+        if (std::unique_ptr<juce::AudioFormatReader> reader(wav.createReaderFor(output.createInputStream().release(), true));
+            reader != nullptr) {
+            renderedSeconds = (double)reader->lengthInSamples / reader->sampleRate;
+        }
+
+        auto offline = new juce::DynamicObject();
+        offline->setProperty("seconds", elapsed);
+        offline->setProperty("audioSeconds", renderedSeconds);
+        offline->setProperty("realtimeMultiple", elapsed > 0.0 ? renderedSeconds / elapsed : 0.0);
+        stages->setProperty("offlineRender", offline);
+    }
+
+    // Live engines, driven block by block without a device. Each second's notes are scheduled
+    // just before it so the event queues never fill up.
+    {
+        auto& mixer = host.getMixer();
+        mixer.audioDeviceAboutToStart(nullptr); // 44.1 kHz, 512-sample blocks
+        juce::AudioBuffer<float> output(2, liveBlockSize);
+        const juce::AudioIODeviceCallbackContext context;
+
+        host.getStatsReport(true); // start a fresh telemetry interval
+
+        const auto totalBlocks = (juce::int64)(workload.seconds * benchRate / liveBlockSize);
+        const auto blocksPerSecond = (juce::int64)(benchRate / liveBlockSize);
+        const int durationMs = juce::roundToInt(noteSeconds * 1000.0);
+        int nextNote = 0;
+        std::vector<int> maxVoices;
+
+        Stopwatch liveTimer;
+        for (juce::int64 block = 0; block < totalBlocks; ++block) {
+            if (block % blocksPerSecond == 0) {
+                const double horizon = (double)(block + blocksPerSecond) * liveBlockSize / benchRate;
+                for (; nextNote < notesPerTrack && nextNote / workload.notesPerSecond < horizon; ++nextNote) {
+                    const double startMs = nextNote * 1000.0 / workload.notesPerSecond;
+                    const auto startTime = host.engineTimeFromMs(juce::jmax(1.0, startMs));
+                    for (int t = 0; t < workload.tracks; ++t) {
+                        host.triggerSamplerNote(trackName("sampler", t), noteFor(t, nextNote), 0.8f, durationMs, startTime);
+                        host.triggerBeat(trackName("beat", t), "hit", 0.8f, startTime);
+                        if (useSoundFont) host.playNote(trackName("sf2", t), noteFor(t, nextNote), 0.8f, durationMs, 1, startTime);
+                    }
+                }
+            }
+            mixer.audioDeviceIOCallbackWithContext(nullptr, 0, output.getArrayOfWritePointers(), 2, liveBlockSize, context);
+        }
+        const double elapsed = liveTimer.elapsedSeconds();
+        mixer.audioDeviceStopped();
+
+        auto live = new juce::DynamicObject();
+        live->setProperty("seconds", elapsed);
+        live->setProperty("audioSeconds", (double)totalBlocks * liveBlockSize / benchRate);
+        live->setProperty("realtimeMultiple", elapsed > 0.0 ? (double)totalBlocks * liveBlockSize / benchRate / elapsed : 0.0);
+        live->setProperty("callback", timingToVar(mixer.getCallbackTiming().read(true)));
+        live->setProperty("mix", timingToVar(mixer.getMixTiming().read(true)));
+        live->setProperty("overruns", mixer.getOverrunCount());
+        live->setProperty("workerThreads", mixer.getNumWorkerThreads());
+
+        // Per engine: the slowest track's figures and the busiest voice count
+        auto engines = new juce::DynamicObject();
+        for (const auto& source : host.getSourceStats(true)) {
+            const juce::Identifier kind(source.kind);
+            auto* engine = engines->getProperty(kind).getDynamicObject();
+            if (engine == nullptr) {
+                engine = new juce::DynamicObject();
+                engines->setProperty(kind, engine);
+            }
+            engine->setProperty("tracks", (int)engine->getProperty("tracks") + 1);
+            engine->setProperty("maxMeanUs", juce::jmax((double)engine->getProperty("maxMeanUs"), source.timing.meanMicros));
+            engine->setProperty("maxUs", juce::jmax((double)engine->getProperty("maxUs"), source.timing.maxMicros));
+            engine->setProperty("voices", juce::jmax((int)engine->getProperty("voices"), source.activeVoices));
+        }
+        live->setProperty("engines", engines);
+        stages->setProperty("liveRender", live);
+    }
+
+    result.setProperty("peakRssBytes", getPeakRssBytes());
+    workDir.deleteRecursively();
+    return 0;
+}
+
+} // namespace
+
+int main(int argc, char* argv[]) {
+    juce::ScopedJuceInitialiser_GUI juceInit;
+
+    juce::StringArray args;
+    for (int i = 1; i < argc; ++i) args.add(juce::String(argv[i]));
+
+    Workload workload;
+    juce::String error;
+    if (!parseArguments(args, workload, error)) {
+        std::cerr << error << std::endl;
+        return 2;
+    }
+
+    auto result = new juce::DynamicObject();
+    juce::var resultVar(result);
+    const int status = runBench(workload, *result);
+    const auto json = juce::JSON::toString(resultVar, true);
+
+    if (workload.jsonFile != juce::File()) workload.jsonFile.replaceWithText(json + "\n");
+
+    EventOutput::flush();
+    std::cout << "BENCH_RESULT " << json << std::endl;
+    EventOutput::shutdown();
+    return status;
+}
@@ -0,0 +1,101 @@
+#pragma once
+
+#include <juce_core/juce_core.h>
+#include <array>
+#include <atomic>
+
+// Processing times recorded by the audio thread and read by any other thread without locks:
+// count, min/mean/max and a log2 histogram. A reader that asks for a reset doesn't clear anything
+// itself; the writer starts a new interval on its next record(), so the figures of one interval
+// always come from the same writer.
+class TimingStats {
+public:
+    // Bucket 0 counts durations under 16 us, each further bucket doubles the bound; the last one
+    // also takes everything above 8 ms
+    static constexpr int numBuckets = 11;
+    static constexpr double firstBucketMicros = 16.0;
+
+    struct Snapshot {
+        juce::int64 count = 0;
+        double minMicros = 0.0;
+        double meanMicros = 0.0;
+        double maxMicros = 0.0;
+        std::array<juce::uint32, numBuckets> histogram {};
+
+        // "min/mean/max" in microseconds
+        juce::String formatMicros() const {
+            return juce::String(minMicros, 1) + "/" + juce::String(meanMicros, 1) + "/" + juce::String(maxMicros, 1);
+        }
+
+        juce::String formatHistogram() const {
+            juce::StringArray counts;
+            for (auto bucket : histogram) counts.add(juce::String(bucket));
+            return counts.joinIntoString(",");
+        }
+    };
+
+    // Writer (audio thread)
+    void record(double micros) {
+        if (resetRequested.exchange(false, std::memory_order_acquire)) {
+            count.store(0, std::memory_order_relaxed);
+            total.store(0.0, std::memory_order_relaxed);
+            for (auto& bucket : histogram) bucket.store(0, std::memory_order_relaxed);
+        }
+
+        const juce::int64 n = count.load(std::memory_order_relaxed);
+        if (n == 0 || micros < minimum.load(std::memory_order_relaxed)) minimum.store(micros, std::memory_order_relaxed);
+        if (n == 0 || micros > maximum.load(std::memory_order_relaxed)) maximum.store(micros, std::memory_order_relaxed);
+        total.store(total.load(std::memory_order_relaxed) + micros, std::memory_order_relaxed);
+
+        int bucket = 0;
+        for (double bound = firstBucketMicros; micros >= bound && bucket < numBuckets - 1; bound *= 2.0) ++bucket;
+        auto& slot = histogram[(size_t)bucket];
+        slot.store(slot.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+
+        count.store(n + 1, std::memory_order_release);
+    }
+
+    // Reader (any thread). With startNewInterval, the next snapshot only covers what follows.
+    Snapshot read(bool startNewInterval) {
+        Snapshot snapshot;
+        if (!resetRequested.load(std::memory_order_relaxed)) {
+            snapshot.count = count.load(std::memory_order_acquire);
+            if (snapshot.count > 0) {
+                snapshot.minMicros = minimum.load(std::memory_order_relaxed);
+                snapshot.maxMicros = maximum.load(std::memory_order_relaxed);
+                snapshot.meanMicros = total.load(std::memory_order_relaxed) / (double)snapshot.count;
+                for (int i = 0; i < numBuckets; ++i) {
+                    snapshot.histogram[(size_t)i] = histogram[(size_t)i].load(std::memory_order_relaxed);
+                }
+            }
+        }
+        if (startNewInterval) resetRequested.store(true, std::memory_order_release);
+        return snapshot;
+    }
+
+private:
+    std::atomic<juce::int64> count { 0 };
+    std::atomic<double> minimum { 0.0 };
+    std::atomic<double> maximum { 0.0 };
+    std::atomic<double> total { 0.0 };
+    std::array<std::atomic<juce::uint32>, numBuckets> histogram {};
+    std::atomic<bool> resetRequested { false };
+};
+
+// Times one scope on the audio thread into a TimingStats
+class ScopedTiming {
+public:
+    explicit ScopedTiming(TimingStats& statsToUse)
+        : stats(statsToUse), start(juce::Time::getHighResolutionTicks()) {}
+
+    ~ScopedTiming() {
+        const auto elapsed = juce::Time::getHighResolutionTicks() - start;
+        stats.record(juce::Time::highResolutionTicksToSeconds(elapsed) * 1.0e6);
+    }
+
+private:
+    TimingStats& stats;
+    const juce::int64 start;
+
+    JUCE_DECLARE_NON_COPYABLE(ScopedTiming)
+};
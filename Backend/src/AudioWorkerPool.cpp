@@ -0,0 +1,130 @@
+#include "AudioWorkerPool.h"
+
+#if JUCE_INTEL
+ #include <immintrin.h>
+#endif
+
+namespace {
+
+constexpr int realtimePriority = 10; // JUCE's highest realtime priority
+
+// One polling step of a spin-wait: tells the core (and its hyperthread sibling) we are waiting
+inline void spinPause() {
+#if JUCE_INTEL
+    _mm_pause();
+#elif JUCE_ARM && (defined(__GNUC__) || defined(__clang__))
+    __asm__ __volatile__("yield");
+#endif
+}
+
+} // namespace
+
+class AudioWorkerPool::Worker : public juce::Thread {
+public:
+    Worker(AudioWorkerPool& owner, int index)
+        : juce::Thread("Audio worker " + juce::String(index + 1)), pool(owner) {}
+
+    void run() override { pool.workerLoop(*this); }
+
+    juce::WaitableEvent wakeUp;
+    std::atomic<bool> asleep { false };
+
+private:
+    AudioWorkerPool& pool;
+};
+
+int AudioWorkerPool::defaultNumWorkers() {
+    return juce::jlimit(0, 15, juce::SystemStats::getNumCpus() - 2);
+}
+
+AudioWorkerPool::AudioWorkerPool(int numWorkers) {
+    setSpinTime(defaultSpinMicroseconds);
+
+    // The device thread joins every batch, so more workers than the other cores just compete with it
+    const int numCpus = juce::SystemStats::getNumCpus();
+    numWorkers = juce::jmin(numWorkers, numCpus - 1);
+    for (int i = 0; i < numWorkers; ++i) {
+        auto worker = std::make_unique<Worker>(*this, i);
+
+        // Pinned one per core from core 1 up, so no two workers share a core. The device thread
+        // isn't pinned: keeping workers off core 0 only leaves it one core it never shares with them.
+        if (i + 1 < 32) worker->setAffinityMask((juce::uint32)1 << (i + 1));
+        if (!worker->startRealtimeThread(juce::Thread::RealtimeOptions {}.withPriority(realtimePriority))) {
+            worker->startThread(juce::Thread::Priority::highest);
+        }
+        workers.push_back(std::move(worker));
+    }
+}
+
+AudioWorkerPool::~AudioWorkerPool() {
+    for (auto& worker : workers) {
+        worker->signalThreadShouldExit();
+        worker->wakeUp.signal();
+    }
+    for (auto& worker : workers) worker->stopThread(2000);
+}
+
+void AudioWorkerPool::run(int numTasks, Task task, void* context) {
+    if (numTasks <= 0) return;
+    if (workers.empty() || numTasks == 1 || numTasks > maxTasks) {
+        for (int i = 0; i < numTasks; ++i) task(context, i);
+        return;
+    }
+
+    currentTask = task;
+    currentContext = context;
+    remaining.store(numTasks, std::memory_order_relaxed);
+
+    const juce::uint32 generation = generationOf(ticket.load(std::memory_order_relaxed)) + 1;
+    ticket.store(((juce::uint64)generation << 32) | ((juce::uint64)numTasks << 16), std::memory_order_seq_cst);
+
+    // A worker that saw the old ticket just before sleeping re-checks it after raising its flag,
+    // so it either sees this batch or gets woken here
+    for (auto& worker : workers) {
+        if (worker->asleep.load(std::memory_order_seq_cst)) worker->wakeUp.signal();
+    }
+
+    helpWith(generation);
+    while (remaining.load(std::memory_order_acquire) > 0) spinPause(); // the last tasks are running elsewhere
+}
+
+void AudioWorkerPool::helpWith(juce::uint32 generation) {
+    juce::uint64 current = ticket.load(std::memory_order_acquire);
+    for (;;) {
+        if (generationOf(current) != generation) return;
+        const int next = (int)(current & 0xffff);
+        const int count = (int)((current >> 16) & 0xffff);
+        if (next >= count) return;
+
+        if (!ticket.compare_exchange_weak(current, current + 1, std::memory_order_acq_rel, std::memory_order_acquire)) {
+            continue;
+        }
+        currentTask(currentContext, next);
+        remaining.fetch_sub(1, std::memory_order_release);
+        current = ticket.load(std::memory_order_acquire);
+    }
+}
+
+bool AudioWorkerPool::waitForBatch(Worker& worker, juce::uint32 lastGeneration) {
+    const juce::int64 spinUntil = juce::Time::getHighResolutionTicks() + spinTicks.load(std::memory_order_relaxed);
+    while (generationOf(ticket.load(std::memory_order_acquire)) == lastGeneration) {
+        if (worker.threadShouldExit()) return false;
+        if (juce::Time::getHighResolutionTicks() < spinUntil) {
+            spinPause();
+            continue;
+        }
+
+        worker.asleep.store(true, std::memory_order_seq_cst);
+        if (generationOf(ticket.load(std::memory_order_seq_cst)) == lastGeneration) worker.wakeUp.wait();
+        worker.asleep.store(false, std::memory_order_relaxed);
+    }
+    return true;
+}
+
+void AudioWorkerPool::workerLoop(Worker& worker) {
+    juce::uint32 generation = generationOf(ticket.load(std::memory_order_acquire));
+    while (waitForBatch(worker, generation)) {
+        generation = generationOf(ticket.load(std::memory_order_acquire));
+        helpWith(generation);
+    }
+}
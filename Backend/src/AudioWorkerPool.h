@@ -0,0 +1,58 @@
+#pragma once
+
+#include <juce_core/juce_core.h>
+#include <atomic>
+#include <memory>
+#include <vector>
+
+// Realtime worker threads for the device callback. run() spreads a batch of independent tasks
+// over the workers and the calling thread and returns once every task is done (a barrier).
+// Tasks are claimed one at a time from a shared counter, so a slow task never holds up the rest.
+// Nothing on the way locks or allocates: between batches the workers spin for a few
+// microseconds, then sleep on their event, and the caller only wakes the ones that actually went
+// to sleep. Spinning any longer would keep spare cores busy through playback, and yielding gives
+// nothing to lower-priority threads under realtime scheduling.
+class AudioWorkerPool {
+public:
+    using Task = void (*)(void* context, int taskIndex);
+
+    // Leaves a core for the device thread (which joins in anyway) and one for everything else
+    static int defaultNumWorkers();
+
+    // At most one worker per core besides core 0
+    explicit AudioWorkerPool(int numWorkers = defaultNumWorkers());
+    ~AudioWorkerPool();
+
+    int getNumWorkers() const { return (int)workers.size(); }
+
+    static constexpr double defaultSpinMicroseconds = 5.0;
+
+    // How long idle workers keep polling for the next batch before they sleep
+    void setSpinTime(double microseconds) { spinTicks = juce::Time::secondsToHighResolutionTicks(microseconds / 1.0e6); }
+
+    // Audio thread. Runs task(context, i) for every i in [0, numTasks) and waits for all of them.
+    // Only one thread may call run() at a time.
+    void run(int numTasks, Task task, void* context);
+
+private:
+    class Worker;
+
+    // Batch ticket: generation in the upper 32 bits, task count in bits 16..31, next task in 0..15
+    static constexpr int maxTasks = 0xffff;
+    static juce::uint32 generationOf(juce::uint64 ticket) { return (juce::uint32)(ticket >> 32); }
+
+    void workerLoop(Worker& worker);
+    bool waitForBatch(Worker& worker, juce::uint32 lastGeneration);
+
+    // Claims and runs tasks of the batch with the given generation until none are left
+    void helpWith(juce::uint32 generation);
+
+    std::vector<std::unique_ptr<Worker>> workers;
+    std::atomic<juce::uint64> ticket { 0 };
+    std::atomic<int> remaining { 0 };
+    Task currentTask = nullptr;     // written by the caller before it publishes the ticket
+    void* currentContext = nullptr;
+    std::atomic<juce::int64> spinTicks { 0 };
+
+    JUCE_DECLARE_NON_COPYABLE(AudioWorkerPool)
+};
@@ -0,0 +1,139 @@
+#include "Automation.h"
+
+#include <algorithm>
+#include <cmath>
+
+namespace {
+
+juce::String getParameterId(const juce::AudioProcessorParameter& parameter) {
+    if (auto* hosted = dynamic_cast<const juce::HostedAudioProcessorParameter*>(&parameter)) {
+        return hosted->getParameterID();
+    }
+    if (auto* withId = dynamic_cast<const juce::AudioProcessorParameterWithID*>(&parameter)) {
+        return withId->paramID;
+    }
+    return {};
+}
+
+// Samples from t until the timeline reaches seconds, at least one
+int samplesUntil(double seconds, double t, double sampleRate) {
+    return juce::jmax(1, (int)std::ceil((seconds - t) * sampleRate));
+}
+
+} // namespace
+
+//==============================================================================
+AutomationCurve::AutomationCurve(std::vector<AutomationPoint> breakpoints) : points(std::move(breakpoints)) {
+    std::stable_sort(points.begin(), points.end(), [](const AutomationPoint& a, const AutomationPoint& b) {
+        return a.timeSeconds < b.timeSeconds;
+    });
+    for (size_t i = 1; i < points.size(); ++i) {
+        points[i].timeSeconds = juce::jmax(points[i].timeSeconds, points[i - 1].timeSeconds + minRampSeconds);
+    }
+}
+
+float AutomationCurve::getValueAt(double seconds) const {
+    if (points.empty()) return 0.0f;
+
+    const auto next = std::upper_bound(points.begin(), points.end(), seconds,
+                                       [](double t, const AutomationPoint& point) { return t < point.timeSeconds; });
+    if (next == points.begin()) return points.front().value;
+    if (next == points.end()) return points.back().value;
+
+    const auto& a = *(next - 1);
+    const auto& b = *next;
+    const double position = (seconds - a.timeSeconds) / (b.timeSeconds - a.timeSeconds);
+    return a.value + (float)position * (b.value - a.value);
+}
+
+void AutomationCurve::render(float* dest, int numSamples, double startSeconds, double sampleRate) const {
+    if (numSamples <= 0) return;
+    if (points.empty() || sampleRate <= 0.0) {
+        juce::FloatVectorOperations::fill(dest, getValueAt(startSeconds), numSamples);
+        return;
+    }
+
+    size_t next = (size_t)(std::upper_bound(points.begin(), points.end(), startSeconds,
+                                            [](double t, const AutomationPoint& point) { return t < point.timeSeconds; })
+                           - points.begin());
+
+    // One run per segment: flat before the first and after the last point, a linear ramp between
+    int i = 0;
+    while (i < numSamples) {
+        const double t = startSeconds + i / sampleRate;
+        while (next < points.size() && points[next].timeSeconds <= t) ++next;
+
+        if (next == points.size()) {
+            juce::FloatVectorOperations::fill(dest + i, points.back().value, numSamples - i);
+            return;
+        }
+        const int run = juce::jmin(numSamples - i, samplesUntil(points[next].timeSeconds, t, sampleRate));
+        if (next == 0) {
+            juce::FloatVectorOperations::fill(dest + i, points.front().value, run);
+        } else {
+            const auto& a = points[next - 1];
+            const auto& b = points[next];
+            const double slope = (b.value - a.value) / (b.timeSeconds - a.timeSeconds);
+            const double first = a.value + (t - a.timeSeconds) * slope;
+            const double step = slope / sampleRate;
+            for (int k = 0; k < run; ++k) dest[i + k] = (float)(first + k * step);
+        }
+        i += run;
+    }
+}
+
+//==============================================================================
+float TrackAutomation::renderMixGains(float* left, float* right, int numSamples, double startSeconds,
+                                      double sampleRate, float staticGain) const {
+    if (numSamples <= 0) return staticGain;
+
+    if (gain) gain->render(left, numSamples, startSeconds, sampleRate);
+    else juce::FloatVectorOperations::fill(left, staticGain, numSamples);
+    const float endGain = left[numSamples - 1];
+
+    if (!pan) {
+        juce::FloatVectorOperations::copy(right, left, numSamples);
+        return endGain;
+    }
+
+    pan->render(right, numSamples, startSeconds, sampleRate);
+    for (int i = 0; i < numSamples; ++i) {
+        const float position = juce::jlimit(-1.0f, 1.0f, right[i]);
+        const float level = left[i];
+        left[i] = level * juce::jmin(1.0f, 1.0f - position);
+        right[i] = level * juce::jmin(1.0f, 1.0f + position);
+    }
+    return endGain;
+}
+
+void TrackAutomation::resolveParameters(const juce::AudioProcessor* processor) {
+    for (auto& lane : parameters) {
+        lane.parameterIndex = -1;
+        if (processor == nullptr) continue;
+
+        const auto& processorParameters = processor->getParameters();
+        for (int i = 0; i < processorParameters.size(); ++i) {
+            if (getParameterId(*processorParameters[i]) == lane.parameterId) {
+                lane.parameterIndex = i;
+                break;
+            }
+        }
+
+        // Plugins without stable IDs are automated by parameter index
+        if (lane.parameterIndex < 0 && lane.parameterId.isNotEmpty() && lane.parameterId.containsOnly("0123456789")) {
+            const int index = lane.parameterId.getIntValue();
+            if (index < processorParameters.size()) lane.parameterIndex = index;
+        }
+    }
+}
+
+void TrackAutomation::applyParameters(juce::AudioProcessor& processor, double seconds) const {
+    const auto& processorParameters = processor.getParameters();
+    for (const auto& lane : parameters) {
+        if (lane.parameterIndex < 0 || lane.parameterIndex >= processorParameters.size()) continue;
+
+        auto* parameter = processorParameters.getUnchecked(lane.parameterIndex);
+        const float value = juce::jlimit(0.0f, 1.0f, lane.curve->getValueAt(seconds));
+        if (parameter->getValue() != value) parameter->setValue(value);
+    }
+}
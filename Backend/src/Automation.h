@@ -0,0 +1,67 @@
+#pragma once
+
+#include <juce_audio_processors/juce_audio_processors.h>
+#include <memory>
+#include <vector>
+
+// Breakpoint automation of track gain, pan and plugin parameters. A whole lane arrives in one
+// command; the mixer evaluates it per sample on the audio thread, and offline renders evaluate
+// the same curves at the same timeline positions, so an export moves exactly like playback.
+
+struct AutomationPoint {
+    double timeSeconds = 0.0; // timeline time
+    float value = 0.0f;
+};
+
+// Piecewise-linear curve through breakpoints, holding the first value before the first point
+// and the last one after the last. Immutable once built, so any thread may read it.
+class AutomationCurve {
+public:
+    // Breakpoints closer together than this are spread apart, so a vertical step becomes a short
+    // ramp instead of a click
+    static constexpr double minRampSeconds = 0.001;
+
+    explicit AutomationCurve(std::vector<AutomationPoint> points);
+
+    bool isEmpty() const { return points.empty(); }
+    const std::vector<AutomationPoint>& getPoints() const { return points; }
+
+    float getValueAt(double seconds) const;
+
+    // Writes the curve's value at numSamples consecutive timeline samples, the first one at
+    // startSeconds. Doesn't allocate.
+    void render(float* dest, int numSamples, double startSeconds, double sampleRate) const;
+
+private:
+    std::vector<AutomationPoint> points; // sorted by time
+};
+
+// Every lane of one track. Published as a whole and never changed afterwards: an edit builds a
+// new one, which the mixer swaps in like a source.
+struct TrackAutomation {
+    struct ParameterLane {
+        juce::String parameterId;
+        int parameterIndex = -1; // in the track's current plugin; -1 if it has no such parameter
+        std::shared_ptr<const AutomationCurve> curve; // normalised 0..1
+    };
+
+    std::shared_ptr<const AutomationCurve> gain; // linear gain; replaces the track volume
+    std::shared_ptr<const AutomationCurve> pan;  // -1 (left) .. 1 (right)
+    std::vector<ParameterLane> parameters;
+
+    bool isEmpty() const { return !gain && !pan && parameters.empty(); }
+    bool hasMixLanes() const { return gain != nullptr || pan != nullptr; }
+
+    // Per-sample left and right gains for numSamples from startSeconds: the gain lane (staticGain
+    // without one) through a balance pan law, which leaves the centre at unity and fades the
+    // opposite side out towards the edges. Returns the gain lane's value at the last sample.
+    float renderMixGains(float* left, float* right, int numSamples, double startSeconds, double sampleRate,
+                         float staticGain) const;
+
+    // Message thread: looks the lanes' parameter IDs up in processor (nullptr clears them)
+    void resolveParameters(const juce::AudioProcessor* processor);
+
+    // Audio or render thread, once per processing block: sets the automated parameters to their
+    // values at seconds
+    void applyParameters(juce::AudioProcessor& processor, double seconds) const;
+};
@@ -1,310 +1,823 @@
-#define TSF_IMPLEMENTATION
 #include "../TinySoundFont/tsf.h"
 
 #include "BackendHost.h"
+#include "ClipPlayer.h"
+#include "EventOutput.h"
+#include "EventScheduler.h"
+#include "OfflineRender.h"
+#include "PeakCache.h"
+#include "PitchDetector.h"
+#include "PluginCache.h"
+#include "PreparedSample.h"
+#include "Resampler.h"
+#include "SampleCache.h"
+#include "SamplerVoices.h"
+#include "SoundFontBank.h"
 
 #include <juce_core/juce_core.h>
 #include <algorithm>
-#include <iostream>
 #include <cmath>
+#include <limits>
 
-// SF2 audio callback for TinySoundFont rendering
-class SF2AudioCallback : public juce::AudioIODeviceCallback {
+// Timestamped event for plugin and SF2 sources
+struct InstrumentEvent {
+    enum Type : uint8_t { midi, allNotesOff, setPreset };
+
+    juce::int64 time = 0; // engine sample time, 0 = immediately
+    Type type = midi;
+    uint8_t data[3] {};   // raw MIDI bytes for midi events
+    uint8_t size = 0;
+    int presetIndex = 0;  // for setPreset (SF2 only)
+
+    static InstrumentEvent fromMidi(const juce::MidiMessage& message, juce::int64 time) {
+        InstrumentEvent event;
+        event.time = time;
+        event.size = (uint8_t)juce::jmin(3, message.getRawDataSize());
+        std::copy(message.getRawData(), message.getRawData() + event.size, event.data);
+        return event;
+    }
+};
+
+// Instrument source whose events are delivered sample-accurately on the audio thread
+class InstrumentSource : public MixerSource {
 public:
-    SF2AudioCallback(tsf* soundFont, float* gainPtr, double sampleRate)
-        : sf(soundFont), gainLinearPtr(gainPtr), bufferSampleRate(sampleRate) {
-        if (sf) {
-            tsf_set_output(sf, TSF_STEREO_INTERLEAVED, (int)sampleRate, 0.0f);
-            tsf_set_max_voices(sf, 256); // Pre-allocate voices for thread safety
+    static constexpr int eventQueueSize = 4096;
+
+    explicit InstrumentSource(const TrackSleepSettings* sleepSettings = nullptr)
+        : events(eventQueueSize), sleep(sleepSettings) {}
+
+    // Any non-audio thread. Returns false if the event queue is full.
+    bool post(const InstrumentEvent& event) {
+        return events.push(event, event.type == InstrumentEvent::allNotesOff);
+    }
+
+    bool postMidi(const juce::MidiMessage& message, juce::int64 time = 0) {
+        return post(InstrumentEvent::fromMidi(message, time));
+    }
+
+    int getActiveVoices() const override { return activeVoices.load(std::memory_order_relaxed); }
+    int getQueueDepth() const override { return queueDepth.load(std::memory_order_relaxed); }
+    bool isAsleep() const override { return sleeping.load(std::memory_order_relaxed); }
+
+protected:
+    // Called from prepare(): the device was not pulling audio, so note-ons due meanwhile are
+    // dropped instead of firing late. Other due events (note-offs, controllers, presets) stay
+    // queued and play at the start of the first block; events for later keep their place on the
+    // timeline, which the mixer has rescaled to the new rate. release() silenced held notes.
+    void carryOverEvents(double sampleRate) {
+        events.collect();
+        const juce::int64 now = renderedUntil;
+        events.removePending([now](const InstrumentEvent& event) {
+            return event.time != 0 && event.time <= now && isNoteOn(event);
+        });
+
+        if (eventRate > 0.0 && sampleRate > 0.0 && eventRate != sampleRate) {
+            const double scale = sampleRate / eventRate;
+            auto rescale = [scale](juce::int64 time) { return (juce::int64)std::llround((double)time * scale); };
+            events.retime(rescale);
+            renderedUntil = rescale(renderedUntil);
         }
+        eventRate = sampleRate;
+        heldNotes.fill(false);
+        numHeldNotes = 0;
     }
-    
-    void audioDeviceIOCallbackWithContext(const float* const* inputChannelData,
-                                          int numInputChannels,
-                                          float* const* outputChannelData,
-                                          int numOutputChannels,
-                                          int numSamples,
-                                          const juce::AudioIODeviceCallbackContext& context) override {
-        if (!sf || numOutputChannels < 1) {
-            // Clear output
-            for (int ch = 0; ch < numOutputChannels; ++ch) {
-                if (outputChannelData[ch]) {
-                    juce::FloatVectorOperations::clear(outputChannelData[ch], numSamples);
-                }
-            }
+
+    // Audio thread, after events.collect() in render()
+    void markRendered(juce::int64 blockEnd) { renderedUntil = blockEnd; }
+
+    // Audio thread, from prepare() and render()
+    void resetSleep(double sampleRate) {
+        sleepRate = sampleRate;
+        quietSamples = 0;
+        sleeping.store(false, std::memory_order_relaxed);
+    }
+
+    // Audio thread, after events.collect(): true if the source is asleep and nothing falls due
+    // before blockEnd, so the block can be skipped (the bus is already silent). Otherwise the
+    // source is awake and renders the whole block, so a waking event keeps its offset.
+    bool sleepsThrough(juce::int64 blockEnd) {
+        if (!sleeping.load(std::memory_order_relaxed)) return false;
+        if (sleep->enabled.load(std::memory_order_relaxed) && events.nextDue(blockEnd) == nullptr) return true;
+        resetSleep(sleepRate);
+        return false;
+    }
+
+    // Audio thread, after a rendered block: a source that holds notes or sounding voices (busy)
+    // never falls asleep
+    void updateSleep(const juce::AudioBuffer<float>& bus, int numSamples, bool busy) {
+        if (sleep == nullptr || !sleep->enabled.load(std::memory_order_relaxed) || busy || numHeldNotes > 0
+            || bus.getMagnitude(0, numSamples) >= sleep->threshold.load(std::memory_order_relaxed)) {
+            quietSamples = 0;
             return;
         }
-        
-        // Render SF2 audio (interleaved stereo)
-        tempBuffer.resize(numSamples * 2); // stereo interleaved
-        tsf_render_float(sf, tempBuffer.data(), numSamples, 0);
-        
-        // Deinterleave and apply gain
-        const float gain = *gainLinearPtr;
-        if (numOutputChannels >= 2) {
-            // Stereo output
-            for (int i = 0; i < numSamples; ++i) {
-                outputChannelData[0][i] = tempBuffer[i * 2] * gain;
-                outputChannelData[1][i] = tempBuffer[i * 2 + 1] * gain;
-            }
-        } else {
-            // Mono output - mix stereo to mono
-            for (int i = 0; i < numSamples; ++i) {
-                outputChannelData[0][i] = (tempBuffer[i * 2] + tempBuffer[i * 2 + 1]) * 0.5f * gain;
-            }
+        quietSamples += numSamples;
+        if (quietSamples >= (juce::int64)(sleep->idleSeconds.load(std::memory_order_relaxed) * sleepRate)) {
+            sleeping.store(true, std::memory_order_relaxed);
         }
-        
-        // Clear additional channels
-        for (int ch = 2; ch < numOutputChannels; ++ch) {
-            if (outputChannelData[ch]) {
-                juce::FloatVectorOperations::clear(outputChannelData[ch], numSamples);
-            }
+    }
+
+    // Audio thread: follows note-ons and note-offs, so a held note keeps the source awake even
+    // while it is quiet
+    void trackHeldNotes(const InstrumentEvent& event) {
+        if (event.type == InstrumentEvent::allNotesOff) {
+            heldNotes.fill(false);
+            numHeldNotes = 0;
+            return;
+        }
+        if (event.type != InstrumentEvent::midi || event.size < 3) return;
+
+        const int status = event.data[0] & 0xF0;
+        const size_t index = (size_t)(event.data[0] & 0x0F) * 128 + (event.data[1] & 0x7F);
+        if (isNoteOn(event)) {
+            if (!heldNotes[index]) ++numHeldNotes;
+            heldNotes[index] = true;
+        } else if (status == 0x80 || status == 0x90) {
+            if (heldNotes[index]) --numHeldNotes;
+            heldNotes[index] = false;
+        } else if (status == 0xB0 && (event.data[1] == 120 || event.data[1] == 123)) {
+            heldNotes.fill(false);
+            numHeldNotes = 0;
         }
     }
-    
-    void audioDeviceAboutToStart(juce::AudioIODevice* device) override {
-        if (device && sf) {
-            double newRate = device->getCurrentSampleRate();
-            if (newRate != bufferSampleRate) {
-                bufferSampleRate = newRate;
-                tsf_set_output(sf, TSF_STEREO_INTERLEAVED, (int)newRate, 0.0f);
-            }
+
+    // Audio thread, at the end of render()
+    void publishTelemetry(int voices) {
+        activeVoices.store(voices, std::memory_order_relaxed);
+        queueDepth.store(events.getNumPending(), std::memory_order_relaxed);
+    }
+
+    EventScheduler<InstrumentEvent> events;
+
+private:
+    static bool isNoteOn(const InstrumentEvent& event) {
+        return event.type == InstrumentEvent::midi && event.size >= 3
+            && (event.data[0] & 0xF0) == 0x90 && event.data[2] > 0;
+    }
+
+    juce::int64 renderedUntil = 0; // engine time after the last block
+    double eventRate = 0.0;        // rate the queued event times are based on, 0 until prepared
+    std::atomic<int> activeVoices { 0 };
+    std::atomic<int> queueDepth { 0 };
+
+    const TrackSleepSettings* sleep; // nullptr: never sleeps
+    double sleepRate = 44100.0;
+    juce::int64 quietSamples = 0;
+    std::atomic<bool> sleeping { false };
+    std::array<bool, 16 * 128> heldNotes {}; // channel * 128 + note
+    int numHeldNotes = 0;
+};
+
+// SF2 mixer source for TinySoundFont rendering. All tsf_channel_* calls for a live track go
+// through events so they happen on the audio thread, split at their sample offset. Voices come
+// preallocated from SoundFontBank and the render buffer is sized in prepare(), so render() never
+// allocates.
+class SF2Source : public InstrumentSource {
+public:
+    SF2Source(tsf* soundFont, double sampleRate, const TrackSleepSettings& sleepSettings)
+        : InstrumentSource(&sleepSettings), sf(soundFont), outputRate(sampleRate) {
+        if (sf) {
+            tsf_set_output(sf, TSF_STEREO_UNWEAVED, (int)sampleRate, 0.0f);
         }
     }
-    
-    void audioDeviceStopped() override {
+
+    void prepare(double sampleRate, int maxBlockSize) override {
+        outputRate = sampleRate;
+        carryOverEvents(sampleRate);
+        resetSleep(sampleRate);
+        planar.assign((size_t)juce::jmax(1, maxBlockSize) * 2, 0.0f);
+        if (sf) {
+            tsf_set_output(sf, TSF_STEREO_UNWEAVED, (int)sampleRate, 0.0f);
+        }
+    }
+
+    // Any thread; takes effect from the next note-on
+    void setVoiceBudget(int limit, SoundFontBank::VoiceStealing policy) {
+        voiceLimit = limit;
+        voiceStealing = policy;
+    }
+
+    void release() override {
         if (sf) {
             tsf_note_off_all(sf);
         }
     }
-    
+
+    void render(juce::AudioBuffer<float>& bus, int numSamples, juce::int64 blockStart) override {
+        if (!sf) return;
+
+        events.collect();
+        markRendered(blockStart + numSamples);
+        if (sleepsThrough(blockStart + numSamples)) {
+            publishTelemetry(0);
+            return;
+        }
+
+        int rendered = 0;
+        while (const auto* due = events.nextDue(blockStart + numSamples)) {
+            const InstrumentEvent event = *due;
+            events.popNext();
+
+            const int offset = juce::jmax(rendered, EventScheduler<InstrumentEvent>::offsetInBlock(event, blockStart, numSamples));
+            renderSegment(bus, rendered, offset - rendered);
+            rendered = offset;
+            apply(event);
+            trackHeldNotes(event); // a held note keeps the track awake even at a zero-level envelope
+        }
+        renderSegment(bus, rendered, numSamples - rendered);
+        const int voices = tsf_active_voice_count(sf);
+        updateSleep(bus, numSamples, voices > 0);
+        publishTelemetry(voices);
+    }
+
     tsf* getSoundFont() const { return sf; }
-    
+
 private:
+    void apply(const InstrumentEvent& event) {
+        switch (event.type) {
+            case InstrumentEvent::midi: {
+                if (event.size < 3) break;
+                const int status = event.data[0] & 0xF0;
+                const int channel = event.data[0] & 0x0F;
+                if (status == 0x90 && event.data[2] > 0) {
+                    tsf_channel_note_on(sf, channel, event.data[1], event.data[2] / 127.0f);
+                    SoundFontBank::enforceVoiceLimit(sf, voiceLimit.load(std::memory_order_relaxed),
+                                                     voiceStealing.load(std::memory_order_relaxed));
+                } else if (status == 0x80 || status == 0x90) {
+                    tsf_channel_note_off(sf, channel, event.data[1]);
+                } else if (status == 0xB0) {
+                    tsf_channel_midi_control(sf, channel, event.data[1], event.data[2]);
+                }
+                break;
+            }
+            case InstrumentEvent::allNotesOff:
+                for (int ch = 0; ch < 16; ++ch) {
+                    tsf_channel_note_off_all(sf, ch);
+                }
+                break;
+            case InstrumentEvent::setPreset:
+                for (int ch = 0; ch < 16; ++ch) {
+                    tsf_channel_set_presetindex(sf, ch, event.presetIndex);
+                }
+                break;
+        }
+    }
+
+    void renderSegment(juce::AudioBuffer<float>& bus, int startSample, int numSamples) {
+        // Unweaved output puts the left block then the right block of each render in planar, so
+        // two vector copies fill the bus (gain is ramped by the mixer)
+        const int maxChunk = (int)planar.size() / 2;
+        for (int done = 0; done < numSamples && maxChunk > 0;) {
+            const int chunk = juce::jmin(maxChunk, numSamples - done);
+            tsf_render_float(sf, planar.data(), chunk, 0);
+            juce::FloatVectorOperations::copy(bus.getWritePointer(0, startSample + done), planar.data(), chunk);
+            juce::FloatVectorOperations::copy(bus.getWritePointer(1, startSample + done), planar.data() + chunk, chunk);
+            done += chunk;
+        }
+    }
+
     tsf* sf;
-    float* gainLinearPtr;
-    double bufferSampleRate;
-    std::vector<float> tempBuffer;
-    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(SF2AudioCallback)
+    double outputRate;
+    std::vector<float> planar; // left block then right block, sized by prepare()
+    std::atomic<int> voiceLimit { SoundFontBank::maxVoices };
+    std::atomic<SoundFontBank::VoiceStealing> voiceStealing { SoundFontBank::VoiceStealing::releasing };
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(SF2Source)
 };
 
-// Custom audio callback that wraps AudioProcessorPlayer and applies gain
-class GainAudioCallback : public juce::AudioIODeviceCallback {
+// Mixer source that drives a plugin instance directly (replaces AudioProcessorPlayer)
+class PluginSource : public InstrumentSource {
 public:
-    GainAudioCallback(juce::AudioProcessorPlayer* player, float* gainPtr)
-        : player(player), gainLinearPtr(gainPtr) {}
-    
-    void audioDeviceIOCallbackWithContext(const float* const* inputChannelData,
-                                          int numInputChannels,
-                                          float* const* outputChannelData,
-                                          int numOutputChannels,
-                                          int numSamples,
-                                          const juce::AudioIODeviceCallbackContext& context) override {
-        // Let the player process audio
-        player->audioDeviceIOCallbackWithContext(inputChannelData, numInputChannels,
-                                                  outputChannelData, numOutputChannels,
-                                                  numSamples, context);
-        
-        // Apply gain to output
-        const float gain = *gainLinearPtr;
-        if (gain != 1.0f) {
-            for (int ch = 0; ch < numOutputChannels; ++ch) {
-                if (outputChannelData[ch]) {
-                    juce::FloatVectorOperations::multiply(outputChannelData[ch], gain, numSamples);
+    // Only instruments sleep: a plugin without MIDI input may make sound on its own
+    PluginSource(juce::AudioPluginInstance& instance, const TrackSleepSettings& sleepSettings)
+        : InstrumentSource(instance.acceptsMidi() ? &sleepSettings : nullptr), plugin(instance) {}
+
+    void prepare(double sampleRate, int maxBlockSize) override {
+        const int numChannels = juce::jmax(2, plugin.getTotalNumInputChannels(), plugin.getTotalNumOutputChannels());
+        processBuffer.setSize(numChannels, juce::jmax(1, maxBlockSize));
+        midiBuffer.ensureSize(8192);
+        carryOverEvents(sampleRate);
+        resetSleep(sampleRate);
+
+        plugin.setRateAndBufferSizeDetails(sampleRate, maxBlockSize);
+        plugin.prepareToPlay(sampleRate, maxBlockSize);
+    }
+
+    // Notes still sounding would otherwise hang in plugins that keep their voices across a
+    // re-prepare, since the note-offs they were waiting for may have been dropped
+    void release() override {
+        {
+            const juce::ScopedLock sl(plugin.getCallbackLock());
+            if (!plugin.isSuspended() && plugin.acceptsMidi() && processBuffer.getNumSamples() > 0) {
+                midiBuffer.clear();
+                for (int ch = 1; ch <= 16; ++ch) {
+                    midiBuffer.addEvent(juce::MidiMessage::allNotesOff(ch), 0);
                 }
+                juce::AudioBuffer<float> block(processBuffer.getArrayOfWritePointers(), processBuffer.getNumChannels(),
+                                               juce::jmin(processBuffer.getNumSamples(), 64));
+                block.clear();
+                plugin.processBlock(block, midiBuffer);
+                midiBuffer.clear();
             }
         }
+        plugin.releaseResources();
     }
-    
-    void audioDeviceAboutToStart(juce::AudioIODevice* device) override {
-        player->audioDeviceAboutToStart(device);
+
+    // Parameter values only change once per device block, like the offline PluginRenderer's blocks
+    void applyParameterAutomation(const TrackAutomation& automation, double seconds) override {
+        automation.applyParameters(plugin, seconds);
     }
-    
-    void audioDeviceStopped() override {
-        player->audioDeviceStopped();
+
+    void render(juce::AudioBuffer<float>& bus, int numSamples, juce::int64 blockStart) override {
+        midiBuffer.clear();
+        events.collect();
+        markRendered(blockStart + numSamples);
+        if (sleepsThrough(blockStart + numSamples)) {
+            publishTelemetry(0);
+            return;
+        }
+
+        while (const auto* due = events.nextDue(blockStart + numSamples)) {
+            const InstrumentEvent event = *due;
+            events.popNext();
+            trackHeldNotes(event);
+
+            const int offset = EventScheduler<InstrumentEvent>::offsetInBlock(event, blockStart, numSamples);
+            if (event.type == InstrumentEvent::midi && event.size > 0) {
+                midiBuffer.addEvent(event.data, event.size, offset);
+            } else if (event.type == InstrumentEvent::allNotesOff) {
+                for (int ch = 1; ch <= 16; ++ch) {
+                    midiBuffer.addEvent(juce::MidiMessage::allNotesOff(ch), offset);
+                }
+            }
+        }
+        publishTelemetry(0); // plugins don't report their voices
+
+        const juce::ScopedLock sl(plugin.getCallbackLock());
+        if (plugin.isSuspended()) return;
+
+        juce::AudioBuffer<float> block(processBuffer.getArrayOfWritePointers(), processBuffer.getNumChannels(), numSamples);
+        block.clear();
+        plugin.processBlock(block, midiBuffer);
+
+        const int numOutputs = plugin.getTotalNumOutputChannels();
+        if (numOutputs <= 0) return;
+        bus.copyFrom(0, 0, block, 0, 0, numSamples);
+        bus.copyFrom(1, 0, block, numOutputs > 1 ? 1 : 0, 0, numSamples);
+        updateSleep(bus, numSamples, false);
     }
-    
+
 private:
-    juce::AudioProcessorPlayer* player;
-    float* gainLinearPtr;
-    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(GainAudioCallback)
+    juce::AudioPluginInstance& plugin;
+    juce::MidiBuffer midiBuffer;
+    juce::AudioBuffer<float> processBuffer;
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(PluginSource)
 };
 
-// Shared beat-sample mixer across all beat tracks
-class BeatAudioCallback : public juce::AudioIODeviceCallback {
+// Plays a frozen track's stem, streamed from disk (see ClipStream), in place of its instrument
+class StemSource : public MixerSource {
 public:
-    BeatAudioCallback(
-        std::map<juce::String, std::map<juce::String, std::shared_ptr<BeatSample>>>& samples,
-        std::map<juce::String, std::vector<BackendHost::BeatVoice>>& voices,
-        juce::CriticalSection& lock)
-        : sampleMap(samples), voiceMap(voices), mapLock(lock) {}
-
-    void audioDeviceIOCallbackWithContext(const float* const* /*inputChannelData*/,
-                                          int /*numInputChannels*/,
-                                          float* const* outputChannelData,
-                                          int numOutputChannels,
-                                          int numSamples,
-                                          const juce::AudioIODeviceCallbackContext& /*context*/) override {
-        if (!outputChannelData || numSamples <= 0 || numOutputChannels <= 0) return;
-
-        // Clear output buffer before mixing beat voices to avoid stale data buzzing
-        for (int ch = 0; ch < numOutputChannels; ++ch) {
-            if (outputChannelData[ch]) {
-                juce::FloatVectorOperations::clear(outputChannelData[ch], numSamples);
-            }
+    StemSource(std::unique_ptr<juce::AudioFormatReader> reader, juce::TimeSliceThread& readAheadThread)
+        : stream(std::move(reader), readAheadThread) {}
+
+    // Message thread, while detached from the mixer (repositioning isn't safe while the audio
+    // thread reads): plays from offsetSeconds into the stem, starting at engine time startTime
+    void cue(juce::int64 startTime, double offsetSeconds) {
+        stream.setPosition(offsetSeconds);
+        start.store(startTime);
+        stop.store(std::numeric_limits<juce::int64>::max());
+    }
+
+    // Any thread
+    void stopAt(juce::int64 time) { stop.store(time); }
+
+    void prepare(double sampleRate, int maxBlockSize) override {
+        stream.prepare(sampleRate, maxBlockSize);
+    }
+
+    void release() override {
+        stream.release();
+    }
+
+    void render(juce::AudioBuffer<float>& bus, int numSamples, juce::int64 blockStart) override {
+        const juce::int64 startTime = start.load(std::memory_order_relaxed);
+        if (startTime < 0) return; // not cued
+        const juce::int64 from = juce::jmax(blockStart, startTime);
+        const juce::int64 to = juce::jmin(blockStart + numSamples, stop.load(std::memory_order_relaxed));
+
+        // Sample-accurate start and stop within the block
+        if (to > from) stream.render(bus, (int)(from - blockStart), (int)(to - from));
+    }
+
+private:
+    ClipStream stream;
+    std::atomic<juce::int64> start { -1 }; // engine time playback starts, -1 until cued
+    std::atomic<juce::int64> stop { std::numeric_limits<juce::int64>::max() };
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(StemSource)
+};
+
+// Command posted from the message thread to a sample voice engine
+struct VoiceCommand {
+    enum Type : uint8_t { startVoice, releaseNote, stopSample, stopAll, cancelScheduled };
+
+    juce::int64 time = 0; // engine sample time, 0 = immediately
+    Type type = startVoice;
+    const BeatSample* sample = nullptr;
+    float gain = 1.0f;
+    int midiNote = -1;
+    double playbackRate = 1.0;
+    uint32_t serial = 0; // non-zero for commands the message thread waits on
+};
+
+// Shared plumbing for the beat and sampler engines. The message thread posts timestamped
+// commands and the audio thread owns the fixed voice pool, so render() never locks or
+// allocates; each block is rendered in segments split at the commands' sample offsets.
+// Voices reference samples by raw pointer; the owning shared_ptr of a replaced sample is
+// kept here until the audio thread has acknowledged the matching stopSample.
+class SampleVoiceSource : public MixerSource {
+public:
+    static constexpr int commandQueueSize = 1024;
+
+    SampleVoiceSource() : commands(commandQueueSize) {}
+
+    // Any non-audio thread; callers serialise through the owning track map's lock.
+    // stopAll and cancelScheduled also drop commands scheduled for later.
+    // Returns false if the command queue is full.
+    bool post(const VoiceCommand& command) {
+        collectRetiredSamples();
+        const bool cancels = command.type == VoiceCommand::stopAll || command.type == VoiceCommand::cancelScheduled;
+        return commands.push(command, cancels);
+    }
+
+    // Message thread: stops every voice playing sample and frees it once that is safe
+    void retireSample(std::shared_ptr<const BeatSample> sample) {
+        if (!sample) return;
+        retired.push_back({ 0, std::move(sample) });
+        collectRetiredSamples();
+    }
+
+    void stopAllVoices() {
+        VoiceCommand command;
+        command.type = VoiceCommand::stopAll;
+        post(command);
+    }
+
+    // Drops scheduled commands without cutting voices that are already sounding
+    void cancelScheduled() {
+        VoiceCommand command;
+        command.type = VoiceCommand::cancelScheduled;
+        post(command);
+    }
+
+    void prepare(double sampleRate, int /*maxBlockSize*/) override {
+        currentRate = sampleRate;
+
+        // The device was not pulling audio, so drop stale note-ons instead of firing them all at
+        // once; releases and stops due meanwhile still happen
+        commands.collect();
+        while (const auto* due = commands.nextDue(renderedUntil + 1)) {
+            const VoiceCommand command = *due;
+            commands.popNext();
+            if (command.type != VoiceCommand::startVoice) dispatch(command);
+            else acknowledge(command);
         }
 
-        const juce::ScopedLock sl(mapLock);
-        juce::ignoreUnused(sampleMap);
-        if (voiceMap.empty()) return;
+        // Commands for later keep their place on the timeline, which the mixer has rescaled
+        if (commandRate > 0.0 && sampleRate > 0.0 && commandRate != sampleRate) {
+            const double scale = sampleRate / commandRate;
+            auto rescale = [scale](juce::int64 time) { return (juce::int64)std::llround((double)time * scale); };
+            commands.retime(rescale);
+            renderedUntil = rescale(renderedUntil);
+        }
+        commandRate = sampleRate;
+    }
 
-        for (auto& [trackId, voices] : voiceMap) {
-            juce::ignoreUnused(trackId);
-            for (auto it = voices.begin(); it != voices.end();) {
-                auto& voice = *it;
-                auto samplePtr = voice.sample;
-                if (!samplePtr || samplePtr->buffer.getNumSamples() == 0) {
-                    it = voices.erase(it);
-                    continue;
-                }
+    void render(juce::AudioBuffer<float>& bus, int numSamples, juce::int64 blockStart) override {
+        commands.collect();
+        int rendered = 0;
+        while (const auto* due = commands.nextDue(blockStart + numSamples)) {
+            const VoiceCommand command = *due;
+            commands.popNext();
 
-                const int sourceSamples = samplePtr->buffer.getNumSamples();
-                const int sourceChannels = samplePtr->buffer.getNumChannels();
-                const double ratio = (currentRate > 0.0) ? (samplePtr->sampleRate / currentRate) : 1.0;
+            const int offset = juce::jmax(rendered, EventScheduler<VoiceCommand>::offsetInBlock(command, blockStart, numSamples));
+            renderSegment(bus, rendered, offset - rendered);
+            rendered = offset;
+            dispatch(command);
+        }
+        renderSegment(bus, rendered, numSamples - rendered);
+        renderedUntil = blockStart + numSamples;
 
-                double pos = voice.position;
-                bool finished = false;
+        activeVoices.store(getNumVoices(), std::memory_order_relaxed);
+        queueDepth.store(commands.getNumPending(), std::memory_order_relaxed);
+    }
 
-                for (int i = 0; i < numSamples; ++i) {
-                    const int idx = static_cast<int>(pos);
-                    if (idx >= sourceSamples) { finished = true; break; }
+    int getActiveVoices() const override { return activeVoices.load(std::memory_order_relaxed); }
+    int getQueueDepth() const override { return queueDepth.load(std::memory_order_relaxed); }
 
-                    const double frac = pos - static_cast<double>(idx);
+protected:
+    // Audio thread
+    virtual void handleCommand(const VoiceCommand& command) = 0;
+    virtual void renderVoices(juce::AudioBuffer<float>& segment, int numSamples) = 0;
+    virtual int getNumVoices() const = 0;
 
-                    for (int ch = 0; ch < numOutputChannels; ++ch) {
-                        if (!outputChannelData[ch]) continue;
-                        const int srcCh = (sourceChannels == 1) ? 0 : juce::jmin(ch, sourceChannels - 1);
-                        const float s0 = samplePtr->buffer.getSample(srcCh, idx);
-                        const float s1 = (idx + 1 < sourceSamples) ? samplePtr->buffer.getSample(srcCh, idx + 1) : 0.0f;
-                        const float blended = static_cast<float>((1.0 - frac) * s0 + frac * s1);
-                        outputChannelData[ch][i] += blended * voice.gain;
-                    }
+    double currentRate = 44100.0;
 
-                    pos += ratio;
-                }
+private:
+    struct RetiredSample {
+        uint32_t serial = 0; // 0 until the stopSample command has been queued
+        std::shared_ptr<const BeatSample> sample;
+    };
 
-                voice.position = pos;
-                if (finished || pos >= sourceSamples) {
-                    it = voices.erase(it);
-                } else {
-                    ++it;
-                }
-            }
+    void dispatch(const VoiceCommand& command) {
+        handleCommand(command);
+
+        // Note-ons scheduled for later must not outlive the sample they point at
+        if (command.type == VoiceCommand::stopSample) {
+            commands.removePending([&command](const VoiceCommand& pending) {
+                return pending.type == VoiceCommand::startVoice && pending.sample == command.sample;
+            });
         }
+        acknowledge(command);
     }
 
-    void audioDeviceAboutToStart(juce::AudioIODevice* device) override {
-        currentRate = device ? device->getCurrentSampleRate() : 44100.0;
+    void renderSegment(juce::AudioBuffer<float>& bus, int startSample, int numSamples) {
+        if (numSamples <= 0) return;
+        juce::AudioBuffer<float> segment(bus.getArrayOfWritePointers(), bus.getNumChannels(), startSample, numSamples);
+        renderVoices(segment, numSamples);
     }
 
-    void audioDeviceStopped() override {
-        currentRate = 44100.0;
+    void acknowledge(const VoiceCommand& command) {
+        if (command.serial != 0) {
+            ackedSerial.store(command.serial, std::memory_order_release);
+        }
     }
 
-private:
-    std::map<juce::String, std::map<juce::String, std::shared_ptr<BeatSample>>>& sampleMap;
-    std::map<juce::String, std::vector<BackendHost::BeatVoice>>& voiceMap;
-    juce::CriticalSection& mapLock;
-    double currentRate = 44100.0;
+    void collectRetiredSamples() {
+        for (auto& entry : retired) {
+            if (entry.serial != 0) continue;
+
+            VoiceCommand command;
+            command.type = VoiceCommand::stopSample;
+            command.sample = entry.sample.get();
+            command.serial = nextSerial;
+            if (!commands.push(command)) break;
+
+            entry.serial = nextSerial;
+            if (++nextSerial == 0) nextSerial = 1;
+        }
+
+        const uint32_t acked = ackedSerial.load(std::memory_order_acquire);
+        retired.erase(std::remove_if(retired.begin(), retired.end(), [acked](const RetiredSample& entry) {
+                          return entry.serial != 0 && static_cast<int32_t>(acked - entry.serial) >= 0;
+                      }),
+                      retired.end());
+    }
+
+    EventScheduler<VoiceCommand> commands;
+    juce::int64 renderedUntil = 0;           // audio thread: engine time after the last block
+    double commandRate = 0.0;                // rate the queued command times are based on
+    std::atomic<uint32_t> ackedSerial { 0 };
+    std::atomic<int> activeVoices { 0 };
+    std::atomic<int> queueDepth { 0 };
+    uint32_t nextSerial = 1;                 // producer side, under the track map lock
+    std::vector<RetiredSample> retired;      // producer side, under the track map lock
 };
 
-// Sampler audio callback for polyphonic sample playback with pitch shifting
-class SamplerAudioCallback : public juce::AudioIODeviceCallback {
+// Beat voice engine for one beat track (one-shot samples at the source rate)
+class BeatTrackSource : public SampleVoiceSource {
 public:
-    SamplerAudioCallback(
-        std::map<juce::String, std::shared_ptr<BeatSample>>& samples,
-        std::map<juce::String, std::vector<BackendHost::SamplerVoice>>& voices,
-        juce::CriticalSection& lock)
-        : sampleMap(samples), voiceMap(voices), mapLock(lock) {}
-
-    void audioDeviceIOCallbackWithContext(const float* const* /*inputChannelData*/,
-                                          int /*numInputChannels*/,
-                                          float* const* outputChannelData,
-                                          int numOutputChannels,
-                                          int numSamples,
-                                          const juce::AudioIODeviceCallbackContext& /*context*/) override {
-        if (!outputChannelData || numSamples <= 0 || numOutputChannels <= 0) return;
-
-        // Clear output buffer
-        for (int ch = 0; ch < numOutputChannels; ++ch) {
-            if (outputChannelData[ch]) {
-                juce::FloatVectorOperations::clear(outputChannelData[ch], numSamples);
+    static constexpr int maxVoices = 64;
+
+    bool trigger(const BeatSample* sample, float gain, juce::int64 time = 0) {
+        VoiceCommand command;
+        command.time = time;
+        command.type = VoiceCommand::startVoice;
+        command.sample = sample;
+        command.gain = gain;
+        return post(command);
+    }
+
+    void prepare(double sampleRate, int maxBlockSize) override {
+        SampleVoiceSource::prepare(sampleRate, maxBlockSize);
+        for (int v = 0; v < numVoices; ++v) voices[(size_t)v].ratio = ratioFor(*voices[(size_t)v].sample);
+    }
+
+private:
+    struct Voice {
+        const BeatSample* sample = nullptr;
+        double position = 0.0; // position in source samples
+        double ratio = 1.0;    // source samples per output sample; exactly 1 for a prepared sample
+        float gain = 1.0f;
+        uint32_t startOrder = 0;
+    };
+
+    double ratioFor(const BeatSample& sample) const {
+        return (currentRate > 0.0) ? (sample.sampleRate / currentRate) : 1.0;
+    }
+
+    void handleCommand(const VoiceCommand& command) override {
+        switch (command.type) {
+            case VoiceCommand::startVoice: {
+                if (!command.sample || command.sample->getNumSamples() == 0) break;
+
+                // Pool exhausted: steal the oldest voice
+                int index = numVoices;
+                if (numVoices == maxVoices) {
+                    index = 0;
+                    for (int v = 1; v < numVoices; ++v) {
+                        if (voices[(size_t)v].startOrder < voices[(size_t)index].startOrder) index = v;
+                    }
+                } else {
+                    ++numVoices;
+                }
+
+                auto& voice = voices[(size_t)index];
+                voice.sample = command.sample;
+                voice.position = 0.0;
+                voice.ratio = ratioFor(*command.sample);
+                voice.gain = command.gain;
+                voice.startOrder = nextStartOrder++;
+                break;
             }
+            case VoiceCommand::stopSample:
+                for (int v = 0; v < numVoices;) {
+                    if (voices[(size_t)v].sample == command.sample) {
+                        voices[(size_t)v] = voices[(size_t)--numVoices];
+                    } else {
+                        ++v;
+                    }
+                }
+                break;
+            case VoiceCommand::stopAll:
+                numVoices = 0;
+                break;
+            case VoiceCommand::releaseNote:
+            case VoiceCommand::cancelScheduled:
+                break;
         }
+    }
 
-        const juce::ScopedLock sl(mapLock);
-        juce::ignoreUnused(sampleMap);
-        if (voiceMap.empty()) return;
+    int getNumVoices() const override { return numVoices; }
 
-        for (auto& [trackId, voices] : voiceMap) {
-            juce::ignoreUnused(trackId);
-            for (auto it = voices.begin(); it != voices.end();) {
-                auto& voice = *it;
-                auto samplePtr = voice.sample;
-                if (!samplePtr || samplePtr->buffer.getNumSamples() == 0 || !voice.active) {
-                    it = voices.erase(it);
-                    continue;
-                }
+    void renderVoices(juce::AudioBuffer<float>& bus, int numSamples) override {
+        for (int v = 0; v < numVoices;) {
+            if (renderVoice(voices[(size_t)v], bus, numSamples)) {
+                ++v;
+            } else {
+                voices[(size_t)v] = voices[(size_t)--numVoices]; // swap and pop
+            }
+        }
+    }
 
-                const int sourceSamples = samplePtr->buffer.getNumSamples();
-                const int sourceChannels = samplePtr->buffer.getNumChannels();
-                const double baseRatio = (currentRate > 0.0) ? (samplePtr->sampleRate / currentRate) : 1.0;
-                const double pitchRatio = voice.playbackRate * baseRatio;
+    // Returns false once the voice has finished
+    bool renderVoice(Voice& voice, juce::AudioBuffer<float>& bus, int numSamples) {
+        const auto* samplePtr = voice.sample;
+        const int written = Resampler::mix(samplePtr->getSource(), voice.position, voice.ratio,
+                                           bus.getArrayOfWritePointers(), bus.getNumChannels(),
+                                           numSamples, voice.gain);
+        return written == numSamples && voice.position < samplePtr->getNumSamples();
+    }
 
-                double pos = voice.position;
-                bool finished = false;
+    std::array<Voice, maxVoices> voices;
+    int numVoices = 0;
+    uint32_t nextStartOrder = 0;
+};
 
-                for (int i = 0; i < numSamples; ++i) {
-                    const int idx = static_cast<int>(pos);
-                    if (idx >= sourceSamples) { finished = true; break; }
+// Sampler voice engine for one sampler track (one sample pitched across the keyboard). Held
+// notes are capped by the track's voice budget; stolen and released voices fade out on their
+// envelopes instead of stopping dead (see SamplerVoices).
+class SamplerTrackSource : public SampleVoiceSource {
+public:
+    bool noteOn(const BeatSample* sample, int midiNote, float gain, double playbackRate, juce::int64 time = 0) {
+        VoiceCommand command;
+        command.time = time;
+        command.type = VoiceCommand::startVoice;
+        command.sample = sample;
+        command.midiNote = midiNote;
+        command.gain = gain;
+        command.playbackRate = playbackRate;
+        return post(command);
+    }
 
-                    const double frac = pos - static_cast<double>(idx);
+    bool noteOff(int midiNote, juce::int64 time = 0) {
+        VoiceCommand command;
+        command.time = time;
+        command.type = VoiceCommand::releaseNote;
+        command.midiNote = midiNote;
+        return post(command);
+    }
 
-                    for (int ch = 0; ch < numOutputChannels; ++ch) {
-                        if (!outputChannelData[ch]) continue;
-                        const int srcCh = (sourceChannels == 1) ? 0 : juce::jmin(ch, sourceChannels - 1);
-                        const float s0 = samplePtr->buffer.getSample(srcCh, idx);
-                        const float s1 = (idx + 1 < sourceSamples) ? samplePtr->buffer.getSample(srcCh, idx + 1) : 0.0f;
-                        const float blended = static_cast<float>((1.0 - frac) * s0 + frac * s1);
-                        outputChannelData[ch][i] += blended * voice.gain;
-                    }
+    // Any thread; applies from the next note-on
+    void setVoiceBudget(int limit, SoundFontBank::VoiceStealing policy) {
+        voiceLimit.store(juce::jlimit(1, SamplerVoices::maxVoices, limit), std::memory_order_relaxed);
+        voiceStealing.store(policy, std::memory_order_relaxed);
+    }
+
+    void prepare(double sampleRate, int maxBlockSize) override {
+        scratch.setSize(MasterMixer::busChannels, juce::jmax(1, maxBlockSize));
+        SampleVoiceSource::prepare(sampleRate, maxBlockSize);
+    }
 
-                    pos += pitchRatio;
+private:
+    struct Voice {
+        const BeatSample* sample = nullptr;
+        double position = 0.0;
+        float gain = 1.0f;
+        int midiNote = 60;         // The MIDI note being played
+        double playbackRate = 1.0; // Pitch shift based on note
+        uint32_t startOrder = 0;
+        SamplerVoices::Envelope envelope;
+    };
+
+    void handleCommand(const VoiceCommand& command) override {
+        switch (command.type) {
+            case VoiceCommand::startVoice: {
+                if (!command.sample || command.sample->getNumSamples() == 0) break;
+
+                // Over budget: the policy's victim fades out quickly, or the new note is dropped
+                int held = 0;
+                for (int v = 0; v < numVoices; ++v) {
+                    if (!voices[(size_t)v].envelope.isReleasing()) ++held;
+                }
+                if (held >= voiceLimit.load(std::memory_order_relaxed)) {
+                    const int victim = SamplerVoices::findVoiceToSteal(voices.data(), numVoices,
+                                                                       voiceStealing.load(std::memory_order_relaxed));
+                    if (victim < 0) break;
+                    voices[(size_t)victim].envelope.release(currentRate, SamplerVoices::stealSeconds);
                 }
 
-                voice.position = pos;
-                if (finished || pos >= sourceSamples) {
-                    it = voices.erase(it);
+                // Pool full of fading voices: the quietest of them is cut
+                int index = numVoices;
+                if (numVoices == SamplerVoices::poolSize) {
+                    index = SamplerVoices::findVoiceToCut(voices.data(), numVoices);
+                    if (index < 0) break;
                 } else {
-                    ++it;
+                    ++numVoices;
                 }
+
+                auto& voice = voices[(size_t)index];
+                voice.sample = command.sample;
+                voice.position = 0.0;
+                voice.gain = command.gain;
+                voice.midiNote = command.midiNote;
+                voice.playbackRate = command.playbackRate;
+                voice.startOrder = nextStartOrder++;
+                voice.envelope.start(currentRate);
+                break;
             }
+            case VoiceCommand::releaseNote:
+                for (int v = 0; v < numVoices; ++v) {
+                    if (voices[(size_t)v].midiNote == command.midiNote) voices[(size_t)v].envelope.release(currentRate);
+                }
+                break;
+            case VoiceCommand::stopSample:
+                // The sample is about to be freed, so its voices can't fade out
+                for (int v = 0; v < numVoices;) {
+                    if (voices[(size_t)v].sample == command.sample) {
+                        voices[(size_t)v] = voices[(size_t)--numVoices];
+                    } else {
+                        ++v;
+                    }
+                }
+                break;
+            case VoiceCommand::stopAll:
+                for (int v = 0; v < numVoices; ++v) {
+                    voices[(size_t)v].envelope.release(currentRate, SamplerVoices::stealSeconds);
+                }
+                break;
+            case VoiceCommand::cancelScheduled:
+                break;
         }
     }
 
-    void audioDeviceAboutToStart(juce::AudioIODevice* device) override {
-        currentRate = device ? device->getCurrentSampleRate() : 44100.0;
+    int getNumVoices() const override { return numVoices; }
+
+    void renderVoices(juce::AudioBuffer<float>& bus, int numSamples) override {
+        for (int v = 0; v < numVoices;) {
+            if (renderVoice(voices[(size_t)v], bus, numSamples)) {
+                ++v;
+            } else {
+                voices[(size_t)v] = voices[(size_t)--numVoices]; // swap and pop
+            }
+        }
     }
 
-    void audioDeviceStopped() override {
-        currentRate = 44100.0;
+    // Returns false once the voice has finished
+    bool renderVoice(Voice& voice, juce::AudioBuffer<float>& bus, int numSamples) {
+        const auto* samplePtr = voice.sample;
+        const double baseRatio = (currentRate > 0.0) ? (samplePtr->sampleRate / currentRate) : 1.0;
+        const double pitchRatio = voice.playbackRate * baseRatio;
+
+        const int written = SamplerVoices::mix(samplePtr->getSource(), voice.position, pitchRatio, voice.envelope,
+                                               voice.gain, bus, 0, numSamples, scratch);
+        return written == numSamples && !voice.envelope.isFinished()
+               && voice.position < samplePtr->getNumSamples();
     }
 
-private:
-    std::map<juce::String, std::shared_ptr<BeatSample>>& sampleMap;
-    std::map<juce::String, std::vector<BackendHost::SamplerVoice>>& voiceMap;
-    juce::CriticalSection& mapLock;
-    double currentRate = 44100.0;
+    std::array<Voice, SamplerVoices::poolSize> voices;
+    int numVoices = 0;
+    uint32_t nextStartOrder = 0;
+    juce::AudioBuffer<float> scratch; // ramped envelope runs before they are summed
+    std::atomic<int> voiceLimit { SamplerVoices::maxVoices };
+    std::atomic<SoundFontBank::VoiceStealing> voiceStealing { SoundFontBank::VoiceStealing::oldest };
 };
 
 // Simple window to host the plugin's editor
@@ -339,71 +852,81 @@ private:
     JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(PluginEditorWindow)
 };
 
-namespace {
-// Utility to emit structured logs to stdout for the Electron bridge
-void emit(const juce::String& msg) {
-    std::cout << msg << std::endl;
-    std::cout.flush();
-}
-}
+// Structured logs for the Electron bridge go through the buffered event stream
+using EventOutput::emit;
 
-BackendHost::BackendHost() {
-    // Manually register VST3 format (addDefaultFormats is deleted in console builds)
-#if JUCE_PLUGINHOST_VST3
-    formatManager.addFormat(std::make_unique<juce::VST3PluginFormat>());
-#endif
+BackendHost::BackendHost(bool openAudioDevice) : usesAudioDevice(openAudioDevice) {
+    PluginCache::addFormats(formatManager);
+    pluginCache = std::make_unique<PluginCache>(formatManager);
     beatFormatManager.registerBasicFormats();
+    rootNotes = std::make_unique<RootNoteCache>();
+    diskReadAhead.startThread();
+    sampleCache = std::make_unique<SampleCache>(beatFormatManager);
+    peakCache = std::make_unique<PeakCache>(beatFormatManager);
+
+    // Beat rows' device-rate copies are remade for the new rate
+    juce::WeakReference<BackendHost> weakThis(this);
+    mixer.onSampleRateChanged = [weakThis](double) {
+        juce::MessageManager::callAsync([weakThis] {
+            if (auto* host = weakThis.get()) host->refreshPreparedSamples();
+        });
+    };
+    if (!openAudioDevice) return;
     prepareDevice();
 
-    // Shared beat mixer callback (handles all beat tracks)
-    beatCallback = std::make_unique<BeatAudioCallback>(beatSamples, beatVoices, beatLock);
-    deviceManager.addAudioCallback(beatCallback.get());
-
-    // Shared sampler callback (handles all sampler tracks)
-    samplerCallback = std::make_unique<SamplerAudioCallback>(samplerSamples, samplerVoices, samplerLock);
-    deviceManager.addAudioCallback(samplerCallback.get());
+    // One device callback renders and sums every track
+    deviceManager.addAudioCallback(&mixer);
 }
 
 BackendHost::~BackendHost() {
-    if (samplerCallback) {
-        deviceManager.removeAudioCallback(samplerCallback.get());
-        samplerCallback.reset();
-    }
-    if (beatCallback) {
-        deviceManager.removeAudioCallback(beatCallback.get());
-        beatCallback.reset();
-    }
+    // Loads still decoding finish first (plugin scans give up); their results are dropped with
+    // the posted messages
+    pluginCache->cancelScans();
+    loaderPool.removeAllJobs(true, 10000);
+    deviceManager.removeAudioCallback(&mixer);
+
     const juce::ScopedLock sl(tracksLock);
     for (auto& [trackId, track] : tracks) {
         if (track.editorWindow) {
             track.editorWindow->setVisible(false);
             track.editorWindow.reset();
         }
-        if (track.sf2Callback) {
-            deviceManager.removeAudioCallback(track.sf2Callback.get());
-        }
-        if (track.gainCallback) {
-            deviceManager.removeAudioCallback(track.gainCallback.get());
-        }
-        if (track.player) {
-            track.player->setProcessor(nullptr);
-        }
-        if (track.soundFont) {
-            tsf_close(track.soundFont);
-            track.soundFont = nullptr;
-        }
+        mixer.setSource(track.mixerChannel, MasterMixer::instrumentSlot, nullptr);
+        track.stemSource.reset();
+        track.pluginSource.reset();
+        track.sf2Source.reset();
+        SoundFontBank::release(track.soundFont);
+        track.soundFont = nullptr;
     }
     tracks.clear();
 
     {
         const juce::ScopedLock bl(beatLock);
-        beatSamples.clear();
-        beatVoices.clear();
+        for (auto& [trackId, beatTrack] : beatTracks) {
+            mixer.setSource(beatTrack.mixerChannel, MasterMixer::beatSlot, nullptr);
+        }
+        beatTracks.clear();
+    }
+
+    {
+        const juce::ScopedLock sl2(samplerLock);
+        for (auto& [trackId, samplerTrack] : samplerTracks) {
+            mixer.setSource(samplerTrack.mixerChannel, MasterMixer::samplerSlot, nullptr);
+        }
+        samplerTracks.clear();
+    }
+
+    {
+        const juce::ScopedLock cl(clipLock);
+        for (auto& [trackId, clipTrack] : clipTracks) {
+            mixer.setSource(clipTrack.mixerChannel, MasterMixer::clipSlot, nullptr);
+        }
+        clipTracks.clear();
     }
 }
 
 void BackendHost::prepareDevice() {
-    if (deviceManager.getCurrentAudioDevice() != nullptr) return;
+    if (!usesAudioDevice || deviceManager.getCurrentAudioDevice() != nullptr) return;
 
     juce::String error = deviceManager.initialise(0, 2, nullptr, true, {}, nullptr);
     if (error.isNotEmpty()) {
@@ -425,30 +948,284 @@ int BackendHost::getBlockSize() const {
     return 512;
 }
 
+namespace {
+
+// Short names for the driver types JUCE offers on each platform
+juce::String resolveDeviceTypeAlias(const juce::String& name) {
+    static const std::pair<const char*, const char*> aliases[] = {
+        { "asio", "ASIO" },
+        { "wasapi", "Windows Audio" },
+        { "wasapi-exclusive", "Windows Audio (Exclusive Mode)" },
+        { "wasapi-low-latency", "Windows Audio (Low Latency Mode)" },
+        { "directsound", "DirectSound" },
+        { "coreaudio", "CoreAudio" },
+        { "alsa", "ALSA" },
+        { "jack", "JACK" },
+    };
+    for (const auto& [alias, typeName] : aliases) {
+        if (name.equalsIgnoreCase(alias)) return typeName;
+    }
+    return name;
+}
+
+template <typename Values>
+juce::String joinValues(const Values& values) {
+    juce::StringArray parts;
+    for (const auto value : values) parts.add(juce::String(value));
+    return parts.joinIntoString(",");
+}
+
+} // namespace
+
+juce::StringArray BackendHost::getDeviceReport() {
+    juce::StringArray lines;
+    for (auto* type : deviceManager.getAvailableDeviceTypes()) {
+        type->scanForDevices();
+        const auto names = type->getDeviceNames(false);
+        lines.add("EVENT DEVICE_TYPE " + type->getTypeName().quoted() + " devices=" + juce::String(names.size()));
+        for (const auto& name : names) lines.add("EVENT DEVICE " + type->getTypeName().quoted() + " " + name.quoted());
+    }
+
+    if (auto* device = deviceManager.getCurrentAudioDevice()) {
+        lines.add(getDeviceLine("DEVICE_CURRENT") +
+                  " rates=" + joinValues(device->getAvailableSampleRates()) +
+                  " buffers=" + joinValues(device->getAvailableBufferSizes()));
+    }
+    return lines;
+}
+
+bool BackendHost::setDevice(const juce::String& typeName, const juce::String& deviceName, double sampleRate,
+                            int bufferSize, juce::String& errorMessage) {
+    const juce::String previousType = deviceManager.getCurrentAudioDeviceType();
+    const auto previousSetup = deviceManager.getAudioDeviceSetup();
+
+    juce::String type = previousType;
+    if (typeName.isNotEmpty()) {
+        const juce::String wanted = resolveDeviceTypeAlias(typeName);
+        type = {};
+        for (auto* available : deviceManager.getAvailableDeviceTypes()) {
+            if (available->getTypeName().equalsIgnoreCase(wanted)) type = available->getTypeName();
+        }
+        if (type.isEmpty()) {
+            errorMessage = "unknown-device-type " + typeName.quoted();
+            return false;
+        }
+    }
+
+    // The mixer stays registered across the switch: the old device stops it (releasing every
+    // source), the new one starts it again and the sources are prepared for the new rate and
+    // block size, so plugins keep their instances and state
+    if (type != previousType) deviceManager.setCurrentAudioDeviceType(type, true);
+
+    auto setup = deviceManager.getAudioDeviceSetup();
+    if (deviceName.isNotEmpty()) setup.outputDeviceName = deviceName;
+    else if (type != previousType) setup.outputDeviceName = {};
+    setup.inputDeviceName = {};
+    setup.useDefaultInputChannels = false;
+    setup.inputChannels.clear();
+    setup.useDefaultOutputChannels = true;
+    if (sampleRate > 0.0) setup.sampleRate = sampleRate;
+    if (bufferSize > 0) setup.bufferSize = bufferSize;
+
+    juce::String error = deviceManager.setAudioDeviceSetup(setup, true);
+    if (error.isEmpty() && deviceManager.getCurrentAudioDevice() == nullptr) error = "no-device";
+    if (error.isEmpty()) return true;
+
+    errorMessage = error;
+    if (type != previousType) deviceManager.setCurrentAudioDeviceType(previousType, true);
+    const juce::String restoreError = deviceManager.setAudioDeviceSetup(previousSetup, true);
+    if (restoreError.isNotEmpty()) emit("ERROR AUDIO " + restoreError);
+    return false;
+}
+
+juce::String BackendHost::getDeviceLine(const char* eventName) {
+    auto* device = deviceManager.getCurrentAudioDevice();
+    if (device == nullptr) return "EVENT " + juce::String(eventName) + " none";
+
+    return "EVENT " + juce::String(eventName) + " " + device->getTypeName().quoted() + " " + device->getName().quoted() +
+           " rate=" + juce::String(device->getCurrentSampleRate()) +
+           " block=" + juce::String(device->getCurrentBufferSizeSamples()) +
+           " inputLatency=" + juce::String(device->getInputLatencyInSamples()) +
+           " outputLatency=" + juce::String(device->getOutputLatencyInSamples());
+}
+
+juce::StringArray BackendHost::getStatusReport() {
+    juce::StringArray trackLines;
+    int pluginLatency = 0;
+    {
+        const juce::ScopedLock sl(tracksLock);
+        for (const auto& [trackId, track] : tracks) {
+            if (!track.plugin) continue;
+            const int latency = track.plugin->getLatencySamples();
+            pluginLatency = juce::jmax(pluginLatency, latency);
+            trackLines.add("EVENT STATUS_TRACK " + trackId + " latency=" + juce::String(latency));
+        }
+    }
+
+    auto* device = deviceManager.getCurrentAudioDevice();
+    juce::StringArray lines;
+    lines.add("EVENT STATUS rate=" + juce::String(getSampleRate()) +
+              " block=" + juce::String(getBlockSize()) +
+              " clock=" + juce::String(getEngineTimeMs(), 3) +
+              " inputLatency=" + juce::String(device ? device->getInputLatencyInSamples() : 0) +
+              " outputLatency=" + juce::String(device ? device->getOutputLatencyInSamples() : 0) +
+              " pluginLatency=" + juce::String(pluginLatency));
+    lines.addArray(trackLines);
+    return lines;
+}
+
+bool BackendHost::findPluginType(const juce::File& file, juce::PluginDescription& description, juce::String& errorMessage) {
+    // Cached descriptions skip loading the module just to scan it
+    return pluginCache->findType(file, description, errorMessage);
+}
+
+void BackendHost::scanPluginsAsync(const juce::StringArray& paths) {
+    loaderPool.addJob([this, paths] {
+        const juce::StringArray files = paths.isEmpty() ? pluginCache->findPluginFiles() : paths;
+        int found = 0, failed = 0;
+
+        for (int i = 0; i < files.size(); ++i) {
+            const juce::String& path = files[i];
+            emit("EVENT PLUGIN_SCAN_PROGRESS " + juce::String(i) + " " + juce::String(files.size()) + " " + path);
+
+            if (pluginCache->needsScan(path)) {
+                juce::String error;
+                if (pluginCache->scanInChildProcess(path, error) < 0) {
+                    emit("EVENT PLUGIN_SCAN_FAILED " + path.quoted() + " " + error);
+                    ++failed;
+                    if (error == "cancelled") break;
+                    continue;
+                }
+            }
+
+            for (const auto& type : pluginCache->getTypesForFile(path)) {
+                emit("EVENT PLUGIN_FOUND " + path.quoted() + " " + type.name);
+                ++found;
+            }
+        }
+
+        emit("EVENT PLUGIN_SCAN_COMPLETE " + juce::String(found) + " " + juce::String(failed));
+    });
+}
+
 std::unique_ptr<juce::AudioPluginInstance> BackendHost::createPlugin(
     const juce::File& file,
     double sampleRate,
     int blockSize,
     juce::String& errorMessage) {
 
-    if (formatManager.getNumFormats() == 0) {
-        errorMessage = "No plugin formats available (VST3 support may not be compiled)";
-        return {};
+    juce::PluginDescription description;
+    if (!findPluginType(file, description, errorMessage)) return {};
+
+    return formatManager.createPluginInstance(description, sampleRate, blockSize, errorMessage);
+}
+
+namespace {
+
+// Load slot names end in a space so that one slot's name never prefixes another's
+juce::String instrumentLoadSlot(const juce::String& trackId) { return "instrument " + trackId + " "; }
+juce::String samplerLoadSlot(const juce::String& trackId) { return "sampler " + trackId + " "; }
+juce::String beatTrackLoadPrefix(const juce::String& trackId) { return "beat " + trackId + " "; }
+juce::String beatLoadSlot(const juce::String& trackId, const juce::String& rowId) {
+    return beatTrackLoadPrefix(trackId) + rowId + " ";
+}
+
+void emitLoadProgress(const juce::String& trackId, const juce::String& kind, const juce::String& stage) {
+    emit("EVENT LOAD_PROGRESS " + trackId + " " + kind + " " + stage);
+}
+
+// A SoundFont instance on its way from the loader pool to the track
+using SoundFontHandle = std::unique_ptr<tsf, void (*)(tsf*)>;
+
+} // namespace
+
+juce::uint64 BackendHost::beginLoad(const juce::String& slot) {
+    const juce::uint64 ticket = nextLoadTicket++;
+    loadTickets[slot] = ticket;
+    return ticket;
+}
+
+void BackendHost::supersedeLoads(const juce::String& slotPrefix) {
+    for (auto it = loadTickets.lower_bound(slotPrefix); it != loadTickets.end() && it->first.startsWith(slotPrefix);) {
+        it = loadTickets.erase(it);
     }
+}
 
-    juce::OwnedArray<juce::PluginDescription> types;
-    for (int i = 0; i < formatManager.getNumFormats(); ++i) {
-        if (auto* format = formatManager.getFormat(i)) {
-            format->findAllTypesForFile(types, file.getFullPathName());
-        }
+void BackendHost::finishLoad(const juce::String& slot, juce::uint64 ticket, const juce::String& trackId,
+                             const juce::String& kind, const LoadCallback& onFinished,
+                             const std::function<bool(juce::String&)>& install) {
+    auto it = loadTickets.find(slot);
+    if (it == loadTickets.end() || it->second != ticket) {
+        emitLoadProgress(trackId, kind, "superseded");
+        onFinished(LoadStatus::superseded, {});
+        return;
     }
+    loadTickets.erase(it);
 
-    if (types.isEmpty()) {
-        errorMessage = "No plugin types found in file";
-        return {};
+    juce::String errorMessage;
+    if (install(errorMessage)) {
+        onFinished(LoadStatus::loaded, {});
+    } else {
+        onFinished(LoadStatus::failed, errorMessage);
     }
 
-    return formatManager.createPluginInstance(*types[0], sampleRate, blockSize, errorMessage);
+    // Root notes detected by a batch of loads (a kit) are written once it has finished
+    if (loadTickets.empty()) loaderPool.addJob([this] { rootNotes->save(); });
+}
+
+void BackendHost::loadPluginAsync(const juce::String& trackId, const juce::File& file, LoadCallback onFinished,
+                                  const juce::MemoryBlock& state) {
+    prepareDevice();
+
+    if (!file.exists()) {
+        onFinished(LoadStatus::failed, "Path not found: " + file.getFullPathName());
+        return;
+    }
+
+    const juce::String slot = instrumentLoadSlot(trackId);
+    const juce::uint64 ticket = beginLoad(slot);
+    emitLoadProgress(trackId, "plugin", "queued");
+
+    // The scan runs on the loader pool; the instance is then created asynchronously on the
+    // message thread, as VST3 requires, without blocking it in the meantime
+    juce::WeakReference<BackendHost> weakThis(this);
+    loaderPool.addJob([this, weakThis, trackId, file, slot, ticket, onFinished, state] {
+        emitLoadProgress(trackId, "plugin", "scanning");
+        juce::PluginDescription description;
+        juce::String scanError;
+        const bool found = findPluginType(file, description, scanError);
+
+        juce::MessageManager::callAsync([weakThis, trackId, file, slot, ticket, onFinished, state, description, found,
+                                         scanError] {
+            auto* host = weakThis.get();
+            if (host == nullptr) return;
+
+            const auto current = host->loadTickets.find(slot);
+            if (!found || current == host->loadTickets.end() || current->second != ticket) {
+                host->finishLoad(slot, ticket, trackId, "plugin", onFinished, [&scanError](juce::String& errorMessage) {
+                    errorMessage = scanError;
+                    return false;
+                });
+                return;
+            }
+
+            emitLoadProgress(trackId, "plugin", "instantiating");
+            host->formatManager.createPluginInstanceAsync(
+                description, host->getSampleRate(), host->getBlockSize(),
+                [weakThis, trackId, file, slot, ticket, onFinished, state](std::unique_ptr<juce::AudioPluginInstance> instance,
+                                                                          const juce::String& createError) {
+                    auto* host = weakThis.get();
+                    if (host == nullptr) return;
+                    host->finishLoad(slot, ticket, trackId, "plugin", onFinished, [&](juce::String& errorMessage) {
+                        if (instance == nullptr) {
+                            errorMessage = createError.isNotEmpty() ? createError : "Unknown plugin load failure";
+                            return false;
+                        }
+                        return host->installPlugin(trackId, std::move(instance), file, errorMessage, state);
+                    });
+                });
+        });
+    });
 }
 
 bool BackendHost::loadPlugin(const juce::String& trackId, const juce::File& file, juce::String& errorMessage) {
@@ -469,72 +1246,82 @@ bool BackendHost::loadPlugin(const juce::String& trackId, const juce::File& file
         return false;
     }
 
+    supersedeLoads(instrumentLoadSlot(trackId));
+    return installPlugin(trackId, std::move(instance), file, errorMessage);
+}
+
+bool BackendHost::installPlugin(const juce::String& trackId, std::unique_ptr<juce::AudioPluginInstance> instance,
+                                const juce::File& file, juce::String& errorMessage, const juce::MemoryBlock& state) {
     const juce::ScopedLock sl(tracksLock);
     
-    // Unload existing plugin for this track if any
+    // Unload existing plugin/SF2 for this track if any
     auto it = tracks.find(trackId);
     if (it != tracks.end()) {
-        // IMPORTANT: Remove audio callbacks BEFORE freeing resources they depend on
-        if (it->second.gainCallback) {
-            deviceManager.removeAudioCallback(it->second.gainCallback.get());
-            it->second.gainCallback.reset(); // Clear the callback
-        }
-        if (it->second.player) {
-            it->second.player->setProcessor(nullptr);
-        }
-        it->second.editorWindow.reset();
-        it->second.plugin.reset();
-        it->second.activeNoteTimers.clear();
+        releaseInstrument(it->second);
     }
     
-    // Create new track state
+    // Create new track state (the mixer channel, and with it gain/mute/solo, survives reloads)
     TrackState& track = tracks[trackId];
+    track.mixerChannel = acquireMixerChannel(trackId);
+    if (track.mixerChannel < 0) {
+        tracks.erase(trackId);
+        errorMessage = "Too many tracks (mixer is full)";
+        return false;
+    }
     track.plugin = std::move(instance);
-    track.player = std::make_unique<juce::AudioProcessorPlayer>();
-    track.player->setProcessor(track.plugin.get());
-    track.player->getMidiMessageCollector().reset(sr);
+    track.pluginFile = file;
+    if (state.getSize() > 0) {
+        // Not playing yet, so no suspend and re-prepare as in setPluginState
+        track.plugin->setStateInformation(state.getData(), (int)state.getSize());
+    }
+    track.pluginSource = std::make_unique<PluginSource>(*track.plugin, trackSleep);
     track.gainLinear = 1.0f; // Default unity gain
-    
-    // Create gain wrapper callback
-    track.gainCallback = std::make_unique<GainAudioCallback>(track.player.get(), &track.gainLinear);
-    
-    // Add the gain callback as an audio callback (not the player directly)
-    deviceManager.addAudioCallback(track.gainCallback.get());
+    mixer.setChannelGain(track.mixerChannel, track.gainLinear);
+
+    // Parameter lanes find the new plugin's parameters before it starts playing
+    resolveAutomationParameters(trackId, track.plugin.get());
+
+    // Install the plugin on the track's mixer channel (prepares it with the device settings)
+    mixer.setSource(track.mixerChannel, MasterMixer::instrumentSlot, track.pluginSource.get());
 
     emit("EVENT LOADED " + trackId + " " + file.getFullPathName());
     return true;
 }
 
+void BackendHost::releaseInstrument(TrackState& track) {
+    // IMPORTANT: Detach from the mixer BEFORE freeing resources the source depends on
+    mixer.setSource(track.mixerChannel, MasterMixer::instrumentSlot, nullptr);
+
+    if (track.editorWindow) {
+        track.editorWindow->setVisible(false);
+        track.editorWindow.reset();
+    }
+    if (track.pluginSource) {
+        track.pluginSource->release();
+        track.pluginSource.reset();
+    }
+    track.plugin.reset();
+    track.pluginFile = juce::File();
+    track.sf2Source.reset();
+    track.stemSource.reset();
+    track.pendingStem = juce::File();
+
+    // Now safe to release the SoundFont after the source is detached (the file itself is freed
+    // once no other track uses it)
+    SoundFontBank::release(track.soundFont);
+    track.soundFont = nullptr;
+}
+
 void BackendHost::unloadPlugin(const juce::String& trackId) {
+    supersedeLoads(instrumentLoadSlot(trackId));
     const juce::ScopedLock sl(tracksLock);
     
     auto it = tracks.find(trackId);
     if (it == tracks.end()) return;
     
-    if (it->second.editorWindow) {
-        it->second.editorWindow->setVisible(false);
-        it->second.editorWindow.reset();
-    }
-    
-    // IMPORTANT: Remove audio callbacks BEFORE freeing resources they depend on
-    if (it->second.sf2Callback) {
-        deviceManager.removeAudioCallback(it->second.sf2Callback.get());
-    }
-    
-    if (it->second.gainCallback) {
-        deviceManager.removeAudioCallback(it->second.gainCallback.get());
-    }
-    
-    if (it->second.player) {
-        it->second.player->setProcessor(nullptr);
-    }
-    
-    // Now safe to close the SoundFont after callback is removed
-    if (it->second.soundFont) {
-        tsf_close(it->second.soundFont);
-    }
-    
+    releaseInstrument(it->second);
     tracks.erase(it);
+    releaseMixerChannelIfUnused(trackId);
 }
 
 juce::String BackendHost::getPluginState(const juce::String& trackId) const {
@@ -618,6 +1405,100 @@ bool BackendHost::setPluginState(const juce::String& trackId, const juce::String
     return true;
 }
 
+void BackendHost::getPeaksAsync(const juce::File& file, PeaksCallback onReady) {
+    juce::WeakReference<BackendHost> weakThis(this);
+    loaderPool.addJob([this, weakThis, file, onReady] {
+        // A beat row, sampler or clip that decoded the file already spares reading it again
+        const auto decoded = sampleCache->find(file);
+        PeakFileInfo info;
+        juce::String error;
+        if (!peakCache->getPeaks(file, decoded.get(), info, error) && error.isEmpty()) error = "failed";
+
+        juce::MessageManager::callAsync([weakThis, onReady, info, error] {
+            if (weakThis.get() != nullptr) onReady(info, error);
+        });
+    });
+}
+
+Session BackendHost::captureSession() const {
+    std::map<juce::String, SessionTrack> byId;
+    auto trackFor = [&byId](const juce::String& trackId) -> SessionTrack& {
+        auto& track = byId[trackId];
+        track.trackId = trackId;
+        return track;
+    };
+
+    {
+        const juce::ScopedLock sl(tracksLock);
+        for (const auto& [trackId, track] : tracks) {
+            auto& saved = trackFor(trackId);
+            if (track.plugin) {
+                saved.instrument = SessionTrack::Instrument::plugin;
+                saved.instrumentFile = track.pluginFile;
+                track.plugin->getStateInformation(saved.pluginState);
+            } else if (track.soundFont) {
+                saved.instrument = SessionTrack::Instrument::sf2;
+                saved.instrumentFile = track.sf2File;
+                saved.sf2Bank = track.sf2CurrentBank;
+                saved.sf2Preset = track.sf2CurrentPreset;
+                saved.sf2VoiceLimit = track.sf2VoiceLimit;
+                saved.sf2VoiceStealing = track.sf2VoiceStealing;
+            }
+        }
+    }
+    {
+        const juce::ScopedLock bl(beatLock);
+        for (const auto& [trackId, beatTrack] : beatTracks) trackFor(trackId).beatRows = beatTrack.rowFiles;
+    }
+    {
+        const juce::ScopedLock sl(samplerLock);
+        for (const auto& [trackId, samplerTrack] : samplerTracks) {
+            auto& saved = trackFor(trackId);
+            saved.samplerFile = samplerTrack.file;
+            saved.samplerVoiceLimit = samplerTrack.voiceLimit;
+            saved.samplerVoiceStealing = samplerTrack.voiceStealing;
+        }
+    }
+
+    Session session;
+    for (auto& [trackId, track] : byId) {
+        const int handle = getMixerChannel(trackId);
+        track.gainLinear = mixer.getChannelGain(handle);
+        track.muted = mixer.isChannelMuted(handle);
+        track.soloed = mixer.isChannelSoloed(handle);
+        session.tracks.push_back(std::move(track));
+    }
+    return session;
+}
+
+void BackendHost::saveSessionAsync(const juce::File& file, SaveCallback onSaved) {
+    // Plugin states must be read on the message thread; compressing and writing them needn't be
+    auto session = std::make_shared<Session>(captureSession());
+    juce::WeakReference<BackendHost> weakThis(this);
+    loaderPool.addJob([weakThis, session, file, onSaved] {
+        juce::String error;
+        const bool saved = SessionFile::write(*session, file, error);
+        const juce::int64 numBytes = saved ? file.getSize() : 0;
+        juce::MessageManager::callAsync([weakThis, session, onSaved, saved, numBytes, error] {
+            if (weakThis.get() == nullptr) return;
+            onSaved((int)session->tracks.size(), numBytes, saved ? juce::String() : error);
+        });
+    });
+}
+
+void BackendHost::readSessionAsync(const juce::File& file, ReadCallback onRead) {
+    juce::WeakReference<BackendHost> weakThis(this);
+    loaderPool.addJob([weakThis, file, onRead] {
+        auto session = std::make_shared<Session>();
+        juce::String error;
+        if (!SessionFile::read(file, *session, error)) session->tracks.clear();
+        juce::MessageManager::callAsync([weakThis, session, onRead, error] {
+            if (weakThis.get() == nullptr) return;
+            onRead(*session, error);
+        });
+    });
+}
+
 bool BackendHost::loadBeatSample(const juce::String& trackId,
                                  const juce::String& rowId,
                                  const juce::File& file,
@@ -627,173 +1508,219 @@ bool BackendHost::loadBeatSample(const juce::String& trackId,
         return false;
     }
 
-    if (!file.existsAsFile()) {
-        errorMessage = "file-not-found: " + file.getFullPathName();
-        return false;
-    }
+    auto sample = sampleCache->load(file, errorMessage);
+    if (!sample) return false;
 
-    std::unique_ptr<juce::AudioFormatReader> reader(beatFormatManager.createReaderFor(file));
-    if (!reader) {
-        errorMessage = "unsupported-format";
-        return false;
+    supersedeLoads(beatLoadSlot(trackId, rowId));
+    auto prepared = prepareForDevice(*sample);
+    return installBeatSample(trackId, rowId, std::move(sample), std::move(prepared), file, errorMessage);
+}
+
+void BackendHost::loadBeatSampleAsync(const juce::String& trackId, const juce::String& rowId, const juce::File& file,
+                                      LoadCallback onFinished) {
+    if (trackId.isEmpty() || rowId.isEmpty()) {
+        onFinished(LoadStatus::failed, "missing-track-or-row");
+        return;
     }
 
-    const int numSamples = static_cast<int>(reader->lengthInSamples);
-    auto sample = std::make_shared<BeatSample>();
-    sample->sampleRate = reader->sampleRate;
-    sample->buffer.setSize(static_cast<int>(reader->numChannels), juce::jmax(1, numSamples));
-    reader->read(&sample->buffer, 0, numSamples, 0, true, true);
+    const juce::String slot = beatLoadSlot(trackId, rowId);
+    const juce::String kind = "beat:" + rowId;
+    const juce::uint64 ticket = beginLoad(slot);
+    emitLoadProgress(trackId, kind, "queued");
+
+    juce::WeakReference<BackendHost> weakThis(this);
+    loaderPool.addJob([this, weakThis, trackId, rowId, file, slot, kind, ticket, onFinished] {
+        emitLoadProgress(trackId, kind, "reading");
+        juce::String loadError;
+        auto sample = sampleCache->load(file, loadError);
+        auto prepared = sample ? prepareForDevice(*sample) : nullptr;
+
+        juce::MessageManager::callAsync([weakThis, trackId, rowId, file, slot, kind, ticket, onFinished, sample, prepared,
+                                         loadError] {
+            if (auto* host = weakThis.get()) {
+                host->finishLoad(slot, ticket, trackId, kind, onFinished, [&](juce::String& errorMessage) {
+                    errorMessage = loadError;
+                    return sample != nullptr
+                           && host->installBeatSample(trackId, rowId, sample, prepared, file, errorMessage);
+                });
+            }
+        });
+    });
+}
+
+bool BackendHost::installBeatSample(const juce::String& trackId, const juce::String& rowId,
+                                    std::shared_ptr<const BeatSample> sample, std::shared_ptr<const BeatSample> prepared,
+                                    const juce::File& file, juce::String& errorMessage) {
+    // Prepared for a rate the device has left since: redo it
+    if (prepared && prepared->sampleRate != mixer.getCurrentSampleRate()) prepared = prepareForDevice(*sample);
 
     {
         const juce::ScopedLock slb(beatLock);
-        beatSamples[trackId][rowId] = sample;
+        auto& beatTrack = beatTracks[trackId];
+        if (!beatTrack.source) {
+            beatTrack.mixerChannel = acquireMixerChannel(trackId);
+            if (beatTrack.mixerChannel < 0) {
+                beatTracks.erase(trackId);
+                errorMessage = "mixer-full";
+                return false;
+            }
+            beatTrack.source = std::make_unique<BeatTrackSource>();
+            mixer.setSource(beatTrack.mixerChannel, MasterMixer::beatSlot, beatTrack.source.get());
+        }
+
+        // Voices still playing the previous sample are stopped before it is freed
+        auto rowIt = beatTrack.rows.find(rowId);
+        if (rowIt == beatTrack.rows.end() || rowIt->second != sample) {
+            beatTrack.releaseRowSample(rowId);
+            beatTrack.rows[rowId] = sample;
+
+            // Rows sharing a sample share its copy too
+            for (const auto& [otherRow, copy] : beatTrack.prepared) {
+                auto otherIt = beatTrack.rows.find(otherRow);
+                if (prepared && otherIt != beatTrack.rows.end() && otherIt->second == sample
+                    && copy->sampleRate == prepared->sampleRate) {
+                    prepared = copy;
+                    break;
+                }
+            }
+            beatTrack.setPreparedSample(rowId, std::move(prepared));
+        }
+        beatTrack.rowFiles[rowId] = file;
     }
 
     emit("EVENT BEAT_LOADED " + trackId + " " + rowId + " " + file.getFileName());
     return true;
 }
 
-void BackendHost::triggerBeat(const juce::String& trackId,
+bool BackendHost::triggerBeat(const juce::String& trackId,
                               const juce::String& rowId,
-                              float gainLinear) {
+                              float gainLinear,
+                              juce::int64 startTime) {
     const juce::ScopedLock sl(beatLock);
-    auto trackIt = beatSamples.find(trackId);
-    if (trackIt == beatSamples.end()) return;
-    auto rowIt = trackIt->second.find(rowId);
-    if (rowIt == trackIt->second.end()) return;
-    auto sample = rowIt->second;
-    if (!sample || sample->buffer.getNumSamples() <= 0) return;
-
-    BeatVoice voice;
-    voice.sample = sample;
-    voice.position = 0.0;
-    voice.gain = juce::jlimit(0.0f, 4.0f, gainLinear);
-    beatVoices[trackId].push_back(voice);
+    auto trackIt = beatTracks.find(trackId);
+    if (trackIt == beatTracks.end()) return false;
+    auto rowIt = trackIt->second.rows.find(rowId);
+    if (rowIt == trackIt->second.rows.end()) return false;
+    const auto* sample = trackIt->second.getPlayable(rowId);
+    if (!sample || sample->getNumSamples() <= 0) return false;
+
+    trackIt->second.source->trigger(sample, juce::jlimit(0.0f, 4.0f, gainLinear), startTime);
+    return true;
 }
 
 void BackendHost::clearBeatTrack(const juce::String& trackId) {
-    const juce::ScopedLock sl(beatLock);
-    beatSamples.erase(trackId);
-    beatVoices.erase(trackId);
+    supersedeLoads(beatTrackLoadPrefix(trackId));
+    {
+        const juce::ScopedLock sl(beatLock);
+        auto trackIt = beatTracks.find(trackId);
+        if (trackIt == beatTracks.end()) return;
+
+        // Detaching from the mixer guarantees the audio thread no longer reads the samples
+        mixer.setSource(trackIt->second.mixerChannel, MasterMixer::beatSlot, nullptr);
+        beatTracks.erase(trackIt);
+    }
+    releaseMixerChannelIfUnused(trackId);
 }
 
 void BackendHost::clearBeatRow(const juce::String& trackId, const juce::String& rowId) {
+    supersedeLoads(beatLoadSlot(trackId, rowId));
     const juce::ScopedLock sl(beatLock);
-    auto trackIt = beatSamples.find(trackId);
-    if (trackIt != beatSamples.end()) {
-        trackIt->second.erase(rowId);
-    }
-    auto voiceIt = beatVoices.find(trackId);
-    if (voiceIt != beatVoices.end()) {
-        auto& v = voiceIt->second;
-        v.erase(std::remove_if(v.begin(), v.end(), [&](const BeatVoice& bv) { return bv.sample && trackIt != beatSamples.end() && (!trackIt->second.count(rowId) || trackIt->second.at(rowId) != bv.sample); }), v.end());
-    }
+    auto trackIt = beatTracks.find(trackId);
+    if (trackIt == beatTracks.end()) return;
+
+    trackIt->second.releaseRowSample(rowId);
+    trackIt->second.rows.erase(rowId);
+    trackIt->second.rowFiles.erase(rowId);
 }
 
-// Simple autocorrelation-based pitch detection
-static int detectPitch(const juce::AudioBuffer<float>& buffer, double sampleRate) {
-    if (buffer.getNumSamples() < 1024 || buffer.getNumChannels() < 1) {
-        return 60; // Default to C4
-    }
+const BeatSample* BackendHost::BeatTrack::getPlayable(const juce::String& rowId) const {
+    auto preparedIt = prepared.find(rowId);
+    if (preparedIt != prepared.end()) return preparedIt->second.get();
+    auto rowIt = rows.find(rowId);
+    return rowIt != rows.end() ? rowIt->second.get() : nullptr;
+}
 
-    // Mix to mono if stereo
-    std::vector<float> mono;
-    const int numSamples = juce::jmin(buffer.getNumSamples(), 88200); // Max 2 seconds
-    mono.resize(numSamples);
-    
-    const int numChannels = buffer.getNumChannels();
-    for (int i = 0; i < numSamples; ++i) {
-        float sum = 0.0f;
-        for (int ch = 0; ch < numChannels; ++ch) {
-            sum += buffer.getSample(ch, i);
-        }
-        mono[i] = sum / static_cast<float>(numChannels);
-    }
+void BackendHost::BeatTrack::releaseRowSample(const juce::String& rowId) {
+    setPreparedSample(rowId, nullptr);
 
-    // Find section with highest energy (avoid silence at start/end)
-    int bestStart = 0;
-    float maxEnergy = 0.0f;
-    const int windowSize = 8192; // Larger window for better low-frequency detection
-    for (int start = 0; start < numSamples - windowSize; start += windowSize / 4) {
-        float energy = 0.0f;
-        for (int i = 0; i < windowSize && (start + i) < numSamples; ++i) {
-            float s = mono[start + i];
-            energy += s * s;
-        }
-        if (energy > maxEnergy) {
-            maxEnergy = energy;
-            bestStart = start;
-        }
-    }
+    auto rowIt = rows.find(rowId);
+    if (rowIt == rows.end() || !rowIt->second) return;
+    retireUnlessShared(std::move(rowIt->second));
+}
 
-    if (maxEnergy < 0.0001f) {
-        return 60; // Too quiet, default to C4
-    }
-
-    // Autocorrelation on best window
-    const int analyzeSize = juce::jmin(windowSize, numSamples - bestStart);
-    const int minLag = static_cast<int>(sampleRate / 2000.0); // ~2000 Hz max (above piano range)
-    const int maxLag = static_cast<int>(sampleRate / 27.5);   // ~27.5 Hz min (A0 - lowest piano note)
-    
-    std::vector<float> acf(maxLag - minLag + 1);
-    
-    // Calculate autocorrelation function
-    for (int lag = minLag; lag <= maxLag && lag < analyzeSize / 2; ++lag) {
-        float corr = 0.0f;
-        float norm1 = 0.0f;
-        float norm2 = 0.0f;
-        for (int i = 0; i < analyzeSize - lag; ++i) {
-            float s1 = mono[bestStart + i];
-            float s2 = mono[bestStart + i + lag];
-            corr += s1 * s2;
-            norm1 += s1 * s1;
-            norm2 += s2 * s2;
-        }
-        float normFactor = std::sqrt(norm1 * norm2);
-        if (normFactor > 0.0f) {
-            acf[lag - minLag] = corr / normFactor;
-        }
+void BackendHost::BeatTrack::setPreparedSample(const juce::String& rowId, std::shared_ptr<const BeatSample> copy) {
+    std::shared_ptr<const BeatSample> previous;
+    auto preparedIt = prepared.find(rowId);
+    if (preparedIt != prepared.end()) {
+        if (preparedIt->second == copy) return;
+        previous = std::move(preparedIt->second);
+        prepared.erase(preparedIt);
     }
+    if (copy) prepared[rowId] = std::move(copy);
+    retireUnlessShared(std::move(previous));
+}
 
-    // Find peaks in autocorrelation
-    std::vector<std::pair<int, float>> peaks; // lag, correlation
-    for (int i = 1; i < static_cast<int>(acf.size()) - 1; ++i) {
-        if (acf[i] > acf[i - 1] && acf[i] > acf[i + 1] && acf[i] > 0.3f) {
-            peaks.push_back({minLag + i, acf[i]});
-        }
-    }
+void BackendHost::BeatTrack::retireUnlessShared(std::shared_ptr<const BeatSample> sample) {
+    if (!sample) return;
+    const auto usedBy = [&sample](const auto& row) { return row.second == sample; };
+    if (std::any_of(rows.begin(), rows.end(), usedBy) || std::any_of(prepared.begin(), prepared.end(), usedBy)) return;
+    source->retireSample(std::move(sample));
+}
 
-    if (peaks.empty()) {
-        return 60; // No clear pitch detected
-    }
+void BackendHost::setSamplePreparation(bool enabled) {
+    samplePreparation = enabled;
+    refreshPreparedSamples();
+}
 
-    // Sort by correlation strength
-    std::sort(peaks.begin(), peaks.end(), [](const auto& a, const auto& b) {
-        return a.second > b.second;
-    });
+std::shared_ptr<const BeatSample> BackendHost::prepareForDevice(const BeatSample& sample) const {
+    if (!samplePreparation.load()) return nullptr;
+    return PreparedSample::create(sample, mixer.getCurrentSampleRate());
+}
 
-    // Use the first strong peak (prefer lower frequencies/longer periods)
-    // This helps avoid detecting harmonics
-    int bestLag = peaks[0].first;
-    
-    // Check if there's a peak at roughly double the period (octave lower)
-    // that's also strong - prefer that one
-    for (const auto& peak : peaks) {
-        if (peak.first > bestLag * 1.8 && peak.first < bestLag * 2.2 && peak.second > 0.5f) {
-            bestLag = peak.first; // Use the lower octave
-            break;
+void BackendHost::refreshPreparedSamples() {
+    struct Row {
+        juce::String trackId, rowId;
+        std::shared_ptr<const BeatSample> sample;
+    };
+    std::vector<Row> rows;
+    {
+        const juce::ScopedLock sl(beatLock);
+        for (auto& [trackId, beatTrack] : beatTracks) {
+            if (!samplePreparation.load()) {
+                while (!beatTrack.prepared.empty()) beatTrack.setPreparedSample(beatTrack.prepared.begin()->first, nullptr);
+                continue;
+            }
+            for (const auto& [rowId, sample] : beatTrack.rows) {
+                if (sample) rows.push_back({trackId, rowId, sample});
+            }
         }
     }
+    if (rows.empty()) return;
 
-    // Convert lag to frequency to MIDI note
-    const double frequency = sampleRate / static_cast<double>(bestLag);
-    double midiNote = 69.0 + 12.0 * std::log2(frequency / 440.0); // A4 = 440 Hz = MIDI 69
-    
-    // Round to nearest semitone
-    int roundedNote = static_cast<int>(std::round(midiNote));
-    roundedNote = juce::jlimit(21, 108, roundedNote); // Piano range A0 to C8
-    
-    return roundedNote;
+    const double rate = mixer.getCurrentSampleRate();
+    juce::WeakReference<BackendHost> weakThis(this);
+    loaderPool.addJob([weakThis, rows, rate] {
+        // One copy per distinct sample, however many rows play it
+        std::map<const BeatSample*, std::shared_ptr<const BeatSample>> copies;
+        for (const auto& row : rows) {
+            if (copies.count(row.sample.get()) == 0) copies[row.sample.get()] = PreparedSample::create(*row.sample, rate);
+        }
+
+        juce::MessageManager::callAsync([weakThis, rows, copies, rate] {
+            auto* host = weakThis.get();
+            // A newer refresh is on its way if the rate or the setting changed meanwhile
+            if (host == nullptr || !host->samplePreparation.load() || host->mixer.getCurrentSampleRate() != rate) return;
+
+            const juce::ScopedLock sl(host->beatLock);
+            for (const auto& row : rows) {
+                auto trackIt = host->beatTracks.find(row.trackId);
+                if (trackIt == host->beatTracks.end()) continue;
+                auto rowIt = trackIt->second.rows.find(row.rowId);
+                if (rowIt == trackIt->second.rows.end() || rowIt->second != row.sample) continue; // reloaded since
+                trackIt->second.setPreparedSample(row.rowId, copies.at(row.sample.get()));
+            }
+        });
+    });
 }
 
 bool BackendHost::loadSamplerSample(const juce::String& trackId,
@@ -804,86 +1731,190 @@ bool BackendHost::loadSamplerSample(const juce::String& trackId,
         return false;
     }
 
-    if (!file.existsAsFile()) {
-        errorMessage = "file-not-found: " + file.getFullPathName();
-        return false;
-    }
+    // Decoded once per file version, then shared through the cache
+    auto sample = sampleCache->load(file, errorMessage);
+    if (!sample) return false;
+    const auto rootNote = detectRootNote(file, *sample);
 
-    std::unique_ptr<juce::AudioFormatReader> reader(beatFormatManager.createReaderFor(file));
-    if (!reader) {
-        errorMessage = "unsupported-format";
-        return false;
-    }
+    supersedeLoads(samplerLoadSlot(trackId));
+    return installSamplerSample(trackId, std::move(sample), rootNote, file, errorMessage);
+}
+
+PitchDetector::Result BackendHost::detectRootNote(const juce::File& file, const BeatSample& sample) const {
+    if (!sample.mapped) return rootNotes->detect(file, sample.buffer, sample.sampleRate);
 
-    const int numSamples = static_cast<int>(reader->lengthInSamples);
-    auto sample = std::make_shared<BeatSample>();
-    sample->sampleRate = reader->sampleRate;
-    sample->buffer.setSize(static_cast<int>(reader->numChannels), juce::jmax(1, numSamples));
-    reader->read(&sample->buffer, 0, numSamples, 0, true, true);
+    // Only the head is analysed; decoding it also pages in the start every voice plays first
+    auto& reader = *sample.mapped;
+    const int headLength = (int)juce::jmin<juce::int64>(reader.lengthInSamples,
+                                                       (juce::int64)(reader.sampleRate * PitchDetector::searchSeconds));
+    juce::AudioBuffer<float> head((int)reader.numChannels, juce::jmax(1, headLength));
+    reader.read(&head, 0, headLength, 0, true, true);
+    return rootNotes->detect(file, head, sample.sampleRate);
+}
+
+void BackendHost::loadSamplerSampleAsync(const juce::String& trackId, const juce::File& file, LoadCallback onFinished) {
+    if (trackId.isEmpty()) {
+        onFinished(LoadStatus::failed, "missing-track-id");
+        return;
+    }
 
-    // Detect pitch
-    sample->detectedRootNote = detectPitch(sample->buffer, sample->sampleRate);
+    const juce::String slot = samplerLoadSlot(trackId);
+    const juce::uint64 ticket = beginLoad(slot);
+    emitLoadProgress(trackId, "sampler", "queued");
+
+    juce::WeakReference<BackendHost> weakThis(this);
+    loaderPool.addJob([this, weakThis, trackId, file, slot, ticket, onFinished] {
+        emitLoadProgress(trackId, "sampler", "reading");
+        juce::String loadError;
+        auto sample = sampleCache->load(file, loadError);
+        // Only sampler tracks need a root note, so beat rows and clips never pay for detection
+        const auto rootNote = sample != nullptr ? detectRootNote(file, *sample) : PitchDetector::Result();
+
+        juce::MessageManager::callAsync([weakThis, trackId, file, slot, ticket, onFinished, sample, rootNote, loadError] {
+            if (auto* host = weakThis.get()) {
+                host->finishLoad(slot, ticket, trackId, "sampler", onFinished, [&](juce::String& errorMessage) {
+                    errorMessage = loadError;
+                    return sample != nullptr
+                           && host->installSamplerSample(trackId, sample, rootNote, file, errorMessage);
+                });
+            }
+        });
+    });
+}
 
+bool BackendHost::installSamplerSample(const juce::String& trackId, std::shared_ptr<const BeatSample> sample,
+                                       const PitchDetector::Result& rootNote, const juce::File& file,
+                                       juce::String& errorMessage) {
     {
         const juce::ScopedLock sl(samplerLock);
-        samplerSamples[trackId] = sample;
-        samplerVoices.erase(trackId); // Clear any playing voices
+        auto& samplerTrack = samplerTracks[trackId];
+        if (!samplerTrack.source) {
+            samplerTrack.mixerChannel = acquireMixerChannel(trackId);
+            if (samplerTrack.mixerChannel < 0) {
+                samplerTracks.erase(trackId);
+                errorMessage = "mixer-full";
+                return false;
+            }
+            samplerTrack.source = std::make_unique<SamplerTrackSource>();
+            samplerTrack.source->setVoiceBudget(samplerTrack.voiceLimit, samplerTrack.voiceStealing);
+            mixer.setSource(samplerTrack.mixerChannel, MasterMixer::samplerSlot, samplerTrack.source.get());
+        }
+
+        // Clear any playing voices; the old sample is freed once the audio thread lets go of it
+        samplerTrack.source->stopAllVoices();
+        if (samplerTrack.sample != sample) {
+            samplerTrack.source->retireSample(std::move(samplerTrack.sample));
+            samplerTrack.sample = sample;
+        }
+        samplerTrack.file = file;
+        samplerTrack.rootNote = rootNote;
     }
 
-    emit("EVENT SAMPLER_LOADED " + trackId + " " + file.getFileName() + " root=" + juce::String(sample->detectedRootNote));
+    emit("EVENT SAMPLER_LOADED " + trackId + " " + file.getFileName() + " root=" + juce::String(rootNote.rootNote)
+         + " confidence=" + juce::String(rootNote.confidence, 2));
     return true;
 }
 
-void BackendHost::triggerSamplerNote(const juce::String& trackId,
+bool BackendHost::triggerSamplerNote(const juce::String& trackId,
                                     int midiNote,
                                     float velocity,
-                                    int durationMs) {
+                                    int durationMs,
+                                    juce::int64 startTime) {
     const juce::ScopedLock sl(samplerLock);
-    auto sampleIt = samplerSamples.find(trackId);
-    if (sampleIt == samplerSamples.end()) return;
-    auto sample = sampleIt->second;
-    if (!sample || sample->buffer.getNumSamples() <= 0) return;
+    auto trackIt = samplerTracks.find(trackId);
+    if (trackIt == samplerTracks.end()) return false;
+    const auto& sample = trackIt->second.sample;
+    if (!sample || sample->getNumSamples() <= 0) return false;
 
     // Calculate pitch shift based on MIDI note relative to detected root note
-    const int rootNote = sample->detectedRootNote; // Use detected pitch as root
+    const int rootNote = trackIt->second.rootNote.rootNote; // Use detected pitch as root
     const int noteOffset = midiNote - rootNote;
     const double semitone = std::pow(2.0, noteOffset / 12.0); // Equal temperament tuning
 
-    SamplerVoice voice;
-    voice.sample = sample;
-    voice.position = 0.0;
-    voice.gain = juce::jlimit(0.0f, 1.0f, velocity);
-    voice.midiNote = midiNote;
-    voice.playbackRate = semitone;
-    voice.active = true;
-    
-    samplerVoices[trackId].push_back(voice);
+    auto& source = *trackIt->second.source;
+    source.noteOn(sample.get(), midiNote, juce::jlimit(0.0f, 1.0f, velocity), semitone, startTime);
 
-    // Schedule note off if duration is specified
+    // The note-off is scheduled on the engine clock, not with a message-thread timer
     if (durationMs > 0) {
-        juce::Timer::callAfterDelay(durationMs, [this, trackId, midiNote]() {
-            stopSamplerNote(trackId, midiNote);
-        });
+        source.noteOff(midiNote, noteOffTime(startTime, durationMs));
     }
+    return true;
 }
 
-void BackendHost::stopSamplerNote(const juce::String& trackId, int midiNote) {
+bool BackendHost::stopSamplerNote(const juce::String& trackId, int midiNote, juce::int64 startTime) {
     const juce::ScopedLock sl(samplerLock);
-    auto voiceIt = samplerVoices.find(trackId);
-    if (voiceIt == samplerVoices.end()) return;
-    
-    // Mark voices with matching note as inactive (will be removed in audio callback)
-    for (auto& voice : voiceIt->second) {
-        if (voice.midiNote == midiNote) {
-            voice.active = false;
+    auto trackIt = samplerTracks.find(trackId);
+    if (trackIt == samplerTracks.end() || !trackIt->second.source) return false;
+
+    trackIt->second.source->noteOff(midiNote, startTime);
+    return true;
+}
+
+void BackendHost::clearSamplerTrack(const juce::String& trackId) {
+    supersedeLoads(samplerLoadSlot(trackId));
+    {
+        const juce::ScopedLock sl(samplerLock);
+        auto trackIt = samplerTracks.find(trackId);
+        if (trackIt == samplerTracks.end()) return;
+
+        mixer.setSource(trackIt->second.mixerChannel, MasterMixer::samplerSlot, nullptr);
+        samplerTracks.erase(trackIt);
+    }
+    releaseMixerChannelIfUnused(trackId);
+}
+
+bool BackendHost::playClip(const juce::String& trackId,
+                           const juce::String& clipId,
+                           const juce::File& file,
+                           juce::String& errorMessage,
+                           juce::int64 startTime,
+                           double offsetSeconds,
+                           float gainLinear) {
+    // Only the header is read here; the read-ahead thread decodes the rest while it plays
+    std::unique_ptr<juce::AudioFormatReader> reader(beatFormatManager.createReaderFor(file));
+    if (reader == nullptr || reader->lengthInSamples <= 0) {
+        errorMessage = "unsupported-or-empty-file";
+        return false;
+    }
+
+    const juce::ScopedLock cl(clipLock);
+    auto& clipTrack = clipTracks[trackId];
+    if (!clipTrack.source) {
+        clipTrack.mixerChannel = acquireMixerChannel(trackId);
+        if (clipTrack.mixerChannel < 0) {
+            clipTracks.erase(trackId);
+            errorMessage = "mixer-full";
+            return false;
         }
+        clipTrack.source = std::make_unique<ClipTrackSource>(diskReadAhead);
+        mixer.setSource(clipTrack.mixerChannel, MasterMixer::clipSlot, clipTrack.source.get());
+    }
+
+    if (!clipTrack.source->play(clipId, std::move(reader), startTime, juce::jmax(0.0, offsetSeconds),
+                                juce::jlimit(0.0f, 4.0f, gainLinear))) {
+        errorMessage = "queue-full";
+        return false;
     }
+    return true;
 }
 
-void BackendHost::clearSamplerTrack(const juce::String& trackId) {
-    const juce::ScopedLock sl(samplerLock);
-    samplerSamples.erase(trackId);
-    samplerVoices.erase(trackId);
+bool BackendHost::stopClip(const juce::String& trackId, const juce::String& clipId, juce::int64 stopTime) {
+    const juce::ScopedLock cl(clipLock);
+    auto it = clipTracks.find(trackId);
+    return it != clipTracks.end() && it->second.source->stop(clipId, stopTime);
+}
+
+void BackendHost::clearClipTrack(const juce::String& trackId) {
+    {
+        const juce::ScopedLock cl(clipLock);
+        auto it = clipTracks.find(trackId);
+        if (it == clipTracks.end()) return;
+
+        // Detaching from the mixer guarantees the audio thread no longer reads the streams
+        mixer.setSource(it->second.mixerChannel, MasterMixer::clipSlot, nullptr);
+        clipTracks.erase(it);
+    }
+    releaseMixerChannelIfUnused(trackId);
 }
 
 bool BackendHost::isPluginLoaded(const juce::String& trackId) const {
@@ -907,49 +1938,75 @@ bool BackendHost::loadSF2(const juce::String& trackId, const juce::File& file, j
         return false;
     }
     
-    // Load the SoundFont using TinySoundFont
-    tsf* sf = tsf_load_filename(file.getFullPathName().toRawUTF8());
-    if (!sf) {
-        errorMessage = "Failed to load SF2 file (invalid format or corrupted)";
-        return false;
+    // Tracks using the same file share one parsed font, each with its own instance
+    tsf* sf = SoundFontBank::acquire(file, errorMessage);
+    if (!sf) return false;
+
+    supersedeLoads(instrumentLoadSlot(trackId));
+    return installSF2(trackId, sf, file, errorMessage);
+}
+
+void BackendHost::loadSF2Async(const juce::String& trackId, const juce::File& file, LoadCallback onFinished) {
+    prepareDevice();
+
+    if (!file.existsAsFile()) {
+        onFinished(LoadStatus::failed, "SF2 file not found: " + file.getFullPathName());
+        return;
     }
-    
+
+    const juce::String slot = instrumentLoadSlot(trackId);
+    const juce::uint64 ticket = beginLoad(slot);
+    emitLoadProgress(trackId, "sf2", "queued");
+
+    juce::WeakReference<BackendHost> weakThis(this);
+    loaderPool.addJob([weakThis, trackId, file, slot, ticket, onFinished] {
+        emitLoadProgress(trackId, "sf2", "reading");
+        juce::String loadError;
+        auto soundFont = std::make_shared<SoundFontHandle>(SoundFontBank::acquire(file, loadError), SoundFontBank::release);
+
+        juce::MessageManager::callAsync([weakThis, trackId, file, slot, ticket, onFinished, soundFont, loadError] {
+            if (auto* host = weakThis.get()) {
+                host->finishLoad(slot, ticket, trackId, "sf2", onFinished, [&](juce::String& errorMessage) {
+                    if (*soundFont == nullptr) {
+                        errorMessage = loadError;
+                        return false;
+                    }
+                    return host->installSF2(trackId, soundFont->release(), file, errorMessage);
+                });
+            }
+        });
+    });
+}
+
+// Takes ownership of sf
+bool BackendHost::installSF2(const juce::String& trackId, tsf* sf, const juce::File& file, juce::String& errorMessage) {
     const juce::ScopedLock sl(tracksLock);
     
     // Unload existing plugin/SF2 for this track if any
     auto it = tracks.find(trackId);
     if (it != tracks.end()) {
-        // IMPORTANT: Remove audio callbacks BEFORE freeing resources they depend on
-        if (it->second.sf2Callback) {
-            deviceManager.removeAudioCallback(it->second.sf2Callback.get());
-            it->second.sf2Callback.reset(); // Clear the callback
-        }
-        if (it->second.gainCallback) {
-            deviceManager.removeAudioCallback(it->second.gainCallback.get());
-            it->second.gainCallback.reset(); // Clear the callback
-        }
-        if (it->second.player) {
-            it->second.player->setProcessor(nullptr);
-        }
-        // Now safe to close the SoundFont after callback is removed
-        if (it->second.soundFont) {
-            tsf_close(it->second.soundFont);
-            it->second.soundFont = nullptr;
-        }
-        it->second.editorWindow.reset();
-        it->second.plugin.reset();
-        it->second.activeNoteTimers.clear();
+        releaseInstrument(it->second);
     }
     
     // Create new track state for SF2
     TrackState& track = tracks[trackId];
+    track.mixerChannel = acquireMixerChannel(trackId);
+    if (track.mixerChannel < 0) {
+        SoundFontBank::release(sf);
+        tracks.erase(trackId);
+        errorMessage = "Too many tracks (mixer is full)";
+        return false;
+    }
     track.soundFont = sf;
     track.sf2Name = file.getFileNameWithoutExtension();
+    track.sf2File = file;
     track.gainLinear = 1.0f;
+    mixer.setChannelGain(track.mixerChannel, track.gainLinear);
     
     // Configure TinySoundFont
     const double sr = getSampleRate();
-    track.sf2Callback = std::make_unique<SF2AudioCallback>(sf, &track.gainLinear, sr);
+    track.sf2Source = std::make_unique<SF2Source>(sf, sr, trackSleep);
+    track.sf2Source->setVoiceBudget(track.sf2VoiceLimit, track.sf2VoiceStealing);
     
     // Find and set the first available preset
     int presetIndex = tsf_get_presetindex(sf, 0, 0);
@@ -972,8 +2029,8 @@ bool BackendHost::loadSF2(const juce::String& trackId, const juce::File& file, j
         track.sf2CurrentPreset = 0;
     }
     
-    // Add to audio device
-    deviceManager.addAudioCallback(track.sf2Callback.get());
+    // Install on the track's mixer channel
+    mixer.setSource(track.mixerChannel, MasterMixer::instrumentSlot, track.sf2Source.get());
     
     emit("EVENT LOADED_SF2 " + trackId + " " + track.sf2Name);
     return true;
@@ -1001,10 +2058,8 @@ bool BackendHost::setSF2Preset(const juce::String& trackId, int bank, int preset
                  " requested_preset=" + juce::String(preset) + " using_preset=0 " + 
                  juce::String(presetName ? presetName : "Unknown"));
             
-            // Set the first available preset
-            for (int ch = 0; ch < 16; ++ch) {
-                tsf_channel_set_presetindex(track.soundFont, ch, 0);
-            }
+            // Set the first available preset (applied on the audio thread)
+            postPresetChange(track, 0);
             track.sf2CurrentBank = 0;
             track.sf2CurrentPreset = 0;
             return true;
@@ -1015,9 +2070,7 @@ bool BackendHost::setSF2Preset(const juce::String& trackId, int bank, int preset
     }
     
     // Set preset for all channels (typically use channel 0 for single-track playback)
-    for (int ch = 0; ch < 16; ++ch) {
-        tsf_channel_set_bank_preset(track.soundFont, ch, bank, preset);
-    }
+    postPresetChange(track, presetIndex);
     
     track.sf2CurrentBank = bank;
     track.sf2CurrentPreset = preset;
@@ -1028,177 +2081,410 @@ bool BackendHost::setSF2Preset(const juce::String& trackId, int bank, int preset
     return true;
 }
 
-bool BackendHost::isSF2Loaded(const juce::String& trackId) const {
+bool BackendHost::setSF2Voices(const juce::String& trackId, int voiceLimit, SoundFontBank::VoiceStealing policy,
+                               juce::String& errorMessage) {
     const juce::ScopedLock sl(tracksLock);
-    auto it = tracks.find(trackId);
-    return it != tracks.end() && it->second.soundFont != nullptr;
-}
 
-bool BackendHost::playNote(const juce::String& trackId, int midiNote, float velocity01, int durationMs, int channel) {
-    const juce::ScopedLock sl(tracksLock);
-    
     auto it = tracks.find(trackId);
-    if (it == tracks.end()) return false;
-    
+    if (it == tracks.end() || !it->second.sf2Source) {
+        errorMessage = "No SF2 loaded for track " + trackId;
+        return false;
+    }
+    if (voiceLimit < 1 || voiceLimit > SoundFontBank::maxVoices) {
+        errorMessage = "Voice limit must be between 1 and " + juce::String(SoundFontBank::maxVoices);
+        return false;
+    }
+
+    // Kept on the track, so reloading another SF2 keeps the budget
     TrackState& track = it->second;
-    velocity01 = juce::jlimit(0.0f, 1.0f, velocity01);
-    
-    // Handle SF2 playback
-    if (track.soundFont) {
-        // Play note on SF2
-        tsf_channel_note_on(track.soundFont, channel - 1, midiNote, velocity01); // TSF uses 0-based channels
-        
-        // Schedule note-off using a Timer
-        const int key = (channel << 8) | midiNote;
-        track.activeNoteTimers.erase(key);
-        
-        class SF2NoteOffTimer : public juce::Timer {
-        public:
-            SF2NoteOffTimer(tsf* sf, int note, int chan) : soundFont(sf), midiNote(note), tsfChannel(chan) {}
-            void timerCallback() override {
-                if (soundFont) {
-                    tsf_channel_note_off(soundFont, tsfChannel, midiNote);
-                }
-            }
-        private:
-            tsf* soundFont;
-            int midiNote;
-            int tsfChannel;
-        };
-        
-        auto timer = std::make_unique<SF2NoteOffTimer>(track.soundFont, midiNote, channel - 1);
-        timer->startTimer(durationMs);
-        track.activeNoteTimers[key].timer = std::move(timer);
-        return true;
+    track.sf2VoiceLimit = voiceLimit;
+    track.sf2VoiceStealing = policy;
+    track.sf2Source->setVoiceBudget(voiceLimit, policy);
+
+    emit("EVENT SF2_VOICES " + trackId + " " + juce::String(voiceLimit) + " "
+         + SoundFontBank::getVoiceStealingName(policy));
+    return true;
+}
+
+bool BackendHost::setSamplerVoices(const juce::String& trackId, int voiceLimit, SoundFontBank::VoiceStealing policy,
+                                   juce::String& errorMessage) {
+    const juce::ScopedLock sl(samplerLock);
+
+    auto it = samplerTracks.find(trackId);
+    if (it == samplerTracks.end() || !it->second.source) {
+        errorMessage = "No sampler sample loaded for track " + trackId;
+        return false;
+    }
+    if (voiceLimit < 1 || voiceLimit > SamplerVoices::maxVoices) {
+        errorMessage = "Voice limit must be between 1 and " + juce::String(SamplerVoices::maxVoices);
+        return false;
     }
-    
-    // Handle VST plugin playback
-    if (!track.plugin) return false;
-    
-    // Send note-on immediately
-    juce::MidiMessage on = juce::MidiMessage::noteOn(channel, midiNote, velocity01);
-    track.player->getMidiMessageCollector().addMessageToQueue(on);
 
-    // Schedule note-off using a Timer for reliable timing
-    const int key = (channel << 8) | midiNote;
-    
-    // Cancel any existing timer for this note/channel
-    track.activeNoteTimers.erase(key);
-    
-    // Create a lambda-based timer for the note-off
-    class NoteOffTimerCallback : public juce::Timer {
-    public:
-        NoteOffTimerCallback(BackendHost* host, juce::String tid, int note, int chan, int timerKey)
-            : hostPtr(host), trackId(tid), midiNote(note), channel(chan), key(timerKey) {}
-        
-        void timerCallback() override {
-            if (hostPtr) {
-                hostPtr->sendNoteOff(trackId, midiNote, channel);
-                // Remove self from active timers
-                const juce::ScopedLock sl(hostPtr->tracksLock);
-                auto it = hostPtr->tracks.find(trackId);
-                if (it != hostPtr->tracks.end()) {
-                    it->second.activeNoteTimers.erase(key);
-                }
-            }
-        }
-        
-    private:
-        BackendHost* hostPtr;
-        juce::String trackId;
-        int midiNote;
-        int channel;
-        int key;
-    };
-    
-    auto timer = std::make_unique<NoteOffTimerCallback>(this, trackId, midiNote, channel, key);
-    timer->startTimer(durationMs);
-    track.activeNoteTimers[key].timer = std::move(timer);
+    // Kept on the track, so loading another sample keeps the budget
+    SamplerTrack& samplerTrack = it->second;
+    samplerTrack.voiceLimit = voiceLimit;
+    samplerTrack.voiceStealing = policy;
+    samplerTrack.source->setVoiceBudget(voiceLimit, policy);
 
+    emit("EVENT SAMPLER_VOICES " + trackId + " " + juce::String(voiceLimit) + " "
+         + SoundFontBank::getVoiceStealingName(policy));
     return true;
 }
 
-void BackendHost::sendNoteOff(const juce::String& trackId, int midiNote, int channel) {
+bool BackendHost::isSF2Loaded(const juce::String& trackId) const {
+    const juce::ScopedLock sl(tracksLock);
+    auto it = tracks.find(trackId);
+    return it != tracks.end() && it->second.soundFont != nullptr;
+}
+
+bool BackendHost::playNote(const juce::String& trackId, int midiNote, float velocity01, int durationMs, int channel,
+                           juce::int64 startTime) {
     const juce::ScopedLock sl(tracksLock);
     
     auto it = tracks.find(trackId);
-    if (it == tracks.end()) return;
+    if (it == tracks.end()) return false;
     
-    // Handle SF2
-    if (it->second.soundFont) {
-        tsf_channel_note_off(it->second.soundFont, channel - 1, midiNote);
-        return;
+    if (it->second.stemSource) return true; // frozen: the notes are in the stem
+
+    InstrumentSource* source = getInstrumentSource(it->second);
+    if (!source) return false;
+
+    velocity01 = juce::jlimit(0.0f, 1.0f, velocity01);
+
+    // Note-on and note-off are both stamped on the engine clock and delivered at their exact
+    // sample offset by the audio thread (SF2 and plugin tracks alike)
+    source->postMidi(juce::MidiMessage::noteOn(channel, midiNote, velocity01), startTime);
+    if (durationMs > 0) {
+        source->postMidi(juce::MidiMessage::noteOff(channel, midiNote), noteOffTime(startTime, durationMs));
     }
-    
-    // Handle VST plugin
-    if (!it->second.player) return;
-    juce::MidiMessage off = juce::MidiMessage::noteOff(channel, midiNote);
-    it->second.player->getMidiMessageCollector().addMessageToQueue(off);
+    return true;
 }
 
 void BackendHost::allNotesOff(const juce::String& trackId) {
-    const juce::ScopedLock sl(tracksLock);
-    
-    if (trackId.isEmpty()) {
-        // All tracks
+    // Also drops any notes that were scheduled ahead but have not started yet
+    InstrumentEvent panic;
+    panic.type = InstrumentEvent::allNotesOff;
+
+    {
+        const juce::ScopedLock sl(tracksLock);
         for (auto& [tid, track] : tracks) {
-            track.activeNoteTimers.clear();
-            
-            if (track.soundFont) {
-                // SF2 all notes off
-                for (int ch = 0; ch < 16; ++ch) {
-                    tsf_channel_note_off_all(track.soundFont, ch);
-                }
-            } else if (track.player) {
-                // VST plugin all notes off
-                for (int ch = 1; ch <= 16; ++ch) {
-                    auto msg = juce::MidiMessage::allNotesOff(ch);
-                    track.player->getMidiMessageCollector().addMessageToQueue(msg);
-                }
-            }
+            if (trackId.isNotEmpty() && tid != trackId) continue;
+            if (track.stemSource) track.stemSource->stopAt(mixer.getSampleClock());
+            if (auto* source = getInstrumentSource(track)) source->post(panic);
         }
-    } else {
-        // Specific track
-        auto it = tracks.find(trackId);
-        if (it == tracks.end()) return;
-        
-        it->second.activeNoteTimers.clear();
-        
-        if (it->second.soundFont) {
-            // SF2 all notes off
-            for (int ch = 0; ch < 16; ++ch) {
-                tsf_channel_note_off_all(it->second.soundFont, ch);
-            }
-        } else if (it->second.player) {
-            // VST plugin all notes off
-            for (int ch = 1; ch <= 16; ++ch) {
-                auto msg = juce::MidiMessage::allNotesOff(ch);
-                it->second.player->getMidiMessageCollector().addMessageToQueue(msg);
+    }
+    {
+        // One-shots already sounding ring out; only pending hits are cancelled
+        const juce::ScopedLock sl(beatLock);
+        for (auto& [tid, beatTrack] : beatTracks) {
+            if (trackId.isNotEmpty() && tid != trackId) continue;
+            beatTrack.source->cancelScheduled();
+        }
+    }
+    {
+        const juce::ScopedLock sl(samplerLock);
+        for (auto& [tid, samplerTrack] : samplerTracks) {
+            if (trackId.isNotEmpty() && tid != trackId) continue;
+            samplerTrack.source->stopAllVoices();
+        }
+    }
+    {
+        const juce::ScopedLock cl(clipLock);
+        for (auto& [tid, clipTrack] : clipTracks) {
+            if (trackId.isNotEmpty() && tid != trackId) continue;
+            clipTrack.source->stopAll();
+        }
+    }
+}
+
+double BackendHost::getEngineTimeMs() const {
+    const double rate = mixer.getCurrentSampleRate();
+    return rate > 0.0 ? (double)mixer.getSampleClock() * 1000.0 / rate : 0.0;
+}
+
+std::vector<BackendHost::SourceStats> BackendHost::getSourceStats(bool startNewInterval) {
+    std::vector<SourceStats> sources;
+    auto addSource = [&](const juce::String& trackId, const char* kind, const MixerSource* source, int handle,
+                         MasterMixer::SourceSlot slot) {
+        auto* timing = source ? mixer.getSourceTiming(handle, slot) : nullptr;
+        if (timing == nullptr) return;
+        sources.push_back({trackId, kind, timing->read(startNewInterval), source->getActiveVoices(),
+                           source->getQueueDepth(), source->isAsleep()});
+    };
+
+    {
+        const juce::ScopedLock sl(tracksLock);
+        for (auto& [trackId, track] : tracks) {
+            if (track.stemSource) {
+                addSource(trackId, "stem", track.stemSource.get(), track.mixerChannel, MasterMixer::instrumentSlot);
+                continue;
             }
+            addSource(trackId, track.sf2Source ? "sf2" : "plugin", getInstrumentSource(track), track.mixerChannel,
+                      MasterMixer::instrumentSlot);
+        }
+    }
+    {
+        const juce::ScopedLock bl(beatLock);
+        for (const auto& [trackId, beatTrack] : beatTracks) {
+            addSource(trackId, "beat", beatTrack.source.get(), beatTrack.mixerChannel, MasterMixer::beatSlot);
+        }
+    }
+    {
+        const juce::ScopedLock sl(samplerLock);
+        for (const auto& [trackId, samplerTrack] : samplerTracks) {
+            addSource(trackId, "sampler", samplerTrack.source.get(), samplerTrack.mixerChannel, MasterMixer::samplerSlot);
+        }
+    }
+    {
+        const juce::ScopedLock cl(clipLock);
+        for (const auto& [trackId, clipTrack] : clipTracks) {
+            addSource(trackId, "clip", clipTrack.source.get(), clipTrack.mixerChannel, MasterMixer::clipSlot);
         }
     }
+    return sources;
+}
+
+juce::StringArray BackendHost::getStatsReport(bool startNewInterval) {
+    juce::StringArray lines;
+
+    const auto callback = mixer.getCallbackTiming().read(startNewInterval);
+    const auto mix = mixer.getMixTiming().read(startNewInterval);
+    const double rate = mixer.getCurrentSampleRate();
+    const double budgetMicros = rate > 0.0 ? mixer.getCurrentBlockSize() * 1.0e6 / rate : 0.0;
+    auto loadPercent = [budgetMicros](double micros) {
+        return juce::String(budgetMicros > 0.0 ? micros * 100.0 / budgetMicros : 0.0, 1);
+    };
+    auto* device = deviceManager.getCurrentAudioDevice();
+
+    lines.add("EVENT STATS callbacks=" + juce::String(callback.count) +
+              " load=" + loadPercent(callback.meanMicros) + "/" + loadPercent(callback.maxMicros) +
+              " callbackUs=" + callback.formatMicros() +
+              " hist=" + callback.formatHistogram() +
+              " mixUs=" + mix.formatMicros() +
+              " overruns=" + juce::String(mixer.getOverrunCount()) +
+              " workers=" + juce::String(mixer.getNumWorkerThreads()) +
+              " xruns=" + juce::String(device ? device->getXRunCount() : -1));
+
+    for (const auto& source : getSourceStats(startNewInterval)) {
+        lines.add("EVENT STATS_TRACK " + source.trackId + " " + source.kind +
+                  " us=" + source.timing.formatMicros() +
+                  " hist=" + source.timing.formatHistogram() +
+                  " voices=" + juce::String(source.activeVoices) +
+                  " queue=" + juce::String(source.queueDepth) +
+                  " asleep=" + juce::String(source.asleep ? 1 : 0));
+    }
+    return lines;
+}
+
+void BackendHost::setTrackSleep(bool enabled, double idleSeconds, float thresholdDb) {
+    trackSleep.idleSeconds = juce::jmax(0.0, idleSeconds);
+    trackSleep.threshold = juce::Decibels::decibelsToGain(thresholdDb, -200.0f);
+    trackSleep.enabled = enabled;
+}
+
+juce::int64 BackendHost::engineTimeFromMs(double timeMs) const {
+    if (timeMs <= 0.0) return 0;
+    return juce::jmax((juce::int64)1, (juce::int64)std::llround(timeMs * mixer.getCurrentSampleRate() / 1000.0));
+}
+
+juce::int64 BackendHost::noteOffTime(juce::int64 startTime, int durationMs) const {
+    const juce::int64 start = startTime > 0 ? startTime : mixer.getSampleClock();
+    const juce::int64 length = juce::jmax((juce::int64)1, (juce::int64)std::llround(durationMs * mixer.getCurrentSampleRate() / 1000.0));
+    return start + length;
+}
+
+InstrumentSource* BackendHost::getInstrumentSource(TrackState& track) {
+    if (track.sf2Source) return track.sf2Source.get();
+    if (track.pluginSource && track.plugin) return track.pluginSource.get();
+    return nullptr;
+}
+
+void BackendHost::postPresetChange(TrackState& track, int presetIndex) {
+    if (!track.sf2Source) return;
+    InstrumentEvent event;
+    event.type = InstrumentEvent::setPreset;
+    event.presetIndex = presetIndex;
+    track.sf2Source->post(event);
 }
 
 bool BackendHost::setTrackVolume(const juce::String& trackId, int volume, int channel) {
-    const juce::ScopedLock sl(tracksLock);
-    
-    auto it = tracks.find(trackId);
-    if (it == tracks.end() || !it->second.player) return false;
+    const int mixerChannel = getMixerChannel(trackId);
+    if (mixerChannel < 0) return false;
     
     // Clamp volume to MIDI range 0-127
     volume = juce::jlimit(0, 127, volume);
     
     // Convert MIDI 0-127 to linear gain (0.0 to 2.0)
     // MIDI 0 = silent, 64 = unity (1.0), 127 = +6dB (~2.0)
-    it->second.gainLinear = (volume / 64.0f);
+    const float gainLinear = volume / 64.0f;
+    mixer.setChannelGain(mixerChannel, gainLinear);
+
+    const juce::ScopedLock sl(tracksLock);
+    auto it = tracks.find(trackId);
+    if (it == tracks.end()) return true; // beat/sampler track: mixer gain only
+
+    it->second.gainLinear = gainLinear;
     
     // Also send MIDI CC 7 for plugins that support it
-    juce::MidiMessage volumeMsg = juce::MidiMessage::controllerEvent(channel, 7, volume);
-    it->second.player->getMidiMessageCollector().addMessageToQueue(volumeMsg);
+    if (it->second.pluginSource) {
+        it->second.pluginSource->postMidi(juce::MidiMessage::controllerEvent(channel, 7, volume));
+    }
     
     return true;
 }
 
+bool BackendHost::setTrackGain(const juce::String& trackId, float gainLinear) {
+    const int mixerChannel = getMixerChannel(trackId);
+    if (mixerChannel < 0) return false;
+
+    gainLinear = juce::jmax(0.0f, gainLinear);
+    mixer.setChannelGain(mixerChannel, gainLinear);
+
+    const juce::ScopedLock sl(tracksLock);
+    auto it = tracks.find(trackId);
+    if (it != tracks.end()) it->second.gainLinear = gainLinear;
+    return true;
+}
+
+bool BackendHost::setTrackMute(const juce::String& trackId, bool shouldBeMuted) {
+    const int channel = getMixerChannel(trackId);
+    if (channel < 0) return false;
+    mixer.setChannelMute(channel, shouldBeMuted);
+    return true;
+}
+
+bool BackendHost::setTrackSolo(const juce::String& trackId, bool shouldBeSoloed) {
+    const int channel = getMixerChannel(trackId);
+    if (channel < 0) return false;
+    mixer.setChannelSolo(channel, shouldBeSoloed);
+    return true;
+}
+
+bool BackendHost::setAutomation(const juce::String& trackId, const juce::String& target,
+                                std::vector<AutomationPoint> points, juce::String& errorMessage) {
+    const juce::String lowered = target.toLowerCase();
+    const bool isGain = lowered == "gain" || lowered == "volume";
+    const bool isParameter = lowered.startsWith("param:");
+    const juce::String parameterId = target.fromFirstOccurrenceOf(":", false, false);
+    if (!isGain && lowered != "pan" && !isParameter) {
+        errorMessage = "unknown-target " + target;
+        return false;
+    }
+    if (isParameter && parameterId.isEmpty()) {
+        errorMessage = "missing-parameter-id";
+        return false;
+    }
+
+    const int numPoints = (int)points.size();
+    std::shared_ptr<const AutomationCurve> curve;
+    if (!points.empty()) curve = std::make_shared<const AutomationCurve>(std::move(points));
+
+    // Parameter IDs are looked up here rather than on the audio thread.
+    // Lock order: tracksLock -> channelLock
+    const juce::ScopedLock tl(tracksLock);
+    const juce::ScopedLock cl(channelLock);
+    auto existing = trackAutomation.find(trackId);
+    auto automation = existing != trackAutomation.end() ? std::make_shared<TrackAutomation>(*existing->second)
+                                                        : std::make_shared<TrackAutomation>();
+    if (isGain) {
+        automation->gain = std::move(curve);
+    } else if (!isParameter) {
+        automation->pan = std::move(curve);
+    } else {
+        auto& lanes = automation->parameters;
+        lanes.erase(std::remove_if(lanes.begin(), lanes.end(),
+                                   [&parameterId](const TrackAutomation::ParameterLane& lane) {
+                                       return lane.parameterId == parameterId;
+                                   }),
+                    lanes.end());
+        if (curve) lanes.push_back({ parameterId, -1, std::move(curve) });
+
+        auto trackIt = tracks.find(trackId);
+        automation->resolveParameters(trackIt != tracks.end() ? trackIt->second.plugin.get() : nullptr);
+    }
+    installAutomation(trackId, automation->isEmpty() ? nullptr : std::move(automation));
+
+    emit("EVENT AUTOMATION " + trackId + " " + target + " points=" + juce::String(numPoints));
+    return true;
+}
+
+void BackendHost::clearAutomation(const juce::String& trackId) {
+    installAutomation(trackId, nullptr);
+}
+
+void BackendHost::startAutomation(double positionSeconds, juce::int64 startTime) {
+    const juce::int64 at = startTime > 0 ? startTime : mixer.getSampleClock();
+    mixer.startAutomation(at - (juce::int64)std::llround(positionSeconds * mixer.getCurrentSampleRate()));
+}
+
+void BackendHost::stopAutomation() {
+    mixer.stopAutomation();
+}
+
+std::shared_ptr<const TrackAutomation> BackendHost::getAutomation(const juce::String& trackId) const {
+    const juce::ScopedLock cl(channelLock);
+    auto it = trackAutomation.find(trackId);
+    return it != trackAutomation.end() ? it->second : nullptr;
+}
+
+void BackendHost::installAutomation(const juce::String& trackId, std::shared_ptr<const TrackAutomation> automation) {
+    const juce::ScopedLock cl(channelLock);
+    auto channel = mixerChannels.find(trackId);
+    if (channel != mixerChannels.end()) mixer.setChannelAutomation(channel->second, automation.get());
+
+    // The mixer has let go of the previous lanes
+    if (automation) trackAutomation[trackId] = std::move(automation);
+    else trackAutomation.erase(trackId);
+}
+
+void BackendHost::resolveAutomationParameters(const juce::String& trackId, const juce::AudioProcessor* plugin) {
+    const juce::ScopedLock cl(channelLock);
+    auto it = trackAutomation.find(trackId);
+    if (it == trackAutomation.end() || it->second->parameters.empty()) return;
+
+    auto automation = std::make_shared<TrackAutomation>(*it->second);
+    automation->resolveParameters(plugin);
+    installAutomation(trackId, std::move(automation));
+}
+
+int BackendHost::acquireMixerChannel(const juce::String& trackId) {
+    const juce::ScopedLock sl(channelLock);
+    auto it = mixerChannels.find(trackId);
+    if (it != mixerChannels.end()) return it->second;
+
+    const int channel = mixer.allocateChannel();
+    if (channel < 0) return channel;
+    mixerChannels[trackId] = channel;
+
+    // Lanes set before the track had a channel (or kept since it last had one)
+    auto automation = trackAutomation.find(trackId);
+    if (automation != trackAutomation.end()) mixer.setChannelAutomation(channel, automation->second.get());
+    return channel;
+}
+
+int BackendHost::getMixerChannel(const juce::String& trackId) const {
+    const juce::ScopedLock sl(channelLock);
+    auto it = mixerChannels.find(trackId);
+    return it != mixerChannels.end() ? it->second : -1;
+}
+
+void BackendHost::releaseMixerChannelIfUnused(const juce::String& trackId) {
+    // Lock order: tracksLock -> beatLock -> samplerLock -> clipLock -> channelLock
+    const juce::ScopedLock tl(tracksLock);
+    const juce::ScopedLock bl(beatLock);
+    const juce::ScopedLock sl(samplerLock);
+    const juce::ScopedLock kl(clipLock);
+    if (tracks.count(trackId) || beatTracks.count(trackId) || samplerTracks.count(trackId) || clipTracks.count(trackId)) {
+        return;
+    }
+
+    const juce::ScopedLock cl(channelLock);
+    auto it = mixerChannels.find(trackId);
+    if (it == mixerChannels.end()) return;
+    mixer.releaseChannel(it->second);
+    mixerChannels.erase(it);
+}
+
 bool BackendHost::openEditor(const juce::String& trackId, juce::String& errorMessage) {
     const juce::ScopedLock sl(tracksLock);
     
@@ -1271,452 +2557,992 @@ bool BackendHost::isEditorOpen(const juce::String& trackId) const {
     return it->second.editorWindow != nullptr && it->second.editorWindow->isVisible();
 }
 
-bool BackendHost::renderToWav(const std::vector<MidiNoteEvent>& notes,
-                               const juce::File& outputPath,
-                               juce::String& errorMessage,
-                               double sampleRate,
-                               int bitDepth,
-                               const std::vector<BeatRenderEvent>& beatEvents,
-                               const std::vector<AudioClipRenderEvent>& audioClips) {
+// Everything one bounce needs, captured on the message thread so the render itself never touches
+// live track state. Plugins are render-private instances restored from the live plugin's state;
+// SF2 tracks get another instance over the shared font (SoundFontBank::copy).
+struct BackendHost::RenderJob {
+    using SoundFontCopy = std::unique_ptr<tsf, void (*)(tsf*)>;
+
+    struct InstrumentTrack {
+        juce::String trackId;
+        std::vector<MidiNoteEvent> notes; // sorted by start time
+        std::unique_ptr<juce::AudioPluginInstance> plugin;
+        SoundFontCopy soundFont { nullptr, SoundFontBank::release };
+        int sf2VoiceLimit = SoundFontBank::maxVoices;
+        SoundFontBank::VoiceStealing sf2VoiceStealing = SoundFontBank::VoiceStealing::releasing;
+        std::shared_ptr<const BeatSample> samplerSample;
+        int samplerRootNote = 60;
+        int samplerVoiceLimit = SamplerVoices::maxVoices;
+        SoundFontBank::VoiceStealing samplerVoiceStealing = SoundFontBank::VoiceStealing::oldest;
+        float gainLinear = 1.0f;
+
+        // Stem cache: where this track's stem is written, or the cached stem that replays
+        // instead of any instrument above
+        juce::File stemFile;
+        std::unique_ptr<juce::AudioFormatReader> cachedStem;
+    };
+
+    struct BeatHit {
+        juce::String trackId;
+        std::shared_ptr<const BeatSample> sample;
+        double startTimeSeconds = 0.0;
+        float gain = 1.0f;
+    };
+
+    juce::File outputPath;
+    double sampleRate = 44100.0;
+    int bitDepth = 24;
+    RenderOptions options;
+
+    std::vector<InstrumentTrack> instruments;
+    std::vector<BeatHit> beatHits;
+    std::vector<AudioClipRenderEvent> audioClips;
+
+    // Every track's automation as it was when the render was queued
+    std::map<juce::String, std::shared_ptr<const TrackAutomation>> automation;
+
+    const TrackAutomation* getAutomation(const juce::String& trackId) const {
+        auto it = automation.find(trackId);
+        return it != automation.end() ? it->second.get() : nullptr;
+    }
+
+    std::atomic<bool> cancelled { false };
+};
+
+namespace {
+
+constexpr int renderChannels = 2; // Stereo output
+constexpr double songTailSeconds = 2.0; // rendered past the end of a whole song, for reverbs and delays
+
+// How far ahead of its range a range render starts: long enough for the longest plugin tail, so
+// reverbs and delays of the notes just before the range have built up by then
+double getPreRollSeconds(const BackendHost::RenderJob& job) {
+    if (job.options.preRollSeconds >= 0.0) return job.options.preRollSeconds;
+
+    double preRoll = RenderOptions::minPreRollSeconds;
+    for (const auto& instrument : job.instruments) {
+        if (instrument.plugin) preRoll = juce::jmax(preRoll, instrument.plugin->getTailLengthSeconds());
+    }
+    return juce::jmin(preRoll, RenderOptions::maxPreRollSeconds); // also catches infinite tails
+}
+
+// Frames in a whole-song render of these events, tail included, worked out as renderTracks does
+// (clips that can't be read are left out, as renderTracks skips them)
+juce::int64 getSongFrames(const std::vector<MidiNoteEvent>& notes, const std::vector<BackendHost::RenderJob::BeatHit>& beatHits,
+                          const std::vector<AudioClipRenderEvent>& audioClips, double sampleRate,
+                          juce::AudioFormatManager& formatManager, SampleCache& sampleCache) {
+    auto toSamples = [sampleRate](double seconds) {
+        return juce::jmax<juce::int64>(0, (juce::int64)(seconds * sampleRate));
+    };
+
+    juce::int64 endSample = 0;
+    for (const auto& note : notes) {
+        endSample = juce::jmax(endSample, toSamples(note.startTimeSeconds + note.durationSeconds));
+    }
+    for (const auto& hit : beatHits) {
+        endSample = juce::jmax(endSample, toSamples(hit.startTimeSeconds + hit.sample->getNumSamples() / hit.sample->sampleRate));
+    }
+    for (const auto& clip : audioClips) {
+        juce::int64 length = 0;
+        double clipRate = 0.0;
+        if (auto sample = sampleCache.find(clip.file)) {
+            length = sample->getNumSamples();
+            clipRate = sample->sampleRate;
+        } else if (std::unique_ptr<juce::AudioFormatReader> reader(formatManager.createReaderFor(clip.file)); reader) {
+            length = reader->lengthInSamples;
+            clipRate = reader->sampleRate;
+        }
+        if (length <= 0 || clipRate <= 0.0) continue;
+        const juce::int64 startSample = juce::jmax<juce::int64>(0, (juce::int64)std::floor(clip.startTimeSeconds * sampleRate));
+        endSample = juce::jmax(endSample, startSample + (juce::int64)std::ceil((double)length / (clipRate / sampleRate)));
+    }
+    return juce::jmax<juce::int64>(1, endSample + (juce::int64)(songTailSeconds * sampleRate));
+}
+
+} // namespace
+
+std::shared_ptr<BackendHost::RenderJob> BackendHost::prepareRender(const std::vector<MidiNoteEvent>& notes,
+                                                                    const juce::File& outputPath,
+                                                                    juce::String& errorMessage,
+                                                                    double sampleRate,
+                                                                    int bitDepth,
+                                                                    const std::vector<BeatRenderEvent>& beatEvents,
+                                                                    const std::vector<AudioClipRenderEvent>& audioClips,
+                                                                    const RenderOptions& options) {
     // Validate bit depth
     if (bitDepth != 16 && bitDepth != 24 && bitDepth != 32) {
         errorMessage = "Invalid bit depth. Must be 16, 24, or 32";
-        return false;
+        return {};
     }
 
     if (notes.empty() && beatEvents.empty() && audioClips.empty()) {
         errorMessage = "Nothing to render";
-        return false;
+        return {};
     }
 
-    const juce::ScopedLock sl(tracksLock);
-
-    // Determine total duration from notes first
-    double totalDuration = 0.0;
-    for (const auto& note : notes) {
-        const double endTime = note.startTimeSeconds + note.durationSeconds;
-        if (endTime > totalDuration) totalDuration = endTime;
+    auto job = std::make_shared<RenderJob>();
+    job->outputPath = outputPath;
+    job->sampleRate = sampleRate;
+    job->bitDepth = bitDepth;
+    job->options = options;
+    if (options.hasRange()) job->options.useStemCache = false; // stems hold the song past the range end
+    job->audioClips = audioClips;
+    {
+        const juce::ScopedLock cl(channelLock);
+        job->automation = trackAutomation;
     }
 
-    // Preload beat samples referenced by beatEvents and account for their duration
-    struct BeatJob {
-        std::shared_ptr<BeatSample> sample;
-        double startTimeSeconds = 0.0;
-        float gain = 1.0f;
-    };
-    std::vector<BeatJob> beatJobs;
+    // Resolve beat samples referenced by beatEvents
     {
         const juce::ScopedLock bl(beatLock);
         for (const auto& ev : beatEvents) {
-            auto trackIt = beatSamples.find(ev.trackId);
-            if (trackIt == beatSamples.end()) {
+            auto trackIt = beatTracks.find(ev.trackId);
+            if (trackIt == beatTracks.end()) {
                 emit("WARNING: Beat track " + ev.trackId + " not loaded; skipping");
                 continue;
             }
-            auto rowIt = trackIt->second.find(ev.rowId);
-            if (rowIt == trackIt->second.end() || !rowIt->second) {
+            auto rowIt = trackIt->second.rows.find(ev.rowId);
+            if (rowIt == trackIt->second.rows.end() || !rowIt->second) {
                 emit("WARNING: Beat row " + ev.rowId + " missing for track " + ev.trackId);
                 continue;
             }
-            auto samplePtr = rowIt->second;
-            if (!samplePtr || samplePtr->buffer.getNumSamples() == 0) continue;
-            const double sampleDuration = samplePtr->buffer.getNumSamples() / samplePtr->sampleRate;
-            const double endTime = ev.startTimeSeconds + sampleDuration;
-            if (endTime > totalDuration) totalDuration = endTime;
-            beatJobs.push_back({samplePtr, ev.startTimeSeconds, ev.gainLinear});
+            if (rowIt->second->getNumSamples() == 0) continue;
+            job->beatHits.push_back({ev.trackId, rowIt->second, ev.startTimeSeconds, ev.gainLinear});
         }
     }
 
-    // Preload audio clips referenced by export payload and compute duration
-    struct LoadedAudioClip {
-        AudioClipRenderEvent event;
-        juce::AudioBuffer<float> buffer;
-        double sourceRate = 44100.0;
+    // A stem holds the whole song's length, tail included, so it is only reused by renders as long
+    const juce::int64 renderFrames = job->options.useStemCache
+                                         ? getSongFrames(notes, job->beatHits, audioClips, sampleRate, beatFormatManager, *sampleCache)
+                                         : 0;
+
+    // Group MIDI notes by track ID, each track's notes sorted by start time
+    std::map<juce::String, std::vector<MidiNoteEvent>> notesByTrack;
+    for (const auto& note : notes) {
+        notesByTrack[note.trackId].push_back(note);
+    }
+
+    // Snapshot what each track plays with. Plugin instances are created outside tracksLock.
+    struct PluginSnapshot {
+        size_t instrumentIndex;
+        juce::PluginDescription description;
+        juce::MemoryBlock state;
     };
-    std::vector<LoadedAudioClip> loadedClips;
-    for (const auto& clip : audioClips) {
-        if (!clip.file.existsAsFile()) {
-            emit("WARNING: Audio clip missing file " + clip.file.getFullPathName());
-            continue;
+    std::vector<PluginSnapshot> pluginSnapshots;
+
+    // Points a track at its stem in the cache: the stem to replay when there is one (returns
+    // true), otherwise the file to record it to
+    auto useCachedStem = [this](RenderJob::InstrumentTrack& instrument, const StemCache::Key& key) {
+        const juce::File cached = stemCache.find(key);
+        if (cached.existsAsFile()) {
+            instrument.cachedStem.reset(beatFormatManager.createReaderFor(cached));
+            if (instrument.cachedStem != nullptr) return true;
         }
+        instrument.stemFile = stemCache.getStemFile(key);
+        return false;
+    };
 
-        std::unique_ptr<juce::AudioFormatReader> reader(beatFormatManager.createReaderFor(clip.file));
-        if (!reader) {
-            emit("WARNING: Unsupported audio format for clip " + clip.file.getFullPathName());
-            continue;
+    for (auto& [trackId, trackNotes] : notesByTrack) {
+        std::stable_sort(trackNotes.begin(), trackNotes.end(), [](const MidiNoteEvent& a, const MidiNoteEvent& b) {
+            return a.startTimeSeconds < b.startTimeSeconds;
+        });
+
+        RenderJob::InstrumentTrack instrument;
+        instrument.trackId = trackId;
+        instrument.notes = std::move(trackNotes);
+
+        // A track with a sampler sample renders as a sampler-only track
+        {
+            const juce::ScopedLock sl(samplerLock);
+            auto samplerIt = samplerTracks.find(trackId);
+            if (samplerIt != samplerTracks.end() && samplerIt->second.sample) {
+                instrument.samplerSample = samplerIt->second.sample;
+                instrument.samplerRootNote = samplerIt->second.rootNote.rootNote;
+                instrument.samplerVoiceLimit = samplerIt->second.voiceLimit;
+                instrument.samplerVoiceStealing = samplerIt->second.voiceStealing;
+                if (job->options.useStemCache) {
+                    useCachedStem(instrument, getStemKey(samplerIt->second, instrument.notes, sampleRate,
+                                                         renderFrames, options.resamplerQuality));
+                }
+            }
         }
 
-        const auto numSamples = reader->lengthInSamples;
-        if (numSamples <= 0) continue;
+        if (!instrument.samplerSample) {
+            const juce::ScopedLock sl(tracksLock);
+            auto trackIt = tracks.find(trackId);
+            if (trackIt == tracks.end()) {
+                emit("WARNING: Track " + trackId + " not found, skipping");
+                continue;
+            }
+
+            const TrackState& track = trackIt->second;
+            instrument.gainLinear = track.gainLinear;
 
-        juce::AudioBuffer<float> buffer((int)reader->numChannels, (int)numSamples);
-        if (!reader->read(&buffer, 0, (int)numSamples, 0, true, true)) {
-            emit("WARNING: Failed to read audio clip " + clip.file.getFullPathName());
-            continue;
+            if (track.plugin) {
+                PluginSnapshot snapshot { job->instruments.size(), track.plugin->getPluginDescription(), {} };
+                track.plugin->getStateInformation(snapshot.state);
+                if (job->options.useStemCache
+                    && useCachedStem(instrument, getStemKey(track, snapshot.state, instrument.notes, sampleRate,
+                                                            renderFrames, job->getAutomation(trackId)))) {
+                    job->instruments.push_back(std::move(instrument));
+                    continue; // no render instance needed
+                }
+                pluginSnapshots.push_back(std::move(snapshot));
+            } else if (track.soundFont) {
+                if (job->options.useStemCache && useCachedStem(instrument, getStemKey(track, {}, instrument.notes, sampleRate, renderFrames, nullptr))) {
+                    job->instruments.push_back(std::move(instrument));
+                    continue;
+                }
+                instrument.soundFont.reset(SoundFontBank::copy(track.soundFont));
+                if (!instrument.soundFont) {
+                    errorMessage = "Failed to copy SoundFont for track " + trackId;
+                    return {};
+                }
+                instrument.sf2VoiceLimit = track.sf2VoiceLimit;
+                instrument.sf2VoiceStealing = track.sf2VoiceStealing;
+
+                // Same preset as the live track (falling back to the first one, as loadSF2 does)
+                int presetIndex = tsf_get_presetindex(instrument.soundFont.get(), track.sf2CurrentBank, track.sf2CurrentPreset);
+                if (presetIndex < 0 && tsf_get_presetcount(instrument.soundFont.get()) > 0) presetIndex = 0;
+                if (presetIndex >= 0) {
+                    for (int ch = 0; ch < 16; ++ch) {
+                        tsf_channel_set_presetindex(instrument.soundFont.get(), ch, presetIndex);
+                    }
+                }
+            } else {
+                emit("WARNING: Track " + trackId + " has no plugin, SF2, or sampler sample loaded; skipping");
+                continue;
+            }
         }
 
-        const double clipDuration = (double)numSamples / reader->sampleRate;
-        const double endTime = clip.startTimeSeconds + clipDuration;
-        if (endTime > totalDuration) totalDuration = endTime;
+        job->instruments.push_back(std::move(instrument));
+    }
 
-        LoadedAudioClip loaded;
-        loaded.event = clip;
-        loaded.buffer = std::move(buffer);
-        loaded.sourceRate = reader->sampleRate;
-        loadedClips.push_back(std::move(loaded));
+    for (auto& snapshot : pluginSnapshots) {
+        auto& instrument = job->instruments[snapshot.instrumentIndex];
+        juce::String pluginError;
+        instrument.plugin = formatManager.createPluginInstance(snapshot.description, sampleRate, OfflineRender::blockSize, pluginError);
+        if (!instrument.plugin) {
+            errorMessage = "Failed to create render instance for track " + instrument.trackId + ": " + pluginError;
+            return {};
+        }
+        if (snapshot.state.getSize() > 0) {
+            instrument.plugin->setStateInformation(snapshot.state.getData(), (int)snapshot.state.getSize());
+        }
     }
 
-    // Add 2 seconds of tail for reverb/delay effects
-    totalDuration += 2.0;
+    {
+        const juce::ScopedLock rl(renderLock);
+        activeRenders.erase(std::remove_if(activeRenders.begin(), activeRenders.end(),
+                                           [](const std::weak_ptr<RenderJob>& r) { return r.expired(); }),
+                            activeRenders.end());
+        activeRenders.push_back(job);
+    }
+    return job;
+}
 
-    const int blockSize = 512;
-    const int totalSamples = juce::jmax(1, static_cast<int>(totalDuration * sampleRate));
-    const int numChannels = 2; // Stereo output
+bool BackendHost::runRender(RenderJob& job, juce::String& errorMessage) {
+    const bool completed = renderTracks(job, errorMessage);
+    releaseRenderInstruments(job);
+    return completed;
+}
 
-    // Create output buffer
-    juce::AudioBuffer<float> renderBuffer(numChannels, totalSamples);
-    renderBuffer.clear();
+bool BackendHost::renderTracks(RenderJob& job, juce::String& errorMessage) {
+    const double sampleRate = job.sampleRate;
+    const auto quality = job.options.resamplerQuality;
+    const int numChannels = renderChannels;
 
-    // Group MIDI notes by track ID
-    std::map<juce::String, std::vector<const MidiNoteEvent*>> notesByTrack;
-    for (const auto& note : notes) {
-        notesByTrack[note.trackId].push_back(&note);
+    if (job.cancelled) {
+        errorMessage = "cancelled";
+        return false;
     }
 
-    // Process each track separately, then mix
-    for (const auto& [trackId, trackNotes] : notesByTrack) {
-        emit("DEBUG Processing track: " + trackId + " with " + juce::String(trackNotes.size()) + " notes");
-        
-        auto trackIt = tracks.find(trackId);
-        
-        // Check if this is a sampler-only track (not in tracks map but has sampler sample)
-        bool isSamplerOnly = false;
-        std::shared_ptr<BeatSample> samplerSample = nullptr;
-        {
-            const juce::ScopedLock sl(samplerLock);
-            auto samplerIt = samplerSamples.find(trackId);
-            if (samplerIt != samplerSamples.end() && samplerIt->second) {
-                isSamplerOnly = true;
-                samplerSample = samplerIt->second;
+    // One renderer per instrument track, plus shared ones for beat hits and audio clips (a track
+    // with gain or pan automation, or any track when stems are exported, gets its own); the
+    // timeline ends where the last of them falls silent (plus a tail)
+    std::vector<std::unique_ptr<OfflineRender::TrackRenderer>> renderers;
+    std::vector<float> gains;
+    std::vector<const TrackAutomation*> mixAutomation; // replaces the gain when set
+    std::vector<juce::String> rendererTracks;          // empty for the shared renderers
+    const bool exportStems = job.options.stemFolder != juce::File();
+    juce::int64 endSample = 0;
+
+    auto getMixAutomation = [&job](const juce::String& trackId) -> const TrackAutomation* {
+        const auto* automation = job.getAutomation(trackId);
+        return automation != nullptr && automation->hasMixLanes() ? automation : nullptr;
+    };
+
+    auto toSamples = [sampleRate](double seconds) {
+        return juce::jmax<juce::int64>(0, (juce::int64)(seconds * sampleRate));
+    };
+
+    // Range render: the chunks start at renderStart, the pre-roll ahead of the range, and only
+    // events still sounding by then and starting before the range end are processed. Everything
+    // keeps its place on the timeline; notes are cut at the range end.
+    const bool ranged = job.options.hasRange();
+    const juce::int64 rangeStart = ranged ? toSamples(job.options.rangeStartSeconds) : 0;
+    const juce::int64 rangeEnd = ranged ? juce::jmax(rangeStart + 1, toSamples(job.options.rangeEndSeconds)) : 0;
+    const juce::int64 renderStart = ranged ? juce::jmax<juce::int64>(0, rangeStart - toSamples(getPreRollSeconds(job))) : 0;
+    if (ranged) {
+        const double windowStart = (double)renderStart / sampleRate;
+        const double windowEnd = (double)rangeEnd / sampleRate;
+        for (auto& instrument : job.instruments) {
+            auto& notes = instrument.notes;
+            notes.erase(std::remove_if(notes.begin(), notes.end(), [&](const MidiNoteEvent& note) {
+                            return note.startTimeSeconds >= windowEnd
+                                || note.startTimeSeconds + note.durationSeconds <= windowStart;
+                        }),
+                        notes.end());
+            for (auto& note : notes) {
+                note.durationSeconds = juce::jmin(note.durationSeconds, windowEnd - note.startTimeSeconds);
             }
         }
-        
-        if (trackIt == tracks.end() && !isSamplerOnly) {
-            emit("WARNING: Track " + trackId + " not found, skipping");
-            continue;
+        auto& hits = job.beatHits;
+        hits.erase(std::remove_if(hits.begin(), hits.end(), [&](const RenderJob::BeatHit& hit) {
+                       return hit.startTimeSeconds >= windowEnd
+                           || hit.startTimeSeconds + hit.sample->getNumSamples() / hit.sample->sampleRate <= windowStart;
+                   }),
+                   hits.end());
+        endSample = rangeEnd;
+    } else {
+        for (const auto& instrument : job.instruments) {
+            for (const auto& note : instrument.notes) {
+                endSample = juce::jmax(endSample, toSamples(note.startTimeSeconds + note.durationSeconds));
+            }
+        }
+        for (const auto& hit : job.beatHits) {
+            const double sampleDuration = hit.sample->getNumSamples() / hit.sample->sampleRate;
+            endSample = juce::jmax(endSample, toSamples(hit.startTimeSeconds + sampleDuration));
         }
+    }
 
-        // Sort notes by start time for this track
-        std::vector<const MidiNoteEvent*> sortedNotes = trackNotes;
-        std::sort(sortedNotes.begin(), sortedNotes.end(),
-                  [](const MidiNoteEvent* a, const MidiNoteEvent* b) {
-                      return a->startTimeSeconds < b->startTimeSeconds;
-                  });
-
-        // Common buffer for this track
-        juce::AudioBuffer<float> trackBuffer(numChannels, totalSamples);
-        trackBuffer.clear();
-
-        // Handle sampler-only tracks first
-        if (isSamplerOnly && samplerSample) {
-            emit("INFO: Rendering sampler track " + trackId);
-            const int srcChannels = samplerSample->buffer.getNumChannels();
-            const int srcSamples = samplerSample->buffer.getNumSamples();
-            const double srcSampleRate = samplerSample->sampleRate;
-            const int rootNote = samplerSample->detectedRootNote;
-
-            // Render each note with pitch shifting
-            for (const auto* note : sortedNotes) {
-                const int startSample = juce::jlimit(0, totalSamples - 1, (int)(note->startTimeSeconds * sampleRate));
-                const int noteDurationSamples = juce::jmax(1, (int)(note->durationSeconds * sampleRate));
-                
-                // Calculate pitch shift ratio
-                const double semitoneShift = note->midiNote - rootNote;
-                const double pitchRatio = std::pow(2.0, semitoneShift / 12.0);
-                
-                // Apply sample rate conversion on top of pitch shift
-                const double effectiveRatio = (srcSampleRate / sampleRate) * pitchRatio;
-                
-                // Render this note
-                double srcPosition = 0.0;
-                for (int destSample = startSample; destSample < startSample + noteDurationSamples && destSample < totalSamples; ++destSample) {
-                    const int srcIdx = (int)srcPosition;
-                    if (srcIdx >= srcSamples - 1) break;
-                    
-                    const double frac = srcPosition - (double)srcIdx;
-                    
-                    // Linear interpolation for each channel
-                    for (int ch = 0; ch < numChannels; ++ch) {
-                        const int srcCh = (srcChannels == 1) ? 0 : juce::jmin(ch, srcChannels - 1);
-                        const float s0 = samplerSample->buffer.getSample(srcCh, srcIdx);
-                        const float s1 = samplerSample->buffer.getSample(srcCh, srcIdx + 1);
-                        const float interpolated = (float)((1.0 - frac) * s0 + frac * s1);
-                        
-                        // Apply velocity
-                        const float sample = interpolated * note->velocity01;
-                        trackBuffer.addSample(ch, destSample, sample);
-                    }
-                    
-                    srcPosition += effectiveRatio;
+    auto makeClipRenderer = [&] {
+        auto renderer = std::make_unique<OfflineRender::ClipRenderer>(beatFormatManager, *sampleCache, sampleRate, quality);
+        if (ranged) renderer->setRange(renderStart, rangeEnd);
+        return renderer;
+    };
+    auto clips = makeClipRenderer();
+    std::map<juce::String, std::unique_ptr<OfflineRender::ClipRenderer>> trackClips;
+    for (const auto& clip : job.audioClips) {
+        auto* renderer = clips.get();
+        if (exportStems || getMixAutomation(clip.trackId) != nullptr) {
+            auto& own = trackClips[clip.trackId];
+            if (!own) own = makeClipRenderer();
+            renderer = own.get();
+        }
+
+        juce::String warning;
+        const juce::int64 clipEnd = renderer->addClip(clip, warning);
+        if (clipEnd < 0) emit("WARNING: " + warning);
+        else if (!ranged) endSample = juce::jmax(endSample, clipEnd);
+    }
+
+    // Add 2 seconds of tail for reverb/delay effects; a range's tail renders until the mix falls
+    // silent, up to its maximum
+    const juce::int64 tailLength = ranged ? toSamples(job.options.maxTailSeconds) : (juce::int64)(songTailSeconds * sampleRate);
+    const juce::int64 totalSamples = juce::jmax<juce::int64>(1, endSample + tailLength);
+
+    // Tracks rendered afresh are recorded to the stem cache as they go (before their gain)
+    std::vector<std::unique_ptr<OfflineRender::StemWriter>> stemWriters;
+    int cachedStems = 0;
+
+    for (auto& instrument : job.instruments) {
+        if (instrument.cachedStem) {
+            renderers.push_back(std::make_unique<OfflineRender::StemRenderer>(std::move(instrument.cachedStem)));
+            gains.push_back(instrument.samplerSample ? 1.0f : instrument.gainLinear);
+            mixAutomation.push_back(getMixAutomation(instrument.trackId));
+            rendererTracks.push_back(instrument.trackId);
+            stemWriters.push_back(nullptr);
+            ++cachedStems;
+            continue;
+        }
+        if (ranged && instrument.notes.empty()) continue; // nothing plays in the range
+        const size_t numRenderers = renderers.size();
+        if (instrument.samplerSample) {
+            // Sampler notes: the sample pitched from its detected root, released at the note's end
+            // under the live track's voice budget
+            auto sampler = std::make_unique<OfflineRender::SampleRenderer>(quality);
+            sampler->setVoiceBudget(instrument.samplerVoiceLimit, instrument.samplerVoiceStealing, sampleRate);
+            const BeatSample& sample = *instrument.samplerSample;
+            for (const auto& note : instrument.notes) {
+                const double pitchRatio = std::pow(2.0, (note.midiNote - instrument.samplerRootNote) / 12.0);
+                sampler->addShot(instrument.samplerSample, toSamples(note.startTimeSeconds),
+                                 (sample.sampleRate / sampleRate) * pitchRatio, note.velocity01,
+                                 juce::jmax<juce::int64>(1, toSamples(note.durationSeconds)));
+            }
+            renderers.push_back(std::move(sampler));
+            gains.push_back(1.0f); // Sampler-only tracks default to gain 1.0
+        } else if (instrument.plugin) {
+            renderers.push_back(std::make_unique<OfflineRender::PluginRenderer>(*instrument.plugin, instrument.notes,
+                                                                                sampleRate, totalSamples,
+                                                                                job.getAutomation(instrument.trackId)));
+            gains.push_back(instrument.gainLinear);
+        } else if (instrument.soundFont) {
+            renderers.push_back(std::make_unique<OfflineRender::SF2Renderer>(instrument.soundFont.get(), instrument.notes,
+                                                                             sampleRate, totalSamples,
+                                                                             instrument.sf2VoiceLimit,
+                                                                             instrument.sf2VoiceStealing));
+            gains.push_back(instrument.gainLinear);
+        }
+        if (renderers.size() == numRenderers) continue;
+        mixAutomation.push_back(getMixAutomation(instrument.trackId));
+        rendererTracks.push_back(instrument.trackId);
+
+        std::unique_ptr<OfflineRender::StemWriter> stemWriter;
+        if (instrument.stemFile != juce::File()) {
+            stemWriter = std::make_unique<OfflineRender::StemWriter>(instrument.stemFile, sampleRate, numChannels);
+            if (!stemWriter->isOpen()) stemWriter.reset(); // the render goes ahead uncached
+        }
+        stemWriters.push_back(std::move(stemWriter));
+    }
+    if (job.options.useStemCache) {
+        emit("EVENT RENDER_STEMS cached=" + juce::String(cachedStems) +
+             " rendered=" + juce::String((int)job.instruments.size() - cachedStems) + " " + job.outputPath.getFullPathName());
+    }
+
+    if (!job.beatHits.empty()) {
+        auto beats = std::make_unique<OfflineRender::SampleRenderer>(quality);
+        std::map<juce::String, std::unique_ptr<OfflineRender::SampleRenderer>> trackBeats;
+        // With sample preparation each sample is resampled to the render rate once, not per hit
+        std::map<const BeatSample*, std::shared_ptr<const BeatSample>> prepared;
+        for (const auto& hit : job.beatHits) {
+            auto* renderer = beats.get();
+            if (exportStems || getMixAutomation(hit.trackId) != nullptr) {
+                auto& own = trackBeats[hit.trackId];
+                if (!own) own = std::make_unique<OfflineRender::SampleRenderer>(quality);
+                renderer = own.get();
+            }
+            auto sample = hit.sample;
+            if (samplePreparation.load()) {
+                auto preparedIt = prepared.find(sample.get());
+                if (preparedIt == prepared.end()) {
+                    auto copy = PreparedSample::create(*sample, sampleRate, quality);
+                    preparedIt = prepared.emplace(sample.get(), copy ? copy : sample).first;
                 }
+                sample = preparedIt->second;
             }
-        } else {
-            // Handle VST/SF2 tracks
-            TrackState& track = trackIt->second;
+            renderer->addShot(sample, toSamples(hit.startTimeSeconds), sample->sampleRate / sampleRate, hit.gain);
+        }
+        renderers.push_back(std::move(beats));
+        gains.push_back(1.0f);
+        mixAutomation.push_back(nullptr);
+        rendererTracks.push_back({});
+        for (auto& [trackId, renderer] : trackBeats) {
+            renderers.push_back(std::move(renderer));
+            gains.push_back(1.0f);
+            mixAutomation.push_back(getMixAutomation(trackId));
+            rendererTracks.push_back(trackId);
+        }
+    }
+    if (!job.audioClips.empty()) {
+        renderers.push_back(std::move(clips));
+        gains.push_back(1.0f);
+        mixAutomation.push_back(nullptr);
+        rendererTracks.push_back({});
+        for (auto& [trackId, renderer] : trackClips) {
+            renderers.push_back(std::move(renderer));
+            gains.push_back(1.0f);
+            mixAutomation.push_back(getMixAutomation(trackId));
+            rendererTracks.push_back(trackId);
+        }
+    }
 
-            if (track.plugin) {
-            auto* plugin = track.plugin.get();
+    // Outputs: the mix in every requested format, each encoding on its own writer thread. Peak
+    // normalisation streams a float pass-one file first and encodes the outputs from it in a
+    // second pass.
+    const auto normalisation = job.options.normalisation;
+    const int bitRate = job.options.bitRateKbps;
+    std::vector<std::unique_ptr<OfflineRender::RenderOutput>> outputs;
+    outputs.push_back(std::make_unique<OfflineRender::RenderOutput>(job.outputPath, job.options.outputFormat, job.bitDepth));
+    for (const auto& extra : job.options.extraOutputs) {
+        outputs.push_back(std::make_unique<OfflineRender::RenderOutput>(extra.file, extra.format, extra.bitDepth));
+    }
+    std::unique_ptr<OfflineRender::RenderOutput> scanOutput;
+    if (normalisation == RenderOptions::Normalisation::peak) {
+        scanOutput = std::make_unique<OfflineRender::RenderOutput>(job.outputPath, RenderOptions::OutputFormat::wav, 32);
+        if (!scanOutput->open(sampleRate, numChannels, bitRate, errorMessage)) return false;
+    } else {
+        for (auto& output : outputs) {
+            if (!output->open(sampleRate, numChannels, bitRate, errorMessage)) return false;
+        }
+    }
+    auto writeMix = [&](const juce::AudioBuffer<float>& buffer, int startSample, int numSamples) {
+        if (scanOutput) return scanOutput->write(buffer, startSample, numSamples, job.cancelled);
+        for (auto& output : outputs) {
+            if (!output->write(buffer, startSample, numSamples, job.cancelled)) return false;
+        }
+        return true;
+    };
 
-            // Prepare plugin for rendering
-            plugin->prepareToPlay(sampleRate, blockSize);
-            plugin->setNonRealtime(true); // Enable offline rendering mode
+    // Track stems, written from the same pass as the mix
+    std::vector<std::unique_ptr<OfflineRender::RenderOutput>> trackOutputs(renderers.size());
+    if (exportStems) {
+        job.options.stemFolder.createDirectory();
+        const auto extension = RenderOptions::getFileExtension(job.options.stemFormat);
+        juce::StringArray names;
+        for (size_t i = 0; i < renderers.size(); ++i) {
+            if (rendererTracks[i].isEmpty()) continue;
+            // A track with both notes and beats or clips gets one stem per part
+            juce::String name = juce::File::createLegalFileName(rendererTracks[i]);
+            for (int n = 2; names.contains(name); ++n) name = juce::File::createLegalFileName(rendererTracks[i]) + "-" + juce::String(n);
+            names.add(name);
+
+            trackOutputs[i] = std::make_unique<OfflineRender::RenderOutput>(job.options.stemFolder.getChildFile(name + extension),
+                                                                            job.options.stemFormat, job.bitDepth);
+            if (!trackOutputs[i]->open(sampleRate, numChannels, bitRate, errorMessage)) return false;
+        }
+    }
+
+    std::unique_ptr<OfflineRender::PeakLimiter> limiter;
+    if (normalisation == RenderOptions::Normalisation::limiter) {
+        limiter = std::make_unique<OfflineRender::PeakLimiter>(sampleRate, numChannels);
+    }
+    const int latency = limiter ? limiter->getLatency() : 0;
 
-            juce::MidiBuffer midiBuffer;
+    // Per-chunk pipeline: every renderer fills its own chunk buffer on the render pool, then the
+    // chunks are summed in track order and streamed to the writers
+    const int chunkSize = OfflineRender::chunkSize;
+    std::vector<juce::AudioBuffer<float>> trackChunks(renderers.size(), juce::AudioBuffer<float>(numChannels, chunkSize));
+    juce::AudioBuffer<float> mix(numChannels, chunkSize);
+    juce::AudioBuffer<float> mixGains(numChannels, chunkSize); // an automated track's per-sample gains
 
-            // Build MIDI message timeline
-            std::vector<std::pair<int, juce::MidiMessage>> midiTimeline;
-            for (const auto* note : sortedNotes) {
-                int samplePos = static_cast<int>(note->startTimeSeconds * sampleRate);
-                int noteOffPos = static_cast<int>((note->startTimeSeconds + note->durationSeconds) * sampleRate);
+    const juce::String progressSuffix = " " + job.outputPath.getFullPathName();
+    const int passOneShare = scanOutput ? 90 : 100;
+    int lastPercent = -1;
+    auto reportProgress = [&](int percent) {
+        if (percent == lastPercent) return;
+        emit("EVENT RENDER_PROGRESS " + juce::String(percent) + progressSuffix);
+        lastPercent = percent;
+    };
 
-                // Clamp to valid range
-                samplePos = juce::jlimit(0, totalSamples - 1, samplePos);
-                noteOffPos = juce::jlimit(0, totalSamples - 1, noteOffPos);
+    juce::WaitableEvent chunkDone;
+    std::atomic<int> pending { 0 };
+    float peak = 0.0f;
+    juce::int64 framesToSkip = latency + (rangeStart - renderStart); // the limiter's delay and the pre-roll
+    juce::int64 stemFramesToSkip = rangeStart - renderStart;         // stems aren't limited
+    const juce::int64 renderLength = totalSamples + latency;
+
+    // A range render ends at the first chunk of its tail that stays below the silence threshold
+    const juce::int64 tailStart = ranged ? endSample + latency : renderLength;
+    const float silence = juce::Decibels::decibelsToGain(job.options.tailThresholdDb);
+    const juce::int64 progressLength = tailStart - renderStart;
+    juce::int64 framesWritten = 0;
+
+    for (juce::int64 chunkStart = renderStart; chunkStart < renderLength; chunkStart += chunkSize) {
+        if (job.cancelled) {
+            errorMessage = "cancelled";
+            return false;
+        }
 
-                float velocity = juce::jlimit(0.0f, 1.0f, note->velocity01);
+        const int numSamples = (int)juce::jmin<juce::int64>(chunkSize, renderLength - chunkStart);
+        auto renderOne = [&, chunkStart, numSamples](size_t index) {
+            trackChunks[index].clear(0, numSamples);
+            renderers[index]->renderChunk(trackChunks[index], chunkStart, numSamples);
+            if (index < stemWriters.size() && stemWriters[index]) stemWriters[index]->write(trackChunks[index], numSamples);
+        };
 
-                midiTimeline.push_back({samplePos, juce::MidiMessage::noteOn(note->channel, note->midiNote, velocity)});
-                midiTimeline.push_back({noteOffPos, juce::MidiMessage::noteOff(note->channel, note->midiNote)});
+        // The calling thread renders the first track itself while the pool takes the rest
+        pending = (int)renderers.size() - 1;
+        for (size_t i = 1; i < renderers.size(); ++i) {
+            renderPool.addJob([&, i] {
+                renderOne(i);
+                if (--pending == 0) chunkDone.signal();
+            });
+        }
+        if (!renderers.empty()) renderOne(0);
+        if (renderers.size() > 1) chunkDone.wait();
+
+        mix.clear(0, numSamples);
+        for (size_t i = 0; i < renderers.size(); ++i) {
+            if (const auto* automation = mixAutomation[i]) {
+                // The same lanes and pan law as the live mixer, at the same timeline positions
+                automation->renderMixGains(mixGains.getWritePointer(0), mixGains.getWritePointer(1), numSamples,
+                                           (double)chunkStart / sampleRate, sampleRate, gains[i]);
+                for (int ch = 0; ch < numChannels; ++ch) {
+                    if (trackOutputs[i]) {
+                        // An exported stem keeps the gained track
+                        juce::FloatVectorOperations::multiply(trackChunks[i].getWritePointer(ch), mixGains.getReadPointer(ch),
+                                                              numSamples);
+                        mix.addFrom(ch, 0, trackChunks[i], ch, 0, numSamples);
+                    } else {
+                        juce::FloatVectorOperations::addWithMultiply(mix.getWritePointer(ch), trackChunks[i].getReadPointer(ch),
+                                                                     mixGains.getReadPointer(ch), numSamples);
+                    }
+                }
+                continue;
+            }
+            if (trackOutputs[i]) trackChunks[i].applyGain(0, numSamples, gains[i]);
+            const float gain = trackOutputs[i] ? 1.0f : gains[i];
+            for (int ch = 0; ch < numChannels; ++ch) {
+                mix.addFrom(ch, 0, trackChunks[i], ch, 0, numSamples, gain);
             }
+        }
 
-            // Sort MIDI timeline by sample position
-            std::sort(midiTimeline.begin(), midiTimeline.end(),
-                      [](const auto& a, const auto& b) { return a.first < b.first; });
+        if (limiter) limiter->process(mix, numSamples);
+        const float chunkPeak = mix.getMagnitude(0, numSamples);
+        if (chunkStart >= tailStart && chunkPeak < silence) break;
+        peak = juce::jmax(peak, chunkPeak);
 
-            // Process audio in blocks
-            int currentSample = 0;
-            size_t midiIndex = 0;
+        const int skip = (int)juce::jmin<juce::int64>(framesToSkip, numSamples);
+        framesToSkip -= skip;
+        if (!writeMix(mix, skip, numSamples - skip)) {
+            errorMessage = "cancelled";
+            return false;
+        }
+        framesWritten += numSamples - skip;
+
+        const int stemSkip = (int)juce::jmin<juce::int64>(stemFramesToSkip, numSamples);
+        stemFramesToSkip -= stemSkip;
+        for (size_t i = 0; i < renderers.size(); ++i) {
+            if (trackOutputs[i] && !trackOutputs[i]->write(trackChunks[i], stemSkip, numSamples - stemSkip, job.cancelled)) {
+                errorMessage = "cancelled";
+                return false;
+            }
+        }
 
-            while (currentSample < totalSamples) {
-                const int samplesThisBlock = juce::jmin(blockSize, totalSamples - currentSample);
+        const juce::int64 progress = juce::jmin(progressLength, chunkStart + numSamples - renderStart);
+        reportProgress((int)(progress * passOneShare / progressLength));
+    }
 
-                // Clear MIDI buffer for this block
-                midiBuffer.clear();
+    // Range renders also report how much audio they wrote, for preview players reading raw output
+    auto reportRendered = [&] {
+        for (size_t i = 1; i < outputs.size(); ++i) emit("EVENT RENDERED " + outputs[i]->getTarget().getFullPathName());
+        for (size_t i = 0; i < renderers.size(); ++i) {
+            if (trackOutputs[i]) {
+                emit("EVENT RENDERED_STEM " + rendererTracks[i] + " " + trackOutputs[i]->getTarget().getFullPathName());
+            }
+        }
+        if (!ranged) {
+            emit("EVENT RENDERED " + job.outputPath.getFullPathName());
+            return;
+        }
+        emit("EVENT RENDERED_RANGE frames=" + juce::String(framesWritten) +
+             " rangeFrames=" + juce::String(rangeEnd - rangeStart) +
+             " sampleRate=" + juce::String(sampleRate) + " channels=" + juce::String(numChannels) +
+             " format=" + RenderOptions::getFileExtension(job.options.outputFormat).substring(1) +
+             " " + job.outputPath.getFullPathName());
+    };
 
-                // Add MIDI messages that occur in this block
-                while (midiIndex < midiTimeline.size()) {
-                    const auto& [samplePos, msg] = midiTimeline[midiIndex];
+    for (auto& renderer : renderers) renderer->finish();
 
-                    if (samplePos < currentSample) {
-                        ++midiIndex;
-                        continue;
-                    }
+    // Every chunk made it, so the recorded stems are complete
+    bool stemsWritten = false;
+    for (auto& stemWriter : stemWriters) {
+        if (stemWriter && stemWriter->commit()) stemsWritten = true;
+    }
+    if (stemsWritten) stemCache.trim();
 
-                    if (samplePos >= currentSample + samplesThisBlock) {
-                        break;
-                    }
+    for (auto& trackOutput : trackOutputs) {
+        if (trackOutput && !trackOutput->commit(errorMessage)) return false;
+    }
 
-                    // Add message at relative position within block
-                    const int relativePos = samplePos - currentSample;
-                    midiBuffer.addEvent(msg, relativePos);
-                    ++midiIndex;
-                }
+    if (scanOutput) {
+        scanOutput->close();
 
-                // Create a slice of the track buffer for this block
-                juce::AudioBuffer<float> blockBuffer(
-                    trackBuffer.getArrayOfWritePointers(),
-                    numChannels,
-                    currentSample,
-                    samplesThisBlock
-                );
+        // Only pull the mix down if it would clip, as before
+        const float gain = peak > 0.99f ? 0.99f / peak : 1.0f;
 
-                // Process the block
-                plugin->processBlock(blockBuffer, midiBuffer);
+        const auto& only = *outputs.front();
+        if (gain == 1.0f && outputs.size() == 1 && only.getFormat() == RenderOptions::OutputFormat::wav
+            && only.getBitDepth() == 32) {
+            // The float pass-one file is already the result
+            if (!scanOutput->commit(errorMessage)) return false;
+            reportProgress(100);
+            reportRendered();
+            return true;
+        }
 
-                currentSample += samplesThisBlock;
-            }
+        juce::WavAudioFormat wavFormat;
+        std::unique_ptr<juce::AudioFormatReader> reader(
+            wavFormat.createReaderFor(new juce::FileInputStream(scanOutput->getTemporaryFile()), true));
+        if (!reader) {
+            errorMessage = "Failed to read back the rendered mix";
+            return false;
+        }
+        for (auto& output : outputs) {
+            if (!output->open(sampleRate, numChannels, bitRate, errorMessage)) return false;
+        }
 
-            // Reset plugin state
-            plugin->setNonRealtime(false);
-            plugin->releaseResources();
-            plugin->prepareToPlay(getSampleRate(), getBlockSize());
-        } else if (track.soundFont) {
-            // Offline render for SF2 tracks using TinySoundFont
-            tsf* sf = track.soundFont;
-            tsf_set_output(sf, TSF_STEREO_INTERLEAVED, (int)sampleRate, 0.0f);
-
-            struct SF2Event { int samplePos; bool noteOn; int midiNote; float velocity; int channel; };
-            std::vector<SF2Event> timeline;
-            for (const auto* note : sortedNotes) {
-                int samplePos = static_cast<int>(note->startTimeSeconds * sampleRate);
-                int noteOffPos = static_cast<int>((note->startTimeSeconds + note->durationSeconds) * sampleRate);
-                samplePos = juce::jlimit(0, totalSamples - 1, samplePos);
-                noteOffPos = juce::jlimit(0, totalSamples - 1, noteOffPos);
-
-                float velocity = juce::jlimit(0.0f, 1.0f, note->velocity01);
-                timeline.push_back({samplePos, true, note->midiNote, velocity, note->channel});
-                timeline.push_back({noteOffPos, false, note->midiNote, velocity, note->channel});
+        // Encoders run in parallel, each on its own writer thread
+        for (juce::int64 position = 0; position < reader->lengthInSamples; position += chunkSize) {
+            if (job.cancelled) {
+                errorMessage = "cancelled";
+                return false;
             }
+            const int numSamples = (int)juce::jmin<juce::int64>(chunkSize, reader->lengthInSamples - position);
+            reader->read(&mix, 0, numSamples, position, true, true);
+            mix.applyGain(0, numSamples, gain);
+            for (auto& output : outputs) {
+                if (!output->write(mix, 0, numSamples, job.cancelled)) {
+                    errorMessage = "cancelled";
+                    return false;
+                }
+            }
+            reportProgress(passOneShare + (int)((position + numSamples) * (100 - passOneShare) / reader->lengthInSamples));
+        }
+    }
 
-            std::sort(timeline.begin(), timeline.end(), [](const SF2Event& a, const SF2Event& b) {
-                return a.samplePos < b.samplePos;
-            });
+    for (auto& output : outputs) {
+        if (!output->commit(errorMessage)) return false;
+    }
 
-            std::vector<float> tempInterleaved;
-            tempInterleaved.resize((size_t)blockSize * (size_t)numChannels);
+    reportProgress(100);
+    reportRendered();
+    return true;
+}
 
-            int currentSample = 0;
-            size_t eventIndex = 0;
+void BackendHost::releaseRenderInstruments(RenderJob& job) {
+    // Plugin instances (and tsf copies) are freed on the message thread, like the live ones
+    auto* instruments = new std::vector<RenderJob::InstrumentTrack>(std::move(job.instruments));
+    job.instruments.clear();
 
-            auto dispatchEventsUpTo = [&](int samplePos) {
-                while (eventIndex < timeline.size() && timeline[eventIndex].samplePos <= samplePos) {
-                    const auto& ev = timeline[eventIndex];
-                    const int tsfChannel = juce::jlimit(0, 15, ev.channel - 1);
-                    if (ev.noteOn) {
-                        tsf_channel_note_on(sf, tsfChannel, ev.midiNote, ev.velocity);
-                    } else {
-                        tsf_channel_note_off(sf, tsfChannel, ev.midiNote);
-                    }
-                    ++eventIndex;
-                }
-            };
-
-            // Fire any events at time 0
-            dispatchEventsUpTo(0);
-
-            while (currentSample < totalSamples) {
-                const int nextEventSample = (eventIndex < timeline.size()) ? timeline[eventIndex].samplePos : totalSamples;
-                const int remaining = totalSamples - currentSample;
-                const int untilNext = juce::jmax(1, nextEventSample - currentSample);
-                const int samplesThisBlock = juce::jmin(blockSize, juce::jmin(remaining, untilNext));
-
-                // Render block
-                tempInterleaved.resize((size_t)samplesThisBlock * (size_t)numChannels);
-                tsf_render_float(sf, tempInterleaved.data(), samplesThisBlock, 0);
-
-                // Deinterleave and copy
-                for (int i = 0; i < samplesThisBlock; ++i) {
-                    const float l = tempInterleaved[(size_t)i * 2];
-                    const float r = tempInterleaved[(size_t)i * 2 + 1];
-                    trackBuffer.setSample(0, currentSample + i, l);
-                    trackBuffer.setSample(1, currentSample + i, r);
-                }
+    auto* messageManager = juce::MessageManager::getInstanceWithoutCreating();
+    if (messageManager == nullptr || messageManager->isThisTheMessageThread()
+        || messageManager->hasStopMessageBeenSent()
+        || !juce::MessageManager::callAsync([instruments] { delete instruments; })) {
+        delete instruments;
+    }
+}
 
-                currentSample += samplesThisBlock;
+RenderOptions::Normalisation RenderOptions::normalisationFromString(const juce::String& name) {
+    const auto lowered = name.trim().toLowerCase();
+    if (lowered == "limiter" || lowered == "limit") return Normalisation::limiter;
+    if (lowered == "none" || lowered == "off") return Normalisation::none;
+    return Normalisation::peak;
+}
 
-                // Dispatch any events scheduled at or before the new time
-                dispatchEventsUpTo(currentSample);
-            }
-        } else {
-            emit("WARNING: Track " + trackId + " has no plugin, SF2, or sampler sample loaded; skipping");
-            continue;
-        }
-        }
+RenderOptions::OutputFormat RenderOptions::formatForFile(const juce::File& file) {
+    const auto extension = file.getFileExtension().toLowerCase();
+    if (extension == ".f32") return OutputFormat::rawFloat;
+    if (extension == ".flac") return OutputFormat::flac;
+    if (extension == ".ogg") return OutputFormat::ogg;
+    if (extension == ".mp3") return OutputFormat::mp3;
+    return OutputFormat::wav;
+}
 
-        // Apply track gain to the rendered audio (sampler-only tracks default to gain 1.0)
-        const float trackGain = isSamplerOnly ? 1.0f : trackIt->second.gainLinear;
-        if (trackGain != 1.0f) {
-            trackBuffer.applyGain(trackGain);
-        }
+juce::String RenderOptions::getFileExtension(OutputFormat format) {
+    switch (format) {
+        case OutputFormat::rawFloat: return ".f32";
+        case OutputFormat::flac: return ".flac";
+        case OutputFormat::ogg: return ".ogg";
+        case OutputFormat::mp3: return ".mp3";
+        case OutputFormat::wav: break;
+    }
+    return ".wav";
+}
+
+bool BackendHost::renderToWav(const std::vector<MidiNoteEvent>& notes,
+                               const juce::File& outputPath,
+                               juce::String& errorMessage,
+                               double sampleRate,
+                               int bitDepth,
+                               const std::vector<BeatRenderEvent>& beatEvents,
+                               const std::vector<AudioClipRenderEvent>& audioClips,
+                               const RenderOptions& options) {
+    auto job = prepareRender(notes, outputPath, errorMessage, sampleRate, bitDepth, beatEvents, audioClips, options);
+    return job != nullptr && runRender(*job, errorMessage);
+}
 
-        // Mix track buffer into main render buffer
-        for (int ch = 0; ch < numChannels; ++ch) {
-            renderBuffer.addFrom(ch, 0, trackBuffer, ch, 0, totalSamples);
+int BackendHost::cancelRender(const juce::String& outputPath) {
+    const juce::ScopedLock rl(renderLock);
+    int cancelled = 0;
+    for (const auto& weakJob : activeRenders) {
+        if (auto job = weakJob.lock()) {
+            if (outputPath.isNotEmpty() && job->outputPath.getFullPathName() != outputPath) continue;
+            if (!job->cancelled.exchange(true)) ++cancelled;
         }
     }
+    return cancelled;
+}
 
-    // Mix beat events (already prepared as beatJobs)
-    for (const auto& job : beatJobs) {
-        auto samplePtr = job.sample;
-        if (!samplePtr) continue;
-
-        const int srcChannels = samplePtr->buffer.getNumChannels();
-        const int srcSamples = samplePtr->buffer.getNumSamples();
-        if (srcSamples == 0) continue;
+namespace {
 
-        const double ratio = samplePtr->sampleRate / sampleRate;
-        const int startSample = juce::jlimit(0, totalSamples - 1, (int)std::floor(job.startTimeSeconds * sampleRate));
+// Bumped whenever the renderers change what a stem sounds like, so older stems miss
+constexpr const char* stemFormatVersion = "stem-1";
 
-        for (int dest = startSample; dest < totalSamples; ++dest) {
-            const double srcPos = (dest - startSample) * ratio;
-            const int idx = (int)srcPos;
-            if (idx >= srcSamples) break;
-            const double frac = srcPos - (double)idx;
+void addNotesToKey(StemCache::Key& key, const std::vector<MidiNoteEvent>& notes) {
+    for (const auto& note : notes) {
+        key.add(note.startTimeSeconds)
+            .add(note.durationSeconds)
+            .add((juce::int64)note.midiNote)
+            .add((double)note.velocity01)
+            .add((juce::int64)note.channel);
+    }
+}
 
-            for (int ch = 0; ch < numChannels; ++ch) {
-                const int srcCh = (srcChannels == 1) ? 0 : juce::jmin(ch, srcChannels - 1);
-                const float s0 = samplePtr->buffer.getSample(srcCh, idx);
-                const float s1 = (idx + 1 < srcSamples) ? samplePtr->buffer.getSample(srcCh, idx + 1) : 0.0f;
-                const float blended = (float)((1.0 - frac) * s0 + frac * s1);
-                renderBuffer.addSample(ch, dest, blended * job.gain);
-            }
-        }
+// Parameter lanes change what a plugin plays; gain and pan are applied when mixing
+void addParameterAutomationToKey(StemCache::Key& key, const TrackAutomation* automation) {
+    if (automation == nullptr) return;
+    for (const auto& lane : automation->parameters) {
+        key.add(lane.parameterId);
+        for (const auto& point : lane.curve->getPoints()) key.add(point.timeSeconds).add((double)point.value);
     }
+}
 
-    // Mix audio clips
-    for (const auto& clip : loadedClips) {
-        const int srcChannels = clip.buffer.getNumChannels();
-        const int srcSamples = clip.buffer.getNumSamples();
-        if (srcSamples == 0) continue;
+} // namespace
 
-        const double ratio = clip.sourceRate / sampleRate;
-        const int startSample = juce::jlimit(0, totalSamples - 1, (int)std::floor(clip.event.startTimeSeconds * sampleRate));
-        const float gain = clip.event.gainLinear;
+StemCache::Key BackendHost::getStemKey(const TrackState& track, const juce::MemoryBlock& pluginState,
+                                       const std::vector<MidiNoteEvent>& notes, double sampleRate,
+                                       juce::int64 renderFrames, const TrackAutomation* automation) {
+    StemCache::Key key;
+    key.add(juce::String(stemFormatVersion)).add(sampleRate).add(renderFrames);
+    if (track.plugin) {
+        key.add(juce::String("plugin")).add(track.plugin->getPluginDescription().createIdentifierString()).add(pluginState);
+        addParameterAutomationToKey(key, automation);
+    } else {
+        key.add(juce::String("sf2"))
+            .add(track.sf2File.getFullPathName())
+            .add(track.sf2File.getSize())
+            .add(track.sf2File.getLastModificationTime().toMilliseconds())
+            .add((juce::int64)track.sf2CurrentBank)
+            .add((juce::int64)track.sf2CurrentPreset)
+            .add((juce::int64)track.sf2VoiceLimit)
+            .add((juce::int64)track.sf2VoiceStealing);
+    }
+    addNotesToKey(key, notes);
+    return key;
+}
 
-        for (int dest = startSample; dest < totalSamples; ++dest) {
-            const double srcPos = (dest - startSample) * ratio;
-            const int idx = (int)srcPos;
-            if (idx >= srcSamples) break;
-            const double frac = srcPos - (double)idx;
+StemCache::Key BackendHost::getStemKey(const SamplerTrack& samplerTrack, const std::vector<MidiNoteEvent>& notes,
+                                       double sampleRate, juce::int64 renderFrames, Resampler::Quality quality) {
+    StemCache::Key key;
+    key.add(juce::String(stemFormatVersion)).add(sampleRate).add(renderFrames);
+    key.add(juce::String("sampler"))
+        .add(samplerTrack.file.getFullPathName())
+        .add(samplerTrack.file.getSize())
+        .add(samplerTrack.file.getLastModificationTime().toMilliseconds())
+        .add((juce::int64)samplerTrack.rootNote.rootNote)
+        .add((juce::int64)quality)
+        .add((juce::int64)samplerTrack.voiceLimit)
+        .add((juce::int64)samplerTrack.voiceStealing);
+    addNotesToKey(key, notes);
+    return key;
+}
 
-            for (int ch = 0; ch < numChannels; ++ch) {
-                const int srcCh = (srcChannels == 1) ? 0 : juce::jmin(ch, srcChannels - 1);
-                const float s0 = clip.buffer.getSample(srcCh, idx);
-                const float s1 = (idx + 1 < srcSamples) ? clip.buffer.getSample(srcCh, idx + 1) : 0.0f;
-                const float blended = (float)((1.0 - frac) * s0 + frac * s1);
-                renderBuffer.addSample(ch, dest, blended * gain);
-            }
+std::shared_ptr<BackendHost::RenderJob> BackendHost::prepareFreeze(const juce::String& trackId,
+                                                                    const std::vector<MidiNoteEvent>& notes,
+                                                                    juce::String& errorMessage) {
+    if (notes.empty()) {
+        errorMessage = "No notes to freeze";
+        return {};
+    }
+    {
+        const juce::ScopedLock sl(samplerLock);
+        if (samplerTracks.count(trackId) > 0) {
+            errorMessage = "Sampler tracks can't be frozen";
+            return {};
         }
     }
 
-    // Normalize the output to prevent clipping
-    float maxLevel = renderBuffer.getMagnitude(0, totalSamples);
-    if (maxLevel > 0.99f) {
-        float gain = 0.99f / maxLevel;
-        renderBuffer.applyGain(gain);
+    StemCache::Key key;
+    juce::File stem;
+    {
+        const juce::ScopedLock sl(tracksLock);
+        auto it = tracks.find(trackId);
+        if (it == tracks.end() || !(it->second.plugin || it->second.soundFont)) {
+            errorMessage = "No plugin or SF2 loaded for track " + trackId;
+            return {};
+        }
+        juce::MemoryBlock pluginState;
+        if (it->second.plugin) it->second.plugin->getStateInformation(pluginState);
+        const juce::int64 renderFrames = getSongFrames(notes, {}, {}, getSampleRate(), beatFormatManager, *sampleCache);
+        key = getStemKey(it->second, pluginState, notes, getSampleRate(), renderFrames, getAutomation(trackId).get());
+        stem = stemCache.getStemFile(key);
+        it->second.pendingStem = stem;
+    }
+    if (stemCache.find(key).existsAsFile()) return {}; // bounced before with the same notes and instrument
+
+    // The bounce runs at the device rate with no normalisation or track gain: the mixer channel
+    // still applies gain, mute and solo to the stem
+    RenderOptions options;
+    options.normalisation = RenderOptions::Normalisation::none;
+    options.useStemCache = false; // the bounce is the stem
+    auto job = prepareRender(notes, stem, errorMessage, getSampleRate(), 32, {}, {}, options);
+    if (job != nullptr) {
+        for (auto& instrument : job->instruments) instrument.gainLinear = 1.0f;
+
+        // Likewise gain and pan automation; parameter automation is part of the stem
+        for (auto& [automatedTrack, lanes] : job->automation) {
+            if (!lanes->hasMixLanes()) continue;
+            auto parametersOnly = std::make_shared<TrackAutomation>(*lanes);
+            parametersOnly->gain.reset();
+            parametersOnly->pan.reset();
+            lanes = std::move(parametersOnly);
+        }
     }
+    return job;
+}
 
-    // Write to WAV file
-    outputPath.deleteFile(); // Remove if exists
+bool BackendHost::freezeTrack(const juce::String& trackId, juce::File& stemFile, juce::String& errorMessage) {
+    const juce::ScopedLock sl(tracksLock);
+    auto it = tracks.find(trackId);
+    if (it == tracks.end() || it->second.pendingStem == juce::File()) {
+        errorMessage = "Track changed while freezing";
+        return false;
+    }
+    auto& track = it->second;
+    stemFile = track.pendingStem;
+    track.pendingStem = juce::File();
 
-    std::unique_ptr<juce::FileOutputStream> outStream(outputPath.createOutputStream());
-    if (!outStream) {
-        errorMessage = "Failed to create output file: " + outputPath.getFullPathName();
+    std::unique_ptr<juce::AudioFormatReader> reader(beatFormatManager.createReaderFor(stemFile));
+    if (reader == nullptr) {
+        errorMessage = "Could not read stem " + stemFile.getFullPathName();
         return false;
     }
 
-    juce::WavAudioFormat wavFormat;
-    const int bitsPerSample = bitDepth;
+    // Held notes are cut before the instrument goes quiet; it handles the panic once unfrozen
+    InstrumentEvent panic;
+    panic.type = InstrumentEvent::allNotesOff;
+    if (auto* instrument = getInstrumentSource(track)) instrument->post(panic);
 
-    std::unique_ptr<juce::AudioFormatWriter> writer(
-        wavFormat.createWriterFor(outStream.get(), sampleRate, numChannels,
-                                  bitsPerSample, {}, 0)
-    );
+    auto stem = std::make_unique<StemSource>(std::move(reader), diskReadAhead);
+    mixer.setSource(track.mixerChannel, MasterMixer::instrumentSlot, stem.get());
+    track.stemSource = std::move(stem);
+    if (track.plugin) track.plugin->suspendProcessing(true);
 
-    if (!writer) {
-        errorMessage = "Failed to create WAV writer";
+    stemCache.trim();
+    return true;
+}
+
+bool BackendHost::unfreezeTrack(const juce::String& trackId, juce::String& errorMessage) {
+    const juce::ScopedLock sl(tracksLock);
+    auto it = tracks.find(trackId);
+    if (it == tracks.end() || !it->second.stemSource) {
+        errorMessage = "Track " + trackId + " is not frozen";
         return false;
     }
+    auto& track = it->second;
 
-    outStream.release(); // Writer now owns the stream
+    if (track.plugin) track.plugin->suspendProcessing(false);
+    mixer.setSource(track.mixerChannel, MasterMixer::instrumentSlot, getInstrumentSource(track));
+    track.stemSource.reset();
+    return true;
+}
 
-    if (!writer->writeFromAudioSampleBuffer(renderBuffer, 0, totalSamples)) {
-        errorMessage = "Failed to write audio data to file";
-        return false;
-    }
+bool BackendHost::isTrackFrozen(const juce::String& trackId) const {
+    const juce::ScopedLock sl(tracksLock);
+    auto it = tracks.find(trackId);
+    return it != tracks.end() && it->second.stemSource != nullptr;
+}
 
-    writer.reset(); // Flush and close
+bool BackendHost::playFrozen(const juce::String& trackId, juce::int64 startTime, double offsetSeconds) {
+    const juce::ScopedLock sl(tracksLock);
+    auto it = tracks.find(trackId);
+    if (it == tracks.end() || !it->second.stemSource) return false;
+    auto& track = it->second;
+
+    // Detached while it is repositioned; reattaching refills the read-ahead from the new position
+    mixer.setSource(track.mixerChannel, MasterMixer::instrumentSlot, nullptr);
+    track.stemSource->cue(startTime > 0 ? startTime : mixer.getSampleClock(), offsetSeconds);
+    mixer.setSource(track.mixerChannel, MasterMixer::instrumentSlot, track.stemSource.get());
+    return true;
+}
+
+bool BackendHost::stopFrozen(const juce::String& trackId, juce::int64 stopTime) {
+    const juce::ScopedLock sl(tracksLock);
+    auto it = tracks.find(trackId);
+    if (it == tracks.end() || !it->second.stemSource) return false;
 
-    emit("EVENT RENDERED " + outputPath.getFullPathName());
+    it->second.stemSource->stopAt(stopTime > 0 ? stopTime : mixer.getSampleClock());
     return true;
 }
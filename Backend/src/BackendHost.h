@@ -4,20 +4,33 @@
 #include <juce_audio_utils/juce_audio_utils.h>
 #include <juce_gui_basics/juce_gui_basics.h>
 #include <juce_audio_formats/juce_audio_formats.h>
+#include "Automation.h"
+#include "MasterMixer.h"
+#include "PitchDetector.h"
+#include "Resampler.h"
+#include "SamplerVoices.h"
+#include "SessionFile.h"
+#include "SoundFontBank.h"
+#include "StemCache.h"
 #include <atomic>
+#include <functional>
 #include <map>
 #include <memory>
 #include <string>
 #include <vector>
 
-// Forward declare TSF type
-typedef struct tsf tsf;
-
 // Forward declaration
 class PluginEditorWindow;
-class GainAudioCallback;
-class SF2AudioCallback;
-class BeatAudioCallback;
+class InstrumentSource;
+class PluginSource;
+class SF2Source;
+class StemSource;
+class BeatTrackSource;
+class SamplerTrackSource;
+class ClipTrackSource;
+class SampleCache;
+class PeakCache;
+class PluginCache;
 
 // MIDI note event for rendering
 struct MidiNoteEvent {
@@ -34,11 +47,40 @@ struct MidiNoteEvent {
           midiNote(note), velocity01(vel), channel(ch) {}
 };
 
-// Simple PCM buffer for beat samples
+// Simple PCM buffer for beat samples. Large WAV / AIFF files can instead stay in the file, memory
+// mapped (see SampleCache), so the OS pages them in as voices read them; copies already resampled
+// to the device rate live in aligned storage (see PreparedSample).
 struct BeatSample {
-    juce::AudioBuffer<float> buffer;
+    juce::AudioBuffer<float> buffer; // decoded samples; empty when mapped
+    std::unique_ptr<juce::MemoryMappedAudioFormatReader> mapped; // the whole file mapped, or nullptr
+    juce::HeapBlock<char> alignedStorage; // what buffer refers to in a prepared copy
+    int guardSamples = 0; // zeros readable past the end of each of buffer's channels
     double sampleRate = 44100.0;
-    int detectedRootNote = 60; // Detected MIDI note (C4 by default)
+
+    // What voices play
+    Resampler::Source getSource() const {
+        return mapped ? Resampler::Source(*mapped) : Resampler::Source(buffer, guardSamples);
+    }
+    int getNumSamples() const { return getSource().getNumSamples(); }
+};
+
+// Idle instrument tracks (plugins and SF2) stop processing, or "sleep", once they have held no
+// notes and their output has stayed below threshold for idleSeconds. The next event that falls
+// due wakes a track for the block it is in, so it still plays on its exact sample. Read by the
+// audio thread.
+struct TrackSleepSettings {
+    std::atomic<bool> enabled { true };
+    std::atomic<float> threshold { juce::Decibels::decibelsToGain(-90.0f) }; // linear peak
+    std::atomic<double> idleSeconds { 1.0 };
+};
+
+// A waveform peak file (see PeakCache) and what it describes
+struct PeakFileInfo {
+    juce::File peakFile;
+    double sampleRate = 0.0;
+    juce::int64 numFrames = 0;
+    int numChannels = 0;
+    bool cached = false; // the peak file was already there
 };
 
 // Offline render event for beat sampler rows
@@ -57,10 +99,78 @@ struct AudioClipRenderEvent {
     float gainLinear = 1.0f;
 };
 
+// Offline render settings that don't belong to any one event list
+struct RenderOptions {
+    // Interpolation used for beat, sampler and audio-clip playback in the bounce
+    Resampler::Quality resamplerQuality = Resampler::Quality::linear;
+
+    // How the bounce avoids clipping. peak scans the finished mix and scales it down only if it
+    // would clip (a second pass over a float temp file); limiter runs a lookahead limiter while
+    // streaming; none writes the mix as is.
+    enum class Normalisation { peak, limiter, none };
+    Normalisation normalisation = Normalisation::peak;
+
+    // Instrument and sampler tracks whose inputs are unchanged since an earlier render at this
+    // rate replay the stem cached then (see StemCache) instead of rendering again; the tracks that
+    // do render are cached for next time
+    bool useStemCache = true;
+
+    // Range render (RENDER_RANGE): only timeline [rangeStartSeconds, rangeEndSeconds) is written,
+    // followed by its tail. Notes are cut at the range end, and events that fall silent before the
+    // pre-roll are never processed. Range renders neither use nor record cached stems, which hold
+    // the whole song. Without a range (end <= start) the whole timeline renders with a fixed tail.
+    double rangeStartSeconds = 0.0;
+    double rangeEndSeconds = 0.0;
+
+    // Seconds rendered ahead of the range so plugins settle; < 0 uses the longest plugin tail,
+    // between minPreRollSeconds and maxPreRollSeconds
+    static constexpr double minPreRollSeconds = 0.5;
+    static constexpr double maxPreRollSeconds = 4.0;
+    double preRollSeconds = -1.0;
+
+    // A range's tail ends at the first chunk the mix stays below tailThresholdDb throughout, and
+    // after maxTailSeconds at the latest
+    float tailThresholdDb = -90.0f;
+    double maxTailSeconds = 10.0;
+
+    // wav writes a WAV file at the render's bit depth; rawFloat writes headerless interleaved
+    // 32-bit float frames in native byte order, which a preview player can map directly. flac
+    // stores 16 or 24 bits; ogg (Vorbis) and mp3 (through the LAME encoder, when this build has it
+    // and lame can be found next to the backend or on the PATH) encode at bitRateKbps.
+    enum class OutputFormat { wav, rawFloat, flac, ogg, mp3 };
+    OutputFormat outputFormat = OutputFormat::wav;
+    int bitRateKbps = 192;
+
+    // More files of the same mix, written in the same pass. Every file encodes on its own writer
+    // thread while the render goes on.
+    struct Output {
+        juce::File file;
+        OutputFormat format = OutputFormat::wav;
+        int bitDepth = 24;
+    };
+    std::vector<Output> extraOutputs;
+
+    // With a stem folder, each track's part of the mix (after its gain and automation, before
+    // normalisation) is also written there as <trackId><extension of stemFormat>
+    juce::File stemFolder;
+    OutputFormat stemFormat = OutputFormat::wav;
+
+    // The format for a file name's extension (.wav, .f32, .flac, .ogg, .mp3); wav for others
+    static OutputFormat formatForFile(const juce::File& file);
+    static juce::String getFileExtension(OutputFormat format);
+
+    bool hasRange() const { return rangeEndSeconds > rangeStartSeconds; }
+
+    // Parses "peak" / "limiter" / "none"; unknown names map to peak
+    static Normalisation normalisationFromString(const juce::String& name);
+};
+
 // Multi-track JUCE host that manages multiple VST3 instances per track
 class BackendHost {
 public:
-    BackendHost();
+    // Without openAudioDevice nothing is played: the mixer is only driven through getMixer()
+    // (headless tools such as BackendBench)
+    explicit BackendHost(bool openAudioDevice = true);
     ~BackendHost();
 
     // Loads a plugin for a specific track ID. Returns false and fills errorMessage on failure.
@@ -72,18 +182,43 @@ public:
     // Set the preset/bank for an SF2 track
     bool setSF2Preset(const juce::String& trackId, int bank, int preset, juce::String& errorMessage);
 
+    // Caps an SF2 track's voices (1..SoundFontBank::maxVoices) and picks how notes over the cap
+    // steal; offline renders of the track use the same budget
+    bool setSF2Voices(const juce::String& trackId, int voiceLimit, SoundFontBank::VoiceStealing policy,
+                      juce::String& errorMessage);
+
     bool isPluginLoaded(const juce::String& trackId) const;
     bool isSF2Loaded(const juce::String& trackId) const;
     juce::String getLoadedPluginName(const juce::String& trackId) const;
 
-    // Sends a note on + scheduled note off to the track's plugin.
-    bool playNote(const juce::String& trackId, int midiNote, float velocity01, int durationMs, int channel = 1);
+    // Sends a note on + scheduled note off to the track's plugin or SF2. startTime is an engine
+    // time in samples (see engineTimeFromMs); 0 plays the note as soon as possible.
+    bool playNote(const juce::String& trackId, int midiNote, float velocity01, int durationMs, int channel = 1,
+                  juce::int64 startTime = 0);
 
     // Sends all-notes-off for a specific track, or all tracks if trackId is empty
     void allNotesOff(const juce::String& trackId = "");
     
     // Set track volume via MIDI CC 7 (0-127, where 100 is default)
     bool setTrackVolume(const juce::String& trackId, int volume, int channel = 1);
+    // Sets the mixer gain exactly (linear), without any MIDI to the instrument
+    bool setTrackGain(const juce::String& trackId, float gainLinear);
+
+    // Mixer channel mute/solo (applied on the audio thread without taking tracksLock)
+    bool setTrackMute(const juce::String& trackId, bool shouldBeMuted);
+    bool setTrackSolo(const juce::String& trackId, bool shouldBeSoloed);
+
+    // Replaces one automation lane of a track: target is "gain" (linear, replaces the volume),
+    // "pan" (-1..1) or "param:<id>" (a plugin parameter by ID or index, normalised 0..1). Lanes
+    // are evaluated per sample while automation plays and the same way by renderToWav; no points
+    // clears the lane. Lanes are kept by track ID, so they survive reloading the instrument.
+    bool setAutomation(const juce::String& trackId, const juce::String& target, std::vector<AutomationPoint> points,
+                       juce::String& errorMessage);
+    void clearAutomation(const juce::String& trackId);
+
+    // Plays automation from timeline position positionSeconds at engine time startTime (0 = now)
+    void startAutomation(double positionSeconds, juce::int64 startTime = 0);
+    void stopAutomation();
 
     // Opens the plugin's native editor window (non-blocking)
     bool openEditor(const juce::String& trackId, juce::String& errorMessage);
@@ -110,98 +245,360 @@ public:
                         const juce::String& rowId,
                         const juce::File& file,
                         juce::String& errorMessage);
-    void triggerBeat(const juce::String& trackId,
+    // Returns false if the track or row has no sample loaded (yet)
+    bool triggerBeat(const juce::String& trackId,
                      const juce::String& rowId,
-                     float gainLinear = 1.0f);
+                     float gainLinear = 1.0f,
+                     juce::int64 startTime = 0);
     void clearBeatTrack(const juce::String& trackId);
+
+    // Beat rows play copies of their samples resampled to the device rate (see PreparedSample),
+    // made when a row loads and again whenever the device rate changes. Off by default.
+    void setSamplePreparation(bool enabled);
+    bool isSamplePreparationEnabled() const { return samplePreparation.load(); }
     void clearBeatRow(const juce::String& trackId, const juce::String& rowId);
 
     // Sampler controls - loads a sample and maps it across the piano keyboard
     bool loadSamplerSample(const juce::String& trackId,
                           const juce::File& file,
                           juce::String& errorMessage);
-    void triggerSamplerNote(const juce::String& trackId,
+    // Both return false if the track has no sampler sample loaded (yet)
+    bool triggerSamplerNote(const juce::String& trackId,
                            int midiNote,
                            float velocity,
-                           int durationMs);
-    void stopSamplerNote(const juce::String& trackId, int midiNote);
+                           int durationMs,
+                           juce::int64 startTime = 0);
+    bool stopSamplerNote(const juce::String& trackId, int midiNote, juce::int64 startTime = 0);
     void clearSamplerTrack(const juce::String& trackId);
 
-    // Beat voice used by the shared mixer callback
-    struct BeatVoice {
-        std::shared_ptr<BeatSample> sample;
-        double position = 0.0; // position in source samples
-        float gain = 1.0f;
-    };
+    // Caps a sampler track's held notes (1..SamplerVoices::maxVoices) and picks which one an extra
+    // note steals; released and stolen voices fade out. Offline renders use the same budget.
+    bool setSamplerVoices(const juce::String& trackId, int voiceLimit, SoundFontBank::VoiceStealing policy,
+                          juce::String& errorMessage);
 
-    // Sampler voice for polyphonic sample playback
-    struct SamplerVoice {
-        std::shared_ptr<BeatSample> sample;
-        double position = 0.0;
-        float gain = 1.0f;
-        int midiNote = 60; // The MIDI note being played
-        double playbackRate = 1.0; // Pitch shift based on note
-        bool active = true;
-    };
+    // Timeline audio clips, streamed from disk with a few seconds of read-ahead per playing clip,
+    // so memory use doesn't grow with clip length. playClip starts file offsetSeconds in at
+    // engine time startTime (0 = now), replacing clipId's previous play; stopClip stops it.
+    bool playClip(const juce::String& trackId,
+                  const juce::String& clipId,
+                  const juce::File& file,
+                  juce::String& errorMessage,
+                  juce::int64 startTime = 0,
+                  double offsetSeconds = 0.0,
+                  float gainLinear = 1.0f);
+    bool stopClip(const juce::String& trackId, const juce::String& clipId, juce::int64 stopTime = 0);
+    void clearClipTrack(const juce::String& trackId);
 
-    // Render MIDI notes to WAV file using realtime processing
+    // Render MIDI notes to WAV file using offline processing
     // notes: array of MIDI events sorted by startTimeSeconds
     // outputPath: output WAV file path
     // sampleRate: output sample rate (default 44100)
     // bitDepth: bit depth (16, 24, or 32)
     // Returns true on success, false on failure (fills errorMessage)
+    // Same as prepareRender + runRender on the calling thread, so call it from the message thread.
     bool renderToWav(const std::vector<MidiNoteEvent>& notes,
                      const juce::File& outputPath,
                      juce::String& errorMessage,
                      double sampleRate = 44100.0,
                      int bitDepth = 24,
                      const std::vector<BeatRenderEvent>& beatEvents = {},
-                     const std::vector<AudioClipRenderEvent>& audioClips = {});
+                     const std::vector<AudioClipRenderEvent>& audioClips = {},
+                     const RenderOptions& options = {});
+
+    // Two-step bounce so the render itself can run off the message thread while live playback
+    // and commands carry on. prepareRender (message thread) snapshots the tracks into a job with
+    // render-private plugin instances and SF2 copies; runRender (any thread) renders the tracks in
+    // parallel, writes the file and emits EVENT RENDER_PROGRESS <percent> <outputPath>.
+    struct RenderJob;
+    std::shared_ptr<RenderJob> prepareRender(const std::vector<MidiNoteEvent>& notes,
+                                             const juce::File& outputPath,
+                                             juce::String& errorMessage,
+                                             double sampleRate = 44100.0,
+                                             int bitDepth = 24,
+                                             const std::vector<BeatRenderEvent>& beatEvents = {},
+                                             const std::vector<AudioClipRenderEvent>& audioClips = {},
+                                             const RenderOptions& options = {});
+    bool runRender(RenderJob& job, juce::String& errorMessage);
+
+    // Cancels prepared or running renders to outputPath (all renders if empty). A cancelled
+    // render fails with "cancelled" and leaves outputPath untouched. Returns how many were cancelled.
+    int cancelRender(const juce::String& outputPath = {});
+
+    // Track freeze: a plugin or SF2 track's notes are bounced once to a stem (see StemCache) that
+    // streams from disk in place of the instrument, which is suspended so it costs no CPU.
+    // prepareFreeze (message thread) returns the bounce to run with runRender, or nullptr when the
+    // stem is already cached (errorMessage left empty) or the track can't be frozen. freezeTrack
+    // then swaps the stem in; it fails if the instrument was reloaded or unloaded meanwhile.
+    // A frozen track ignores notes: playFrozen/stopFrozen start and stop the stem at engine times
+    // (0 = now), playing from offsetSeconds into it.
+    std::shared_ptr<RenderJob> prepareFreeze(const juce::String& trackId, const std::vector<MidiNoteEvent>& notes,
+                                             juce::String& errorMessage);
+    bool freezeTrack(const juce::String& trackId, juce::File& stemFile, juce::String& errorMessage);
+    bool unfreezeTrack(const juce::String& trackId, juce::String& errorMessage);
+    bool isTrackFrozen(const juce::String& trackId) const;
+    bool playFrozen(const juce::String& trackId, juce::int64 startTime = 0, double offsetSeconds = 0.0);
+    bool stopFrozen(const juce::String& trackId, juce::int64 stopTime = 0);
+
+    // Background loading. The plugin scan, SF2 parse or sample decode runs on the loader pool and
+    // the finished instrument or sample is swapped into the track on the message thread, so other
+    // tracks keep loading and playing meanwhile. A newer load for the same instrument, sampler or
+    // beat row supersedes one still in flight, as do the unload/clear calls. Stages are reported as
+    // EVENT LOAD_PROGRESS <trackId> <kind> <stage>. Call from the message thread; onFinished runs
+    // there as well.
+    enum class LoadStatus { loaded, failed, superseded };
+    using LoadCallback = std::function<void(LoadStatus status, const juce::String& errorMessage)>;
+    // A non-empty state is restored into the new instance before it starts playing, so it is
+    // prepared once instead of again after a SET_STATE
+    void loadPluginAsync(const juce::String& trackId, const juce::File& file, LoadCallback onFinished,
+                         const juce::MemoryBlock& state = {});
+    void loadSF2Async(const juce::String& trackId, const juce::File& file, LoadCallback onFinished);
+    void loadBeatSampleAsync(const juce::String& trackId, const juce::String& rowId, const juce::File& file,
+                             LoadCallback onFinished);
+    void loadSamplerSampleAsync(const juce::String& trackId, const juce::File& file, LoadCallback onFinished);
+
+    // Scans plugin bundles (the default VST3 locations if paths is empty) into the plugin cache,
+    // each in a child process, on the loader pool. Files cached and unchanged since are skipped.
+    // Reports EVENT PLUGIN_SCAN_PROGRESS <done> <total> <path>, EVENT PLUGIN_FOUND "<path>" <name>,
+    // EVENT PLUGIN_SCAN_FAILED "<path>" <reason> and finally EVENT PLUGIN_SCAN_COMPLETE <found> <failed>.
+    void scanPluginsAsync(const juce::StringArray& paths);
 
     double getSampleRate() const;
     int getBlockSize() const;
 
+    // Audio device selection (message thread). LIST_DEVICES lines: EVENT DEVICE_TYPE "<type>"
+    // devices=<n>, then EVENT DEVICE "<type>" "<name>" per output device and finally EVENT
+    // DEVICE_CURRENT with the open device's rates, buffer sizes and latencies.
+    juce::StringArray getDeviceReport();
+
+    // Reopens the output on typeName (a driver type such as "ASIO", "CoreAudio" or
+    // "Windows Audio (Exclusive Mode)", or one of the aliases asio, wasapi, wasapi-exclusive,
+    // wasapi-low-latency, directsound, coreaudio, alsa and jack; empty keeps the current one),
+    // deviceName (empty keeps the current device, or takes a new type's default) at sampleRate and bufferSize (0 keeps the
+    // current ones; the device picks the nearest it supports). Loaded tracks stay as they are and
+    // are prepared again for the new device, and the engine clock carries on. If the device
+    // can't be opened the previous one is reopened and errorMessage says why.
+    bool setDevice(const juce::String& typeName, const juce::String& deviceName, double sampleRate, int bufferSize,
+                   juce::String& errorMessage);
+
+    // The open device as EVENT <eventName> "<type>" "<name>" rate=<hz> block=<n> inputLatency=<n>
+    // outputLatency=<n> (latencies in samples)
+    juce::String getDeviceLine(const char* eventName);
+
+    // STATUS: one EVENT STATUS line with the device rate, block size, engine clock and the
+    // device's input and output latency and the largest plugin latency (all in samples), then
+    // EVENT STATUS_TRACK <trackId> latency=<n> per plugin track, so the scheduler can widen its
+    // lookahead by the delay between a note time and its sound.
+    juce::StringArray getStatusReport();
+
+    // Decoded samples shared by beat rows, sampler tracks and renders (see SampleCache)
+    SampleCache& getSampleCache() { return *sampleCache; }
+
+    // Waveform peaks of an audio file for the timeline (see PeakCache), found or computed on the
+    // loader pool; a file a track has already decoded is scanned from memory. onReady runs on the
+    // message thread, with errorMessage empty on success.
+    using PeaksCallback = std::function<void(const PeakFileInfo& info, const juce::String& errorMessage)>;
+    void getPeaksAsync(const juce::File& file, PeaksCallback onReady);
+
+    // Engine clock that scheduled events are stamped with. Clients read it with the CLOCK
+    // command and send future note times in the same milliseconds.
+    double getEngineTimeMs() const;
+    juce::int64 engineTimeFromMs(double timeMs) const; // <= 0 maps to 0 ("immediately")
+
+    // Audio path telemetry per track source: render timing since the previous read that started
+    // a new interval, plus what the source last published
+    struct SourceStats {
+        juce::String trackId;
+        juce::String kind; // plugin, sf2, stem (frozen), beat, sampler or clip
+        TimingStats::Snapshot timing;
+        int activeVoices = 0;
+        int queueDepth = 0;
+        bool asleep = false;
+    };
+    std::vector<SourceStats> getSourceStats(bool startNewInterval);
+
+    // The same as EVENT lines: one STATS line for the device callback, then one STATS_TRACK line
+    // per track source. Overrun and xrun counts are totals.
+    juce::StringArray getStatsReport(bool startNewInterval);
+
+    // Idle sleep of plugin and SF2 tracks (see TrackSleepSettings); applies to loaded tracks at once
+    void setTrackSleep(bool enabled, double idleSeconds, float thresholdDb);
+    const TrackSleepSettings& getTrackSleep() const { return trackSleep; }
+
+    // Sessions (message thread). captureSession snapshots every track's instrument or samples,
+    // plugin state, SF2 preset, voice budgets, gain, mute and solo; saveSessionAsync also writes
+    // it with SessionFile on the loader pool and reports to onSaved on the message thread.
+    // readSessionAsync likewise reads and decompresses a session file on the loader pool.
+    // Automation lanes and freezes aren't part of a session.
+    Session captureSession() const;
+    using SaveCallback = std::function<void(int numTracks, juce::int64 numBytes, const juce::String& errorMessage)>;
+    void saveSessionAsync(const juce::File& file, SaveCallback onSaved);
+    using ReadCallback = std::function<void(const Session& session, const juce::String& errorMessage)>;
+    void readSessionAsync(const juce::File& file, ReadCallback onRead);
+
+    MasterMixer& getMixer() { return mixer; }
+
 private:
+    struct TrackState;
+
+    // Opens the default device if none is open yet; does nothing on a headless host
     void prepareDevice();
+    bool findPluginType(const juce::File& file, juce::PluginDescription& description, juce::String& errorMessage);
     std::unique_ptr<juce::AudioPluginInstance> createPlugin(const juce::File& file, double sampleRate, int blockSize, juce::String& errorMessage);
-    void sendNoteOff(const juce::String& trackId, int midiNote, int channel);
 
+    // Second half of each load, on the message thread: swaps the loaded instrument or sample into the track
+    bool installPlugin(const juce::String& trackId, std::unique_ptr<juce::AudioPluginInstance> instance,
+                       const juce::File& file, juce::String& errorMessage, const juce::MemoryBlock& state = {});
+    bool installSF2(const juce::String& trackId, tsf* soundFont, const juce::File& file, juce::String& errorMessage);
+    bool installBeatSample(const juce::String& trackId, const juce::String& rowId,
+                           std::shared_ptr<const BeatSample> sample, std::shared_ptr<const BeatSample> prepared,
+                           const juce::File& file, juce::String& errorMessage);
+
+    // sample at the device rate if sample preparation is on and that helps, otherwise nullptr.
+    // Loader or message thread.
+    std::shared_ptr<const BeatSample> prepareForDevice(const BeatSample& sample) const;
+    // Message thread: remakes every beat row's device-rate copy in the background, or drops them
+    // all once preparation is off
+    void refreshPreparedSamples();
+    bool installSamplerSample(const juce::String& trackId, std::shared_ptr<const BeatSample> sample,
+                              const PitchDetector::Result& rootNote, const juce::File& file,
+                              juce::String& errorMessage);
+    // Root note of a sampler sample (cached per file version). Any thread.
+    PitchDetector::Result detectRootNote(const juce::File& file, const BeatSample& sample) const;
+
+    // Background load bookkeeping (message thread). Each instrument, sampler or beat row is a load
+    // slot; only the newest ticket per slot may install.
+    juce::uint64 beginLoad(const juce::String& slot);
+    void supersedeLoads(const juce::String& slotPrefix);
+    void finishLoad(const juce::String& slot, juce::uint64 ticket, const juce::String& trackId, const juce::String& kind,
+                    const LoadCallback& onFinished, const std::function<bool(juce::String&)>& install);
+    void releaseInstrument(TrackState& track);
+    static InstrumentSource* getInstrumentSource(TrackState& track);
+    void postPresetChange(TrackState& track, int presetIndex);
+    struct SamplerTrack;
+    // Everything a track's rendered stem depends on except its gain (applied when mixing), so
+    // renders and freezes can reuse stems of tracks that haven't changed. renderFrames is the
+    // length of the render the stem is part of.
+    static StemCache::Key getStemKey(const TrackState& track, const juce::MemoryBlock& pluginState,
+                                     const std::vector<MidiNoteEvent>& notes, double sampleRate,
+                                     juce::int64 renderFrames, const TrackAutomation* automation);
+    static StemCache::Key getStemKey(const SamplerTrack& samplerTrack, const std::vector<MidiNoteEvent>& notes,
+                                     double sampleRate, juce::int64 renderFrames, Resampler::Quality quality);
+    juce::int64 noteOffTime(juce::int64 startTime, int durationMs) const;
+    bool renderTracks(RenderJob& job, juce::String& errorMessage);
+    void releaseRenderInstruments(RenderJob& job);
+
+    // Every track ID (plugin, SF2, beat or sampler) owns one mixer channel; the integer
+    // handle is what the audio thread works with
+    int acquireMixerChannel(const juce::String& trackId);
+    int getMixerChannel(const juce::String& trackId) const;
+    void releaseMixerChannelIfUnused(const juce::String& trackId);
+
+    // Publishes a track's automation to its mixer channel (channelLock). The previous lanes are
+    // freed once the mixer has let go of them.
+    void installAutomation(const juce::String& trackId, std::shared_ptr<const TrackAutomation> automation);
+    void resolveAutomationParameters(const juce::String& trackId, const juce::AudioProcessor* plugin);
+    std::shared_ptr<const TrackAutomation> getAutomation(const juce::String& trackId) const;
+
+    const bool usesAudioDevice; // false for headless hosts, which never open a device
     juce::AudioDeviceManager deviceManager;
     juce::AudioPluginFormatManager formatManager;
+    std::unique_ptr<PluginCache> pluginCache;
     juce::AudioFormatManager beatFormatManager;
+    std::unique_ptr<RootNoteCache> rootNotes;
+    std::unique_ptr<SampleCache> sampleCache;
+    std::unique_ptr<PeakCache> peakCache;
+
+    // Single device callback that renders and sums every track
+    MasterMixer mixer;
+    TrackSleepSettings trackSleep; // shared by every instrument source
+
+    // Frozen track stems, and the thread that reads stems and clips ahead of the audio thread
+    StemCache stemCache;
+    juce::TimeSliceThread diskReadAhead { "Disk read-ahead" };
     
     // Per-track plugin state
     struct TrackState {
         std::unique_ptr<juce::AudioPluginInstance> plugin;
-        std::unique_ptr<juce::AudioProcessorPlayer> player;
-        std::unique_ptr<GainAudioCallback> gainCallback;
+        juce::File pluginFile;
+        std::unique_ptr<PluginSource> pluginSource;
         std::unique_ptr<PluginEditorWindow> editorWindow;
         float gainLinear = 1.0f; // Linear gain multiplier (0.0 to ~2.0)
+        int mixerChannel = -1;   // Handle of this track's MasterMixer channel
         
         // SF2 SoundFont support
-        tsf* soundFont = nullptr;
-        std::unique_ptr<SF2AudioCallback> sf2Callback;
+        tsf* soundFont = nullptr; // this track's instance over a SoundFontBank font
+        std::unique_ptr<SF2Source> sf2Source;
         juce::String sf2Name;
         int sf2CurrentBank = 0;
         int sf2CurrentPreset = 0;
-        
-        // Track active timers for scheduled note-offs
-        struct NoteOffTimer {
-            std::unique_ptr<juce::Timer> timer;
-        };
-        std::map<int, NoteOffTimer> activeNoteTimers; // key: (channel << 8) | midiNote
+        int sf2VoiceLimit = SoundFontBank::maxVoices;
+        SoundFontBank::VoiceStealing sf2VoiceStealing = SoundFontBank::VoiceStealing::releasing;
+        juce::File sf2File;
+
+        // Freeze: the stem prepareFreeze bounces to, then the source playing it once frozen
+        juce::File pendingStem;
+        std::unique_ptr<StemSource> stemSource;
     };
     
     std::map<juce::String, TrackState> tracks;
     mutable juce::CriticalSection tracksLock;
 
-    std::map<juce::String, std::map<juce::String, std::shared_ptr<BeatSample>>> beatSamples; // trackId -> rowId -> sample
-    std::map<juce::String, std::vector<BeatVoice>> beatVoices; // trackId -> active voices
+    std::map<juce::String, int> mixerChannels; // trackId -> mixer channel handle
+    std::map<juce::String, std::shared_ptr<const TrackAutomation>> trackAutomation; // under channelLock
+    mutable juce::CriticalSection channelLock;
+
+    // Beat tracks: the samples live here, the voices live in the track's realtime source.
+    // beatLock/samplerLock only guard these maps (message thread and the binary protocol reader)
+    // and are never taken on the audio thread.
+    struct BeatTrack {
+        std::map<juce::String, std::shared_ptr<const BeatSample>> rows; // rowId -> sample (cached, may be shared)
+        std::map<juce::String, std::shared_ptr<const BeatSample>> prepared; // rowId -> its sample at the device rate
+        std::map<juce::String, juce::File> rowFiles; // rowId -> the file its sample came from
+        std::unique_ptr<BeatTrackSource> source;
+        int mixerChannel = -1;
+
+        // What the row's voices play: its prepared copy if it has one
+        const BeatSample* getPlayable(const juce::String& rowId) const;
+
+        // Drops the row's sample and prepared copy, stopping their voices unless another row plays
+        // the same buffer
+        void releaseRowSample(const juce::String& rowId);
+        // Replaces (or with nullptr removes) the row's prepared copy
+        void setPreparedSample(const juce::String& rowId, std::shared_ptr<const BeatSample> copy);
+        void retireUnlessShared(std::shared_ptr<const BeatSample> sample);
+    };
+    std::map<juce::String, BeatTrack> beatTracks;
     mutable juce::CriticalSection beatLock;
-    std::unique_ptr<BeatAudioCallback> beatCallback;
+    std::atomic<bool> samplePreparation { false };
 
-    std::map<juce::String, std::shared_ptr<BeatSample>> samplerSamples; // trackId -> loaded sample
-    std::map<juce::String, std::vector<SamplerVoice>> samplerVoices; // trackId -> active voices
+    struct SamplerTrack {
+        std::shared_ptr<const BeatSample> sample;
+        juce::File file; // the sample's file, identifies it for the stem cache
+        PitchDetector::Result rootNote; // notes are pitched relative to this
+        int voiceLimit = SamplerVoices::maxVoices;
+        SoundFontBank::VoiceStealing voiceStealing = SoundFontBank::VoiceStealing::oldest;
+        std::unique_ptr<SamplerTrackSource> source;
+        int mixerChannel = -1;
+    };
+    std::map<juce::String, SamplerTrack> samplerTracks;
     mutable juce::CriticalSection samplerLock;
-    std::unique_ptr<juce::AudioIODeviceCallback> samplerCallback;
+
+    struct ClipTrack {
+        std::unique_ptr<ClipTrackSource> source;
+        int mixerChannel = -1;
+    };
+    std::map<juce::String, ClipTrack> clipTracks;
+    mutable juce::CriticalSection clipLock;
+
+    // Offline renders: each chunk's tracks render in parallel on renderPool; activeRenders is only
+    // used for cancelling
+    std::vector<std::weak_ptr<RenderJob>> activeRenders;
+    juce::CriticalSection renderLock;
+    juce::ThreadPool renderPool { juce::jmax(1, juce::SystemStats::getNumCpus() - 1) };
+
+    std::map<juce::String, juce::uint64> loadTickets; // slot -> newest load
+    juce::uint64 nextLoadTicket = 1;
+    juce::ThreadPool loaderPool { juce::jlimit(2, 8, juce::SystemStats::getNumCpus()) };
+
+    JUCE_DECLARE_WEAK_REFERENCEABLE(BackendHost)
 };
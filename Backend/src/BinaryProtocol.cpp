@@ -0,0 +1,157 @@
+#include "BinaryProtocol.h"
+#include "BackendHost.h"
+
+#include <cstring>
+#include <limits>
+
+namespace BinaryProtocol {
+
+namespace {
+
+bool readExactly(std::istream& in, void* dest, size_t numBytes) {
+    in.read(static_cast<char*>(dest), (std::streamsize)numBytes);
+    return (size_t)in.gcount() == numBytes;
+}
+
+bool isFrameHeader(const uint8_t* header) {
+    return header[0] == 'M' && header[1] == 'K' && header[2] == version
+           && (header[3] == textFrame || header[3] == eventsFrame)
+           && juce::ByteOrder::littleEndianInt(header + 4) <= maxPayloadSize;
+}
+
+float readFloat(const uint8_t* data) {
+    const uint32_t bits = juce::ByteOrder::littleEndianInt(data);
+    float value;
+    std::memcpy(&value, &bits, sizeof(value));
+    return value;
+}
+
+double readDouble(const uint8_t* data) {
+    const uint64_t bits = juce::ByteOrder::littleEndianInt64(data);
+    double value;
+    std::memcpy(&value, &bits, sizeof(value));
+    return value;
+}
+
+} // namespace
+
+bool readFrame(std::istream& in, Frame& frame, juce::String& errorMessage) {
+    errorMessage.clear();
+
+    uint8_t header[headerSize];
+    if (!readExactly(in, header, sizeof(header))) return false;
+
+    // Resynchronise on the next valid header if the stream got out of step
+    int skipped = 0;
+    while (!isFrameHeader(header)) {
+        std::memmove(header, header + 1, sizeof(header) - 1);
+        if (!readExactly(in, header + sizeof(header) - 1, 1)) return false;
+        ++skipped;
+    }
+    if (skipped > 0) {
+        errorMessage = "skipped " + juce::String(skipped) + " bytes before frame header";
+    }
+
+    const uint32_t payloadSize = juce::ByteOrder::littleEndianInt(header + 4);
+    frame.type = static_cast<FrameType>(header[3]);
+    frame.payload.setSize(payloadSize, false);
+    return payloadSize == 0 || readExactly(in, frame.payload.getData(), payloadSize);
+}
+
+int dispatchEvents(const juce::MemoryBlock& payload, BackendHost& host, juce::String& errorMessage) {
+    const auto* data = static_cast<const uint8_t*>(payload.getData());
+    const size_t size = payload.getSize();
+    size_t pos = 0;
+    int failures = 0;
+
+    auto fail = [&](const juce::String& reason) {
+        if (failures++ == 0) errorMessage = reason;
+    };
+
+    // String table (track and row ids)
+    if (size < 1) {
+        fail("truncated-frame");
+        return failures;
+    }
+    const int stringCount = data[pos++];
+    juce::StringArray strings;
+    for (int i = 0; i < stringCount; ++i) {
+        if (pos >= size || pos + 1 + data[pos] > size) {
+            fail("truncated-frame");
+            return failures;
+        }
+        const int length = data[pos++];
+        strings.add(juce::String::fromUTF8(reinterpret_cast<const char*>(data + pos), length));
+        pos += (size_t)length;
+    }
+
+    if (pos + 2 > size) {
+        fail("truncated-frame");
+        return failures;
+    }
+    int eventCount = juce::ByteOrder::littleEndianShort(data + pos);
+    pos += 2;
+
+    const int available = (int)((size - pos) / recordSize);
+    if (available < eventCount) {
+        for (int i = available; i < eventCount; ++i) fail("truncated-frame");
+        eventCount = available;
+    }
+
+    for (int i = 0; i < eventCount; ++i, pos += recordSize) {
+        const uint8_t* record = data + pos;
+        const auto kind = static_cast<EventKind>(record[0]);
+        const int trackIndex = record[1];
+        const int rowIndex = record[2];
+        const int channel = juce::jlimit(1, 16, record[3] == 0 ? 1 : (int)record[3]);
+        const int note = juce::jlimit(0, 127, (int)record[4]);
+        const float velocity = juce::jlimit(0.0f, 1.0f, record[5] / 127.0f);
+        const float gain = readFloat(record + 8);
+        const int durationMs = (int)juce::jmin((uint32_t)std::numeric_limits<int>::max(), juce::ByteOrder::littleEndianInt(record + 12));
+        const juce::int64 startTime = host.engineTimeFromMs(readDouble(record + 16));
+
+        if (kind == panicEvent && trackIndex == 0xFF) {
+            host.allNotesOff();
+            continue;
+        }
+        if (trackIndex >= strings.size()) {
+            fail("bad-track-index " + juce::String(trackIndex));
+            continue;
+        }
+        const juce::String& trackId = strings.getReference(trackIndex);
+
+        switch (kind) {
+            case noteEvent:
+                if (!host.playNote(trackId, note, velocity, durationMs, channel, startTime)) {
+                    fail(trackId + " no-plugin-loaded");
+                }
+                break;
+            case beatEvent:
+                if (rowIndex >= strings.size()) {
+                    fail("bad-row-index " + juce::String(rowIndex));
+                    break;
+                }
+                if (!host.triggerBeat(trackId, strings[rowIndex], gain, startTime)) {
+                    fail(trackId + " no-beat-sample " + strings[rowIndex]);
+                }
+                break;
+            case samplerNoteEvent:
+                if (!host.triggerSamplerNote(trackId, note, velocity, durationMs, startTime)) {
+                    fail(trackId + " no-sampler-sample");
+                }
+                break;
+            case samplerOffEvent:
+                if (!host.stopSamplerNote(trackId, note, startTime)) fail(trackId + " no-sampler-sample");
+                break;
+            case panicEvent:
+                host.allNotesOff(trackId);
+                break;
+            default:
+                fail("unknown-event-kind " + juce::String((int)record[0]));
+                break;
+        }
+    }
+    return failures;
+}
+
+} // namespace BinaryProtocol
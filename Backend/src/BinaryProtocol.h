@@ -0,0 +1,62 @@
+#pragma once
+
+#include <juce_core/juce_core.h>
+#include <cstdint>
+#include <istream>
+
+class BackendHost;
+
+// Framed binary stdin protocol, selected with --protocol=binary. Replies stay newline-delimited
+// text events on stdout.
+//
+// Every frame is an 8-byte header followed by the payload:
+//   'M' 'K', version, frame type, payload size (uint32, little-endian)
+//
+// textFrame    UTF-8 text commands separated by '\n', handled exactly like stdin lines
+//              (in order, on the message thread).
+// eventsFrame  A batch of realtime events. They are decoded on the stdin thread and go straight
+//              to the tracks' event queues without a message-thread round trip, so they may
+//              overtake text commands that are still queued. Payload:
+//                u8 stringCount, then per string: u8 length + UTF-8 bytes (track and row ids)
+//                u16 eventCount (little-endian), then eventCount records of recordSize bytes
+//              Record layout (little-endian):
+//                0 u8 kind, 1 u8 track string index (0xFF = all tracks for panic),
+//                2 u8 row string index, 3 u8 MIDI channel (1-16), 4 u8 note, 5 u8 velocity (0-127),
+//                6 u16 reserved, 8 f32 gain, 12 u32 durationMs, 16 f64 atMs (engine clock, 0 = now)
+//              Successful events are not acknowledged. Events for tracks with nothing loaded,
+//              including tracks still loading (events aren't held back for loads the way text
+//              commands are), fail; failures are summarised in one "ERROR EVENTS" line per frame.
+namespace BinaryProtocol {
+
+constexpr uint8_t version = 1;
+constexpr int headerSize = 8;
+constexpr int recordSize = 24;
+constexpr uint32_t maxPayloadSize = 16 * 1024 * 1024;
+
+enum FrameType : uint8_t {
+    textFrame = 1,
+    eventsFrame = 2
+};
+
+enum EventKind : uint8_t {
+    noteEvent = 1,        // plugin/SF2 note on, plus note-off after durationMs
+    beatEvent = 2,        // beat row trigger with gain
+    samplerNoteEvent = 3, // sampler note on, plus note-off after durationMs (0 = hold)
+    samplerOffEvent = 4,  // sampler note off
+    panicEvent = 5        // all notes off for one track, or all tracks
+};
+
+struct Frame {
+    FrameType type = textFrame;
+    juce::MemoryBlock payload;
+};
+
+// Reads the next frame. Skips ahead to the next frame header after garbage (reporting it in
+// errorMessage). Returns false at end of stream.
+bool readFrame(std::istream& in, Frame& frame, juce::String& errorMessage);
+
+// Decodes an events frame and hands every event to the host. Callable from any non-audio thread.
+// Returns the number of events that could not be delivered; errorMessage describes the first one.
+int dispatchEvents(const juce::MemoryBlock& payload, BackendHost& host, juce::String& errorMessage);
+
+} // namespace BinaryProtocol
@@ -0,0 +1,196 @@
+#include "ClipPlayer.h"
+
+#include <algorithm>
+#include <cmath>
+
+ClipStream::ClipStream(std::unique_ptr<juce::AudioFormatReader> reader, juce::TimeSliceThread& readAheadThread)
+    : fileRate(reader->sampleRate > 0.0 ? reader->sampleRate : 44100.0),
+      length(reader->lengthInSamples),
+      buffered(new juce::AudioFormatReaderSource(reader.release(), true), readAheadThread, true,
+               (int)(readAheadSeconds * fileRate), MasterMixer::busChannels, true),
+      resampler(&buffered, false, MasterMixer::busChannels) {}
+
+void ClipStream::prepare(double sampleRate, int maxBlockSize) {
+    resampler.setResamplingRatio(sampleRate > 0.0 ? fileRate / sampleRate : 1.0);
+    resampler.prepareToPlay(maxBlockSize, sampleRate);
+}
+
+void ClipStream::release() {
+    resampler.releaseResources();
+}
+
+void ClipStream::setPosition(double seconds) {
+    buffered.setNextReadPosition(juce::jlimit((juce::int64)0, length, (juce::int64)std::llround(seconds * fileRate)));
+}
+
+void ClipStream::render(juce::AudioBuffer<float>& bus, int startSample, int numSamples) {
+    if (numSamples <= 0) return;
+    resampler.getNextAudioBlock(juce::AudioSourceChannelInfo(&bus, startSample, numSamples));
+}
+
+//==============================================================================
+ClipTrackSource::ClipTrackSource(juce::TimeSliceThread& thread)
+    : readAheadThread(thread), commands(commandQueueSize) {
+    playing.reserve((size_t)maxPlayingClips);
+}
+
+bool ClipTrackSource::play(const juce::String& clipId, std::unique_ptr<juce::AudioFormatReader> reader,
+                           juce::int64 startTime, double offsetSeconds, float gain) {
+    collectRetiredStreams();
+    if (reader == nullptr) return false;
+
+    auto stream = std::make_unique<ClipStream>(std::move(reader), readAheadThread);
+    stream->setPosition(offsetSeconds);
+    if (preparedRate.load() > 0.0) stream->prepare(preparedRate.load(), preparedBlockSize.load());
+
+    ClipCommand command;
+    command.time = startTime;
+    command.type = ClipCommand::startClip;
+    command.stream = stream.get();
+    command.gain = gain;
+    if (!commands.push(command)) return false;
+
+    auto& slot = clips[clipId];
+    retire(std::move(slot));
+    slot = std::move(stream);
+    return true;
+}
+
+bool ClipTrackSource::stop(const juce::String& clipId, juce::int64 stopTime) {
+    collectRetiredStreams();
+    auto it = clips.find(clipId);
+    if (it == clips.end()) return false;
+
+    ClipCommand command;
+    command.time = stopTime;
+    command.type = ClipCommand::stopClip;
+    command.stream = it->second.get();
+    return commands.push(command);
+}
+
+void ClipTrackSource::stopAll() {
+    ClipCommand command;
+    command.type = ClipCommand::stopAll;
+    commands.push(command, true);
+    collectRetiredStreams();
+}
+
+void ClipTrackSource::prepare(double sampleRate, int maxBlockSize) {
+    const double previousRate = preparedRate.load();
+    scratch.setSize(MasterMixer::busChannels, juce::jmax(1, maxBlockSize));
+    preparedRate = sampleRate;
+    preparedBlockSize = maxBlockSize;
+
+    // The device was not pulling audio, so clips scheduled meanwhile don't start late; the ones
+    // playing carry on at the new rate. Immediate starts (posted while the device was stopped)
+    // still play, or their stream would sit in the clip map without ever sounding.
+    commands.collect();
+    while (const auto* due = commands.nextDue(renderedUntil + 1)) {
+        const ClipCommand command = *due;
+        commands.popNext();
+        if (command.type != ClipCommand::startClip || command.time == 0) dispatch(command);
+    }
+
+    // Commands for later keep their place on the timeline: the mixer has rescaled the engine
+    // clock to the new rate, and their times move with it
+    if (previousRate > 0.0 && sampleRate > 0.0 && previousRate != sampleRate) {
+        const double scale = sampleRate / previousRate;
+        auto rescale = [scale](juce::int64 time) { return (juce::int64)std::llround((double)time * scale); };
+        commands.retime(rescale);
+        renderedUntil = rescale(renderedUntil);
+    }
+    for (auto& clip : playing) clip.stream->prepare(sampleRate, maxBlockSize);
+}
+
+void ClipTrackSource::release() {
+    for (auto& clip : playing) clip.stream->release();
+}
+
+void ClipTrackSource::render(juce::AudioBuffer<float>& bus, int numSamples, juce::int64 blockStart) {
+    commands.collect();
+    int rendered = 0;
+    while (const auto* due = commands.nextDue(blockStart + numSamples)) {
+        const ClipCommand command = *due;
+        commands.popNext();
+
+        const int offset = juce::jmax(rendered, EventScheduler<ClipCommand>::offsetInBlock(command, blockStart, numSamples));
+        renderSegment(bus, rendered, offset - rendered);
+        rendered = offset;
+        dispatch(command);
+    }
+    renderSegment(bus, rendered, numSamples - rendered);
+    renderedUntil = blockStart + numSamples;
+
+    activeClips.store((int)playing.size(), std::memory_order_relaxed);
+    queueDepth.store(commands.getNumPending(), std::memory_order_relaxed);
+}
+
+void ClipTrackSource::dispatch(const ClipCommand& command) {
+    switch (command.type) {
+        case ClipCommand::startClip:
+            removePlaying(command.stream);
+            if (command.stream != nullptr && (int)playing.size() < maxPlayingClips) {
+                playing.push_back({ command.stream, command.gain });
+            }
+            break;
+        case ClipCommand::stopClip:
+            removePlaying(command.stream);
+            break;
+        case ClipCommand::stopAll:
+            playing.clear();
+            break;
+        case ClipCommand::releaseClip:
+            // Commands scheduled for later must not outlive the stream they point at
+            removePlaying(command.stream);
+            commands.removePending([&command](const ClipCommand& pending) { return pending.stream == command.stream; });
+            ackedSerial.store(command.serial, std::memory_order_release);
+            break;
+    }
+}
+
+void ClipTrackSource::renderSegment(juce::AudioBuffer<float>& bus, int startSample, int numSamples) {
+    if (numSamples <= 0 || playing.empty()) return;
+
+    for (auto& clip : playing) {
+        clip.stream->render(scratch, 0, numSamples);
+        for (int ch = 0; ch < MasterMixer::busChannels; ++ch) {
+            bus.addFrom(ch, startSample, scratch, ch, 0, numSamples, clip.gain);
+        }
+    }
+    playing.erase(std::remove_if(playing.begin(), playing.end(),
+                                 [](const PlayingClip& clip) { return clip.stream->isFinished(); }),
+                  playing.end());
+}
+
+void ClipTrackSource::removePlaying(const ClipStream* stream) {
+    playing.erase(std::remove_if(playing.begin(), playing.end(),
+                                 [stream](const PlayingClip& clip) { return clip.stream == stream; }),
+                  playing.end());
+}
+
+void ClipTrackSource::retire(std::unique_ptr<ClipStream> stream) {
+    if (stream == nullptr) return;
+    retired.push_back({ 0, std::move(stream) });
+    collectRetiredStreams();
+}
+
+void ClipTrackSource::collectRetiredStreams() {
+    for (auto& entry : retired) {
+        if (entry.serial != 0) continue;
+
+        ClipCommand command;
+        command.type = ClipCommand::releaseClip;
+        command.stream = entry.stream.get();
+        command.serial = nextSerial;
+        if (!commands.push(command)) break;
+
+        entry.serial = nextSerial;
+        if (++nextSerial == 0) nextSerial = 1;
+    }
+
+    const uint32_t acked = ackedSerial.load(std::memory_order_acquire);
+    retired.erase(std::remove_if(retired.begin(), retired.end(), [acked](const RetiredStream& entry) {
+                      return entry.serial != 0 && static_cast<int32_t>(acked - entry.serial) >= 0;
+                  }),
+                  retired.end());
+}
@@ -0,0 +1,112 @@
+#pragma once
+
+#include "EventScheduler.h"
+#include "MasterMixer.h"
+#include <juce_audio_formats/juce_audio_formats.h>
+#include <map>
+#include <memory>
+#include <vector>
+
+// One audio file streamed from disk. A read-ahead thread keeps the next few seconds decoded in a
+// ring buffer (BufferingAudioSource) that is resampled to the device rate, so memory use doesn't
+// depend on the file's length and the audio thread never reads the file itself.
+class ClipStream {
+public:
+    static constexpr double readAheadSeconds = 4.0;
+
+    ClipStream(std::unique_ptr<juce::AudioFormatReader> reader, juce::TimeSliceThread& readAheadThread);
+
+    // Fills the read-ahead before returning, so playback cued shortly ahead starts on time
+    void prepare(double sampleRate, int maxBlockSize);
+    void release();
+
+    // Not while the stream is being rendered
+    void setPosition(double seconds);
+
+    // Audio thread. render() overwrites numSamples of bus from startSample on.
+    void render(juce::AudioBuffer<float>& bus, int startSample, int numSamples);
+    bool isFinished() const { return buffered.getNextReadPosition() >= length; }
+
+private:
+    const double fileRate;
+    const juce::int64 length; // in file samples
+    juce::BufferingAudioSource buffered;
+    juce::ResamplingAudioSource resampler;
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(ClipStream)
+};
+
+// Command posted from the message thread to a clip track
+struct ClipCommand {
+    enum Type : uint8_t { startClip, stopClip, stopAll, releaseClip };
+
+    juce::int64 time = 0; // engine sample time, 0 = immediately
+    Type type = startClip;
+    ClipStream* stream = nullptr;
+    float gain = 1.0f;
+    uint32_t serial = 0; // non-zero for releaseClip, which the message thread waits on
+};
+
+// Timeline audio clips of one track, streamed from disk. Each play opens its own ClipStream; the
+// audio thread starts and stops streams at the commands' exact sample offsets. A stream that is
+// replaced or cleared stays alive until the audio thread has acknowledged releasing it, like
+// retired samples in the beat and sampler engines.
+class ClipTrackSource : public MixerSource {
+public:
+    static constexpr int maxPlayingClips = 32;
+    static constexpr int commandQueueSize = 512;
+
+    explicit ClipTrackSource(juce::TimeSliceThread& readAheadThread);
+
+    // Message thread; callers serialise through the host's clip lock. Plays reader's file from
+    // offsetSeconds at engine time startTime (0 = now), replacing whatever clipId played before.
+    // Returns false if the command queue is full.
+    bool play(const juce::String& clipId, std::unique_ptr<juce::AudioFormatReader> reader, juce::int64 startTime,
+              double offsetSeconds, float gain);
+    bool stop(const juce::String& clipId, juce::int64 stopTime = 0);
+    void stopAll();
+
+    void prepare(double sampleRate, int maxBlockSize) override;
+    void release() override;
+    void render(juce::AudioBuffer<float>& bus, int numSamples, juce::int64 blockStart) override;
+
+    int getActiveVoices() const override { return activeClips.load(std::memory_order_relaxed); }
+    int getQueueDepth() const override { return queueDepth.load(std::memory_order_relaxed); }
+
+private:
+    struct PlayingClip {
+        ClipStream* stream = nullptr;
+        float gain = 1.0f;
+    };
+
+    struct RetiredStream {
+        uint32_t serial = 0; // 0 until the releaseClip command has been queued
+        std::unique_ptr<ClipStream> stream;
+    };
+
+    // Audio thread
+    void dispatch(const ClipCommand& command);
+    void renderSegment(juce::AudioBuffer<float>& bus, int startSample, int numSamples);
+    void removePlaying(const ClipStream* stream);
+
+    // Message thread
+    void retire(std::unique_ptr<ClipStream> stream);
+    void collectRetiredStreams();
+
+    juce::TimeSliceThread& readAheadThread;
+    EventScheduler<ClipCommand> commands;
+    std::vector<PlayingClip> playing;     // audio thread, reserved for maxPlayingClips
+    juce::AudioBuffer<float> scratch;     // one clip's block before it is summed with its gain
+    juce::int64 renderedUntil = 0;        // audio thread: engine time after the last block
+    std::atomic<double> preparedRate { 0.0 };
+    std::atomic<int> preparedBlockSize { 0 };
+
+    std::map<juce::String, std::unique_ptr<ClipStream>> clips; // message thread: clipId -> latest play
+    std::vector<RetiredStream> retired;                        // message thread
+    uint32_t nextSerial = 1;                                   // message thread
+    std::atomic<uint32_t> ackedSerial { 0 };
+    std::atomic<int> activeClips { 0 };
+    std::atomic<int> queueDepth { 0 };
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(ClipTrackSource)
+};
@@ -0,0 +1,103 @@
+#include "EventOutput.h"
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <iostream>
+#include <mutex>
+#include <string>
+#include <thread>
+
+namespace EventOutput {
+
+namespace {
+
+// How long the writer waits for more lines before writing a batch
+constexpr auto coalesceWindow = std::chrono::milliseconds(2);
+
+class Writer {
+public:
+    Writer() : thread([this] { run(); }) {}
+
+    ~Writer() { stop(); }
+
+    void append(const juce::String& line) {
+        {
+            const std::lock_guard<std::mutex> lock(pendingMutex);
+            pending.append(line.toStdString());
+            pending.push_back('\n');
+        }
+        if (stopped) {
+            drain();
+            return;
+        }
+        dataReady.notify_one();
+    }
+
+    // Swap and write under writeMutex so batches reach stdout in emit order
+    void drain() {
+        const std::lock_guard<std::mutex> writeLock(writeMutex);
+        std::string batch;
+        {
+            const std::lock_guard<std::mutex> lock(pendingMutex);
+            batch.swap(pending);
+        }
+        if (batch.empty()) return;
+        std::cout.write(batch.data(), (std::streamsize)batch.size());
+        std::cout.flush();
+    }
+
+    void stop() {
+        {
+            const std::lock_guard<std::mutex> lock(pendingMutex);
+            if (stopped) return;
+            stopped = true;
+        }
+        dataReady.notify_one();
+        if (thread.joinable()) thread.join();
+        drain();
+    }
+
+private:
+    void run() {
+        std::unique_lock<std::mutex> lock(pendingMutex);
+        while (!stopped) {
+            dataReady.wait(lock, [this] { return stopped || !pending.empty(); });
+            if (stopped) break;
+
+            // Let the rest of a burst arrive, then write it in one go
+            dataReady.wait_for(lock, coalesceWindow, [this] { return stopped.load(); });
+            lock.unlock();
+            drain();
+            lock.lock();
+        }
+    }
+
+    std::mutex pendingMutex;
+    std::mutex writeMutex;
+    std::condition_variable dataReady;
+    std::string pending;
+    std::atomic<bool> stopped { false };
+    std::thread thread;
+};
+
+Writer& getWriter() {
+    static Writer writer;
+    return writer;
+}
+
+} // namespace
+
+void emit(const juce::String& line) {
+    getWriter().append(line);
+}
+
+void flush() {
+    getWriter().drain();
+}
+
+void shutdown() {
+    getWriter().stop();
+}
+
+} // namespace EventOutput
@@ -0,0 +1,18 @@
+#pragma once
+
+#include <juce_core/juce_core.h>
+
+// Stdout event stream shared by Main and BackendHost. emit() is thread-safe and never flushes
+// inline: lines are appended to a buffer that a writer thread drains in coalesced batches, so a
+// burst of events costs one write and one flush instead of one per line.
+namespace EventOutput {
+
+void emit(const juce::String& line);
+
+// Blocks until everything emitted so far has been written and flushed
+void flush();
+
+// Flushes and stops the writer thread. Call once before exit; emit() after this writes directly.
+void shutdown();
+
+} // namespace EventOutput
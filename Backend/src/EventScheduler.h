@@ -0,0 +1,98 @@
+#pragma once
+
+#include "RealtimeQueue.h"
+#include <juce_core/juce_core.h>
+#include <algorithm>
+#include <vector>
+
+// Timestamped event delivery for realtime sources. Producers on any non-audio thread push events
+// stamped with an engine sample time (see MasterMixer::getSampleClock); the audio thread pulls
+// the ones due in the current block in time order and turns them into sample offsets. A time of
+// 0 means "immediately": such events go ahead of everything else and are never cancelled.
+//
+// Event must be copyable and have a juce::int64 `time` member. Pending storage is reserved up
+// front, so nothing on the audio side locks or allocates.
+template <typename Event>
+class EventScheduler {
+public:
+    explicit EventScheduler(int capacity)
+        : incoming(capacity) {
+        pending.reserve((size_t)capacity);
+    }
+
+    // Producer side. With cancelScheduled set, every timestamped event pushed before this one
+    // that has not been delivered yet is dropped (used for panic / stop). Returns false (and
+    // drops the event) when the queue is full.
+    bool push(const Event& event, bool cancelScheduled = false) {
+        const juce::SpinLock::ScopedLockType sl(producerLock);
+        return incoming.push({ event, cancelScheduled });
+    }
+
+    // Consumer side: moves newly pushed events into the time-ordered pending list.
+    // Events with equal times keep their push order.
+    void collect() {
+        compact();
+        Entry entry;
+        while (pending.size() < pending.capacity() && incoming.pop(entry)) {
+            // The queue is FIFO, so everything pending was pushed before a cancelling event
+            if (entry.cancelScheduled) {
+                removePending([](const Event& e) { return e.time != 0; });
+            }
+            auto pos = std::upper_bound(pending.begin(), pending.end(), entry.event.time,
+                                        [](juce::int64 t, const Event& e) { return t < e.time; });
+            pending.insert(pos, entry.event);
+        }
+    }
+
+    // Consumer side: the next event due before blockEnd, or nullptr
+    const Event* nextDue(juce::int64 blockEnd) const {
+        if (head < pending.size() && pending[head].time < blockEnd) return &pending[head];
+        return nullptr;
+    }
+
+    void popNext() { ++head; }
+
+    // Sample offset of a due event inside the block starting at blockStart
+    static int offsetInBlock(const Event& event, juce::int64 blockStart, int numSamples) {
+        return (int)juce::jlimit((juce::int64)0, (juce::int64)juce::jmax(0, numSamples - 1), event.time - blockStart);
+    }
+
+    // Consumer side: drops pending events matching the predicate
+    template <typename Predicate>
+    void removePending(Predicate&& shouldRemove) {
+        compact();
+        pending.erase(std::remove_if(pending.begin(), pending.end(), shouldRemove), pending.end());
+    }
+
+    // Consumer side: moves every queued timestamped event onto a new time base (the clock was
+    // rescaled for a new sample rate). newTime must be monotonic, so the order stays as it was.
+    template <typename Retime>
+    void retime(Retime&& newTime) {
+        collect();
+        for (size_t i = head; i < pending.size(); ++i) {
+            if (pending[i].time != 0) pending[i].time = newTime(pending[i].time);
+        }
+    }
+
+    // Consumer side
+    int getNumPending() const { return (int)(pending.size() - head) + incoming.getNumReady(); }
+
+private:
+    struct Entry {
+        Event event;
+        bool cancelScheduled = false;
+    };
+
+    void compact() {
+        if (head == 0) return;
+        pending.erase(pending.begin(), pending.begin() + (std::ptrdiff_t)head);
+        head = 0;
+    }
+
+    RealtimeQueue<Entry> incoming;
+    juce::SpinLock producerLock;
+    std::vector<Event> pending; // consumer only, sorted by time
+    size_t head = 0;            // first pending event not yet dispatched
+
+    JUCE_DECLARE_NON_COPYABLE(EventScheduler)
+};
@@ -1,23 +1,388 @@
 #include <juce_gui_basics/juce_gui_basics.h>
 
+#include <algorithm>
 #include <atomic>
 #include <iostream>
+#include <map>
 #include <string>
 #include <thread>
+#include <vector>
+
+#if JUCE_WINDOWS
+ #include <fcntl.h>
+ #include <io.h>
+#endif
 
 #include "BackendHost.h"
+#include "BinaryProtocol.h"
+#include "EventOutput.h"
+#include "PeakCache.h"
+#include "PluginCache.h"
+#include "SampleCache.h"
+#include "SoundFontBank.h"
 
 namespace {
-void emit(const juce::String& msg) {
-    std::cout << msg << std::endl;
-    std::cout.flush();
+using EventOutput::emit;
+
+// Removes an optional "at=<ms>" token (engine clock, see CLOCK) and returns it as an engine
+// sample time; 0 means "play now"
+juce::int64 takeScheduledTime(juce::StringArray& tokens, const BackendHost& host) {
+    for (int i = tokens.size(); --i >= 0;) {
+        if (tokens[i].startsWithIgnoreCase("at=")) {
+            const double timeMs = tokens[i].fromFirstOccurrenceOf("=", false, false).getDoubleValue();
+            tokens.remove(i);
+            return host.engineTimeFromMs(timeMs);
+        }
+    }
+    return 0;
+}
+
+// Appends the note objects of a render payload ({trackId, startTime, duration, midiNote,
+// velocity, channel}) to notes
+void parseNoteEvents(const juce::Array<juce::var>* arr, std::vector<MidiNoteEvent>& notes) {
+    if (!arr) return;
+    for (int i = 0; i < arr->size(); ++i) {
+        const juce::var& noteObj = arr->getReference(i);
+        if (!noteObj.isObject()) continue;
+
+        juce::String trackId = noteObj.getProperty("trackId", "").toString();
+        double startTime = noteObj.getProperty("startTime", 0.0);
+        double duration = noteObj.getProperty("duration", 0.5);
+        int midiNote = noteObj.getProperty("midiNote", 60);
+        float velocity = (float)noteObj.getProperty("velocity", 0.8);
+        int channel = noteObj.getProperty("channel", 1);
+
+        notes.emplace_back(trackId, startTime, duration, midiNote, velocity, channel);
+    }
+}
+
+// Everything a RENDER_WAV or RENDER_RANGE payload describes
+struct RenderPayload {
+    std::vector<MidiNoteEvent> notes;
+    std::vector<BeatRenderEvent> beats;
+    std::vector<AudioClipRenderEvent> audio;
+    RenderOptions options;
+};
+
+// Reads a render payload: a JSON note array, or { notes, beats?, audio?, quality?, normalize?,
+// stemCache?, preRoll?, tailThresholdDb?, maxTail?, bitRate?, outputs?: [{path, bitDepth?}],
+// stems?: {folder, format?} }. Output formats follow the file extension. Relative paths are
+// resolved against baseDirectory. On failure error is the reason to report.
+bool parseRenderPayload(const juce::var& jsonData, RenderPayload& payload, juce::String& error,
+                        const juce::File& baseDirectory = {}) {
+    auto resolve = [&](const juce::String& path) {
+        return baseDirectory == juce::File() ? juce::File(path) : baseDirectory.getChildFile(path);
+    };
+
+    auto parseBeatsArray = [&](const juce::Array<juce::var>* arr) {
+        if (!arr) return;
+        for (int i = 0; i < arr->size(); ++i) {
+            const juce::var& beatObj = arr->getReference(i);
+            if (!beatObj.isObject()) continue;
+            BeatRenderEvent ev;
+            ev.trackId = beatObj.getProperty("trackId", "").toString();
+            ev.rowId = beatObj.getProperty("rowId", "").toString();
+            ev.startTimeSeconds = beatObj.getProperty("startTime", 0.0);
+            ev.gainLinear = (float)beatObj.getProperty("gain", 1.0);
+            payload.beats.push_back(ev);
+        }
+    };
+
+    auto parseAudioArray = [&](const juce::Array<juce::var>* arr) {
+        if (!arr) return;
+        for (int i = 0; i < arr->size(); ++i) {
+            const juce::var& audioObj = arr->getReference(i);
+            if (!audioObj.isObject()) continue;
+            AudioClipRenderEvent ev;
+            ev.trackId = audioObj.getProperty("trackId", "").toString();
+            const juce::String path = audioObj.getProperty("path", "").toString().unquoted();
+            if (path.isEmpty()) continue;
+            ev.file = resolve(path);
+            ev.startTimeSeconds = audioObj.getProperty("startTime", 0.0);
+            ev.gainLinear = (float)audioObj.getProperty("gain", 1.0);
+            payload.audio.push_back(ev);
+        }
+    };
+
+    auto& options = payload.options;
+    auto parseOutputs = [&](const juce::Array<juce::var>* arr) {
+        if (!arr) return;
+        for (const auto& outputObj : *arr) {
+            const juce::String path = outputObj.getProperty("path", "").toString().unquoted();
+            if (path.isEmpty()) continue;
+            RenderOptions::Output output;
+            output.file = resolve(path);
+            output.format = RenderOptions::formatForFile(output.file);
+            output.bitDepth = outputObj.getProperty("bitDepth", output.bitDepth);
+            options.extraOutputs.push_back(output);
+        }
+    };
+
+    auto parseStems = [&](const juce::var& stems) {
+        const juce::String folder = stems.getProperty("folder", "").toString().unquoted();
+        if (folder.isEmpty()) return;
+        options.stemFolder = resolve(folder);
+        const juce::String format = stems.getProperty("format", "wav").toString().toLowerCase();
+        options.stemFormat = RenderOptions::formatForFile(options.stemFolder.getChildFile("stem." + format));
+    };
+
+    if (jsonData.isArray()) {
+        parseNoteEvents(jsonData.getArray(), payload.notes);
+    } else if (auto* obj = jsonData.getDynamicObject()) {
+        parseNoteEvents(obj->getProperty("notes").getArray(), payload.notes);
+        parseBeatsArray(obj->getProperty("beats").getArray());
+        parseAudioArray(obj->getProperty("audio").getArray());
+        options.resamplerQuality = Resampler::qualityFromString(obj->getProperty("quality").toString());
+        options.normalisation = RenderOptions::normalisationFromString(obj->getProperty("normalize").toString());
+        if (obj->hasProperty("stemCache")) options.useStemCache = (bool)obj->getProperty("stemCache");
+        if (obj->hasProperty("preRoll")) options.preRollSeconds = obj->getProperty("preRoll");
+        if (obj->hasProperty("tailThresholdDb")) options.tailThresholdDb = (float)obj->getProperty("tailThresholdDb");
+        if (obj->hasProperty("maxTail")) options.maxTailSeconds = juce::jmax(0.0, (double)obj->getProperty("maxTail"));
+        if (obj->hasProperty("bitRate")) options.bitRateKbps = juce::jlimit(32, 320, (int)obj->getProperty("bitRate"));
+        parseOutputs(obj->getProperty("outputs").getArray());
+        parseStems(obj->getProperty("stems"));
+    } else {
+        error = "unexpected-payload-shape";
+        return false;
+    }
+
+    if (payload.notes.empty() && payload.beats.empty() && payload.audio.empty()) {
+        error = "empty-payload";
+        return false;
+    }
+    return true;
+}
+
+bool parseRenderPayload(const juce::String& payloadB64, RenderPayload& payload, juce::String& error) {
+    juce::MemoryOutputStream decodedStream;
+    if (!juce::Base64::convertFromBase64(decodedStream, payloadB64)) {
+        error = "failed-to-decode-payload";
+        return false;
+    }
+    return parseRenderPayload(juce::JSON::parse(decodedStream.toString()), payload, error);
+}
+
+// An automation lane's breakpoints: [{time: seconds, value}, ...] or [[time, value], ...],
+// optionally wrapped as { points: [...] }
+std::vector<AutomationPoint> parseAutomationPoints(juce::var jsonData) {
+    if (auto* obj = jsonData.getDynamicObject()) jsonData = obj->getProperty("points");
+
+    std::vector<AutomationPoint> points;
+    if (auto* arr = jsonData.getArray()) {
+        for (const auto& pointVar : *arr) {
+            AutomationPoint point;
+            if (pointVar.isArray() && pointVar.size() >= 2) {
+                point.timeSeconds = pointVar[0];
+                point.value = (float)(double)pointVar[1];
+            } else if (pointVar.isObject()) {
+                point.timeSeconds = pointVar.getProperty("time", 0.0);
+                point.value = (float)(double)pointVar.getProperty("value", 0.0);
+            } else {
+                continue;
+            }
+            points.push_back(point);
+        }
+    }
+    return points;
+}
+
+// Where raw range renders to "-" go. The client deletes each preview once it has read it; ones
+// left over for a day are cleared when the backend starts.
+juce::File getPreviewFolder() {
+    return juce::File::getSpecialLocation(juce::File::tempDirectory).getChildFile("MelodyKit Previews");
 }
 
+// Periodic EVENT STATS reports started with STATS <intervalMs> (message thread)
+class StatsStream : public juce::Timer {
+public:
+    explicit StatsStream(BackendHost& hostToReport) : host(hostToReport) {}
+
+    void timerCallback() override {
+        for (const auto& line : host.getStatsReport(true)) emit(line);
+    }
+
+private:
+    BackendHost& host;
+};
+
 struct CommandContext {
     BackendHost host;
     std::atomic<bool> running { true };
+    StatsStream statsStream { host };
+
+    // Offline renders run here one at a time, off the message thread (declared after host so it
+    // finishes before the host is destroyed)
+    juce::ThreadPool renderQueue { 1 };
+
+    // Background loads in flight per track, and the commands for those tracks held back until
+    // they finish, so every track still sees its commands in order (message thread only)
+    std::map<juce::String, int> pendingLoads;
+    std::map<juce::String, juce::StringArray> deferredCommands;
+    juce::StringArray deferredUntilLoaded; // renders snapshot every track, so they wait for all loads
 };
 
+bool handleCommand(const juce::String& rawLine, CommandContext& ctx);
+
+bool isLoadCommand(const juce::String& command) {
+    return command == "LOAD" || command == "LOAD_VST" || command == "LOAD_SF2" ||
+           command == "LOAD_BEAT_SAMPLE" || command == "LOAD_SAMPLER_SAMPLE";
+}
+
+// Commands whose first argument is a track ID
+bool isTrackCommand(const juce::String& command) {
+    static const juce::StringArray trackCommands {
+        "SET_SF2_PRESET", "SET_SF2_VOICES", "TRIGGER_BEAT", "CLEAR_BEAT", "TRIGGER_SAMPLER", "STOP_SAMPLER_NOTE",
+        "CLEAR_SAMPLER", "SET_SAMPLER_VOICES", "NOTE", "NOTE_ON", "SET_VOLUME", "VOLUME", "SET_MUTE", "SET_SOLO",
+        "SHOW_UI", "OPEN_EDITOR", "CLOSE_UI", "CLOSE_EDITOR", "GET_STATE", "SET_STATE",
+        "FREEZE_TRACK", "UNFREEZE_TRACK", "PLAY_FROZEN", "STOP_FROZEN", "PLAY_CLIP", "STOP_CLIP", "CLEAR_CLIPS"
+    };
+    return isLoadCommand(command) || trackCommands.contains(command);
+}
+
+// Holds line back if it targets a track that is still loading. New loads start right away (the
+// newest load of a slot wins) unless earlier commands for the track are already waiting.
+bool deferWhileLoading(const juce::String& command, const juce::String& args, const juce::String& line,
+                       CommandContext& ctx) {
+    if (command == "RENDER_WAV" || command == "RENDER_RANGE" || command == "SAVE_SESSION") {
+        if (ctx.pendingLoads.empty()) return false;
+        ctx.deferredUntilLoaded.add(line);
+        return true;
+    }
+    if (!isTrackCommand(command)) return false;
+
+    juce::StringArray tokens;
+    tokens.addTokens(args, " ", "\"'");
+    tokens.removeEmptyStrings();
+    const juce::String trackId = tokens[0];
+    if (ctx.pendingLoads.count(trackId) == 0) return false;
+
+    auto deferred = ctx.deferredCommands.find(trackId);
+    if (isLoadCommand(command) && deferred == ctx.deferredCommands.end()) return false;
+
+    ctx.deferredCommands[trackId].add(line);
+    return true;
+}
+
+void beginTrackLoad(CommandContext& ctx, const juce::String& trackId) {
+    ++ctx.pendingLoads[trackId];
+}
+
+// Runs the commands that waited for trackId once its last load has finished
+void finishTrackLoad(CommandContext& ctx, const juce::String& trackId) {
+    auto pending = ctx.pendingLoads.find(trackId);
+    if (pending == ctx.pendingLoads.end() || --pending->second > 0) return;
+    ctx.pendingLoads.erase(pending);
+
+    juce::StringArray deferred;
+    auto it = ctx.deferredCommands.find(trackId);
+    if (it != ctx.deferredCommands.end()) {
+        deferred.swapWith(it->second);
+        ctx.deferredCommands.erase(it);
+    }
+    for (const auto& line : deferred) {
+        if (!handleCommand(line, ctx)) return;
+    }
+
+    if (ctx.pendingLoads.empty() && !ctx.deferredUntilLoaded.isEmpty()) {
+        juce::StringArray renders;
+        renders.swapWith(ctx.deferredUntilLoaded);
+        for (const auto& line : renders) {
+            if (!handleCommand(line, ctx)) return;
+        }
+    }
+}
+
+// Completion handler for a background load: reports it the way the synchronous loaders used to
+BackendHost::LoadCallback onTrackLoaded(CommandContext& ctx, const juce::String& trackId,
+                                        std::function<void()> onLoaded, const juce::String& errorPrefix) {
+    beginTrackLoad(ctx, trackId);
+    return [&ctx, trackId, onLoaded, errorPrefix](BackendHost::LoadStatus status, const juce::String& err) {
+        if (status == BackendHost::LoadStatus::loaded) onLoaded();
+        else if (status == BackendHost::LoadStatus::failed) emit(errorPrefix + " " + err);
+        finishTrackLoad(ctx, trackId);
+    };
+}
+
+// LOAD_SESSION: every instrument and sample of every track loads at once on the loader pool, like
+// LOAD_* commands sent together, and commands for those tracks wait until they are in. Plugin
+// states go into the new instances before they start playing. Each track's settings are applied
+// as its parts arrive; EVENT SESSION_LOADED follows the last one.
+void restoreSession(CommandContext& ctx, const Session& session, const juce::String& path) {
+    struct Progress {
+        int pending = 0;
+        int failed = 0;
+    };
+    auto progress = std::make_shared<Progress>();
+    const int numTracks = (int)session.tracks.size();
+
+    auto onLoaded = [&ctx, progress, numTracks, path](const juce::String& trackId,
+                                                      std::function<bool(juce::String&)> apply) {
+        beginTrackLoad(ctx, trackId);
+        ++progress->pending;
+        return [&ctx, progress, numTracks, path, trackId, apply](BackendHost::LoadStatus status, const juce::String& err) {
+            juce::String applyError;
+            if (status == BackendHost::LoadStatus::failed) {
+                emit("ERROR LOAD_SESSION " + trackId + " " + err);
+                ++progress->failed;
+            } else if (status == BackendHost::LoadStatus::loaded && !apply(applyError)) {
+                emit("ERROR LOAD_SESSION " + trackId + " " + applyError);
+                ++progress->failed;
+            }
+            if (--progress->pending == 0) {
+                emit("EVENT SESSION_LOADED tracks=" + juce::String(numTracks) + " failed=" + juce::String(progress->failed) +
+                     " " + path);
+            }
+            finishTrackLoad(ctx, trackId);
+        };
+    };
+
+    for (const auto& track : session.tracks) {
+        const juce::String trackId = track.trackId;
+        const float gain = track.gainLinear;
+        const bool muted = track.muted, soloed = track.soloed;
+        auto applyMix = [&ctx, trackId, gain, muted, soloed] {
+            ctx.host.setTrackGain(trackId, gain);
+            ctx.host.setTrackMute(trackId, muted);
+            ctx.host.setTrackSolo(trackId, soloed);
+        };
+
+        if (track.instrument == SessionTrack::Instrument::plugin) {
+            ctx.host.loadPluginAsync(trackId, track.instrumentFile, onLoaded(trackId, [applyMix](juce::String&) {
+                applyMix();
+                return true;
+            }), track.pluginState);
+        } else if (track.instrument == SessionTrack::Instrument::sf2) {
+            const int bank = track.sf2Bank, preset = track.sf2Preset, voices = track.sf2VoiceLimit;
+            const auto policy = track.sf2VoiceStealing;
+            ctx.host.loadSF2Async(trackId, track.instrumentFile, onLoaded(trackId, [&ctx, trackId, bank, preset, voices, policy, applyMix](juce::String& err) {
+                if (!ctx.host.setSF2Preset(trackId, bank, preset, err)) return false;
+                if (!ctx.host.setSF2Voices(trackId, voices, policy, err)) return false;
+                applyMix();
+                return true;
+            }));
+        }
+
+        if (track.samplerFile != juce::File()) {
+            const int voices = track.samplerVoiceLimit;
+            const auto policy = track.samplerVoiceStealing;
+            ctx.host.loadSamplerSampleAsync(trackId, track.samplerFile, onLoaded(trackId, [&ctx, trackId, voices, policy, applyMix](juce::String& err) {
+                if (voices > 0 && !ctx.host.setSamplerVoices(trackId, voices, policy, err)) return false;
+                applyMix();
+                return true;
+            }));
+        }
+
+        for (const auto& [rowId, file] : track.beatRows) {
+            ctx.host.loadBeatSampleAsync(trackId, rowId, file, onLoaded(trackId, [applyMix](juce::String&) {
+                applyMix();
+                return true;
+            }));
+        }
+    }
+
+    if (progress->pending == 0) emit("EVENT SESSION_LOADED tracks=" + juce::String(numTracks) + " failed=0 " + path);
+}
+
 bool handleCommand(const juce::String& rawLine, CommandContext& ctx) {
     const juce::String line = rawLine.trim();
     if (line.isEmpty()) return true;
@@ -25,6 +390,8 @@ bool handleCommand(const juce::String& rawLine, CommandContext& ctx) {
     const juce::String command = line.upToFirstOccurrenceOf(" ", false, false).toUpperCase();
     const juce::String args = line.fromFirstOccurrenceOf(" ", false, false).trim();
 
+    if (deferWhileLoading(command, args, line, ctx)) return true;
+
     if (command == "PING") {
         emit("EVENT PONG");
         return true;
@@ -44,12 +411,9 @@ bool handleCommand(const juce::String& rawLine, CommandContext& ctx) {
         const juce::String path = tokens[1];
         const juce::File file(path.unquoted());
         
-        juce::String err;
-        if (!ctx.host.loadPlugin(trackId, file, err)) {
-            emit("ERROR LOAD " + trackId + " " + err);
-        } else {
+        ctx.host.loadPluginAsync(trackId, file, onTrackLoaded(ctx, trackId, [&ctx, trackId] {
             emit("EVENT READY " + trackId + " " + ctx.host.getLoadedPluginName(trackId));
-        }
+        }, "ERROR LOAD " + trackId));
         return true;
     }
     
@@ -67,12 +431,9 @@ bool handleCommand(const juce::String& rawLine, CommandContext& ctx) {
         const juce::String path = tokens[1];
         const juce::File file(path.unquoted());
         
-        juce::String err;
-        if (!ctx.host.loadSF2(trackId, file, err)) {
-            emit("ERROR LOAD_SF2 " + trackId + " " + err);
-        } else {
+        ctx.host.loadSF2Async(trackId, file, onTrackLoaded(ctx, trackId, [trackId] {
             emit("EVENT READY_SF2 " + trackId);
-        }
+        }, "ERROR LOAD_SF2 " + trackId));
         return true;
     }
     
@@ -97,6 +458,30 @@ bool handleCommand(const juce::String& rawLine, CommandContext& ctx) {
         return true;
     }
 
+    if (command == "SET_SF2_VOICES") {
+        juce::StringArray tokens;
+        tokens.addTokens(args, " ", "\"'");
+        tokens.removeEmptyStrings();
+
+        if (tokens.size() < 2) {
+            emit("ERROR SET_SF2_VOICES missing-arguments (need trackId maxVoices [releasing|oldest|quietest])");
+            return true;
+        }
+
+        const juce::String trackId = tokens[0];
+        auto policy = SoundFontBank::VoiceStealing::releasing;
+        if (tokens.size() > 2 && !SoundFontBank::parseVoiceStealing(tokens[2].toLowerCase(), policy)) {
+            emit("ERROR SET_SF2_VOICES " + trackId + " unknown-policy " + tokens[2]);
+            return true;
+        }
+
+        juce::String err;
+        if (!ctx.host.setSF2Voices(trackId, tokens[1].getIntValue(), policy, err)) {
+            emit("ERROR SET_SF2_VOICES " + trackId + " " + err);
+        }
+        return true;
+    }
+
     if (command == "LOAD_BEAT_SAMPLE") {
         juce::StringArray tokens;
         tokens.addTokens(args, " ", "\"'");
@@ -110,12 +495,9 @@ bool handleCommand(const juce::String& rawLine, CommandContext& ctx) {
         const juce::String trackId = tokens[0];
         const juce::String rowId = tokens[1];
         const juce::String path = tokens[2];
-        juce::String err;
-        if (!ctx.host.loadBeatSample(trackId, rowId, juce::File(path.unquoted()), err)) {
-            emit("ERROR LOAD_BEAT_SAMPLE " + trackId + " " + rowId + " " + err);
-        } else {
+        ctx.host.loadBeatSampleAsync(trackId, rowId, juce::File(path.unquoted()), onTrackLoaded(ctx, trackId, [trackId, rowId] {
             emit("EVENT BEAT_READY " + trackId + " " + rowId);
-        }
+        }, "ERROR LOAD_BEAT_SAMPLE " + trackId + " " + rowId));
         return true;
     }
 
@@ -125,14 +507,17 @@ bool handleCommand(const juce::String& rawLine, CommandContext& ctx) {
         tokens.removeEmptyStrings();
 
         if (tokens.size() < 2) {
-            emit("ERROR TRIGGER_BEAT missing-args (trackId rowId [gain])");
+            emit("ERROR TRIGGER_BEAT missing-args (trackId rowId [gain] [at=ms])");
             return true;
         }
+        const juce::int64 startTime = takeScheduledTime(tokens, ctx.host);
 
         const juce::String trackId = tokens[0];
         const juce::String rowId = tokens[1];
         const float gain = tokens.size() > 2 ? tokens[2].getFloatValue() : 1.0f;
-        ctx.host.triggerBeat(trackId, rowId, gain);
+        if (!ctx.host.triggerBeat(trackId, rowId, gain, startTime)) {
+            emit("ERROR TRIGGER_BEAT " + trackId + " no-beat-sample " + rowId);
+        }
         return true;
     }
 
@@ -169,12 +554,9 @@ bool handleCommand(const juce::String& rawLine, CommandContext& ctx) {
 
         const juce::String trackId = tokens[0];
         const juce::String path = tokens[1];
-        juce::String err;
-        if (!ctx.host.loadSamplerSample(trackId, juce::File(path.unquoted()), err)) {
-            emit("ERROR LOAD_SAMPLER_SAMPLE " + trackId + " " + err);
-        } else {
+        ctx.host.loadSamplerSampleAsync(trackId, juce::File(path.unquoted()), onTrackLoaded(ctx, trackId, [trackId] {
             emit("EVENT SAMPLER_READY " + trackId);
-        }
+        }, "ERROR LOAD_SAMPLER_SAMPLE " + trackId));
         return true;
     }
 
@@ -184,9 +566,10 @@ bool handleCommand(const juce::String& rawLine, CommandContext& ctx) {
         tokens.removeEmptyStrings();
 
         if (tokens.size() < 2) {
-            emit("ERROR TRIGGER_SAMPLER missing-args (trackId midiNote [velocity] [durationMs])");
+            emit("ERROR TRIGGER_SAMPLER missing-args (trackId midiNote [velocity] [durationMs] [at=ms])");
             return true;
         }
+        const juce::int64 startTime = takeScheduledTime(tokens, ctx.host);
 
         const juce::String trackId = tokens[0];
         const int midiNote = tokens[1].getIntValue();
@@ -196,7 +579,10 @@ bool handleCommand(const juce::String& rawLine, CommandContext& ctx) {
         // Accept velocity in 0..1 or 0..127 range
         if (velocity > 1.5f) velocity = juce::jlimit(0.0f, 1.0f, velocity / 127.0f);
 
-        ctx.host.triggerSamplerNote(trackId, midiNote, velocity, durationMs);
+        if (!ctx.host.triggerSamplerNote(trackId, midiNote, velocity, durationMs, startTime)) {
+            emit("ERROR TRIGGER_SAMPLER " + trackId + " no-sampler-sample");
+            return true;
+        }
         emit("EVENT SAMPLER_NOTE " + trackId + " " + juce::String(midiNote));
         return true;
     }
@@ -205,6 +591,7 @@ bool handleCommand(const juce::String& rawLine, CommandContext& ctx) {
         juce::StringArray tokens;
         tokens.addTokens(args, " ", "\"'");
         tokens.removeEmptyStrings();
+        const juce::int64 startTime = takeScheduledTime(tokens, ctx.host);
 
         if (tokens.size() < 2) {
             emit("ERROR STOP_SAMPLER_NOTE missing-args (trackId midiNote)");
@@ -213,7 +600,9 @@ bool handleCommand(const juce::String& rawLine, CommandContext& ctx) {
 
         const juce::String trackId = tokens[0];
         const int midiNote = tokens[1].getIntValue();
-        ctx.host.stopSamplerNote(trackId, midiNote);
+        if (!ctx.host.stopSamplerNote(trackId, midiNote, startTime)) {
+            emit("ERROR STOP_SAMPLER_NOTE " + trackId + " no-sampler-sample");
+        }
         return true;
     }
 
@@ -233,6 +622,83 @@ bool handleCommand(const juce::String& rawLine, CommandContext& ctx) {
         return true;
     }
 
+    if (command == "SET_SAMPLER_VOICES") {
+        juce::StringArray tokens;
+        tokens.addTokens(args, " ", "\"'");
+        tokens.removeEmptyStrings();
+
+        if (tokens.size() < 2) {
+            emit("ERROR SET_SAMPLER_VOICES missing-arguments (need trackId maxVoices [releasing|oldest|quietest])");
+            return true;
+        }
+
+        const juce::String trackId = tokens[0];
+        auto policy = SoundFontBank::VoiceStealing::oldest;
+        if (tokens.size() > 2 && !SoundFontBank::parseVoiceStealing(tokens[2].toLowerCase(), policy)) {
+            emit("ERROR SET_SAMPLER_VOICES " + trackId + " unknown-policy " + tokens[2]);
+            return true;
+        }
+
+        juce::String err;
+        if (!ctx.host.setSamplerVoices(trackId, tokens[1].getIntValue(), policy, err)) {
+            emit("ERROR SET_SAMPLER_VOICES " + trackId + " " + err);
+        }
+        return true;
+    }
+
+    if (command == "PLAY_CLIP") {
+        // Format: PLAY_CLIP <trackId> <clipId> <path> [offsetMs] [gain] [at=ms]
+        juce::StringArray tokens;
+        tokens.addTokens(args, " ", "\"'");
+        tokens.removeEmptyStrings();
+
+        if (tokens.size() < 3) {
+            emit("ERROR PLAY_CLIP missing-args (trackId clipId path [offsetMs] [gain] [at=ms])");
+            return true;
+        }
+        const juce::int64 startTime = takeScheduledTime(tokens, ctx.host);
+
+        const juce::String trackId = tokens[0];
+        const juce::String clipId = tokens[1];
+        const juce::File file(tokens[2].unquoted());
+        const double offsetSeconds = tokens.size() > 3 ? tokens[3].getDoubleValue() / 1000.0 : 0.0;
+        const float gain = tokens.size() > 4 ? tokens[4].getFloatValue() : 1.0f;
+
+        juce::String err;
+        if (!ctx.host.playClip(trackId, clipId, file, err, startTime, offsetSeconds, gain)) {
+            emit("ERROR PLAY_CLIP " + trackId + " " + clipId + " " + err);
+        }
+        return true;
+    }
+
+    if (command == "STOP_CLIP") {
+        // Format: STOP_CLIP <trackId> <clipId> [at=ms]
+        juce::StringArray tokens;
+        tokens.addTokens(args, " ", "\"'");
+        tokens.removeEmptyStrings();
+
+        if (tokens.size() < 2) {
+            emit("ERROR STOP_CLIP missing-args (trackId clipId [at=ms])");
+            return true;
+        }
+        const juce::int64 stopTime = takeScheduledTime(tokens, ctx.host);
+        if (!ctx.host.stopClip(tokens[0], tokens[1], stopTime)) {
+            emit("ERROR STOP_CLIP " + tokens[0] + " " + tokens[1] + " unknown-clip");
+        }
+        return true;
+    }
+
+    if (command == "CLEAR_CLIPS") {
+        const juce::String trackId = args.upToFirstOccurrenceOf(" ", false, false);
+        if (trackId.isEmpty()) {
+            emit("ERROR CLEAR_CLIPS missing-track-id");
+            return true;
+        }
+        ctx.host.clearClipTrack(trackId);
+        emit("EVENT CLIPS_CLEARED " + trackId);
+        return true;
+    }
+
     if (command == "NOTE" || command == "NOTE_ON") {
         juce::StringArray tokens;
         tokens.addTokens(args, " ", "\"'");
@@ -242,6 +708,7 @@ bool handleCommand(const juce::String& rawLine, CommandContext& ctx) {
             emit("ERROR NOTE missing-track-id-or-midi-note");
             return true;
         }
+        const juce::int64 startTime = takeScheduledTime(tokens, ctx.host);
 
         const juce::String trackId = tokens[0];
         const int midiNote = tokens[1].getIntValue();
@@ -252,7 +719,7 @@ bool handleCommand(const juce::String& rawLine, CommandContext& ctx) {
         // Accept velocity in 0..1 or 0..127 range
         if (velocity > 1.5f) velocity = juce::jlimit(0.0f, 1.0f, velocity / 127.0f);
 
-        if (!ctx.host.playNote(trackId, midiNote, velocity, durationMs, channel)) {
+        if (!ctx.host.playNote(trackId, midiNote, velocity, durationMs, channel, startTime)) {
             emit("ERROR NOTE " + trackId + " no-plugin-loaded");
         } else {
             emit("EVENT NOTE " + trackId + " " + juce::String(midiNote));
@@ -289,9 +756,215 @@ bool handleCommand(const juce::String& rawLine, CommandContext& ctx) {
         return true;
     }
 
+    if (command == "SET_MUTE" || command == "SET_SOLO") {
+        juce::StringArray tokens;
+        tokens.addTokens(args, " ", "\"'");
+        tokens.removeEmptyStrings();
+
+        const juce::String name = command.fromFirstOccurrenceOf("SET_", false, false);
+        if (tokens.size() < 2) {
+            emit("ERROR " + name + " missing-track-id-or-state");
+            return true;
+        }
+
+        const juce::String trackId = tokens[0];
+        const bool enabled = tokens[1].getIntValue() != 0 || tokens[1].equalsIgnoreCase("on");
+        const bool ok = command == "SET_MUTE" ? ctx.host.setTrackMute(trackId, enabled)
+                                              : ctx.host.setTrackSolo(trackId, enabled);
+        if (!ok) {
+            emit("ERROR " + name + " " + trackId + " unknown-track");
+        } else {
+            emit("EVENT " + name + " " + trackId + " " + juce::String(enabled ? 1 : 0));
+        }
+        return true;
+    }
+
+    if (command == "SET_AUTOMATION") {
+        // Format: SET_AUTOMATION <trackId> <gain|pan|param:<id>> <base64EncodedPayload>
+        // Payload: the lane's breakpoints as [{time: seconds, value}, ...] or [[time, value], ...],
+        // optionally wrapped as { points: [...] }; an empty list clears the lane
+        juce::StringArray tokens;
+        tokens.addTokens(args, " ", "\"'");
+        tokens.removeEmptyStrings();
+
+        if (tokens.size() < 3) {
+            emit("ERROR SET_AUTOMATION missing-arguments (need trackId target payload)");
+            return true;
+        }
+        const juce::String trackId = tokens[0];
+        const juce::String target = tokens[1];
+
+        juce::MemoryOutputStream decodedStream;
+        if (!juce::Base64::convertFromBase64(decodedStream, tokens[2])) {
+            emit("ERROR SET_AUTOMATION " + trackId + " failed-to-decode-payload");
+            return true;
+        }
+        auto points = parseAutomationPoints(juce::JSON::parse(decodedStream.toString()));
+
+        juce::String err;
+        if (!ctx.host.setAutomation(trackId, target, std::move(points), err)) {
+            emit("ERROR SET_AUTOMATION " + trackId + " " + err);
+        }
+        return true;
+    }
+
+    if (command == "CLEAR_AUTOMATION") {
+        const juce::String trackId = args.trim();
+        if (trackId.isEmpty()) {
+            emit("ERROR CLEAR_AUTOMATION missing-track-id");
+            return true;
+        }
+        ctx.host.clearAutomation(trackId);
+        emit("EVENT AUTOMATION_CLEARED " + trackId);
+        return true;
+    }
+
+    if (command == "START_AUTOMATION") {
+        // Format: START_AUTOMATION [positionMs] [at=ms]
+        juce::StringArray tokens;
+        tokens.addTokens(args, " ", "\"'");
+        tokens.removeEmptyStrings();
+        const juce::int64 startTime = takeScheduledTime(tokens, ctx.host);
+        const double positionMs = tokens.isEmpty() ? 0.0 : tokens[0].getDoubleValue();
+
+        ctx.host.startAutomation(positionMs / 1000.0, startTime);
+        emit("EVENT AUTOMATION_STARTED " + juce::String(positionMs, 3));
+        return true;
+    }
+
+    if (command == "STOP_AUTOMATION") {
+        ctx.host.stopAutomation();
+        emit("EVENT AUTOMATION_STOPPED");
+        return true;
+    }
+
     if (command == "STATUS") {
-        emit("EVENT STATUS rate=" + juce::String(ctx.host.getSampleRate()) +
-             " block=" + juce::String(ctx.host.getBlockSize()));
+        for (const auto& line : ctx.host.getStatusReport()) emit(line);
+        return true;
+    }
+
+    if (command == "SET_TRACK_SLEEP") {
+        // Format: SET_TRACK_SLEEP on [idleMs] [thresholdDb] | off
+        juce::StringArray tokens;
+        tokens.addTokens(args, " ", "\"'");
+        tokens.removeEmptyStrings();
+        const juce::String mode = tokens[0].toLowerCase();
+        if (mode != "on" && mode != "off") {
+            emit("ERROR SET_TRACK_SLEEP expected on|off");
+            return true;
+        }
+
+        const auto& current = ctx.host.getTrackSleep();
+        const double idleMs = tokens.size() > 1 ? tokens[1].getDoubleValue() : current.idleSeconds.load() * 1000.0;
+        const float thresholdDb = tokens.size() > 2 ? tokens[2].getFloatValue()
+                                                    : juce::Decibels::gainToDecibels(current.threshold.load(), -200.0f);
+        ctx.host.setTrackSleep(mode == "on", idleMs / 1000.0, thresholdDb);
+        emit("EVENT TRACK_SLEEP " + mode + " idleMs=" + juce::String(juce::roundToInt(idleMs)) +
+             " thresholdDb=" + juce::String(thresholdDb, 1));
+        return true;
+    }
+
+    if (command == "LIST_DEVICES") {
+        for (const auto& line : ctx.host.getDeviceReport()) emit(line);
+        emit("EVENT DEVICES_END");
+        return true;
+    }
+
+    if (command == "SET_DEVICE") {
+        // Format: SET_DEVICE <type|-> [device|-] [sampleRate] [bufferSize]; "-" keeps the current
+        // type or device, 0 the current rate or buffer size
+        juce::StringArray tokens;
+        tokens.addTokens(args, " ", "\"'");
+        tokens.removeEmptyStrings();
+        if (tokens.isEmpty()) {
+            emit("ERROR SET_DEVICE missing-arguments (need type [device] [sampleRate] [bufferSize])");
+            return true;
+        }
+
+        auto nameOrEmpty = [](const juce::String& token) {
+            const juce::String name = token.unquoted();
+            return name == "-" ? juce::String() : name;
+        };
+        juce::String err;
+        if (!ctx.host.setDevice(nameOrEmpty(tokens[0]), nameOrEmpty(tokens[1]), tokens[2].getDoubleValue(),
+                                tokens[3].getIntValue(), err)) {
+            emit("ERROR SET_DEVICE " + err);
+            return true;
+        }
+        emit(ctx.host.getDeviceLine("DEVICE_CHANGED"));
+        return true;
+    }
+
+    if (command == "STATS") {
+        // STATS reports once; STATS <intervalMs> also streams reports, STATS 0 stops the stream
+        const juce::String interval = args.trim();
+        if (interval.isNotEmpty()) {
+            const int intervalMs = interval.getIntValue();
+            if (intervalMs > 0) ctx.statsStream.startTimer(juce::jmax(50, intervalMs));
+            else ctx.statsStream.stopTimer();
+        }
+        for (const auto& line : ctx.host.getStatsReport(true)) emit(line);
+        return true;
+    }
+
+    if (command == "CLOCK") {
+        emit("EVENT CLOCK " + juce::String(ctx.host.getEngineTimeMs(), 3));
+        return true;
+    }
+
+    if (command == "SCAN_PLUGINS") {
+        juce::StringArray paths;
+        paths.addTokens(args, " ", "\"'");
+        paths.removeEmptyStrings();
+        for (auto& path : paths) path = path.unquoted();
+        ctx.host.scanPluginsAsync(paths);
+        return true;
+    }
+
+    if (command == "SET_SAMPLE_PREPARATION") {
+        const juce::String mode = args.trim().toLowerCase();
+        if (mode != "on" && mode != "off") {
+            emit("ERROR SET_SAMPLE_PREPARATION missing-arguments (need on | off)");
+            return true;
+        }
+
+        ctx.host.setSamplePreparation(mode == "on");
+        emit("EVENT SAMPLE_PREPARATION " + mode);
+        return true;
+    }
+
+    if (command == "SET_SAMPLE_MAPPING") {
+        juce::StringArray tokens;
+        tokens.addTokens(args, " ", "\"'");
+        tokens.removeEmptyStrings();
+        const juce::String mode = tokens.isEmpty() ? juce::String() : tokens[0].toLowerCase();
+        if (mode != "on" && mode != "off") {
+            emit("ERROR SET_SAMPLE_MAPPING missing-arguments (need on [minSizeKB] | off)");
+            return true;
+        }
+
+        auto& cache = ctx.host.getSampleCache();
+        juce::int64 minBytes = SampleCache::defaultMapThreshold;
+        if (tokens.size() > 1) minBytes = juce::jmax<juce::int64>(0, tokens[1].getLargeIntValue()) * 1024;
+        cache.setMapping(mode == "on", minBytes);
+        emit("EVENT SAMPLE_MAPPING " + mode + " minBytes=" + juce::String(cache.getMapThreshold()));
+        return true;
+    }
+
+    if (command == "CACHE_STATS") {
+        const auto stats = ctx.host.getSampleCache().getStats();
+        const auto fonts = SoundFontBank::getStats();
+        emit("EVENT CACHE_STATS entries=" + juce::String(stats.entries) +
+             " bytes=" + juce::String(stats.bytes) +
+             " inUse=" + juce::String(stats.bytesInUse) +
+             " limit=" + juce::String(stats.memoryLimit) +
+             " hits=" + juce::String(stats.hits) +
+             " misses=" + juce::String(stats.misses) +
+             " evictions=" + juce::String(stats.evictions) +
+             " mapped=" + juce::String(stats.mappedEntries) +
+             " mappedBytes=" + juce::String(stats.mappedBytes) +
+             " sf2Fonts=" + juce::String(fonts.fonts) +
+             " sf2Instances=" + juce::String(fonts.instances));
         return true;
     }
     
@@ -323,6 +996,59 @@ bool handleCommand(const juce::String& rawLine, CommandContext& ctx) {
         return true;
     }
     
+    if (command == "GET_PEAKS") {
+        // Format: GET_PEAKS <path>
+        const juce::String path = args.unquoted();
+        if (path.isEmpty()) {
+            emit("ERROR GET_PEAKS missing-path");
+            return true;
+        }
+        ctx.host.getPeaksAsync(juce::File(path), [path](const PeakFileInfo& info, const juce::String& err) {
+            if (err.isNotEmpty()) {
+                emit("ERROR GET_PEAKS " + path.quoted() + " " + err);
+                return;
+            }
+            juce::StringArray levels;
+            for (int level = 0, samplesPerPeak = PeakCache::baseSamplesPerPeak; level < PeakCache::numLevels; ++level) {
+                levels.add(juce::String(samplesPerPeak));
+                samplesPerPeak *= PeakCache::levelFactor;
+            }
+            emit("EVENT PEAKS " + path.quoted() + " " + info.peakFile.getFullPathName().quoted() +
+                 " sampleRate=" + juce::String(info.sampleRate) + " frames=" + juce::String(info.numFrames) +
+                 " channels=" + juce::String(info.numChannels) + " levels=" + levels.joinIntoString(",") +
+                 " cached=" + juce::String(info.cached ? 1 : 0));
+        });
+        return true;
+    }
+
+    if (command == "SAVE_SESSION") {
+        // Format: SAVE_SESSION <path>
+        const juce::String path = args.unquoted();
+        if (path.isEmpty()) {
+            emit("ERROR SAVE_SESSION missing-path");
+            return true;
+        }
+        ctx.host.saveSessionAsync(juce::File(path), [path](int numTracks, juce::int64 numBytes, const juce::String& err) {
+            if (err.isNotEmpty()) emit("ERROR SAVE_SESSION " + err);
+            else emit("EVENT SESSION_SAVED tracks=" + juce::String(numTracks) + " bytes=" + juce::String(numBytes) + " " + path);
+        });
+        return true;
+    }
+
+    if (command == "LOAD_SESSION") {
+        // Format: LOAD_SESSION <path>
+        const juce::String path = args.unquoted();
+        if (path.isEmpty()) {
+            emit("ERROR LOAD_SESSION missing-path");
+            return true;
+        }
+        ctx.host.readSessionAsync(juce::File(path), [&ctx, path](const Session& session, const juce::String& err) {
+            if (err.isNotEmpty()) emit("ERROR LOAD_SESSION " + err);
+            else restoreSession(ctx, session, path);
+        });
+        return true;
+    }
+
     if (command == "GET_STATE") {
         const juce::String trackId = args.trim();
         if (trackId.isEmpty()) {
@@ -360,111 +1086,170 @@ bool handleCommand(const juce::String& rawLine, CommandContext& ctx) {
         return true;
     }
 
-    if (command == "RENDER_WAV") {
+    if (command == "RENDER_WAV" || command == "RENDER_RANGE") {
         // Format: RENDER_WAV <outputPath> <sampleRate> <bitDepth> <base64EncodedPayload>
+        //         RENDER_RANGE <outputPath|-> <sampleRate> <bitDepth> <startSeconds> <endSeconds> <base64EncodedPayload>
         // Payload: JSON object { notes: [...], beats?: [...], audio?: [...] }
+        // A range render to "-" writes raw float frames to a preview file in the temp folder.
+        const bool ranged = command == "RENDER_RANGE";
         juce::StringArray tokens;
         tokens.addTokens(args, " ", "\"'");
         tokens.removeEmptyStrings();
-        
-        if (tokens.size() < 4) {
-            emit("ERROR RENDER_WAV missing-arguments (need outputPath sampleRate bitDepth payload)");
+
+        if (tokens.size() < (ranged ? 6 : 4)) {
+            emit(ranged ? "ERROR RENDER_RANGE missing-arguments (need outputPath sampleRate bitDepth start end payload)"
+                        : "ERROR RENDER_WAV missing-arguments (need outputPath sampleRate bitDepth payload)");
             return true;
         }
-        
-        const juce::String outputPath = tokens[0].unquoted();
+
+        juce::String outputPath = tokens[0].unquoted();
         const double sampleRate = tokens[1].getDoubleValue();
         const int bitDepth = tokens[2].getIntValue();
-        const juce::String payloadB64 = tokens[3];
-        
-        // Decode base64 payload
-        juce::MemoryOutputStream decodedStream;
-        if (!juce::Base64::convertFromBase64(decodedStream, payloadB64)) {
-            emit("ERROR RENDER_WAV failed-to-decode-payload");
+
+        RenderPayload payload;
+        juce::String payloadError;
+        if (!parseRenderPayload(tokens[ranged ? 5 : 3], payload, payloadError)) {
+            emit("ERROR " + command + " " + payloadError);
             return true;
         }
-        
-        juce::String jsonStr = decodedStream.toString();
-        juce::var jsonData;
-        try {
-            jsonData = juce::JSON::parse(jsonStr);
-        } catch (...) {
-            emit("ERROR RENDER_WAV failed-to-parse-json");
+
+        auto& options = payload.options;
+        options.outputFormat = RenderOptions::formatForFile(juce::File(outputPath));
+        if (ranged) {
+            options.rangeStartSeconds = juce::jmax(0.0, tokens[3].getDoubleValue());
+            options.rangeEndSeconds = tokens[4].getDoubleValue();
+            if (!options.hasRange()) {
+                emit("ERROR RENDER_RANGE empty-range");
+                return true;
+            }
+            if (outputPath == "-") {
+                options.outputFormat = RenderOptions::OutputFormat::rawFloat;
+                outputPath = getPreviewFolder().getChildFile("preview-" + juce::Uuid().toString() + ".f32").getFullPathName();
+                getPreviewFolder().createDirectory();
+            }
+        }
+
+        // Snapshot the tracks here, then render in the background so commands keep flowing
+        juce::String err;
+        auto job = ctx.host.prepareRender(payload.notes, juce::File(outputPath), err, sampleRate, bitDepth, payload.beats,
+                                          payload.audio, options);
+        if (!job) {
+            emit("ERROR " + command + " " + err);
             return true;
         }
 
-        std::vector<MidiNoteEvent> notes;
-        std::vector<BeatRenderEvent> beatEvents;
-        std::vector<AudioClipRenderEvent> audioEvents;
-
-        auto parseNotesArray = [&](const juce::Array<juce::var>* arr) {
-            if (!arr) return;
-            for (int i = 0; i < arr->size(); ++i) {
-                const juce::var& noteObj = arr->getReference(i);
-                if (!noteObj.isObject()) continue;
-
-                juce::String trackId = noteObj.getProperty("trackId", "").toString();
-                double startTime = noteObj.getProperty("startTime", 0.0);
-                double duration = noteObj.getProperty("duration", 0.5);
-                int midiNote = noteObj.getProperty("midiNote", 60);
-                float velocity = (float)noteObj.getProperty("velocity", 0.8);
-                int channel = noteObj.getProperty("channel", 1);
-
-                notes.emplace_back(trackId, startTime, duration, midiNote, velocity, channel);
+        ctx.renderQueue.addJob([&ctx, job, outputPath, command]() {
+            juce::String renderError;
+            if (!ctx.host.runRender(*job, renderError)) {
+                emit("ERROR " + command + " " + renderError);
+            } else {
+                emit("EVENT RENDER_COMPLETE " + outputPath);
             }
-        };
+        });
+        return true;
+    }
+
+    if (command == "FREEZE_TRACK") {
+        // Format: FREEZE_TRACK <trackId> <base64EncodedPayload>
+        // Payload: the track's notes, as a JSON array or { notes: [...] } like RENDER_WAV
+        juce::StringArray tokens;
+        tokens.addTokens(args, " ", "\"'");
+        tokens.removeEmptyStrings();
+
+        if (tokens.size() < 2) {
+            emit("ERROR FREEZE_TRACK missing-arguments (need trackId payload)");
+            return true;
+        }
+        const juce::String trackId = tokens[0];
+
+        juce::MemoryOutputStream decodedStream;
+        if (!juce::Base64::convertFromBase64(decodedStream, tokens[1])) {
+            emit("ERROR FREEZE_TRACK " + trackId + " failed-to-decode-payload");
+            return true;
+        }
+        const juce::var jsonData = juce::JSON::parse(decodedStream.toString());
+
+        std::vector<MidiNoteEvent> notes;
+        if (jsonData.isArray()) {
+            parseNoteEvents(jsonData.getArray(), notes);
+        } else if (auto* obj = jsonData.getDynamicObject()) {
+            parseNoteEvents(obj->getProperty("notes").getArray(), notes);
+        }
+        for (auto& note : notes) note.trackId = trackId;
+        std::sort(notes.begin(), notes.end(), [](const MidiNoteEvent& a, const MidiNoteEvent& b) {
+            return a.startTimeSeconds < b.startTimeSeconds;
+        });
 
-        auto parseBeatsArray = [&](const juce::Array<juce::var>* arr) {
-            if (!arr) return;
-            for (int i = 0; i < arr->size(); ++i) {
-                const juce::var& beatObj = arr->getReference(i);
-                if (!beatObj.isObject()) continue;
-                BeatRenderEvent ev;
-                ev.trackId = beatObj.getProperty("trackId", "").toString();
-                ev.rowId = beatObj.getProperty("rowId", "").toString();
-                ev.startTimeSeconds = beatObj.getProperty("startTime", 0.0);
-                ev.gainLinear = (float)beatObj.getProperty("gain", 1.0);
-                beatEvents.push_back(ev);
+        auto finishFreeze = [&ctx, trackId](bool cached) {
+            juce::File stemFile;
+            juce::String err;
+            if (!ctx.host.freezeTrack(trackId, stemFile, err)) {
+                emit("ERROR FREEZE_TRACK " + trackId + " " + err);
+            } else {
+                emit("EVENT TRACK_FROZEN " + trackId + " " + stemFile.getFullPathName() +
+                     " cached=" + juce::String(cached ? 1 : 0));
             }
         };
 
-        auto parseAudioArray = [&](const juce::Array<juce::var>* arr) {
-            if (!arr) return;
-            for (int i = 0; i < arr->size(); ++i) {
-                const juce::var& audioObj = arr->getReference(i);
-                if (!audioObj.isObject()) continue;
-                AudioClipRenderEvent ev;
-                ev.trackId = audioObj.getProperty("trackId", "").toString();
-                ev.file = juce::File(audioObj.getProperty("path", "").toString().unquoted());
-                ev.startTimeSeconds = audioObj.getProperty("startTime", 0.0);
-                ev.gainLinear = (float)audioObj.getProperty("gain", 1.0);
-                if (ev.file.getFullPathName().isNotEmpty()) {
-                    audioEvents.push_back(ev);
-                }
+        juce::String err;
+        auto job = ctx.host.prepareFreeze(trackId, notes, err);
+        if (!job) {
+            if (err.isNotEmpty()) emit("ERROR FREEZE_TRACK " + trackId + " " + err);
+            else finishFreeze(true);
+            return true;
+        }
+
+        // Bounced in the background like RENDER_WAV; the stem is swapped in on the message thread
+        ctx.renderQueue.addJob([&ctx, job, trackId, finishFreeze]() {
+            juce::String renderError;
+            if (!ctx.host.runRender(*job, renderError)) {
+                emit("ERROR FREEZE_TRACK " + trackId + " " + renderError);
+                return;
             }
-        };
+            juce::MessageManager::callAsync([finishFreeze] { finishFreeze(false); });
+        });
+        return true;
+    }
 
-        if (jsonData.isArray()) {
-            parseNotesArray(jsonData.getArray());
-        } else if (auto* obj = jsonData.getDynamicObject()) {
-            parseNotesArray(obj->getProperty("notes").getArray());
-            parseBeatsArray(obj->getProperty("beats").getArray());
-            parseAudioArray(obj->getProperty("audio").getArray());
+    if (command == "UNFREEZE_TRACK") {
+        const juce::String trackId = args.upToFirstOccurrenceOf(" ", false, false);
+        juce::String err;
+        if (!ctx.host.unfreezeTrack(trackId, err)) {
+            emit("ERROR UNFREEZE_TRACK " + trackId + " " + err);
         } else {
-            emit("ERROR RENDER_WAV unexpected-payload-shape");
-            return true;
+            emit("EVENT TRACK_UNFROZEN " + trackId);
         }
+        return true;
+    }
+
+    if (command == "PLAY_FROZEN" || command == "STOP_FROZEN") {
+        // Format: PLAY_FROZEN <trackId> [offsetMs] [at=ms] / STOP_FROZEN <trackId> [at=ms]
+        juce::StringArray tokens;
+        tokens.addTokens(args, " ", "\"'");
+        tokens.removeEmptyStrings();
 
-        if (notes.empty() && beatEvents.empty() && audioEvents.empty()) {
-            emit("ERROR RENDER_WAV empty-payload");
+        if (tokens.isEmpty()) {
+            emit("ERROR " + command + " missing-track-id");
             return true;
         }
+        const juce::int64 time = takeScheduledTime(tokens, ctx.host);
+        const juce::String trackId = tokens[0];
 
-        juce::String err;
-        if (!ctx.host.renderToWav(notes, juce::File(outputPath), err, sampleRate, bitDepth, beatEvents, audioEvents)) {
-            emit("ERROR RENDER_WAV " + err);
+        const bool done = command == "PLAY_FROZEN"
+            ? ctx.host.playFrozen(trackId, time, tokens[1].getDoubleValue() / 1000.0)
+            : ctx.host.stopFrozen(trackId, time);
+        if (!done) emit("ERROR " + command + " " + trackId + " not-frozen");
+        return true;
+    }
+
+    if (command == "CANCEL_RENDER") {
+        // Format: CANCEL_RENDER [outputPath]
+        const juce::String outputPath = args.unquoted();
+        const int cancelled = ctx.host.cancelRender(outputPath);
+        if (cancelled == 0) {
+            emit("ERROR CANCEL_RENDER no-active-render");
         } else {
-            emit("EVENT RENDER_COMPLETE " + outputPath);
+            emit("EVENT RENDER_CANCELLED " + juce::String(cancelled));
         }
         return true;
     }
@@ -478,31 +1263,268 @@ bool handleCommand(const juce::String& rawLine, CommandContext& ctx) {
     emit("ERROR UNKNOWN " + command);
     return true;
 }
+
+// Reads framed binary commands (see BinaryProtocol.h). Text frames are posted to the message
+// thread as one batch; event frames are dispatched to the tracks right here.
+void readBinaryCommands(CommandContext& ctx) {
+#if JUCE_WINDOWS
+    _setmode(_fileno(stdin), _O_BINARY);
+#endif
+    BinaryProtocol::Frame frame;
+    juce::String error;
+    while (ctx.running && BinaryProtocol::readFrame(std::cin, frame, error)) {
+        if (error.isNotEmpty()) emit("ERROR FRAME " + error);
+
+        if (frame.type == BinaryProtocol::textFrame) {
+            juce::StringArray lines;
+            lines.addLines(frame.payload.toString());
+            juce::MessageManager::callAsync([&ctx, lines]() {
+                for (const auto& line : lines) {
+                    if (!handleCommand(line, ctx)) break;
+                }
+            });
+        } else if (frame.type == BinaryProtocol::eventsFrame) {
+            const int failures = BinaryProtocol::dispatchEvents(frame.payload, ctx.host, error);
+            if (failures > 0) emit("ERROR EVENTS " + juce::String(failures) + " " + error);
+        }
+    }
+}
+
+// Exit codes of --render
+enum BatchExitCode {
+    batchOk = 0,
+    batchBadArguments = 1,
+    batchBadProject = 2,
+    batchLoadFailed = 3,
+    batchRenderFailed = 4
+};
+
+// Headless export: --render <project.json> --out <file.wav>. Every track of the project loads in
+// parallel on the loader pool without an audio device being opened, then the offline engine
+// bounces it and the process exits. Relative paths are resolved against the project's folder.
+// Project:
+//   { sampleRate?, bitDepth?, range?: {start, end}, tracks: [...], notes, beats?, audio?, ...}
+//   with the RENDER_WAV payload keys, and per track
+//   { id, plugin | sf2 | sampler: path, rows?: {rowId: path} (beat track), state?: base64, bank?,
+//     preset?, voices?, stealing?, volume?: 0-127, automation?: {target: points} }
+// Progress and errors are reported as events on stdout like in the interactive mode.
+int runBatchRender(const juce::File& projectFile, const juce::File& outputFile) {
+    juce::var project;
+    if (!juce::JSON::parse(projectFile.loadFileAsString(), project).wasOk() || !project.isObject()) {
+        emit("ERROR RENDER unreadable-project " + projectFile.getFullPathName());
+        return batchBadProject;
+    }
+
+    const juce::File baseDirectory = projectFile.getParentDirectory();
+    RenderPayload payload;
+    juce::String error;
+    if (!parseRenderPayload(project, payload, error, baseDirectory)) {
+        emit("ERROR RENDER " + error);
+        return batchBadProject;
+    }
+    const double sampleRate = project.getProperty("sampleRate", 44100.0);
+    const int bitDepth = project.getProperty("bitDepth", 24);
+    const juce::var range = project.getProperty("range", {});
+    if (range.isObject()) {
+        payload.options.rangeStartSeconds = juce::jmax(0.0, (double)range.getProperty("start", 0.0));
+        payload.options.rangeEndSeconds = range.getProperty("end", 0.0);
+    }
+    payload.options.outputFormat = RenderOptions::formatForFile(outputFile);
+
+    BackendHost host(false);
+    int pendingLoads = 0;
+    bool loadFailed = false;
+    int exitCode = batchOk;
+
+    auto renderProject = [&] {
+        juce::String renderError;
+        if (loadFailed) {
+            exitCode = batchLoadFailed;
+        } else if (!host.renderToWav(payload.notes, outputFile, renderError, sampleRate, bitDepth, payload.beats,
+                                     payload.audio, payload.options)) {
+            emit("ERROR RENDER " + renderError);
+            exitCode = batchRenderFailed;
+        } else {
+            emit("EVENT RENDER_COMPLETE " + outputFile.getFullPathName());
+        }
+        juce::MessageManager::getInstance()->stopDispatchLoop();
+    };
+
+    // Each track's settings are applied once its instrument is in; the render starts after the
+    // last load, whichever finishes last
+    auto onLoaded = [&](const juce::String& trackId, std::function<bool(juce::String&)> apply) {
+        ++pendingLoads;
+        return [&, trackId, apply](BackendHost::LoadStatus status, const juce::String& err) {
+            juce::String applyError;
+            if (status != BackendHost::LoadStatus::loaded) {
+                emit("ERROR RENDER " + trackId + " " + err);
+                loadFailed = true;
+            } else if (apply && !apply(applyError)) {
+                emit("ERROR RENDER " + trackId + " " + applyError);
+                loadFailed = true;
+            }
+            if (--pendingLoads == 0) renderProject();
+        };
+    };
+
+    auto readPolicy = [](const juce::var& track, SoundFontBank::VoiceStealing& policy) {
+        const juce::String name = track.getProperty("stealing", "").toString().toLowerCase();
+        return name.isEmpty() || SoundFontBank::parseVoiceStealing(name, policy);
+    };
+
+    // Everything is checked before the first load starts
+    const juce::var tracks = project.getProperty("tracks", {});
+    std::vector<juce::MemoryBlock> states((size_t)tracks.size()); // decoded plugin state, by track
+    for (int i = 0; tracks.isArray() && i < tracks.size(); ++i) {
+        const juce::var& track = tracks[i];
+        const juce::String trackId = track.getProperty("id", "").toString();
+        if (trackId.isEmpty()) {
+            emit("ERROR RENDER track-without-id");
+            return batchBadProject;
+        }
+        auto policy = SoundFontBank::VoiceStealing::oldest;
+        if (!readPolicy(track, policy)) {
+            emit("ERROR RENDER " + trackId + " unknown-policy");
+            return batchBadProject;
+        }
+        if (track.hasProperty("state") && !states[(size_t)i].fromBase64Encoding(track.getProperty("state", "").toString())) {
+            emit("ERROR RENDER " + trackId + " bad-state");
+            return batchBadProject;
+        }
+        if (auto* lanes = track.getProperty("automation", {}).getDynamicObject()) {
+            for (const auto& lane : lanes->getProperties()) {
+                if (!host.setAutomation(trackId, lane.name.toString(), parseAutomationPoints(lane.value), error)) {
+                    emit("ERROR RENDER " + trackId + " " + error);
+                    return batchBadProject;
+                }
+            }
+        }
+    }
+
+    for (int i = 0; tracks.isArray() && i < tracks.size(); ++i) {
+        const juce::var& track = tracks[i];
+        const juce::String trackId = track.getProperty("id", "").toString();
+        auto fileFor = [&](const char* key) {
+            return baseDirectory.getChildFile(track.getProperty(key, "").toString().unquoted());
+        };
+        const int volume = track.getProperty("volume", -1);
+        // Mixer gain, as LOAD_SESSION restores it: a CC7 would reach the instrument instead
+        // (volume is 0-127 and 64 is unity, as before)
+        auto applyVolume = [&host, trackId, volume] {
+            if (volume >= 0) host.setTrackGain(trackId, volume / 64.0f);
+        };
+        const int voices = track.getProperty("voices", 0);
+
+        if (track.hasProperty("plugin")) {
+            // The state goes into the new instance before its first prepare, as for LOAD_SESSION
+            host.loadPluginAsync(trackId, fileFor("plugin"), onLoaded(trackId, [applyVolume](juce::String&) {
+                applyVolume();
+                return true;
+            }), states[(size_t)i]);
+        } else if (track.hasProperty("sf2")) {
+            const int bank = track.getProperty("bank", 0);
+            const int preset = track.getProperty("preset", 0);
+            auto policy = SoundFontBank::VoiceStealing::releasing;
+            readPolicy(track, policy);
+            host.loadSF2Async(trackId, fileFor("sf2"), onLoaded(trackId, [&host, trackId, bank, preset, voices, policy, applyVolume](juce::String& err) {
+                if (!host.setSF2Preset(trackId, bank, preset, err)) return false;
+                if (voices > 0 && !host.setSF2Voices(trackId, voices, policy, err)) return false;
+                applyVolume();
+                return true;
+            }));
+        } else if (track.hasProperty("sampler")) {
+            auto policy = SoundFontBank::VoiceStealing::oldest;
+            readPolicy(track, policy);
+            host.loadSamplerSampleAsync(trackId, fileFor("sampler"), onLoaded(trackId, [&host, trackId, voices, policy, applyVolume](juce::String& err) {
+                if (voices > 0 && !host.setSamplerVoices(trackId, voices, policy, err)) return false;
+                applyVolume();
+                return true;
+            }));
+        }
+
+        if (auto* rows = track.getProperty("rows", {}).getDynamicObject()) {
+            for (const auto& row : rows->getProperties()) {
+                const auto file = baseDirectory.getChildFile(row.value.toString().unquoted());
+                host.loadBeatSampleAsync(trackId, row.name.toString(), file, onLoaded(trackId, [applyVolume](juce::String&) {
+                    applyVolume();
+                    return true;
+                }));
+            }
+        }
+    }
+
+    if (pendingLoads == 0) juce::MessageManager::callAsync(renderProject);
+    juce::MessageManager::getInstance()->runDispatchLoop();
+    return exitCode;
+}
 }
 
 int main(int argc, char* argv[]) {
     juce::ScopedJuceInitialiser_GUI juceInit;
 
+    // Child process of SCAN_PLUGINS: scan one bundle and exit
+    if (argc > 3 && juce::String(argv[1]) == PluginCache::scanChildFlag) {
+        return PluginCache::runScanChild(juce::String(argv[2]), juce::File(juce::String(argv[3])));
+    }
+
+    // Flags first, then the optional positional trackId/path pair
+    bool binaryProtocol = false;
+    juce::String projectPath, outputPath;
+    juce::StringArray positional;
+    for (int i = 1; i < argc; ++i) {
+        const juce::String arg(argv[i]);
+        if (arg == "--protocol=binary" || arg == "--binary") binaryProtocol = true;
+        else if (arg == "--protocol=text") binaryProtocol = false;
+        else if (arg == "--render" && i + 1 < argc) projectPath = argv[++i];
+        else if (arg == "--out" && i + 1 < argc) outputPath = argv[++i];
+        else positional.add(arg);
+    }
+
+    // Batch export: no stdin loop and no audio device
+    if (projectPath.isNotEmpty() || outputPath.isNotEmpty()) {
+        int exitCode = batchBadArguments;
+        if (projectPath.isEmpty() || outputPath.isEmpty()) {
+            emit("ERROR RENDER usage: --render <project.json> --out <file.wav>");
+        } else {
+            const auto cwd = juce::File::getCurrentWorkingDirectory();
+            exitCode = runBatchRender(cwd.getChildFile(projectPath), cwd.getChildFile(outputPath));
+        }
+        emit("EVENT EXIT " + juce::String(exitCode));
+        EventOutput::shutdown();
+        return exitCode;
+    }
+
+    // Previews a client never collected (another backend may still be using recent ones)
+    for (const auto& preview : getPreviewFolder().findChildFiles(juce::File::findFiles, false, "preview-*.f32")) {
+        if (preview.getLastModificationTime() < juce::Time::getCurrentTime() - juce::RelativeTime::days(1)) {
+            preview.deleteFile();
+        }
+    }
+
     CommandContext ctx;
-    emit("EVENT READY");
+    emit(binaryProtocol ? "EVENT READY protocol=binary" : "EVENT READY");
 
     // Optional: auto-load plugin if path is passed as first two arguments (trackId and path)
-    if (argc > 2) {
-        juce::String trackId = juce::String(argv[1]);
-        juce::String pathArg = juce::String(argv[2]);
+    if (positional.size() > 1) {
+        juce::String trackId = positional[0];
+        juce::String pathArg = positional[1];
         juce::String err;
         ctx.host.loadPlugin(trackId, juce::File(pathArg), err);
         if (err.isNotEmpty()) emit("ERROR LOAD " + trackId + " " + err);
     }
 
     // Run stdin reading on a separate thread so the main thread can run the message loop
-    std::thread stdinThread([&ctx]() {
-        std::string line;
-        while (ctx.running && std::getline(std::cin, line)) {
-            // Post command handling to message thread for thread safety
-            juce::MessageManager::callAsync([&ctx, cmd = juce::String(line)]() {
-                handleCommand(cmd, ctx);
-            });
+    std::thread stdinThread([&ctx, binaryProtocol]() {
+        if (binaryProtocol) {
+            readBinaryCommands(ctx);
+        } else {
+            std::string line;
+            while (ctx.running && std::getline(std::cin, line)) {
+                // Post command handling to message thread for thread safety
+                juce::MessageManager::callAsync([&ctx, cmd = juce::String(line)]() {
+                    handleCommand(cmd, ctx);
+                });
+            }
         }
         // When stdin closes (parent process exits), stop gracefully
         juce::MessageManager::callAsync([&ctx]() {
@@ -520,7 +1542,10 @@ int main(int argc, char* argv[]) {
         stdinThread.join();
     }
 
+    ctx.host.cancelRender();
+    ctx.renderQueue.removeAllJobs(true, 10000);
     ctx.host.allNotesOff();
     emit("EVENT EXIT");
+    EventOutput::shutdown();
     return 0;
 }
@@ -0,0 +1,328 @@
+#include "MasterMixer.h"
+
+#include <algorithm>
+#include <cmath>
+
+MasterMixer::MasterMixer() {
+    prepareBuffers(currentBlockSize.load());
+}
+
+MasterMixer::~MasterMixer() {
+    const juce::ScopedLock sl(structureLock);
+    for (auto& channel : channels) {
+        channel.sources.fill(nullptr);
+        channel.automation = nullptr;
+    }
+    workers.reset();
+}
+
+int MasterMixer::allocateChannel() {
+    for (int i = 0; i < maxChannels; ++i) {
+        auto& channel = channels[(size_t)i];
+        if (channel.inUse) continue;
+
+        channel.inUse = true;
+        channel.gain = 1.0f;
+        channel.muted = false;
+        channel.soloed = false;
+        for (auto& timing : channel.sourceTiming) timing.read(true); // the previous track's figures
+        if (i + 1 > numChannelsInUse.load()) {
+            numChannelsInUse = i + 1;
+        }
+        return i;
+    }
+    return -1;
+}
+
+void MasterMixer::releaseChannel(int handle) {
+    if (!isValidHandle(handle)) return;
+
+    auto& channel = channels[(size_t)handle];
+    {
+        const juce::ScopedLock sl(structureLock);
+        channel.sources.fill(nullptr);
+        channel.automation = nullptr;
+
+        // The audio thread's ramp state, so the slot's next track doesn't start from this one's
+        // gain or mute level (safe to write: the callback holds the lock while it mixes)
+        channel.lastAppliedGain = 1.0f;
+        channel.lastAudibleLevel = 1.0f;
+        channel.automated = false;
+        channel.automatedGainEnd = 1.0f;
+    }
+    channel.inUse = false;
+    channel.soloed = false;
+
+    int highest = 0;
+    for (int i = 0; i < maxChannels; ++i) {
+        if (channels[(size_t)i].inUse) highest = i + 1;
+    }
+    numChannelsInUse = highest;
+}
+
+void MasterMixer::setSource(int handle, SourceSlot slot, MixerSource* source) {
+    if (!isValidHandle(handle)) return;
+
+    // Prepare outside the lock so a slow prepareToPlay never stalls the audio thread
+    if (source) {
+        source->prepare(currentRate.load(), currentBlockSize.load());
+    }
+
+    const juce::ScopedLock sl(structureLock);
+    channels[(size_t)handle].sources[(size_t)slot] = source;
+}
+
+void MasterMixer::setChannelGain(int handle, float gainLinear) {
+    if (!isValidHandle(handle)) return;
+    channels[(size_t)handle].gain = juce::jmax(0.0f, gainLinear);
+}
+
+void MasterMixer::setChannelMute(int handle, bool shouldBeMuted) {
+    if (!isValidHandle(handle)) return;
+    channels[(size_t)handle].muted = shouldBeMuted;
+}
+
+void MasterMixer::setChannelSolo(int handle, bool shouldBeSoloed) {
+    if (!isValidHandle(handle)) return;
+    channels[(size_t)handle].soloed = shouldBeSoloed;
+}
+
+void MasterMixer::setChannelAutomation(int handle, const TrackAutomation* automation) {
+    if (!isValidHandle(handle)) return;
+    const juce::ScopedLock sl(structureLock);
+    channels[(size_t)handle].automation = automation;
+}
+
+void MasterMixer::startAutomation(juce::int64 originSample) {
+    automationOrigin.store(originSample, std::memory_order_relaxed);
+    automationPlaying.store(true, std::memory_order_release);
+}
+
+void MasterMixer::stopAutomation() {
+    automationPlaying.store(false, std::memory_order_release);
+}
+
+TimingStats* MasterMixer::getSourceTiming(int handle, SourceSlot slot) {
+    if (!isValidHandle(handle)) return nullptr;
+    return &channels[(size_t)handle].sourceTiming[(size_t)slot];
+}
+
+float MasterMixer::getChannelGain(int handle) const {
+    if (!isValidHandle(handle)) return 1.0f;
+    return channels[(size_t)handle].gain.load();
+}
+
+bool MasterMixer::isChannelMuted(int handle) const {
+    return isValidHandle(handle) && channels[(size_t)handle].muted.load();
+}
+
+bool MasterMixer::isChannelSoloed(int handle) const {
+    return isValidHandle(handle) && channels[(size_t)handle].soloed.load();
+}
+
+void MasterMixer::prepareBuffers(int blockSize) {
+    blockSize = juce::jmax(1, blockSize);
+    for (auto& channel : channels) {
+        channel.bus.setSize(busChannels, blockSize, false, false, true);
+        channel.scratch.setSize(busChannels, blockSize, false, false, true);
+        channel.mixGains.setSize(busChannels, blockSize, false, false, true);
+        channel.lastAppliedGain = channel.gain.load();
+    }
+    masterBus.setSize(busChannels, blockSize, false, false, true);
+}
+
+void MasterMixer::audioDeviceAboutToStart(juce::AudioIODevice* device) {
+    const double rate = device ? device->getCurrentSampleRate() : 44100.0;
+    const int blockSize = device ? device->getCurrentBufferSizeSamples() : 512;
+
+    const juce::ScopedLock sl(structureLock);
+    const double previousRate = currentRate.load();
+    const bool rateChanged = previousRate != rate;
+    if (rateChanged && previousRate > 0.0 && rate > 0.0) {
+        // The clock counts device samples: rescale it (and the automation origin) so engine time
+        // in milliseconds carries on across a device change
+        const double scale = rate / previousRate;
+        sampleClock = (juce::int64)std::llround((double)sampleClock.load() * scale);
+        automationOrigin = (juce::int64)std::llround((double)automationOrigin.load() * scale);
+    }
+    currentRate = rate;
+    currentBlockSize = blockSize;
+    prepareBuffers(blockSize);
+
+    if (workers == nullptr && AudioWorkerPool::defaultNumWorkers() > 0) {
+        workers = std::make_unique<AudioWorkerPool>();
+        numWorkerThreads = workers->getNumWorkers();
+    }
+
+    for (auto& channel : channels) {
+        for (auto* source : channel.sources) {
+            if (source) source->prepare(rate, blockSize);
+        }
+    }
+    if (rateChanged && onSampleRateChanged) onSampleRateChanged(rate);
+}
+
+void MasterMixer::audioDeviceStopped() {
+    const juce::ScopedLock sl(structureLock);
+    for (auto& channel : channels) {
+        for (auto* source : channel.sources) {
+            if (source) source->release();
+        }
+    }
+}
+
+void MasterMixer::renderChannel(Channel& channel, int numSamples, juce::int64 blockStart) {
+    const auto renderStart = juce::Time::getHighResolutionTicks();
+
+    // Timeline position of the chunk's first sample, if automation is playing
+    const TrackAutomation* automation =
+        automationPlaying.load(std::memory_order_acquire) ? channel.automation : nullptr;
+    const double rate = currentRate.load(std::memory_order_relaxed);
+    const double seconds = (double)(blockStart - automationOrigin.load(std::memory_order_relaxed)) / rate;
+
+    channel.bus.clear(0, numSamples);
+    for (size_t slot = 0; slot < channel.sources.size(); ++slot) {
+        auto* source = channel.sources[slot];
+        if (!source) continue;
+        if (automation != nullptr && !automation->parameters.empty()) source->applyParameterAutomation(*automation, seconds);
+
+        juce::AudioBuffer<float> scratch(channel.scratch.getArrayOfWritePointers(), busChannels, numSamples);
+        scratch.clear();
+        {
+            const ScopedTiming timing(channel.sourceTiming[slot]);
+            source->render(scratch, numSamples, blockStart);
+        }
+        for (int ch = 0; ch < busChannels; ++ch) {
+            channel.bus.addFrom(ch, 0, scratch, ch, 0, numSamples);
+        }
+    }
+
+    channel.automated = automation != nullptr && automation->hasMixLanes();
+    if (channel.automated) {
+        channel.automatedGainEnd = automation->renderMixGains(channel.mixGains.getWritePointer(0),
+                                                              channel.mixGains.getWritePointer(1), numSamples, seconds,
+                                                              rate, channel.gain.load(std::memory_order_relaxed));
+    }
+    channel.lastRenderTicks = juce::Time::getHighResolutionTicks() - renderStart;
+}
+
+void MasterMixer::renderListedChannel(void* context, int listIndex) {
+    auto& mixer = *static_cast<MasterMixer*>(context);
+    auto& channel = mixer.channels[(size_t)mixer.renderList[(size_t)listIndex]];
+    mixer.renderChannel(channel, mixer.chunkSamples, mixer.chunkStart);
+}
+
+void MasterMixer::renderChunk(int numSamples, juce::int64 blockStart) {
+    const int activeChannels = numChannelsInUse.load();
+
+    bool anySoloed = false;
+    renderListSize = 0;
+    for (int i = 0; i < activeChannels; ++i) {
+        const auto& channel = channels[(size_t)i];
+        if (channel.soloed.load(std::memory_order_relaxed)) anySoloed = true;
+        if (std::any_of(channel.sources.begin(), channel.sources.end(), [](MixerSource* s) { return s != nullptr; })) {
+            renderList[(size_t)renderListSize++] = i;
+        }
+    }
+
+    // Every channel renders into its own bus, so they are independent: spread them over the
+    // workers, slowest (as of the previous chunk) first so the long ones don't start last
+    chunkSamples = numSamples;
+    chunkStart = blockStart;
+    if (workers != nullptr && renderListSize >= minParallelChannels) {
+        std::sort(renderList.begin(), renderList.begin() + renderListSize, [this](int a, int b) {
+            return channels[(size_t)a].lastRenderTicks > channels[(size_t)b].lastRenderTicks;
+        });
+        workers->run(renderListSize, &MasterMixer::renderListedChannel, this);
+    } else {
+        for (int i = 0; i < renderListSize; ++i) renderListedChannel(this, i);
+    }
+
+    // The sum runs in channel order whichever thread rendered what, so the mix is deterministic
+    const auto mixStart = juce::Time::getHighResolutionTicks();
+    for (int i = 0; i < activeChannels; ++i) {
+        auto& channel = channels[(size_t)i];
+        if (std::none_of(channel.sources.begin(), channel.sources.end(), [](MixerSource* s) { return s != nullptr; })) {
+            continue;
+        }
+
+        // Sources keep rendering while muted so voices and plugin tails stay in sync
+        const bool audible = !channel.muted.load(std::memory_order_relaxed)
+                             && (!anySoloed || channel.soloed.load(std::memory_order_relaxed));
+        const float startLevel = channel.lastAudibleLevel;
+        const float targetLevel = audible ? 1.0f : 0.0f;
+        channel.lastAudibleLevel = targetLevel;
+
+        // Automated: per-sample gains from the lanes, with mute and solo ramped on top
+        if (channel.automated) {
+            channel.lastAppliedGain = targetLevel * channel.automatedGainEnd;
+            if (startLevel == 0.0f && targetLevel == 0.0f) continue;
+            for (int ch = 0; ch < busChannels; ++ch) {
+                if (startLevel != 1.0f || targetLevel != 1.0f) {
+                    channel.mixGains.applyGainRamp(ch, 0, numSamples, startLevel, targetLevel);
+                }
+                juce::FloatVectorOperations::addWithMultiply(masterBus.getWritePointer(ch), channel.bus.getReadPointer(ch),
+                                                             channel.mixGains.getReadPointer(ch), numSamples);
+            }
+            continue;
+        }
+
+        const float targetGain = audible ? channel.gain.load(std::memory_order_relaxed) : 0.0f;
+        const float startGain = channel.lastAppliedGain;
+        channel.lastAppliedGain = targetGain;
+
+        if (startGain != 0.0f || targetGain != 0.0f) {
+            for (int ch = 0; ch < busChannels; ++ch) {
+                masterBus.addFromWithRamp(ch, 0, channel.bus.getReadPointer(ch), numSamples, startGain, targetGain);
+            }
+        }
+    }
+    mixTiming.record(juce::Time::highResolutionTicksToSeconds(juce::Time::getHighResolutionTicks() - mixStart) * 1.0e6);
+}
+
+void MasterMixer::audioDeviceIOCallbackWithContext(const float* const* /*inputChannelData*/,
+                                                   int /*numInputChannels*/,
+                                                   float* const* outputChannelData,
+                                                   int numOutputChannels,
+                                                   int numSamples,
+                                                   const juce::AudioIODeviceCallbackContext& /*context*/) {
+    if (!outputChannelData || numSamples <= 0 || numOutputChannels <= 0) return;
+
+    const auto callbackStart = juce::Time::getHighResolutionTicks();
+    {
+        const juce::ScopedLock sl(structureLock);
+
+        // Devices may deliver blocks larger than announced; render in chunks that fit the buses
+        const int maxChunk = masterBus.getNumSamples();
+        for (int start = 0; start < numSamples; start += maxChunk) {
+            const int chunk = juce::jmin(maxChunk, numSamples - start);
+            masterBus.clear(0, chunk);
+
+            const juce::int64 blockStart = sampleClock.load(std::memory_order_relaxed);
+            renderChunk(chunk, blockStart);
+            sampleClock.store(blockStart + chunk, std::memory_order_release);
+
+            if (numOutputChannels == 1) {
+                if (outputChannelData[0]) {
+                    juce::FloatVectorOperations::copy(outputChannelData[0] + start, masterBus.getReadPointer(0), chunk);
+                    juce::FloatVectorOperations::add(outputChannelData[0] + start, masterBus.getReadPointer(1), chunk);
+                    juce::FloatVectorOperations::multiply(outputChannelData[0] + start, 0.5f, chunk);
+                }
+            } else {
+                for (int ch = 0; ch < numOutputChannels; ++ch) {
+                    if (!outputChannelData[ch]) continue;
+                    if (ch < busChannels) {
+                        juce::FloatVectorOperations::copy(outputChannelData[ch] + start, masterBus.getReadPointer(ch), chunk);
+                    } else {
+                        juce::FloatVectorOperations::clear(outputChannelData[ch] + start, chunk);
+                    }
+                }
+            }
+        }
+    }
+
+    const double micros = juce::Time::highResolutionTicksToSeconds(juce::Time::getHighResolutionTicks() - callbackStart) * 1.0e6;
+    callbackTiming.record(micros);
+    const double rate = currentRate.load(std::memory_order_relaxed);
+    if (rate > 0.0 && micros > numSamples * 1.0e6 / rate) overruns.fetch_add(1, std::memory_order_relaxed);
+}
@@ -0,0 +1,174 @@
+#pragma once
+
+#include "AudioTelemetry.h"
+#include "AudioWorkerPool.h"
+#include "Automation.h"
+#include <juce_audio_devices/juce_audio_devices.h>
+#include <array>
+#include <atomic>
+#include <functional>
+#include <memory>
+
+// Audio source rendered by the master mixer (plugin, SF2, beat, sampler or clip engine).
+// render() is only ever called from the audio thread; prepare()/release() are called
+// from the device thread on start/stop or from the message thread before the source
+// is installed on a channel.
+class MixerSource {
+public:
+    virtual ~MixerSource() = default;
+
+    virtual void prepare(double sampleRate, int maxBlockSize) = 0;
+    virtual void release() {}
+
+    // Render numSamples into a cleared stereo bus. blockStart is the engine sample time of the
+    // first sample, used to place scheduled events at their exact offset within the block.
+    virtual void render(juce::AudioBuffer<float>& bus, int numSamples, juce::int64 blockStart) = 0;
+
+    // Audio thread, just before render() while automation plays: sources with parameters (plugins)
+    // set the automated ones to their values at timeline time seconds
+    virtual void applyParameterAutomation(const TrackAutomation& /*automation*/, double /*seconds*/) {}
+
+    // Telemetry, any thread: as published by the audio thread after its latest render()
+    virtual int getActiveVoices() const { return 0; }
+    virtual int getQueueDepth() const { return 0; }
+    virtual bool isAsleep() const { return false; } // skipping its processing while idle
+};
+
+// Single device callback that renders every track source into its own preallocated bus
+// and sums the buses into the device output. Gain, mute and solo are plain atomics so
+// the message thread can change them without touching tracksLock or the structure lock.
+// While automation plays, a channel's gain and pan lanes are evaluated per sample instead.
+// Channels render in parallel on an AudioWorkerPool (started with the device) when enough of
+// them are active; the buses are then summed in channel order on the device thread.
+class MasterMixer : public juce::AudioIODeviceCallback {
+public:
+    static constexpr int maxChannels = 128;
+    static constexpr int busChannels = 2;
+
+    // Fewer active channels than this render on the device thread alone: waking workers would
+    // cost more than it saves
+    static constexpr int minParallelChannels = 2;
+
+    // Each mixer channel (one per track) can host one source of each kind
+    enum SourceSlot {
+        instrumentSlot = 0, // VST3 plugin or SF2
+        beatSlot,
+        samplerSlot,
+        clipSlot,           // timeline audio clips
+        numSourceSlots
+    };
+
+    MasterMixer();
+    ~MasterMixer() override;
+
+    // Returns a free channel handle, or -1 when all channels are in use
+    int allocateChannel();
+    void releaseChannel(int handle);
+
+    // Installs (or removes when source is nullptr) a source on a channel. The source is
+    // prepared with the current device settings before it becomes visible to the audio
+    // thread. Once this returns the previous source is no longer referenced and may be freed.
+    void setSource(int handle, SourceSlot slot, MixerSource* source);
+
+    void setChannelGain(int handle, float gainLinear);
+    void setChannelMute(int handle, bool shouldBeMuted);
+    void setChannelSolo(int handle, bool shouldBeSoloed);
+    float getChannelGain(int handle) const;
+    bool isChannelMuted(int handle) const;
+    bool isChannelSoloed(int handle) const;
+
+    // Installs (or removes) a channel's automation, swapped in like a source: once this returns
+    // the previous one is no longer referenced
+    void setChannelAutomation(int handle, const TrackAutomation* automation);
+
+    // Automation follows the timeline from engine time originSample (timeline 0) on, until
+    // stopped; meanwhile channels keep their static gain and parameters aren't touched
+    void startAutomation(juce::int64 originSample);
+    void stopAutomation();
+
+    // Called from audioDeviceAboutToStart (never the audio thread) when the device starts at a
+    // rate other than the previous one. Set it before the mixer is added to a device.
+    std::function<void(double sampleRate)> onSampleRateChanged;
+
+    double getCurrentSampleRate() const { return currentRate.load(); }
+    int getCurrentBlockSize() const { return currentBlockSize.load(); }
+
+    // Engine time in samples at the device rate: the start of the next block to be rendered.
+    // Scheduled events are stamped in this clock; a device restarting at another rate rescales it.
+    juce::int64 getSampleClock() const { return sampleClock.load(); }
+
+    // Audio thread timing for STATS (any thread). Callback timing covers the whole device
+    // callback, mix timing the summing of the track buses and source timing one source's render();
+    // an overrun is a callback that took longer than the audio it rendered.
+    TimingStats& getCallbackTiming() { return callbackTiming; }
+    TimingStats& getMixTiming() { return mixTiming; }
+    TimingStats* getSourceTiming(int handle, SourceSlot slot);
+    juce::int64 getOverrunCount() const { return overruns.load(); }
+
+    // Worker threads channels are spread over (0 until the device has started, or when
+    // the machine has too few cores)
+    int getNumWorkerThreads() const { return numWorkerThreads.load(); }
+
+    void audioDeviceIOCallbackWithContext(const float* const* inputChannelData,
+                                          int numInputChannels,
+                                          float* const* outputChannelData,
+                                          int numOutputChannels,
+                                          int numSamples,
+                                          const juce::AudioIODeviceCallbackContext& context) override;
+    void audioDeviceAboutToStart(juce::AudioIODevice* device) override;
+    void audioDeviceStopped() override;
+
+private:
+    struct Channel {
+        std::array<MixerSource*, numSourceSlots> sources {};
+        const TrackAutomation* automation = nullptr; // like sources, under the structure lock
+        juce::AudioBuffer<float> bus;
+        juce::AudioBuffer<float> scratch; // one source's block, so channels can render concurrently
+        juce::AudioBuffer<float> mixGains; // per-sample left/right gains of an automated block
+        bool automated = false;            // audio thread: mixGains holds this chunk's gains
+        float automatedGainEnd = 1.0f;     // the gain lane's value at the end of the chunk
+        float lastAudibleLevel = 1.0f;     // audio thread, mute/solo ramp of automated chunks
+        std::atomic<float> gain { 1.0f };
+        std::atomic<bool> muted { false };
+        std::atomic<bool> soloed { false };
+        float lastAppliedGain = 1.0f; // audio thread (reset under the structure lock), used for gain ramps
+        std::array<TimingStats, numSourceSlots> sourceTiming;
+        juce::int64 lastRenderTicks = 0; // audio thread, used to start the slowest channels first
+        bool inUse = false;           // message thread only
+    };
+
+    bool isValidHandle(int handle) const { return handle >= 0 && handle < maxChannels; }
+    void prepareBuffers(int blockSize);
+    void renderChunk(int numSamples, juce::int64 blockStart);
+    void renderChannel(Channel& channel, int numSamples, juce::int64 blockStart);
+    static void renderListedChannel(void* mixer, int listIndex);
+
+    std::array<Channel, maxChannels> channels;
+    juce::AudioBuffer<float> masterBus;
+
+    // Audio thread: the channels with a source in the chunk being rendered, slowest first
+    std::array<int, maxChannels> renderList {};
+    int renderListSize = 0;
+    int chunkSamples = 0;
+    juce::int64 chunkStart = 0;
+
+    std::unique_ptr<AudioWorkerPool> workers; // created on the first device start
+    std::atomic<int> numWorkerThreads { 0 };
+
+    // Guards channel source pointers. The message thread only holds it to swap a pointer;
+    // the audio thread holds it for the duration of a callback (like AudioDeviceManager does).
+    juce::CriticalSection structureLock;
+
+    std::atomic<int> numChannelsInUse { 0 }; // highest in-use handle + 1
+    std::atomic<double> currentRate { 44100.0 };
+    std::atomic<int> currentBlockSize { 512 };
+    std::atomic<juce::int64> sampleClock { 0 }; // only advanced by the audio thread
+    std::atomic<juce::int64> automationOrigin { 0 };
+    std::atomic<bool> automationPlaying { false };
+
+    TimingStats callbackTiming;
+    TimingStats mixTiming;
+    std::atomic<juce::int64> overruns { 0 };
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(MasterMixer)
+};
@@ -0,0 +1,619 @@
+#include "OfflineRender.h"
+#include "../TinySoundFont/tsf.h"
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+namespace OfflineRender {
+
+namespace {
+
+// Source frames kept either side of a streamed clip window: covers the widest sinc kernel
+constexpr int clipWindowMargin = 160;
+
+// Size of the ThreadedWriter FIFO in frames (a few seconds of audio)
+constexpr int writerFifoFrames = 1 << 18;
+
+// Headerless interleaved 32-bit float frames (RenderOptions::OutputFormat::rawFloat)
+class RawFloatWriter : public juce::AudioFormatWriter {
+public:
+    RawFloatWriter(juce::OutputStream* out, double rate, unsigned int channels)
+        : juce::AudioFormatWriter(out, "Raw float", rate, channels, 32) {
+        usesFloatingPointData = true;
+    }
+
+    bool write(const int** samplesToWrite, int numSamples) override {
+        interleaved.resize((size_t)numSamples * numChannels);
+        for (unsigned int ch = 0; ch < numChannels; ++ch) {
+            const auto* channel = reinterpret_cast<const float*>(samplesToWrite[ch]);
+            for (int i = 0; i < numSamples; ++i) {
+                interleaved[(size_t)i * numChannels + ch] = channel != nullptr ? channel[i] : 0.0f;
+            }
+        }
+        return output->write(interleaved.data(), interleaved.size() * sizeof(float));
+    }
+
+private:
+    std::vector<float> interleaved;
+};
+
+// The encoder's quality option closest to kbps ("192 kbps", "CBR 192 kbps", ...)
+int findQualityIndex(const juce::StringArray& options, int kbps) {
+    int best = 0;
+    int bestDistance = std::numeric_limits<int>::max();
+    for (int i = 0; i < options.size(); ++i) {
+        if (!options[i].containsIgnoreCase("kbps")) continue;
+        const int rate = options[i].upToFirstOccurrenceOf("kbps", false, true).trim().getTrailingIntValue();
+        if (std::abs(rate - kbps) < bestDistance) {
+            best = i;
+            bestDistance = std::abs(rate - kbps);
+        }
+    }
+    return best;
+}
+
+#if JUCE_USE_LAME_AUDIO_FORMAT
+// The lame executable next to the backend, or the first one on the PATH
+juce::File findLameEncoder() {
+   #if JUCE_WINDOWS
+    const juce::String name = "lame.exe", pathSeparator = ";";
+   #else
+    const juce::String name = "lame", pathSeparator = ":";
+   #endif
+    const auto bundled = juce::File::getSpecialLocation(juce::File::currentExecutableFile).getSiblingFile(name);
+    if (bundled.existsAsFile()) return bundled;
+
+    juce::StringArray path;
+    path.addTokens(juce::SystemStats::getEnvironmentVariable("PATH", {}), pathSeparator, {});
+    for (const auto& directory : path) {
+        const auto candidate = juce::File::createFileWithoutCheckingPath(directory).getChildFile(name);
+        if (directory.isNotEmpty() && candidate.existsAsFile()) return candidate;
+    }
+    return {};
+}
+#endif
+
+// A writer for format on stream (not yet owned), or nullptr with errorMessage
+std::unique_ptr<juce::AudioFormatWriter> createFormatWriter(juce::OutputStream* stream, RenderOptions::OutputFormat format,
+                                                            double sampleRate, int numChannels, int bitDepth,
+                                                            int bitRateKbps, juce::String& errorMessage) {
+    using Format = RenderOptions::OutputFormat;
+    const auto channels = (unsigned int)numChannels;
+    std::unique_ptr<juce::AudioFormatWriter> writer;
+
+    switch (format) {
+        case Format::rawFloat:
+            return std::make_unique<RawFloatWriter>(stream, sampleRate, channels);
+        case Format::wav: {
+            juce::WavAudioFormat wavFormat;
+            writer.reset(wavFormat.createWriterFor(stream, sampleRate, channels, bitDepth, {}, 0));
+            break;
+        }
+        case Format::flac: {
+            juce::FlacAudioFormat flacFormat;
+            writer.reset(flacFormat.createWriterFor(stream, sampleRate, channels, bitDepth >= 24 ? 24 : 16, {}, 0));
+            break;
+        }
+        case Format::ogg: {
+            juce::OggVorbisAudioFormat oggFormat;
+            writer.reset(oggFormat.createWriterFor(stream, sampleRate, channels, 16, {},
+                                                   findQualityIndex(oggFormat.getQualityOptions(), bitRateKbps)));
+            break;
+        }
+        case Format::mp3: {
+           #if JUCE_USE_LAME_AUDIO_FORMAT
+            const juce::File lame = findLameEncoder();
+            if (lame == juce::File()) {
+                errorMessage = "MP3 export needs the LAME encoder (lame) next to the backend or on the PATH";
+                return {};
+            }
+            juce::LAMEEncoderAudioFormat mp3Format(lame);
+            writer.reset(mp3Format.createWriterFor(stream, sampleRate, channels, 16, {},
+                                                   findQualityIndex(mp3Format.getQualityOptions(), bitRateKbps)));
+            break;
+           #else
+            errorMessage = "MP3 export is not available in this build";
+            return {};
+           #endif
+        }
+    }
+
+    if (!writer) errorMessage = "Failed to create " + RenderOptions::getFileExtension(format).substring(1).toUpperCase() + " writer";
+    return writer;
+}
+
+} // namespace
+
+//==============================================================================
+PluginRenderer::PluginRenderer(juce::AudioPluginInstance& pluginToUse, const std::vector<MidiNoteEvent>& notes,
+                               double renderRate, juce::int64 totalSamples, const TrackAutomation* trackAutomation)
+    : plugin(pluginToUse), sampleRate(renderRate), automation(trackAutomation) {
+    if (automation != nullptr && automation->parameters.empty()) automation = nullptr;
+
+    const juce::int64 lastSample = juce::jmax<juce::int64>(0, totalSamples - 1);
+
+    // Build MIDI message timeline
+    for (const auto& note : notes) {
+        const auto samplePos = juce::jlimit<juce::int64>(0, lastSample, (juce::int64)(note.startTimeSeconds * sampleRate));
+        const auto noteOffPos = juce::jlimit<juce::int64>(0, lastSample, (juce::int64)((note.startTimeSeconds + note.durationSeconds) * sampleRate));
+        const float velocity = juce::jlimit(0.0f, 1.0f, note.velocity01);
+
+        timeline.push_back({samplePos, juce::MidiMessage::noteOn(note.channel, note.midiNote, velocity)});
+        timeline.push_back({noteOffPos, juce::MidiMessage::noteOff(note.channel, note.midiNote)});
+    }
+    std::stable_sort(timeline.begin(), timeline.end(),
+                     [](const auto& a, const auto& b) { return a.first < b.first; });
+
+    // Prepare plugin for rendering
+    plugin.prepareToPlay(sampleRate, blockSize);
+    plugin.setNonRealtime(true); // Enable offline rendering mode
+}
+
+void PluginRenderer::renderChunk(juce::AudioBuffer<float>& buffer, juce::int64 chunkStart, int numSamples) {
+    for (int offset = 0; offset < numSamples; offset += blockSize) {
+        const int samplesThisBlock = juce::jmin(blockSize, numSamples - offset);
+        const juce::int64 blockStart = chunkStart + offset;
+
+        // Add MIDI messages that occur in this block at their position within it
+        midiBuffer.clear();
+        while (nextEvent < timeline.size() && timeline[nextEvent].first < blockStart + samplesThisBlock) {
+            const auto& [samplePos, msg] = timeline[nextEvent];
+            midiBuffer.addEvent(msg, (int)juce::jmax<juce::int64>(0, samplePos - blockStart));
+            ++nextEvent;
+        }
+
+        if (automation != nullptr) automation->applyParameters(plugin, (double)blockStart / sampleRate);
+
+        // Process a slice of the chunk in place
+        juce::AudioBuffer<float> blockBuffer(buffer.getArrayOfWritePointers(), buffer.getNumChannels(),
+                                             offset, samplesThisBlock);
+        plugin.processBlock(blockBuffer, midiBuffer);
+    }
+}
+
+void PluginRenderer::finish() {
+    plugin.setNonRealtime(false);
+    plugin.releaseResources();
+}
+
+//==============================================================================
+SF2Renderer::SF2Renderer(tsf* sf, const std::vector<MidiNoteEvent>& notes, double sampleRate, juce::int64 totalSamples,
+                         int limit, SoundFontBank::VoiceStealing stealing)
+    : soundFont(sf), planar((size_t)blockSize * 2), voiceLimit(limit), voiceStealing(stealing) {
+    tsf_set_output(soundFont, TSF_STEREO_UNWEAVED, (int)sampleRate, 0.0f);
+
+    const juce::int64 lastSample = juce::jmax<juce::int64>(0, totalSamples - 1);
+    for (const auto& note : notes) {
+        const auto samplePos = juce::jlimit<juce::int64>(0, lastSample, (juce::int64)(note.startTimeSeconds * sampleRate));
+        const auto noteOffPos = juce::jlimit<juce::int64>(0, lastSample, (juce::int64)((note.startTimeSeconds + note.durationSeconds) * sampleRate));
+        const float velocity = juce::jlimit(0.0f, 1.0f, note.velocity01);
+        timeline.push_back({samplePos, true, note.midiNote, velocity, note.channel});
+        timeline.push_back({noteOffPos, false, note.midiNote, velocity, note.channel});
+    }
+    std::stable_sort(timeline.begin(), timeline.end(),
+                     [](const Event& a, const Event& b) { return a.samplePos < b.samplePos; });
+
+    // Fire any events at time 0
+    dispatchEventsUpTo(0);
+}
+
+void SF2Renderer::dispatchEventsUpTo(juce::int64 samplePos) {
+    while (nextEvent < timeline.size() && timeline[nextEvent].samplePos <= samplePos) {
+        const auto& ev = timeline[nextEvent];
+        const int tsfChannel = juce::jlimit(0, 15, ev.channel - 1);
+        if (ev.noteOn) {
+            tsf_channel_note_on(soundFont, tsfChannel, ev.midiNote, ev.velocity);
+            SoundFontBank::enforceVoiceLimit(soundFont, voiceLimit, voiceStealing);
+        } else {
+            tsf_channel_note_off(soundFont, tsfChannel, ev.midiNote);
+        }
+        ++nextEvent;
+    }
+}
+
+void SF2Renderer::renderChunk(juce::AudioBuffer<float>& buffer, juce::int64 chunkStart, int numSamples) {
+    // Notes still held at the start of a range render begin with its first chunk
+    dispatchEventsUpTo(chunkStart);
+
+    int offset = 0;
+    while (offset < numSamples) {
+        const juce::int64 position = chunkStart + offset;
+
+        // Render up to the next event so it starts on its exact sample
+        const juce::int64 untilNext = nextEvent < timeline.size()
+                                          ? juce::jmax<juce::int64>(1, timeline[nextEvent].samplePos - position)
+                                          : (juce::int64)blockSize;
+        const int samplesThisBlock = (int)juce::jmin<juce::int64>(untilNext, juce::jmin(blockSize, numSamples - offset));
+
+        // Unweaved: the left block, then the right block
+        tsf_render_float(soundFont, planar.data(), samplesThisBlock, 0);
+        juce::FloatVectorOperations::copy(buffer.getWritePointer(0, offset), planar.data(), samplesThisBlock);
+        juce::FloatVectorOperations::copy(buffer.getWritePointer(1, offset), planar.data() + samplesThisBlock,
+                                          samplesThisBlock);
+
+        offset += samplesThisBlock;
+
+        // Dispatch any events scheduled at or before the new time
+        dispatchEventsUpTo(chunkStart + offset);
+    }
+}
+
+//==============================================================================
+void SampleRenderer::setVoiceBudget(int limit, SoundFontBank::VoiceStealing policy, double sampleRate) {
+    enveloped = true;
+    voiceLimit = juce::jlimit(1, SamplerVoices::maxVoices, limit);
+    voiceStealing = policy;
+    envelopeRate = sampleRate;
+    voices.reserve((size_t)SamplerVoices::poolSize);
+}
+
+void SampleRenderer::addShot(std::shared_ptr<const BeatSample> sample, juce::int64 startSample, double ratio,
+                             float gain, juce::int64 maxFrames) {
+    jassert(!sorted);
+    if (sample == nullptr || sample->getNumSamples() == 0) return;
+    shots.push_back({std::move(sample), juce::jmax<juce::int64>(0, startSample), ratio, gain, maxFrames});
+}
+
+void SampleRenderer::renderChunk(juce::AudioBuffer<float>& buffer, juce::int64 chunkStart, int numSamples) {
+    if (!sorted) {
+        std::stable_sort(shots.begin(), shots.end(),
+                         [](const Shot& a, const Shot& b) { return a.startSample < b.startSample; });
+        sorted = true;
+    }
+    if (enveloped) {
+        renderEnvelopedChunk(buffer, chunkStart, numSamples);
+        return;
+    }
+
+    const juce::int64 chunkEnd = chunkStart + numSamples;
+    while (nextShot < shots.size() && shots[nextShot].startSample < chunkEnd) {
+        const Shot& shot = shots[nextShot++];
+        Voice voice { &shot, 0.0, shot.maxFrames < 0 ? std::numeric_limits<juce::int64>::max() : shot.maxFrames };
+        if (skipTo(voice, chunkStart)) voices.push_back(voice);
+    }
+
+    for (auto it = voices.begin(); it != voices.end();) {
+        const int offset = (int)juce::jmax<juce::int64>(0, it->shot->startSample - chunkStart);
+        const int frames = (int)juce::jmin<juce::int64>(numSamples - offset, it->framesLeft);
+
+        juce::AudioBuffer<float> view(buffer.getArrayOfWritePointers(), buffer.getNumChannels(), offset, frames);
+        const int written = Resampler::mix(it->shot->sample->getSource(), it->position, it->shot->ratio,
+                                           view.getArrayOfWritePointers(), buffer.getNumChannels(), frames,
+                                           it->shot->gain, quality);
+        it->framesLeft -= frames;
+
+        if (written < frames || it->framesLeft <= 0) it = voices.erase(it);
+        else ++it;
+    }
+}
+
+void SampleRenderer::renderEnvelopedChunk(juce::AudioBuffer<float>& buffer, juce::int64 chunkStart, int numSamples) {
+    if (scratch.getNumChannels() < buffer.getNumChannels() || scratch.getNumSamples() < numSamples) {
+        scratch.setSize(buffer.getNumChannels(), numSamples);
+    }
+
+    // Rendered up to each note-on, so stealing happens on the note's exact sample as it does live
+    int rendered = 0;
+    for (;;) {
+        const int until = nextShot < shots.size()
+                              ? (int)juce::jlimit<juce::int64>(rendered, numSamples, shots[nextShot].startSample - chunkStart)
+                              : numSamples;
+        renderEnvelopedVoices(buffer, rendered, until - rendered);
+        rendered = until;
+        if (rendered >= numSamples) break;
+        startEnvelopedVoice(shots[nextShot++], chunkStart + rendered);
+    }
+}
+
+void SampleRenderer::renderEnvelopedVoices(juce::AudioBuffer<float>& buffer, int startSample, int numFrames) {
+    if (numFrames <= 0) return;
+
+    for (auto it = voices.begin(); it != voices.end();) {
+        bool finished = false;
+        for (int done = 0; done < numFrames;) {
+            if (!it->envelope.isReleasing() && it->framesLeft <= 0) it->envelope.release(envelopeRate);
+
+            const bool held = !it->envelope.isReleasing();
+            const int frames = held ? (int)juce::jmin<juce::int64>(numFrames - done, it->framesLeft) : numFrames - done;
+            const int written = SamplerVoices::mix(it->shot->sample->getSource(), it->position, it->shot->ratio, it->envelope,
+                                                   it->gain, buffer, startSample + done, frames, scratch, quality);
+            if (held) it->framesLeft -= written;
+            done += written;
+
+            if (written < frames || it->envelope.isFinished()) {
+                finished = true;
+                break;
+            }
+        }
+
+        if (finished) it = voices.erase(it);
+        else ++it;
+    }
+}
+
+void SampleRenderer::startEnvelopedVoice(const Shot& shot, juce::int64 timelinePosition) {
+    Voice voice { &shot, 0.0, shot.maxFrames < 0 ? std::numeric_limits<juce::int64>::max() : shot.maxFrames };
+    voice.gain = shot.gain;
+    voice.startOrder = nextStartOrder++;
+    voice.envelope.start(envelopeRate);
+    if (!skipTo(voice, timelinePosition)) return;
+
+    // Same budget as SamplerTrackSource: the policy's victim fades out quickly, or the note is dropped
+    int held = 0;
+    for (const auto& voice : voices) {
+        if (!voice.envelope.isReleasing()) ++held;
+    }
+    if (held >= voiceLimit) {
+        const int victim = SamplerVoices::findVoiceToSteal(voices.data(), (int)voices.size(), voiceStealing);
+        if (victim < 0) return;
+        voices[(size_t)victim].envelope.release(envelopeRate, SamplerVoices::stealSeconds);
+    }
+
+    // Pool full of fading voices: the quietest of them is cut
+    if ((int)voices.size() == SamplerVoices::poolSize) {
+        const int cut = SamplerVoices::findVoiceToCut(voices.data(), (int)voices.size());
+        if (cut < 0) return;
+        voices[(size_t)cut] = voice;
+    } else {
+        voices.push_back(voice);
+    }
+}
+
+bool SampleRenderer::skipTo(Voice& voice, juce::int64 timelinePosition) {
+    const juce::int64 elapsed = timelinePosition - voice.shot->startSample;
+    if (elapsed <= 0) return true;
+    if (voice.framesLeft <= elapsed) return false; // cut or released before the range
+
+    voice.position = (double)elapsed * voice.shot->ratio;
+    voice.framesLeft -= elapsed;
+    voice.envelope.advance((int)juce::jmin<juce::int64>(elapsed, std::numeric_limits<int>::max()));
+    return voice.position < (double)voice.shot->sample->getNumSamples();
+}
+
+//==============================================================================
+void ClipRenderer::setRange(juce::int64 firstSample, juce::int64 endSample) {
+    jassert(clips.empty());
+    rangeFirst = firstSample;
+    rangeEnd = endSample;
+}
+
+juce::int64 ClipRenderer::addClip(const AudioClipRenderEvent& clip, juce::String& errorMessage) {
+    jassert(!sorted);
+    if (!clip.file.existsAsFile()) {
+        errorMessage = "Audio clip missing file " + clip.file.getFullPathName();
+        return -1;
+    }
+
+    const juce::int64 startSample = juce::jmax<juce::int64>(0, (juce::int64)std::floor(clip.startTimeSeconds * sampleRate));
+    auto addCached = [&](std::shared_ptr<const BeatSample> sample) {
+        const juce::int64 length = sample->getNumSamples();
+        if (length <= 0 || sample->sampleRate <= 0.0) return (juce::int64)0;
+        const double ratio = sample->sampleRate / sampleRate;
+        const juce::int64 end = startSample + (juce::int64)std::ceil((double)length / ratio);
+        if (end > rangeFirst && startSample < rangeEnd) {
+            const bool cut = rangeEnd != std::numeric_limits<juce::int64>::max();
+            cachedClips.addShot(std::move(sample), startSample, ratio, clip.gainLinear, cut ? rangeEnd - startSample : -1);
+        }
+        return end;
+    };
+
+    if (auto sample = cache.find(clip.file)) return addCached(std::move(sample));
+
+    std::unique_ptr<juce::AudioFormatReader> reader(formatManager.createReaderFor(clip.file));
+    if (!reader) {
+        errorMessage = "Unsupported audio format for clip " + clip.file.getFullPathName();
+        return -1;
+    }
+    if (reader->lengthInSamples <= 0 || reader->sampleRate <= 0.0) return 0;
+
+    if (cache.shouldCache(SampleCache::bytesFor((int)reader->numChannels, reader->lengthInSamples))
+        || cache.shouldMap(clip.file)) {
+        reader.reset();
+        juce::String loadError;
+        if (auto sample = cache.load(clip.file, loadError)) return addCached(std::move(sample));
+        errorMessage = "Failed to load audio clip " + clip.file.getFullPathName() + ": " + loadError;
+        return -1;
+    }
+
+    const double ratio = reader->sampleRate / sampleRate;
+    const juce::int64 end = startSample + (juce::int64)std::ceil((double)reader->lengthInSamples / ratio);
+    if (end > rangeFirst && startSample < rangeEnd) {
+        clips.push_back({clip.file, startSample, clip.gainLinear, ratio, reader->lengthInSamples, rangeEnd});
+    }
+    return end;
+}
+
+void ClipRenderer::renderChunk(juce::AudioBuffer<float>& buffer, juce::int64 chunkStart, int numSamples) {
+    cachedClips.renderChunk(buffer, chunkStart, numSamples);
+
+    if (!sorted) {
+        std::stable_sort(clips.begin(), clips.end(),
+                         [](const Clip& a, const Clip& b) { return a.startSample < b.startSample; });
+        sorted = true;
+    }
+
+    // Open clips as they start and close them once they run out
+    const juce::int64 chunkEnd = chunkStart + numSamples;
+    while (nextClip < clips.size() && clips[nextClip].startSample < chunkEnd) {
+        const Clip& clip = clips[nextClip++];
+        std::unique_ptr<juce::AudioFormatReader> reader(formatManager.createReaderFor(clip.file));
+        // A clip that started before a range render's first chunk joins part-way through
+        const double position = (double)juce::jmax<juce::int64>(0, chunkStart - clip.startSample) * clip.ratio;
+        if (reader) voices.push_back({&clip, std::move(reader), position});
+    }
+
+    for (auto it = voices.begin(); it != voices.end();) {
+        const Clip& clip = *it->clip;
+        const int offset = (int)juce::jmax<juce::int64>(0, clip.startSample - chunkStart);
+        const int frames = (int)juce::jmin<juce::int64>(numSamples - offset, clip.endSample - (chunkStart + offset));
+        if (frames <= 0) {
+            it = voices.erase(it);
+            continue;
+        }
+
+        // Read the source span these frames touch, plus the kernel's reach. The window stops at the
+        // clip's real end so the last frames come out exactly as from an in-memory buffer.
+        const juce::int64 windowStart = (juce::int64)std::floor(it->position) - clipWindowMargin;
+        const int windowLength = (int)juce::jmin<juce::int64>((juce::int64)std::ceil(frames * clip.ratio) + 2 * clipWindowMargin + 2,
+                                                              clip.sourceLength - windowStart);
+        const int numChannels = (int)it->reader->numChannels;
+        window.setSize(numChannels, windowLength, false, false, true);
+        it->reader->read(&window, 0, windowLength, windowStart, true, true);
+
+        double localPosition = it->position - (double)windowStart;
+        juce::AudioBuffer<float> view(buffer.getArrayOfWritePointers(), buffer.getNumChannels(), offset, frames);
+        const int written = Resampler::mix(window, localPosition, clip.ratio, view.getArrayOfWritePointers(),
+                                           buffer.getNumChannels(), frames, clip.gain, quality);
+        it->position = (double)windowStart + localPosition;
+
+        if (written < frames || chunkStart + offset + frames >= clip.endSample) it = voices.erase(it);
+        else ++it;
+    }
+}
+
+//==============================================================================
+PeakLimiter::PeakLimiter(double sampleRate, int numChannels, float ceilingToUse)
+    : ceiling(ceilingToUse),
+      lookahead(juce::jmax(1, (int)std::round(sampleRate * 0.0015))),
+      releaseCoeff((float)(1.0 - std::exp(-1.0 / (sampleRate * 0.06)))),
+      delay(numChannels, lookahead),
+      minQueue((size_t)lookahead + 1),
+      boxRing((size_t)lookahead, 1.0f),
+      boxSum((double)lookahead) {
+    delay.clear();
+}
+
+void PeakLimiter::process(juce::AudioBuffer<float>& buffer, int numSamples) {
+    const int numChannels = juce::jmin(buffer.getNumChannels(), delay.getNumChannels());
+    const size_t queueCapacity = minQueue.size();
+
+    for (int i = 0; i < numSamples; ++i, ++sampleIndex) {
+        float peak = 0.0f;
+        for (int ch = 0; ch < numChannels; ++ch) {
+            peak = juce::jmax(peak, std::abs(buffer.getSample(ch, i)));
+        }
+        const float required = peak > ceiling ? ceiling / peak : 1.0f;
+
+        // Running minimum of the required gain over the lookahead window
+        while (queueSize > 0 && minQueue[(queueHead + queueSize - 1) % queueCapacity].second >= required) --queueSize;
+        minQueue[(queueHead + queueSize) % queueCapacity] = {sampleIndex, required};
+        ++queueSize;
+        while (minQueue[queueHead].first <= sampleIndex - lookahead) {
+            queueHead = (queueHead + 1) % queueCapacity;
+            --queueSize;
+        }
+        const float windowMin = minQueue[queueHead].second;
+
+        // Instant attack, smooth release; never above the window minimum
+        released = windowMin < released ? windowMin : released + (windowMin - released) * releaseCoeff;
+
+        // Box-average over the same window so the gain ramps down ahead of each peak
+        const size_t boxIndex = (size_t)(sampleIndex % lookahead);
+        boxSum += released - boxRing[boxIndex];
+        boxRing[boxIndex] = released;
+        const float gain = (float)juce::jmin(1.0, boxSum / lookahead);
+
+        // Output the sample from lookahead - 1 frames ago
+        const int delayIndex = (int)(sampleIndex % lookahead);
+        const int oldestIndex = (int)((sampleIndex + 1) % lookahead);
+        for (int ch = 0; ch < numChannels; ++ch) {
+            delay.setSample(ch, delayIndex, buffer.getSample(ch, i));
+            buffer.setSample(ch, i, delay.getSample(ch, oldestIndex) * gain);
+        }
+    }
+}
+
+//==============================================================================
+void StemRenderer::renderChunk(juce::AudioBuffer<float>& buffer, juce::int64 chunkStart, int numSamples) {
+    if (chunkStart >= reader->lengthInSamples) return;
+    reader->read(&buffer, 0, numSamples, chunkStart, true, true);
+}
+
+//==============================================================================
+StemWriter::StemWriter(const juce::File& stemFile, double sampleRate, int numChannels) : temp(stemFile) {
+    stemFile.getParentDirectory().createDirectory();
+    std::unique_ptr<juce::FileOutputStream> outStream(temp.getFile().createOutputStream());
+    if (!outStream) return;
+
+    juce::WavAudioFormat wavFormat;
+    writer.reset(wavFormat.createWriterFor(outStream.get(), sampleRate, (unsigned int)numChannels, 32, {}, 0));
+    if (writer) outStream.release(); // Writer now owns the stream
+}
+
+void StemWriter::write(const juce::AudioBuffer<float>& buffer, int numSamples) {
+    if (writer && !failed) failed = !writer->writeFromAudioSampleBuffer(buffer, 0, numSamples);
+}
+
+bool StemWriter::commit() {
+    if (!writer || failed) return false;
+    writer.reset(); // flushes and closes the file
+    return temp.overwriteTargetFileWithTemporary();
+}
+
+//==============================================================================
+StreamingWriter::StreamingWriter() : thread("Render writer") {}
+
+StreamingWriter::~StreamingWriter() {
+    close();
+}
+
+bool StreamingWriter::open(const juce::File& file, double sampleRate, int numChannels, int bitDepth,
+                           juce::String& errorMessage, RenderOptions::OutputFormat format, int bitRateKbps) {
+    close();
+    file.deleteFile(); // Remove if exists
+
+    std::unique_ptr<juce::FileOutputStream> outStream(file.createOutputStream());
+    if (!outStream) {
+        errorMessage = "Failed to create output file: " + file.getFullPathName();
+        return false;
+    }
+
+    auto fileWriter = createFormatWriter(outStream.get(), format, sampleRate, numChannels, bitDepth, bitRateKbps,
+                                         errorMessage);
+    if (!fileWriter) return false;
+    outStream.release(); // Writer now owns the stream
+
+    thread.startThread();
+    writer = std::make_unique<juce::AudioFormatWriter::ThreadedWriter>(fileWriter.release(), thread, writerFifoFrames);
+    return true;
+}
+
+bool StreamingWriter::write(const juce::AudioBuffer<float>& buffer, int startSample, int numSamples,
+                            const std::atomic<bool>& cancelled) {
+    jassert(writer != nullptr);
+    if (numSamples <= 0) return true;
+
+    const float* channels[8] {};
+    const int numChannels = juce::jmin(8, buffer.getNumChannels());
+    for (int ch = 0; ch < numChannels; ++ch) channels[ch] = buffer.getReadPointer(ch, startSample);
+
+    // Wait for the disk thread to make room
+    while (!writer->write(channels, numSamples)) {
+        if (cancelled.load(std::memory_order_relaxed)) return false;
+        juce::Thread::sleep(1);
+    }
+    return true;
+}
+
+void StreamingWriter::close() {
+    writer.reset(); // Flushes the FIFO, then closes the file
+    thread.stopThread(2000);
+}
+
+//==============================================================================
+RenderOutput::RenderOutput(const juce::File& targetFile, RenderOptions::OutputFormat outputFormat, int outputBitDepth)
+    : target(targetFile), format(outputFormat), bitDepth(outputBitDepth), temp(targetFile) {}
+
+bool RenderOutput::open(double sampleRate, int numChannels, int bitRateKbps, juce::String& errorMessage) {
+    return writer.open(temp.getFile(), sampleRate, numChannels, bitDepth, errorMessage, format, bitRateKbps);
+}
+
+bool RenderOutput::commit(juce::String& errorMessage) {
+    writer.close();
+    if (temp.overwriteTargetFileWithTemporary()) return true;
+    errorMessage = "Failed to write output file: " + target.getFullPathName();
+    return false;
+}
+
+} // namespace OfflineRender
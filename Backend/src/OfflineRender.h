@@ -0,0 +1,288 @@
+#pragma once
+
+#include "BackendHost.h"
+#include "Resampler.h"
+#include "SampleCache.h"
+#include "SamplerVoices.h"
+#include <atomic>
+#include <limits>
+#include <memory>
+#include <vector>
+
+// Building blocks for chunked offline bounces. Every source renders the same chunk of the
+// timeline, the chunks are summed and streamed to disk, so a render needs a few chunk-sized
+// buffers instead of whole-song ones however long the song is.
+namespace OfflineRender {
+
+constexpr int chunkSize = 8192; // frames per pipeline step
+constexpr int blockSize = 512;  // processBlock size for plugins
+
+// One source of the offline mix
+class TrackRenderer {
+public:
+    virtual ~TrackRenderer() = default;
+
+    // Renders timeline frames [chunkStart, chunkStart + numSamples) into the start of buffer,
+    // which the caller has cleared. Chunks arrive in order; the first one may start past zero
+    // (range renders).
+    virtual void renderChunk(juce::AudioBuffer<float>& buffer, juce::int64 chunkStart, int numSamples) = 0;
+
+    // Called once after the last chunk
+    virtual void finish() {}
+};
+
+// Drives a render-private plugin instance with the track's notes
+class PluginRenderer : public TrackRenderer {
+public:
+    // Parameter lanes of automation (if any) are applied at the start of every processBlock
+    PluginRenderer(juce::AudioPluginInstance& plugin, const std::vector<MidiNoteEvent>& notes,
+                   double sampleRate, juce::int64 totalSamples, const TrackAutomation* automation = nullptr);
+
+    void renderChunk(juce::AudioBuffer<float>& buffer, juce::int64 chunkStart, int numSamples) override;
+    void finish() override;
+
+private:
+    juce::AudioPluginInstance& plugin;
+    double sampleRate;
+    const TrackAutomation* automation;
+    std::vector<std::pair<juce::int64, juce::MidiMessage>> timeline; // sorted by sample position
+    size_t nextEvent = 0;
+    juce::MidiBuffer midiBuffer;
+};
+
+// Renders a TinySoundFont instance (a render-private tsf_copy) with the track's notes, under the
+// same voice budget as the live track
+class SF2Renderer : public TrackRenderer {
+public:
+    SF2Renderer(tsf* soundFont, const std::vector<MidiNoteEvent>& notes, double sampleRate, juce::int64 totalSamples,
+                int voiceLimit = SoundFontBank::maxVoices,
+                SoundFontBank::VoiceStealing voiceStealing = SoundFontBank::VoiceStealing::releasing);
+
+    void renderChunk(juce::AudioBuffer<float>& buffer, juce::int64 chunkStart, int numSamples) override;
+
+private:
+    struct Event { juce::int64 samplePos; bool noteOn; int midiNote; float velocity; int channel; };
+
+    void dispatchEventsUpTo(juce::int64 samplePos);
+
+    tsf* soundFont;
+    std::vector<Event> timeline;
+    size_t nextEvent = 0;
+    std::vector<float> planar; // left block then right block
+    int voiceLimit;
+    SoundFontBank::VoiceStealing voiceStealing;
+};
+
+// One-shot playback of in-memory samples (sampler notes, beat hits)
+class SampleRenderer : public TrackRenderer {
+public:
+    explicit SampleRenderer(Resampler::Quality quality) : quality(quality) {}
+
+    // Plays shots like the live sampler engine instead: at most voiceLimit held at once, stolen
+    // by policy, with attack and release envelopes and maxFrames as the note's release point
+    void setVoiceBudget(int voiceLimit, SoundFontBank::VoiceStealing policy, double sampleRate);
+
+    // maxFrames < 0 plays until the sample runs out; otherwise the shot is cut (or released) after
+    // maxFrames. Add everything before the first chunk. Shots that started before it join at the
+    // position they would have reached by then.
+    void addShot(std::shared_ptr<const BeatSample> sample, juce::int64 startSample, double ratio,
+                 float gain, juce::int64 maxFrames = -1);
+
+    void renderChunk(juce::AudioBuffer<float>& buffer, juce::int64 chunkStart, int numSamples) override;
+
+private:
+    struct Shot {
+        std::shared_ptr<const BeatSample> sample;
+        juce::int64 startSample;
+        double ratio;
+        float gain;
+        juce::int64 maxFrames;
+    };
+    struct Voice {
+        const Shot* shot;
+        double position;
+        juce::int64 framesLeft; // until the cut, or the release once enveloped
+        float gain = 1.0f;
+        uint32_t startOrder = 0;
+        SamplerVoices::Envelope envelope;
+    };
+
+    void renderEnvelopedChunk(juce::AudioBuffer<float>& buffer, juce::int64 chunkStart, int numSamples);
+    void renderEnvelopedVoices(juce::AudioBuffer<float>& buffer, int startSample, int numFrames);
+    void startEnvelopedVoice(const Shot& shot, juce::int64 timelinePosition);
+
+    // Moves a voice whose shot started before timelinePosition to where it would be by then.
+    // Returns false if the shot has ended by then.
+    static bool skipTo(Voice& voice, juce::int64 timelinePosition);
+
+    Resampler::Quality quality;
+    std::vector<Shot> shots; // sorted by start on the first chunk
+    size_t nextShot = 0;
+    bool sorted = false;
+    std::vector<Voice> voices;
+
+    // Sampler mode (setVoiceBudget)
+    bool enveloped = false;
+    int voiceLimit = SamplerVoices::maxVoices;
+    SoundFontBank::VoiceStealing voiceStealing = SoundFontBank::VoiceStealing::oldest;
+    double envelopeRate = 44100.0;
+    uint32_t nextStartOrder = 0;
+    juce::AudioBuffer<float> scratch;
+};
+
+// Audio clips. Clips small enough for the sample cache play from a shared decoded buffer, so
+// exporting them again never touches the disk, and ones the cache maps play straight from the
+// mapping; other long ones are streamed from disk a window at a time instead of being loaded whole.
+class ClipRenderer : public TrackRenderer {
+public:
+    ClipRenderer(juce::AudioFormatManager& formatManager, SampleCache& cache, double sampleRate,
+                 Resampler::Quality quality)
+        : formatManager(formatManager), cache(cache), sampleRate(sampleRate), quality(quality), cachedClips(quality) {}
+
+    // Only renders clips' frames in [firstSample, endSample): clips that end before firstSample
+    // are skipped and the others stop at endSample. Call before adding clips.
+    void setRange(juce::int64 firstSample, juce::int64 endSample);
+
+    // Reads the clip's header (or finds it in the cache). Returns its end position in output
+    // samples, or -1 (with errorMessage) if the file can't be opened. Add everything before the
+    // first chunk.
+    juce::int64 addClip(const AudioClipRenderEvent& clip, juce::String& errorMessage);
+
+    void renderChunk(juce::AudioBuffer<float>& buffer, juce::int64 chunkStart, int numSamples) override;
+
+private:
+    struct Clip {
+        juce::File file;
+        juce::int64 startSample;
+        float gain;
+        double ratio;             // source samples per output sample
+        juce::int64 sourceLength;
+        juce::int64 endSample;    // where the clip is cut (the range end)
+    };
+    struct Voice {
+        const Clip* clip;
+        std::unique_ptr<juce::AudioFormatReader> reader;
+        double position;
+    };
+
+    juce::AudioFormatManager& formatManager;
+    SampleCache& cache;
+    double sampleRate;
+    Resampler::Quality quality;
+    juce::int64 rangeFirst = 0;
+    juce::int64 rangeEnd = std::numeric_limits<juce::int64>::max();
+    SampleRenderer cachedClips;
+    std::vector<Clip> clips; // streamed ones
+    size_t nextClip = 0;
+    bool sorted = false;
+    std::vector<Voice> voices;
+    juce::AudioBuffer<float> window;
+};
+
+// Replays a track stem an earlier render left in the stem cache instead of rendering the track
+// again. Frames past the end of the stem are silent.
+class StemRenderer : public TrackRenderer {
+public:
+    explicit StemRenderer(std::unique_ptr<juce::AudioFormatReader> stemReader) : reader(std::move(stemReader)) {}
+
+    void renderChunk(juce::AudioBuffer<float>& buffer, juce::int64 chunkStart, int numSamples) override;
+
+private:
+    std::unique_ptr<juce::AudioFormatReader> reader;
+};
+
+// Records one track's chunks as a float WAV stem for the stem cache. The stem only appears under
+// its name once commit() succeeds, so a cancelled or failed render leaves no partial stem behind.
+class StemWriter {
+public:
+    StemWriter(const juce::File& stemFile, double sampleRate, int numChannels);
+
+    bool isOpen() const { return writer != nullptr; }
+    void write(const juce::AudioBuffer<float>& buffer, int numSamples);
+    bool commit();
+
+private:
+    juce::TemporaryFile temp;
+    std::unique_ptr<juce::AudioFormatWriter> writer;
+    bool failed = false;
+};
+
+// Lookahead brickwall limiter for normalising a streamed mix. Gain reduction starts ahead of each
+// peak and recovers with a smooth release, so nothing exceeds the ceiling and the whole mix
+// never has to be in memory. The output is delayed by getLatency() samples.
+class PeakLimiter {
+public:
+    PeakLimiter(double sampleRate, int numChannels, float ceiling = 0.99f);
+
+    int getLatency() const { return lookahead - 1; }
+    void process(juce::AudioBuffer<float>& buffer, int numSamples);
+
+private:
+    float ceiling;
+    int lookahead;
+    float releaseCoeff;
+
+    juce::AudioBuffer<float> delay; // lookahead frames per channel
+    std::vector<std::pair<juce::int64, float>> minQueue; // ring of (sample index, gain), increasing gain
+    size_t queueHead = 0, queueSize = 0;
+    std::vector<float> boxRing;
+    double boxSum = 0.0;
+    float released = 1.0f;
+    juce::int64 sampleIndex = 0;
+};
+
+// Writes the render through a ThreadedWriter on the writer's own thread, so encoding and disk I/O
+// overlap rendering and several writers encode in parallel. write() waits while the writer's FIFO
+// is full, which bounds the memory between renderer and encoder.
+class StreamingWriter {
+public:
+    StreamingWriter();
+    ~StreamingWriter();
+
+    // bitDepth applies to wav and flac (at most 24 bits), bitRateKbps to ogg and mp3 (the nearest
+    // rate the encoder offers)
+    bool open(const juce::File& file, double sampleRate, int numChannels, int bitDepth, juce::String& errorMessage,
+              RenderOptions::OutputFormat format = RenderOptions::OutputFormat::wav, int bitRateKbps = 192);
+
+    // Returns false if cancelled while waiting for FIFO space
+    bool write(const juce::AudioBuffer<float>& buffer, int startSample, int numSamples,
+               const std::atomic<bool>& cancelled);
+
+    // Flushes everything written so far and closes the file
+    void close();
+
+private:
+    juce::TimeSliceThread thread;
+    std::unique_ptr<juce::AudioFormatWriter::ThreadedWriter> writer;
+};
+
+// One file a render produces (the mix in some format, or a track stem). It streams to a temporary
+// file next to its target, which commit() swaps in once everything is written, so a cancelled or
+// failed render leaves the target untouched.
+class RenderOutput {
+public:
+    RenderOutput(const juce::File& targetFile, RenderOptions::OutputFormat format, int bitDepth);
+
+    const juce::File& getTarget() const { return target; }
+    const juce::File& getTemporaryFile() const { return temp.getFile(); }
+    RenderOptions::OutputFormat getFormat() const { return format; }
+    int getBitDepth() const { return bitDepth; }
+
+    // Starts (or restarts) the temporary file
+    bool open(double sampleRate, int numChannels, int bitRateKbps, juce::String& errorMessage);
+    bool write(const juce::AudioBuffer<float>& buffer, int startSample, int numSamples,
+               const std::atomic<bool>& cancelled) {
+        return writer.write(buffer, startSample, numSamples, cancelled);
+    }
+    void close() { writer.close(); }
+    bool commit(juce::String& errorMessage);
+
+private:
+    juce::File target;
+    RenderOptions::OutputFormat format;
+    int bitDepth;
+    juce::TemporaryFile temp;
+    StreamingWriter writer;
+};
+
+} // namespace OfflineRender
@@ -0,0 +1,194 @@
+#include "PeakCache.h"
+
+#include <algorithm>
+#include <cmath>
+
+namespace {
+
+constexpr int magic = 0x4b504b4d; // "MKPK"
+constexpr int currentVersion = 1;
+
+// Frames read per step; a whole number of level 0 windows, so windows never straddle reads
+constexpr int readFrames = PeakCache::baseSamplesPerPeak * 256;
+
+juce::int16 toPeakValue(float value) {
+    return (juce::int16)std::lround(juce::jlimit(-1.0f, 1.0f, value) * 32767.0f);
+}
+
+// Min/max peaks of up to two channels at every level, fed in blocks of whole level 0 windows
+class PeakBuilder {
+public:
+    explicit PeakBuilder(int channels) : numChannels(channels) {}
+
+    void add(const float* const* channelData, int numFrames) {
+        for (int start = 0; start < numFrames; start += PeakCache::baseSamplesPerPeak) {
+            const int length = juce::jmin(PeakCache::baseSamplesPerPeak, numFrames - start);
+            for (int ch = 0; ch < numChannels; ++ch) {
+                // Vectorised scan of one window
+                const auto range = juce::FloatVectorOperations::findMinAndMax(channelData[ch] + start, length);
+                base.push_back({ range.getStart(), range.getEnd() });
+            }
+        }
+    }
+
+    // Level 0 is what add() collected; each next level merges levelFactor peaks of the one before
+    std::vector<std::vector<juce::Range<float>>> build() const {
+        std::vector<std::vector<juce::Range<float>>> levels { base };
+        while ((int)levels.size() < PeakCache::numLevels) {
+            const auto& previous = levels.back();
+            const size_t previousPeaks = previous.size() / (size_t)numChannels;
+            std::vector<juce::Range<float>> next;
+            next.reserve((previousPeaks + PeakCache::levelFactor - 1) / PeakCache::levelFactor * (size_t)numChannels);
+            for (size_t first = 0; first < previousPeaks; first += PeakCache::levelFactor) {
+                const size_t last = juce::jmin(previousPeaks, first + PeakCache::levelFactor);
+                for (int ch = 0; ch < numChannels; ++ch) {
+                    auto merged = previous[first * (size_t)numChannels + (size_t)ch];
+                    for (size_t p = first + 1; p < last; ++p) {
+                        merged = merged.getUnionWith(previous[p * (size_t)numChannels + (size_t)ch]);
+                    }
+                    next.push_back(merged);
+                }
+            }
+            levels.push_back(std::move(next));
+        }
+        return levels;
+    }
+
+private:
+    const int numChannels;
+    std::vector<juce::Range<float>> base; // peak-major, channels interleaved
+};
+
+bool readHeader(const juce::File& peakFile, PeakCache::Info& info) {
+    juce::FileInputStream in(peakFile);
+    if (!in.openedOk() || in.readInt() != magic || in.readInt() != currentVersion) return false;
+    info.sampleRate = in.readDouble();
+    info.numFrames = in.readInt64();
+    info.numChannels = in.readInt();
+    return info.numChannels > 0 && !in.isExhausted();
+}
+
+} // namespace
+
+PeakCache::PeakCache(juce::AudioFormatManager& formatManagerToUse, const juce::File& directoryToUse,
+                     juce::int64 sizeLimitBytes)
+    : formatManager(formatManagerToUse), directory(directoryToUse), sizeLimit(sizeLimitBytes) {}
+
+juce::File PeakCache::defaultDirectory() {
+    return juce::File::getSpecialLocation(juce::File::userApplicationDataDirectory)
+        .getChildFile("MelodyKit")
+        .getChildFile("Peaks");
+}
+
+juce::File PeakCache::getPeakFile(const juce::File& audioFile) const {
+    StemCache::Key key;
+    key.add(audioFile.getFullPathName())
+        .add(audioFile.getSize())
+        .add(audioFile.getLastModificationTime().toMilliseconds())
+        .add((juce::int64)currentVersion);
+    return directory.getChildFile(key.toString() + ".peaks");
+}
+
+bool PeakCache::getPeaks(const juce::File& audioFile, const BeatSample* decoded, Info& info,
+                         juce::String& errorMessage) {
+    if (!audioFile.existsAsFile()) {
+        errorMessage = "file-not-found";
+        return false;
+    }
+
+    info.peakFile = getPeakFile(audioFile);
+    if (info.peakFile.existsAsFile() && readHeader(info.peakFile, info)) {
+        info.peakFile.setLastAccessTime(juce::Time::getCurrentTime());
+        info.cached = true;
+        return true;
+    }
+    info.cached = false;
+
+    std::unique_ptr<PeakBuilder> builder;
+    if (decoded != nullptr && decoded->mapped == nullptr && decoded->buffer.getNumChannels() > 0) {
+        const auto& buffer = decoded->buffer;
+        info.sampleRate = decoded->sampleRate;
+        info.numFrames = buffer.getNumSamples();
+        info.numChannels = juce::jmin(2, buffer.getNumChannels());
+        builder = std::make_unique<PeakBuilder>(info.numChannels);
+        builder->add(buffer.getArrayOfReadPointers(), buffer.getNumSamples());
+    } else {
+        // Not decoded (or mapped): stream the file in blocks instead of holding all of it
+        std::unique_ptr<juce::AudioFormatReader> reader(formatManager.createReaderFor(audioFile));
+        if (reader == nullptr) {
+            errorMessage = "unsupported-format";
+            return false;
+        }
+        info.sampleRate = reader->sampleRate;
+        info.numFrames = reader->lengthInSamples;
+        info.numChannels = juce::jlimit(1, 2, (int)reader->numChannels);
+        builder = std::make_unique<PeakBuilder>(info.numChannels);
+
+        juce::AudioBuffer<float> block(juce::jmax(1, (int)reader->numChannels), readFrames);
+        for (juce::int64 position = 0; position < info.numFrames; position += readFrames) {
+            const int numFrames = (int)juce::jmin<juce::int64>(readFrames, info.numFrames - position);
+            if (!reader->read(&block, 0, numFrames, position, true, true)) {
+                errorMessage = "read-failed";
+                return false;
+            }
+            builder->add(block.getArrayOfReadPointers(), numFrames);
+        }
+    }
+
+    const auto levels = builder->build();
+    directory.createDirectory();
+    juce::TemporaryFile temp(info.peakFile);
+    {
+        juce::FileOutputStream out(temp.getFile());
+        if (!out.openedOk()) {
+            errorMessage = "Failed to create peak file: " + info.peakFile.getFullPathName();
+            return false;
+        }
+        out.writeInt(magic);
+        out.writeInt(currentVersion);
+        out.writeDouble(info.sampleRate);
+        out.writeInt64(info.numFrames);
+        out.writeInt(info.numChannels);
+        out.writeInt((int)levels.size());
+        int samplesPerPeak = baseSamplesPerPeak;
+        for (const auto& level : levels) {
+            out.writeInt(samplesPerPeak);
+            out.writeInt64((juce::int64)(level.size() / (size_t)info.numChannels));
+            samplesPerPeak *= levelFactor;
+        }
+        for (const auto& level : levels) {
+            for (const auto& peak : level) {
+                out.writeShort(toPeakValue(peak.getStart()));
+                out.writeShort(toPeakValue(peak.getEnd()));
+            }
+        }
+        out.flush();
+        if (out.getStatus().failed()) {
+            errorMessage = "Failed to write peak file: " + out.getStatus().getErrorMessage();
+            return false;
+        }
+    }
+    if (!temp.overwriteTargetFileWithTemporary()) {
+        errorMessage = "Failed to write peak file: " + info.peakFile.getFullPathName();
+        return false;
+    }
+
+    trim();
+    return true;
+}
+
+void PeakCache::trim() const {
+    auto files = directory.findChildFiles(juce::File::findFiles, false, "*.peaks");
+    juce::int64 total = 0;
+    for (const auto& file : files) total += file.getSize();
+    if (total <= sizeLimit) return;
+
+    std::sort(files.begin(), files.end(), [](const juce::File& a, const juce::File& b) {
+        return a.getLastAccessTime() < b.getLastAccessTime();
+    });
+    for (const auto& file : files) {
+        if (total <= sizeLimit) break;
+        const auto size = file.getSize();
+        if (file.deleteFile()) total -= size;
+    }
+}
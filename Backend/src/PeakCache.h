@@ -0,0 +1,45 @@
+#pragma once
+
+#include "BackendHost.h"
+
+// Waveform overviews of audio files for the timeline: min/max peak pyramids at several zoom
+// levels, kept as small peak files in <user app data>/MelodyKit/Peaks under a hash of the audio
+// file's path, size and modification time, so a file is only scanned again once it changes. The
+// least recently used peak files are deleted once the folder grows past its size cap.
+// Thread-safe (it only touches the file system); computing is slow, so call it off the message
+// thread.
+//
+// Peak file layout (little-endian):
+//   int32 magic "MKPK", int32 version, float64 sampleRate, int64 numFrames, int32 numChannels
+//   (1 or 2), int32 numLevels, then per level int32 samplesPerPeak and int64 numPeaks; then the
+//   levels' peaks in the same order, each peak numChannels pairs of int16 min and max (full scale
+//   32767). Level 0 has baseSamplesPerPeak frames per peak, each next level levelFactor times as
+//   many; the last peak of a level may cover fewer frames.
+class PeakCache {
+public:
+    static constexpr int baseSamplesPerPeak = 256;
+    static constexpr int levelFactor = 4;
+    static constexpr int numLevels = 5; // 256 to 65536 frames per peak
+    static constexpr juce::int64 defaultSizeLimit = 256 * 1024 * 1024;
+
+    explicit PeakCache(juce::AudioFormatManager& formatManager, const juce::File& directory = defaultDirectory(),
+                       juce::int64 sizeLimitBytes = defaultSizeLimit);
+
+    static juce::File defaultDirectory();
+
+    using Info = PeakFileInfo;
+
+    // Finds or computes the peak file of audioFile. decoded, if not nullptr, is the file already
+    // decoded (a SampleCache entry), which is scanned instead of reading the file again.
+    bool getPeaks(const juce::File& audioFile, const BeatSample* decoded, Info& info, juce::String& errorMessage);
+
+    // Deletes least recently used peak files until the folder fits the size cap
+    void trim() const;
+
+private:
+    juce::File getPeakFile(const juce::File& audioFile) const;
+
+    juce::AudioFormatManager& formatManager;
+    const juce::File directory;
+    const juce::int64 sizeLimit;
+};
@@ -0,0 +1,224 @@
+#include "PitchDetector.h"
+
+#include <juce_dsp/juce_dsp.h>
+#include <cmath>
+#include <vector>
+
+namespace PitchDetector {
+
+namespace {
+
+constexpr double minFrequency = 27.5;    // A0, the lowest piano note
+constexpr double maxFrequency = 2000.0;  // above the piano range
+constexpr float pitchedClarity = 0.5f;   // below this the sample counts as unpitched
+constexpr float keyMaximumRatio = 0.9f;  // the first peak this close to the best wins (avoids octave errors)
+
+} // namespace
+
+Result detect(const juce::AudioBuffer<float>& buffer, double sampleRate) {
+    Result result;
+    const int numChannels = buffer.getNumChannels();
+    if (numChannels < 1 || buffer.getNumSamples() < 1024 || sampleRate <= 0.0) return result;
+
+    const int minLag = juce::jmax(2, (int)(sampleRate / maxFrequency));
+    const int maxLag = (int)(sampleRate / minFrequency);
+    const int searchLength = juce::jmin(buffer.getNumSamples(), (int)(sampleRate * searchSeconds));
+    const int windowSize = juce::jmin(juce::nextPowerOfTwo(2 * maxLag), searchLength);
+    const int lagLimit = juce::jmin(maxLag, windowSize / 2);
+    if (lagLimit <= minLag) return result;
+
+    // Mono mixdown of the searched region
+    std::vector<float> mono((size_t)searchLength);
+    juce::FloatVectorOperations::copy(mono.data(), buffer.getReadPointer(0), searchLength);
+    for (int ch = 1; ch < numChannels; ++ch) {
+        juce::FloatVectorOperations::add(mono.data(), buffer.getReadPointer(ch), searchLength);
+    }
+    juce::FloatVectorOperations::multiply(mono.data(), 1.0f / (float)numChannels, searchLength);
+
+    // Loudest window (skips silence and the noisy attack of quiet starts)
+    std::vector<double> cumulativeEnergy((size_t)searchLength + 1, 0.0);
+    for (int i = 0; i < searchLength; ++i) {
+        cumulativeEnergy[(size_t)i + 1] = cumulativeEnergy[(size_t)i] + (double)mono[(size_t)i] * mono[(size_t)i];
+    }
+    int bestStart = 0;
+    double maxEnergy = 0.0;
+    for (int start = 0; start + windowSize <= searchLength; start += juce::jmax(1, windowSize / 4)) {
+        const double energy = cumulativeEnergy[(size_t)(start + windowSize)] - cumulativeEnergy[(size_t)start];
+        if (energy > maxEnergy) {
+            maxEnergy = energy;
+            bestStart = start;
+        }
+    }
+    if (maxEnergy < 0.0001) return result; // too quiet
+
+    // Autocorrelation of the window via the power spectrum, zero-padded so it doesn't wrap
+    const int fftOrder = juce::roundToInt(std::log2((double)juce::nextPowerOfTwo(2 * windowSize)));
+    juce::dsp::FFT fft(fftOrder);
+    const int fftSize = fft.getSize();
+    std::vector<float> spectrum((size_t)fftSize * 2, 0.0f);
+    const float* window = mono.data() + bestStart;
+    std::copy(window, window + windowSize, spectrum.begin());
+
+    fft.performRealOnlyForwardTransform(spectrum.data());
+    for (int i = 0; i < fftSize; ++i) {
+        const float re = spectrum[(size_t)i * 2];
+        const float im = spectrum[(size_t)i * 2 + 1];
+        spectrum[(size_t)i * 2] = re * re + im * im;
+        spectrum[(size_t)i * 2 + 1] = 0.0f;
+    }
+    fft.performRealOnlyInverseTransform(spectrum.data());
+    if (spectrum[0] <= 0.0f) return result;
+
+    // Normalised square difference: n(t) = 2 r(t) / m(t), with m updated incrementally. r is
+    // rescaled so r(0) equals the window energy whatever scaling the FFT applies.
+    const double scale = maxEnergy / spectrum[0];
+    std::vector<float> nsdf((size_t)lagLimit + 1, 0.0f);
+    double m = 2.0 * maxEnergy;
+    for (int lag = 0; lag <= lagLimit; ++lag) {
+        if (lag > 0) {
+            m -= (double)window[lag - 1] * window[lag - 1]
+                 + (double)window[windowSize - lag] * window[windowSize - lag];
+        }
+        nsdf[(size_t)lag] = m > 0.0 ? (float)(2.0 * scale * spectrum[(size_t)lag] / m) : 0.0f;
+    }
+
+    // Key maxima: the highest point of each positive lobe after the one around lag 0
+    std::vector<int> keyMaxima;
+    int lag = 1;
+    while (lag < lagLimit && nsdf[(size_t)lag] > 0.0f) ++lag;
+    int lobePeak = -1;
+    for (; lag < lagLimit; ++lag) {
+        if (nsdf[(size_t)lag] > 0.0f) {
+            if (lobePeak < 0 || nsdf[(size_t)lag] > nsdf[(size_t)lobePeak]) lobePeak = lag;
+        } else if (lobePeak >= 0) {
+            if (lobePeak >= minLag) keyMaxima.push_back(lobePeak);
+            lobePeak = -1;
+        }
+    }
+    if (lobePeak >= minLag) keyMaxima.push_back(lobePeak);
+    if (keyMaxima.empty()) return result;
+
+    float highest = 0.0f;
+    for (int peak : keyMaxima) highest = juce::jmax(highest, nsdf[(size_t)peak]);
+    result.confidence = juce::jlimit(0.0f, 1.0f, highest);
+    if (highest < pitchedClarity) return result;
+
+    int period = keyMaxima.front();
+    for (int peak : keyMaxima) {
+        if (nsdf[(size_t)peak] >= keyMaximumRatio * highest) {
+            period = peak;
+            break;
+        }
+    }
+    result.confidence = juce::jlimit(0.0f, 1.0f, nsdf[(size_t)period]);
+
+    // Parabolic interpolation around the peak for a sub-sample period
+    const float a = nsdf[(size_t)period - 1], b = nsdf[(size_t)period], c = nsdf[(size_t)period + 1];
+    const float curvature = a - 2.0f * b + c;
+    const double refinedPeriod = period + (curvature != 0.0f ? 0.5 * (a - c) / curvature : 0.0);
+
+    const double frequency = sampleRate / refinedPeriod;
+    const double midiNote = 69.0 + 12.0 * std::log2(frequency / 440.0); // A4 = 440 Hz = MIDI 69
+    result.rootNote = juce::jlimit(21, 108, (int)std::round(midiNote)); // Piano range A0 to C8
+    return result;
+}
+
+} // namespace PitchDetector
+
+//==============================================================================
+RootNoteCache::RootNoteCache(const juce::File& file)
+    : cacheFile(file), fileLock("MelodyKit-" + juce::String::toHexString(file.getFullPathName().hashCode64())),
+      entries(readCacheFile(file)) {}
+
+RootNoteCache::~RootNoteCache() {
+    save();
+}
+
+RootNoteCache::EntryMap RootNoteCache::readCacheFile(const juce::File& file) {
+    EntryMap result;
+    auto xml = juce::XmlDocument::parse(file);
+    if (xml == nullptr) return result;
+
+    for (auto* element : xml->getChildWithTagNameIterator("SAMPLE")) {
+        Entry entry;
+        entry.fileSize = element->getStringAttribute("size").getLargeIntValue();
+        entry.modificationTime = element->getStringAttribute("modified").getLargeIntValue();
+        entry.result.rootNote = element->getIntAttribute("note", 60);
+        entry.result.confidence = (float)element->getDoubleAttribute("confidence");
+        result.emplace(element->getStringAttribute("path"), entry);
+    }
+    return result;
+}
+
+juce::File RootNoteCache::defaultCacheFile() {
+    return juce::File::getSpecialLocation(juce::File::userApplicationDataDirectory)
+        .getChildFile("MelodyKit")
+        .getChildFile("RootNotes.xml");
+}
+
+PitchDetector::Result RootNoteCache::detect(const juce::File& file, const juce::AudioBuffer<float>& buffer,
+                                            double sampleRate) {
+    const juce::String path = file.getFullPathName();
+    const juce::int64 fileSize = file.getSize();
+    const juce::int64 modificationTime = file.getLastModificationTime().toMilliseconds();
+
+    {
+        const juce::ScopedLock sl(lock);
+        auto it = entries.find(path);
+        if (it != entries.end() && it->second.fileSize == fileSize && it->second.modificationTime == modificationTime) {
+            return it->second.result;
+        }
+    }
+
+    const auto result = PitchDetector::detect(buffer, sampleRate);
+
+    const juce::ScopedLock sl(lock);
+    entries[path] = {fileSize, modificationTime, result};
+    dirty = true;
+    return result;
+}
+
+void RootNoteCache::save() {
+    const juce::ScopedLock savingLock(saveLock);
+    EntryMap snapshot;
+    {
+        const juce::ScopedLock sl(lock);
+        if (!dirty) return;
+        dirty = false;
+        snapshot = entries;
+    }
+
+    // Other backends save to the same file: keep what they detected meanwhile (this process's
+    // results win), and drop samples that were deleted or moved
+    const juce::InterProcessLock::ScopedLockType fl(fileLock);
+    for (auto& [path, entry] : readCacheFile(cacheFile)) snapshot.emplace(path, entry);
+    juce::StringArray removed;
+    for (auto it = snapshot.begin(); it != snapshot.end();) {
+        if (juce::File(it->first).existsAsFile()) {
+            ++it;
+        } else {
+            removed.add(it->first);
+            it = snapshot.erase(it);
+        }
+    }
+
+    juce::XmlElement xml("ROOTNOTES");
+    for (const auto& [path, entry] : snapshot) {
+        auto* element = xml.createNewChildElement("SAMPLE");
+        element->setAttribute("path", path);
+        element->setAttribute("size", juce::String(entry.fileSize));
+        element->setAttribute("modified", juce::String(entry.modificationTime));
+        element->setAttribute("note", entry.result.rootNote);
+        element->setAttribute("confidence", (double)entry.result.confidence);
+    }
+
+    // Written to a temporary file first so a crash mid-write can't leave a truncated cache
+    cacheFile.getParentDirectory().createDirectory();
+    juce::TemporaryFile temp(cacheFile);
+    const bool written = xml.writeTo(temp.getFile()) && temp.overwriteTargetFileWithTemporary();
+
+    const juce::ScopedLock sl(lock);
+    if (!written) dirty = true; // try again next time
+    for (const auto& path : removed) entries.erase(path);
+    for (auto& [path, entry] : snapshot) entries.emplace(path, entry);
+}
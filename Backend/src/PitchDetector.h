@@ -0,0 +1,61 @@
+#pragma once
+
+#include <juce_audio_basics/juce_audio_basics.h>
+#include <map>
+
+// Root-note detection for sampler samples: the McLeod pitch method (normalised square difference
+// from an FFT autocorrelation) over the loudest window near the start of the sample, so the cost
+// is one small FFT however long the file is.
+namespace PitchDetector {
+
+// Only this much of the start of a sample is analysed
+constexpr double searchSeconds = 2.0;
+
+struct Result {
+    int rootNote = 60;       // MIDI note, C4 when nothing pitched was found
+    float confidence = 0.0f; // clarity of the chosen period, 0..1
+};
+
+// Any thread
+Result detect(const juce::AudioBuffer<float>& buffer, double sampleRate);
+
+} // namespace PitchDetector
+
+// Detected root notes remembered per file (path, size and modification time), in memory and in a
+// cache file, so a sample is only analysed the first time it is ever loaded. New results only
+// mark the cache dirty; save() writes them (once a batch of loads is done, and on destruction).
+// Thread-safe.
+class RootNoteCache {
+public:
+    explicit RootNoteCache(const juce::File& cacheFile = defaultCacheFile());
+    ~RootNoteCache();
+
+    // <user app data>/MelodyKit/RootNotes.xml
+    static juce::File defaultCacheFile();
+
+    // The cached result for file if it is current, otherwise detects over buffer (the decoded
+    // file) and caches that
+    PitchDetector::Result detect(const juce::File& file, const juce::AudioBuffer<float>& buffer, double sampleRate);
+
+    // Writes the cache file if anything was detected since the last save, merged with what other
+    // backends saved meanwhile and without samples that no longer exist. Slow; detect() isn't
+    // blocked while it runs.
+    void save();
+
+private:
+    struct Entry {
+        juce::int64 fileSize = 0;
+        juce::int64 modificationTime = 0;
+        PitchDetector::Result result;
+    };
+    using EntryMap = std::map<juce::String, Entry>; // path -> last detection
+
+    static EntryMap readCacheFile(const juce::File& file);
+
+    const juce::File cacheFile;
+    juce::CriticalSection lock; // entries and dirty
+    juce::CriticalSection saveLock; // one save at a time
+    juce::InterProcessLock fileLock; // the cache file, shared by every backend on the machine
+    EntryMap entries;
+    bool dirty = false;
+};
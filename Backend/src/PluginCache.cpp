@@ -0,0 +1,272 @@
+#include "PluginCache.h"
+
+namespace {
+
+// How long a child may take to scan one bundle before it is treated as hung
+constexpr int childScanTimeoutMs = 60000;
+constexpr int childPollIntervalMs = 100;
+
+// Cache file entries for bundles that were scanned without finding any types
+// (KnownPluginList::recreateFromXml skips them)
+constexpr const char* emptyFileTag = "EMPTY";
+
+} // namespace
+
+PluginCache::PluginCache(juce::AudioPluginFormatManager& formatManagerToUse, const juce::File& file)
+    : formatManager(formatManagerToUse),
+      cacheFile(file),
+      fileLock("MelodyKit-" + juce::String::toHexString(file.getFullPathName().hashCode64())) {
+    if (auto xml = juce::XmlDocument::parse(cacheFile)) {
+        knownPlugins.recreateFromXml(*xml);
+        readEmptyFilesLocked(*xml, {});
+    }
+}
+
+juce::File PluginCache::defaultCacheFile() {
+    return juce::File::getSpecialLocation(juce::File::userApplicationDataDirectory)
+        .getChildFile("MelodyKit")
+        .getChildFile("PluginCache.xml");
+}
+
+void PluginCache::addFormats(juce::AudioPluginFormatManager& formatManager) {
+    // Manually register VST3 format (addDefaultFormats is deleted in console builds)
+#if JUCE_PLUGINHOST_VST3
+    formatManager.addFormat(std::make_unique<juce::VST3PluginFormat>());
+#else
+    juce::ignoreUnused(formatManager);
+#endif
+}
+
+juce::AudioPluginFormat* PluginCache::findFormat(const juce::String& formatName) const {
+    for (int i = 0; i < formatManager.getNumFormats(); ++i) {
+        if (auto* format = formatManager.getFormat(i); format != nullptr && format->getName() == formatName) {
+            return format;
+        }
+    }
+    return nullptr;
+}
+
+juce::int64 PluginCache::modificationTime(const juce::String& path) {
+    return juce::File(path).getLastModificationTime().toMilliseconds();
+}
+
+void PluginCache::readEmptyFilesLocked(const juce::XmlElement& xml, const juce::StringArray& skip) {
+    for (auto* element : xml.getChildWithTagNameIterator(emptyFileTag)) {
+        const juce::String path = element->getStringAttribute("file");
+        if (path.isNotEmpty() && !skip.contains(path)) {
+            emptyFiles[path] = element->getStringAttribute("modified").getLargeIntValue();
+        }
+    }
+}
+
+bool PluginCache::isUpToDateLocked(const juce::PluginDescription& description) const {
+    auto* format = findFormat(description.pluginFormatName);
+    return format != nullptr && !format->pluginNeedsRescanning(description);
+}
+
+bool PluginCache::findType(const juce::File& file, juce::PluginDescription& description, juce::String& errorMessage) {
+    if (formatManager.getNumFormats() == 0) {
+        errorMessage = "No plugin formats available (VST3 support may not be compiled)";
+        return false;
+    }
+
+    const juce::String path = file.getFullPathName();
+    const juce::ScopedLock sl(lock);
+
+    auto findKnown = [&] {
+        for (const auto& known : knownPlugins.getTypes()) {
+            if (known.fileOrIdentifier == path && isUpToDateLocked(known)) {
+                description = known;
+                return true;
+            }
+        }
+        return false;
+    };
+    if (findKnown()) return true;
+
+    // Another backend may have scanned it since this one started
+    {
+        const juce::InterProcessLock::ScopedLockType fl(fileLock);
+        mergeFromDiskLocked();
+    }
+    if (findKnown()) return true;
+
+    juce::OwnedArray<juce::PluginDescription> types;
+    for (int i = 0; i < formatManager.getNumFormats(); ++i) {
+        if (auto* format = formatManager.getFormat(i)) {
+            format->findAllTypesForFile(types, path);
+        }
+    }
+
+    if (types.isEmpty()) {
+        errorMessage = "No plugin types found in file";
+        return false;
+    }
+
+    replaceTypesLocked(path, types);
+    knownPlugins.removeFromBlacklist(path); // it scanned fine in this process after all
+    saveLocked();
+
+    description = *types[0];
+    return true;
+}
+
+void PluginCache::replaceTypesLocked(const juce::String& path, const juce::OwnedArray<juce::PluginDescription>& types) {
+    if (types.isEmpty()) emptyFiles[path] = modificationTime(path);
+    else emptyFiles.erase(path);
+
+    for (const auto& known : knownPlugins.getTypes()) {
+        if (known.fileOrIdentifier == path) knownPlugins.removeType(known);
+    }
+    for (auto* type : types) {
+        knownPlugins.addType(*type);
+    }
+}
+
+void PluginCache::mergeFromDiskLocked() {
+    auto xml = juce::XmlDocument::parse(cacheFile);
+    if (xml == nullptr) return;
+
+    juce::KnownPluginList onDisk;
+    onDisk.recreateFromXml(*xml);
+
+    // This process's entries win for files both know (they were scanned or blacklisted here)
+    juce::StringArray ours;
+    for (const auto& known : knownPlugins.getTypes()) ours.addIfNotAlreadyThere(known.fileOrIdentifier);
+    ours.addArray(knownPlugins.getBlacklistedFiles());
+    for (const auto& [path, modified] : emptyFiles) ours.addIfNotAlreadyThere(path);
+
+    for (const auto& type : onDisk.getTypes()) {
+        if (!ours.contains(type.fileOrIdentifier)) knownPlugins.addType(type);
+    }
+    for (const auto& blacklisted : onDisk.getBlacklistedFiles()) {
+        if (!ours.contains(blacklisted)) knownPlugins.addToBlacklist(blacklisted);
+    }
+    readEmptyFilesLocked(*xml, ours);
+}
+
+void PluginCache::saveLocked() {
+    const juce::InterProcessLock::ScopedLockType fl(fileLock);
+    mergeFromDiskLocked();
+
+    auto xml = knownPlugins.createXml();
+    if (xml == nullptr) return;
+    for (const auto& [path, modified] : emptyFiles) {
+        auto* element = xml->createNewChildElement(emptyFileTag);
+        element->setAttribute("file", path);
+        element->setAttribute("modified", juce::String(modified));
+    }
+
+    // Written to a temporary file first so a crash mid-write can't leave a truncated cache
+    cacheFile.getParentDirectory().createDirectory();
+    juce::TemporaryFile temp(cacheFile);
+    if (xml->writeTo(temp.getFile())) temp.overwriteTargetFileWithTemporary();
+}
+
+juce::StringArray PluginCache::findPluginFiles() {
+    juce::StringArray files;
+    for (int i = 0; i < formatManager.getNumFormats(); ++i) {
+        if (auto* format = formatManager.getFormat(i)) {
+            files.addArray(format->searchPathsForPlugins(format->getDefaultLocationsToSearch(), true));
+        }
+    }
+    files.removeDuplicates(false);
+    return files;
+}
+
+bool PluginCache::needsScan(const juce::String& path) {
+    const juce::ScopedLock sl(lock);
+    if (knownPlugins.getBlacklistedFiles().contains(path)) return false;
+    if (auto empty = emptyFiles.find(path); empty != emptyFiles.end()) {
+        return empty->second != modificationTime(path);
+    }
+
+    bool listed = false;
+    for (const auto& known : knownPlugins.getTypes()) {
+        if (known.fileOrIdentifier != path) continue;
+        if (!isUpToDateLocked(known)) return true;
+        listed = true;
+    }
+    return !listed;
+}
+
+juce::Array<juce::PluginDescription> PluginCache::getTypesForFile(const juce::String& path) const {
+    const juce::ScopedLock sl(lock);
+    juce::Array<juce::PluginDescription> types;
+    for (const auto& known : knownPlugins.getTypes()) {
+        if (known.fileOrIdentifier == path) types.add(known);
+    }
+    return types;
+}
+
+int PluginCache::scanInChildProcess(const juce::String& path, juce::String& errorMessage) {
+    if (cancelled) {
+        errorMessage = "cancelled";
+        return -1;
+    }
+
+    // The child writes its findings to a file; its stdout and stderr are discarded so nothing a
+    // plugin prints can end up in the event stream or block on a full pipe
+    const auto executable = juce::File::getSpecialLocation(juce::File::currentExecutableFile);
+    juce::TemporaryFile resultFile(".xml");
+    juce::ChildProcess child;
+    if (!child.start(juce::StringArray { executable.getFullPathName(), scanChildFlag, path,
+                                         resultFile.getFile().getFullPathName() },
+                     0)) {
+        errorMessage = "child-start-failed";
+        return -1;
+    }
+
+    // The lock isn't held here: loads carry on while the child scans
+    for (int waited = 0; !child.waitForProcessToFinish(childPollIntervalMs); waited += childPollIntervalMs) {
+        if (cancelled || waited >= childScanTimeoutMs) {
+            child.kill();
+            errorMessage = cancelled ? "cancelled" : "timeout";
+            if (!cancelled) {
+                const juce::ScopedLock sl(lock);
+                knownPlugins.addToBlacklist(path);
+                saveLocked();
+            }
+            return -1;
+        }
+    }
+
+    auto xml = juce::XmlDocument::parse(resultFile.getFile());
+    const juce::ScopedLock sl(lock);
+
+    if (child.getExitCode() != 0 || xml == nullptr) {
+        errorMessage = "crashed";
+        knownPlugins.addToBlacklist(path);
+        saveLocked();
+        return -1;
+    }
+
+    juce::OwnedArray<juce::PluginDescription> types;
+    for (auto* element : xml->getChildIterator()) {
+        auto description = std::make_unique<juce::PluginDescription>();
+        if (description->loadFromXml(*element)) types.add(description.release());
+    }
+
+    replaceTypesLocked(path, types);
+    saveLocked();
+    return types.size();
+}
+
+int PluginCache::runScanChild(const juce::String& path, const juce::File& resultFile) {
+    juce::AudioPluginFormatManager formats;
+    addFormats(formats);
+
+    juce::OwnedArray<juce::PluginDescription> types;
+    for (int i = 0; i < formats.getNumFormats(); ++i) {
+        auto* format = formats.getFormat(i);
+        if (format != nullptr && format->fileMightContainThisPluginType(path)) {
+            format->findAllTypesForFile(types, path);
+        }
+    }
+
+    juce::XmlElement result("PLUGINS");
+    for (auto* type : types) {
+        result.addChildElement(type->createXml().release());
+    }
+    return result.writeTo(resultFile) ? 0 : 1;
+}
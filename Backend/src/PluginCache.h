@@ -0,0 +1,68 @@
+#pragma once
+
+#include <juce_audio_processors/juce_audio_processors.h>
+#include <atomic>
+#include <map>
+
+// Plugin descriptions remembered across runs in a KnownPluginList saved to disk. An entry is
+// reused until its bundle's modification time changes, so loading a plugin that was seen before
+// creates the instance straight from the cached description without loading the module to scan
+// it again. Scans that do happen go through here too; SCAN_PLUGINS scans in child processes
+// (runScanChild) so a plugin that crashes while being scanned only takes the child down.
+// Several backends (e.g. batch renders on one machine) can share the file: a save merges in what
+// the others saved meanwhile, and a plugin missing here is looked up on disk before scanning it.
+class PluginCache {
+public:
+    PluginCache(juce::AudioPluginFormatManager& formatManager, const juce::File& cacheFile = defaultCacheFile());
+
+    // <user app data>/MelodyKit/PluginCache.xml
+    static juce::File defaultCacheFile();
+
+    // Registers the formats the backend hosts (VST3 when compiled in)
+    static void addFormats(juce::AudioPluginFormatManager& formatManager);
+
+    // The first plugin type in file: from the cache if it is up to date, otherwise scanned in this
+    // process and cached. Any thread.
+    bool findType(const juce::File& file, juce::PluginDescription& description, juce::String& errorMessage);
+
+    // Plugin bundles in the formats' default locations (found without loading them)
+    juce::StringArray findPluginFiles();
+
+    // Out-of-process scanning, for SCAN_PLUGINS. Files already cached and up to date are skipped
+    // (needsScan is false). scanInChildProcess returns the types found, or -1 with errorMessage if
+    // the child crashed, timed out or was cancelled; crashing files are blacklisted so later scans
+    // skip them (loading one explicitly still works). A bundle with no types is remembered as
+    // empty until its modification time changes.
+    bool needsScan(const juce::String& path);
+    int scanInChildProcess(const juce::String& path, juce::String& errorMessage);
+    juce::Array<juce::PluginDescription> getTypesForFile(const juce::String& path) const;
+
+    // Makes running and future child scans give up (shutdown)
+    void cancelScans() { cancelled = true; }
+
+    // Entry point of the child process started with --scan-plugin <path> <resultFile>: writes the
+    // plugin descriptions found in path to resultFile as XML. Returns the process exit code.
+    static int runScanChild(const juce::String& path, const juce::File& resultFile);
+
+    static constexpr const char* scanChildFlag = "--scan-plugin";
+
+private:
+    juce::AudioPluginFormat* findFormat(const juce::String& formatName) const;
+    bool isUpToDateLocked(const juce::PluginDescription& description) const;
+    void replaceTypesLocked(const juce::String& path, const juce::OwnedArray<juce::PluginDescription>& types);
+    void saveLocked();
+    void mergeFromDiskLocked(); // adds files only another process has cached
+    void readEmptyFilesLocked(const juce::XmlElement& xml, const juce::StringArray& skip);
+    static juce::int64 modificationTime(const juce::String& path);
+
+    juce::AudioPluginFormatManager& formatManager;
+    const juce::File cacheFile;
+    juce::KnownPluginList knownPlugins;
+    std::map<juce::String, juce::int64> emptyFiles; // scanned without types, by modification time
+
+    // Guards knownPlugins and in-process scans (plugin formats aren't safe to scan from several
+    // threads at once). Never held while a child process runs.
+    mutable juce::CriticalSection lock;
+    juce::InterProcessLock fileLock; // the cache file, between processes
+    std::atomic<bool> cancelled { false };
+};
@@ -0,0 +1,41 @@
+#include "PreparedSample.h"
+
+#include <cmath>
+#include <cstdint>
+#include <vector>
+
+namespace PreparedSample {
+
+std::shared_ptr<const BeatSample> create(const BeatSample& sample, double sampleRate, Resampler::Quality quality) {
+    if (sample.mapped || sample.getNumSamples() <= 0 || sample.sampleRate <= 0.0 || sampleRate <= 0.0
+        || sample.sampleRate == sampleRate)
+        return nullptr;
+
+    const double ratio = sample.sampleRate / sampleRate;
+    const int numChannels = sample.buffer.getNumChannels();
+    const int length = (int)std::ceil(sample.getNumSamples() / ratio);
+
+    // Channels are padded to whole cache lines, guard samples included
+    constexpr int lineSamples = alignmentBytes / (int)sizeof(float);
+    const int stride = (length + guardSamples + lineSamples - 1) / lineSamples * lineSamples;
+
+    auto prepared = std::make_shared<BeatSample>();
+    prepared->alignedStorage.allocate((size_t)numChannels * (size_t)stride * sizeof(float) + alignmentBytes, true);
+    auto* base = reinterpret_cast<float*>((reinterpret_cast<uintptr_t>(prepared->alignedStorage.get()) + alignmentBytes - 1)
+                                          & ~(uintptr_t)(alignmentBytes - 1));
+    std::vector<float*> channels((size_t)numChannels);
+    for (int ch = 0; ch < numChannels; ++ch) channels[(size_t)ch] = base + (size_t)ch * (size_t)stride;
+    prepared->buffer.setDataToReferTo(channels.data(), numChannels, length);
+
+    // The same interpolation a voice would have done, once, from the start of the sample
+    double position = 0.0;
+    const int written = Resampler::mix(sample.getSource(), position, ratio, channels.data(), numChannels, length,
+                                       1.0f, quality);
+    jassertquiet(written == length); // every output frame reads at least the last sample
+
+    prepared->guardSamples = guardSamples;
+    prepared->sampleRate = sampleRate;
+    return prepared;
+}
+
+} // namespace PreparedSample
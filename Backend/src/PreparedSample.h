@@ -0,0 +1,21 @@
+#pragma once
+
+#include "BackendHost.h"
+#include <memory>
+
+// Beat samples resampled once to the rate they are played at, so their voices run at ratio 1.0:
+// the kernel's unity path, one scaled vector add per channel and block with no interpolation and
+// no per-sample bounds checks. Each planar channel starts on a cache line and is followed by
+// zeroed guard samples, so the last sample needs no special tail either.
+namespace PreparedSample {
+
+constexpr int alignmentBytes = 64;
+constexpr int guardSamples = 16; // one cache line
+
+// A copy of sample at sampleRate, resampled with quality, or nullptr if that gains nothing: the
+// sample is already at that rate, is empty, or is memory mapped (decoding it would undo that).
+// Any thread except the audio thread.
+std::shared_ptr<const BeatSample> create(const BeatSample& sample, double sampleRate,
+                                         Resampler::Quality quality = Resampler::Quality::linear);
+
+} // namespace PreparedSample
@@ -0,0 +1,44 @@
+#pragma once
+
+#include <juce_core/juce_core.h>
+#include <vector>
+
+// Single-producer/single-consumer queue for handing small POD commands to the audio thread.
+// Storage is allocated once up front; push() and pop() never lock or allocate.
+template <typename T>
+class RealtimeQueue {
+public:
+    explicit RealtimeQueue(int capacity)
+        : fifo(capacity), storage((size_t)capacity) {}
+
+    // Producer side. Returns false (and drops the item) when the queue is full.
+    bool push(const T& item) {
+        int start1, size1, start2, size2;
+        fifo.prepareToWrite(1, start1, size1, start2, size2);
+        if (size1 + size2 < 1) return false;
+
+        storage[(size_t)(size1 > 0 ? start1 : start2)] = item;
+        fifo.finishedWrite(1);
+        return true;
+    }
+
+    // Consumer side. Returns false when the queue is empty.
+    bool pop(T& item) {
+        int start1, size1, start2, size2;
+        fifo.prepareToRead(1, start1, size1, start2, size2);
+        if (size1 + size2 < 1) return false;
+
+        item = storage[(size_t)(size1 > 0 ? start1 : start2)];
+        fifo.finishedRead(1);
+        return true;
+    }
+
+    int getNumReady() const { return fifo.getNumReady(); }
+    int getFreeSpace() const { return fifo.getFreeSpace(); }
+
+private:
+    juce::AbstractFifo fifo;
+    std::vector<T> storage;
+
+    JUCE_DECLARE_NON_COPYABLE(RealtimeQueue)
+};
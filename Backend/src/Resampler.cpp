@@ -0,0 +1,322 @@
+#include "Resampler.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <vector>
+
+#if defined(__AVX2__)
+ #include <immintrin.h>
+ #define MELODYKIT_RESAMPLER_AVX2 1
+#elif defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+ #include <emmintrin.h>
+ #define MELODYKIT_RESAMPLER_SSE2 1
+#elif defined(__ARM_NEON) || defined(__ARM_NEON__) || defined(_M_ARM64)
+ #include <arm_neon.h>
+ #define MELODYKIT_RESAMPLER_NEON 1
+#endif
+
+namespace Resampler {
+
+namespace {
+
+// Read positions are computed per chunk and shared by every channel of the voice
+constexpr int chunkFrames = 256;
+
+// Mapped sources are converted into a window of this many frames (per channel) on the stack, then
+// played by the float kernels. Every destination here is stereo, which two channels cover.
+constexpr int windowFrames = 2048;
+constexpr int maxWindowChannels = 2;
+
+int sourceChannelFor(int destChannel, int numSourceChannels) {
+    return (numSourceChannels == 1) ? 0 : std::min(destChannel, numSourceChannels - 1);
+}
+
+// Number of frames (at most maxFrames) for which both linear taps idx and idx + 1
+// lie inside the source, so the inner loop needs no bounds checks
+int framesWithBothTaps(double position, double ratio, int length, int maxFrames) {
+    const double room = (double)(length - 1) - position;
+    if (room <= 0.0) return 0;
+
+    int frames = (int)std::min((double)maxFrames, std::ceil(room / ratio));
+    // Guard against rounding right at the boundary
+    while (frames > 0 && (int)(position + ratio * (frames - 1)) + 1 >= length) --frames;
+    return frames;
+}
+
+// dest[i] += gain * lerp(src[idx[i]], src[idx[i] + 1], frac[i])
+void mixGathered(const float* src, const int32_t* idx, const float* frac,
+                 float* dest, int numFrames, float gain) {
+    int i = 0;
+#if MELODYKIT_RESAMPLER_AVX2
+    const __m256 g = _mm256_set1_ps(gain);
+    for (; i + 8 <= numFrames; i += 8) {
+        const __m256i vi = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(idx + i));
+        const __m256 s0 = _mm256_i32gather_ps(src, vi, 4);
+        const __m256 s1 = _mm256_i32gather_ps(src + 1, vi, 4);
+        const __m256 f = _mm256_loadu_ps(frac + i);
+        const __m256 v = _mm256_add_ps(s0, _mm256_mul_ps(f, _mm256_sub_ps(s1, s0)));
+        _mm256_storeu_ps(dest + i, _mm256_add_ps(_mm256_loadu_ps(dest + i), _mm256_mul_ps(v, g)));
+    }
+#elif MELODYKIT_RESAMPLER_SSE2
+    const __m128 g = _mm_set1_ps(gain);
+    for (; i + 4 <= numFrames; i += 4) {
+        const __m128 s0 = _mm_set_ps(src[idx[i + 3]], src[idx[i + 2]], src[idx[i + 1]], src[idx[i]]);
+        const __m128 s1 = _mm_set_ps(src[idx[i + 3] + 1], src[idx[i + 2] + 1], src[idx[i + 1] + 1], src[idx[i] + 1]);
+        const __m128 f = _mm_loadu_ps(frac + i);
+        const __m128 v = _mm_add_ps(s0, _mm_mul_ps(f, _mm_sub_ps(s1, s0)));
+        _mm_storeu_ps(dest + i, _mm_add_ps(_mm_loadu_ps(dest + i), _mm_mul_ps(v, g)));
+    }
+#elif MELODYKIT_RESAMPLER_NEON
+    const float32x4_t g = vdupq_n_f32(gain);
+    for (; i + 4 <= numFrames; i += 4) {
+        const float a[4] = { src[idx[i]], src[idx[i + 1]], src[idx[i + 2]], src[idx[i + 3]] };
+        const float b[4] = { src[idx[i] + 1], src[idx[i + 1] + 1], src[idx[i + 2] + 1], src[idx[i + 3] + 1] };
+        const float32x4_t s0 = vld1q_f32(a);
+        const float32x4_t s1 = vld1q_f32(b);
+        const float32x4_t v = vmlaq_f32(s0, vld1q_f32(frac + i), vsubq_f32(s1, s0));
+        vst1q_f32(dest + i, vmlaq_f32(vld1q_f32(dest + i), v, g));
+    }
+#endif
+    for (; i < numFrames; ++i) {
+        const float s0 = src[idx[i]];
+        const float s1 = src[idx[i] + 1];
+        dest[i] += gain * (s0 + frac[i] * (s1 - s0));
+    }
+}
+
+float dotProduct(const float* a, const float* b, int n) {
+    int i = 0;
+    float sum = 0.0f;
+#if MELODYKIT_RESAMPLER_AVX2
+    __m256 acc = _mm256_setzero_ps();
+    for (; i + 8 <= n; i += 8)
+        acc = _mm256_add_ps(acc, _mm256_mul_ps(_mm256_loadu_ps(a + i), _mm256_loadu_ps(b + i)));
+    alignas(32) float lanes[8];
+    _mm256_store_ps(lanes, acc);
+    for (float lane : lanes) sum += lane;
+#elif MELODYKIT_RESAMPLER_SSE2
+    __m128 acc = _mm_setzero_ps();
+    for (; i + 4 <= n; i += 4)
+        acc = _mm_add_ps(acc, _mm_mul_ps(_mm_loadu_ps(a + i), _mm_loadu_ps(b + i)));
+    alignas(16) float lanes[4];
+    _mm_store_ps(lanes, acc);
+    sum = lanes[0] + lanes[1] + lanes[2] + lanes[3];
+#elif MELODYKIT_RESAMPLER_NEON
+    float32x4_t acc = vdupq_n_f32(0.0f);
+    for (; i + 4 <= n; i += 4)
+        acc = vmlaq_f32(acc, vld1q_f32(a + i), vld1q_f32(b + i));
+    sum = vgetq_lane_f32(acc, 0) + vgetq_lane_f32(acc, 1) + vgetq_lane_f32(acc, 2) + vgetq_lane_f32(acc, 3);
+#endif
+    for (; i < n; ++i) sum += a[i] * b[i];
+    return sum;
+}
+
+int mixLinear(const juce::AudioBuffer<float>& source, int guardSamples, double& position, double ratio,
+              float* const* dest, int numDestChannels, int numFrames, float gain) {
+    const int length = source.getNumSamples();
+    const int numSourceChannels = source.getNumChannels();
+    // A zero guard sample stands in for the silence the last sample interpolates towards
+    const int tapLength = guardSamples > 0 ? length + 1 : length;
+
+    int32_t idx[chunkFrames];
+    float frac[chunkFrames];
+
+    int written = 0;
+    while (written < numFrames) {
+        // Unity rate needs no gathered positions, so it isn't chunked
+        const int chunk = (ratio == 1.0) ? numFrames - written : std::min(chunkFrames, numFrames - written);
+        const int inner = framesWithBothTaps(position, ratio, tapLength, chunk);
+
+        if (inner > 0) {
+            if (ratio == 1.0) {
+                // Unity rate: the taps are contiguous, so this is two scaled adds
+                const int i0 = (int)position;
+                const float f = (float)(position - i0);
+                for (int ch = 0; ch < numDestChannels; ++ch) {
+                    const float* src = source.getReadPointer(sourceChannelFor(ch, numSourceChannels), i0);
+                    float* out = dest[ch] + written;
+                    juce::FloatVectorOperations::addWithMultiply(out, src, gain * (1.0f - f), inner);
+                    if (f > 0.0f)
+                        juce::FloatVectorOperations::addWithMultiply(out, src + 1, gain * f, inner);
+                }
+            } else {
+                for (int i = 0; i < inner; ++i) {
+                    const double p = position + ratio * i;
+                    idx[i] = (int32_t)p;
+                    frac[i] = (float)(p - idx[i]);
+                }
+                for (int ch = 0; ch < numDestChannels; ++ch)
+                    mixGathered(source.getReadPointer(sourceChannelFor(ch, numSourceChannels)),
+                                idx, frac, dest[ch] + written, inner, gain);
+            }
+            position += ratio * inner;
+            written += inner;
+            if (inner == chunk) continue;
+        }
+
+        // Tail: the last source sample interpolates towards silence
+        while (written < numFrames) {
+            const int i0 = (int)position;
+            if (i0 >= length) return written;
+            const float f = (float)(position - i0);
+            for (int ch = 0; ch < numDestChannels; ++ch)
+                dest[ch][written] += gain * (1.0f - f) * source.getSample(sourceChannelFor(ch, numSourceChannels), i0);
+            position += ratio;
+            ++written;
+        }
+    }
+    return written;
+}
+
+// Blackman-windowed sinc, tabulated over [0, halfTaps] and linearly interpolated between entries
+struct SincTable {
+    static constexpr int halfTaps = 16;
+    static constexpr int resolution = 512;  // table entries per unit of x
+    static constexpr double maxStretch = 8.0; // widest anti-aliasing kernel (8 octaves down is silly anyway)
+
+    std::vector<float> values;
+
+    SincTable() : values((size_t)(halfTaps * resolution + 2), 0.0f) {
+        for (int i = 0; i <= halfTaps * resolution; ++i) {
+            const double x = (double)i / resolution;
+            const double t = x / halfTaps;
+            const double window = 0.42 + 0.5 * std::cos(juce::MathConstants<double>::pi * t)
+                                + 0.08 * std::cos(2.0 * juce::MathConstants<double>::pi * t);
+            const double px = juce::MathConstants<double>::pi * x;
+            const double sinc = (i == 0) ? 1.0 : std::sin(px) / px;
+            values[(size_t)i] = (float)(sinc * window);
+        }
+    }
+
+    float operator()(double x) const {
+        x = std::abs(x);
+        if (x >= (double)halfTaps) return 0.0f;
+        const double p = x * resolution;
+        const int i = (int)p;
+        const float f = (float)(p - i);
+        return values[(size_t)i] + f * (values[(size_t)i + 1] - values[(size_t)i]);
+    }
+
+    static const SincTable& get() {
+        static const SincTable table;
+        return table;
+    }
+};
+
+// Pitching up reads the source faster than the output rate: lower the cutoff to match
+double sincCutoff(double ratio) {
+    return (ratio > 1.0) ? 1.0 / std::min(ratio, SincTable::maxStretch) : 1.0;
+}
+
+// Source samples the sinc kernel reads either side of the read position
+int sincReach(double ratio) {
+    return (int)std::ceil(SincTable::halfTaps / sincCutoff(ratio));
+}
+
+int mixSinc(const juce::AudioBuffer<float>& source, double& position, double ratio,
+            float* const* dest, int numDestChannels, int numFrames, float gain) {
+    const SincTable& kernel = SincTable::get();
+    const int length = source.getNumSamples();
+    const int numSourceChannels = source.getNumChannels();
+
+    const double cutoff = sincCutoff(ratio);
+    const int reach = sincReach(ratio);
+    const int numTaps = 2 * reach;
+
+    // Offline only, so a per-call allocation is fine here
+    std::vector<float> weights((size_t)numTaps);
+
+    int written = 0;
+    for (; written < numFrames; ++written) {
+        const int centre = (int)std::floor(position);
+        if (centre >= length) break;
+        const double f = position - centre;
+
+        // Taps run from centre - reach + 1 to centre + reach; clip them to the source
+        const int first = centre - reach + 1;
+        const int lo = std::max(0, -first);
+        const int hi = std::min(numTaps, length - first);
+
+        for (int t = lo; t < hi; ++t)
+            weights[(size_t)t] = (float)cutoff * kernel(((double)(t - reach + 1) - f) * cutoff);
+
+        if (hi > lo) {
+            for (int ch = 0; ch < numDestChannels; ++ch) {
+                const float* src = source.getReadPointer(sourceChannelFor(ch, numSourceChannels));
+                dest[ch][written] += gain * dotProduct(src + first + lo, weights.data() + lo, hi - lo);
+            }
+        }
+        position += ratio;
+    }
+    return written;
+}
+
+int mixDecoded(const juce::AudioBuffer<float>& source, int guardSamples, double& position, double ratio,
+               float* const* dest, int numDestChannels, int numFrames, float gain, Quality quality) {
+    if (quality == Quality::sinc)
+        return mixSinc(source, position, ratio, dest, numDestChannels, numFrames, gain);
+    return mixLinear(source, guardSamples, position, ratio, dest, numDestChannels, numFrames, gain);
+}
+
+// Converts the span of the file the next frames read into a float window, plays that, and moves on.
+// Each window covers every tap of its frames plus a sample either side for rounding, and stops only
+// at the real end of the file, so the output matches the decoded kernels exactly.
+int mixMapped(juce::MemoryMappedAudioFormatReader& reader, int length, double& position, double ratio,
+              float* const* dest, int numDestChannels, int numFrames, float gain, Quality quality) {
+    const int numWindowChannels = std::min({(int)reader.numChannels, numDestChannels, maxWindowChannels});
+    const int reach = (quality == Quality::sinc) ? sincReach(ratio) : 1;
+    const int framesPerWindow = (int)std::max(1.0, std::min((double)numFrames,
+                                                            (windowFrames - 2 * reach - 4) / ratio + 1.0));
+
+    float storage[maxWindowChannels][windowFrames];
+    float* channels[maxWindowChannels] = { storage[0], storage[1] };
+
+    int written = 0;
+    while (written < numFrames) {
+        const int frames = std::min(framesPerWindow, numFrames - written);
+        const juce::int64 first = std::max<juce::int64>(0, (juce::int64)position - reach);
+        if (first >= length) break;
+        const juce::int64 end = std::min<juce::int64>(length, (juce::int64)(position + ratio * (frames - 1)) + reach + 2);
+
+        juce::AudioBuffer<float> window(channels, numWindowChannels, (int)(end - first));
+        reader.read(&window, 0, window.getNumSamples(), first, true, true);
+
+        juce::AudioBuffer<float> out(dest, numDestChannels, written, frames);
+        double localPosition = position - (double)first;
+        const int got = mixDecoded(window, 0, localPosition, ratio, out.getArrayOfWritePointers(), numDestChannels,
+                                   frames, gain, quality);
+        position = (double)first + localPosition;
+        written += got;
+        if (got < frames) break;
+    }
+    return written;
+}
+
+} // namespace
+
+int mix(const Source& source,
+        double& position,
+        double ratio,
+        float* const* dest,
+        int numDestChannels,
+        int numFrames,
+        float gain,
+        Quality quality) {
+    if (source.getNumSamples() <= 0 || source.getNumChannels() <= 0
+        || numFrames <= 0 || numDestChannels <= 0 || !(ratio > 0.0) || position < 0.0)
+        return 0;
+
+    if (source.mapped != nullptr)
+        return mixMapped(*source.mapped, source.getNumSamples(), position, ratio, dest, numDestChannels, numFrames,
+                         gain, quality);
+    return mixDecoded(*source.buffer, source.guardSamples, position, ratio, dest, numDestChannels, numFrames, gain, quality);
+}
+
+Quality qualityFromString(const juce::String& name) {
+    const auto lowered = name.trim().toLowerCase();
+    if (lowered == "sinc" || lowered == "high") return Quality::sinc;
+    return Quality::linear;
+}
+
+} // namespace Resampler
@@ -0,0 +1,61 @@
+#pragma once
+
+#include <juce_audio_basics/juce_audio_basics.h>
+#include <juce_audio_formats/juce_audio_formats.h>
+#include <limits>
+
+// Block-based sample playback kernel shared by the live voice engines and the offline renderer.
+// Each call mixes a whole block of one voice: read positions are computed once per block and
+// reused for every channel, bounds are resolved up front, and the inner loops run on
+// AVX2/SSE2/NEON with a scalar fallback.
+namespace Resampler {
+
+enum class Quality {
+    linear, // two-tap linear interpolation, used for live playback
+    sinc    // 32-tap Blackman-windowed sinc with anti-aliasing, for bounces
+};
+
+// What a voice plays: a decoded float buffer, or PCM left in a memory-mapped file, which the
+// kernel converts to float a short window at a time as it reads. Cheap to copy.
+struct Source {
+    // guard: zeroed samples readable past the end of every channel of decoded. With at least one
+    // the linear kernel plays the last sample without a bounds-checked tail.
+    Source(const juce::AudioBuffer<float>& decoded, int guard = 0)
+        : buffer(&decoded), numChannels(decoded.getNumChannels()), length(decoded.getNumSamples()),
+          guardSamples(guard) {}
+
+    // reader must have the whole file mapped. Reads from a mapping keep no state, so voices on any
+    // thread may share one reader.
+    explicit Source(juce::MemoryMappedAudioFormatReader& reader)
+        : mapped(&reader), numChannels((int)reader.numChannels),
+          length((int)juce::jmin<juce::int64>(reader.getMappedSection().getEnd(), std::numeric_limits<int>::max())) {}
+
+    int getNumChannels() const { return numChannels; }
+    int getNumSamples() const { return length; }
+
+    const juce::AudioBuffer<float>* buffer = nullptr;
+    juce::MemoryMappedAudioFormatReader* mapped = nullptr;
+    int numChannels = 0;
+    int length = 0;
+    int guardSamples = 0;
+};
+
+// Mixes up to numFrames output frames of source into dest, reading from position and advancing
+// by ratio source samples per frame. Output is added to dest and scaled by gain. Mono sources
+// feed every destination channel; extra destination channels reuse the last source channel.
+// position is advanced past the frames written. Returns the number of frames written, which is
+// less than numFrames once the source has run out. Mapped sources play exactly like decoded ones
+// into mono or stereo destinations; further destination channels repeat their second channel.
+int mix(const Source& source,
+        double& position,
+        double ratio,
+        float* const* dest,
+        int numDestChannels,
+        int numFrames,
+        float gain,
+        Quality quality = Quality::linear);
+
+// Parses "linear" / "sinc" (also accepts "high"); unknown names map to linear
+Quality qualityFromString(const juce::String& name);
+
+} // namespace Resampler
@@ -0,0 +1,163 @@
+#include "SampleCache.h"
+
+SampleCache::SampleCache(juce::AudioFormatManager& formatManagerToUse, juce::int64 memoryLimitBytes)
+    : formatManager(formatManagerToUse), memoryLimit(memoryLimitBytes) {}
+
+juce::int64 SampleCache::bytesFor(int numChannels, juce::int64 numSamples) {
+    return (juce::int64)numChannels * numSamples * (juce::int64)sizeof(float);
+}
+
+bool SampleCache::shouldCache(juce::int64 bytes) const {
+    return bytes <= memoryLimit / 4;
+}
+
+void SampleCache::setMapping(bool enabled, juce::int64 minFileBytes) {
+    mapThreshold = juce::jmax<juce::int64>(0, minFileBytes);
+    mappingEnabled = enabled;
+}
+
+bool SampleCache::shouldMap(const juce::File& file) const {
+    return createMappedReader(file) != nullptr;
+}
+
+std::unique_ptr<juce::MemoryMappedAudioFormatReader> SampleCache::createMappedReader(const juce::File& file) const {
+    if (!mappingEnabled.load() || file.getSize() < mapThreshold.load()) return nullptr;
+
+    // Formats that can't be read in place (compressed ones) have no mapped reader
+    auto* format = formatManager.findFormatForFileExtension(file.getFileExtension());
+    if (format == nullptr) return nullptr;
+    std::unique_ptr<juce::MemoryMappedAudioFormatReader> reader(format->createMemoryMappedReader(file));
+    if (!reader || reader->lengthInSamples <= 0 || reader->numChannels <= 0 || reader->sampleRate <= 0.0) return nullptr;
+    return reader;
+}
+
+std::shared_ptr<BeatSample> SampleCache::mapSample(std::unique_ptr<juce::MemoryMappedAudioFormatReader> reader) {
+    if (!reader->mapEntireFile()) return nullptr;
+
+    auto sample = std::make_shared<BeatSample>();
+    sample->sampleRate = reader->sampleRate;
+    sample->mapped = std::move(reader);
+    return sample;
+}
+
+std::shared_ptr<const BeatSample> SampleCache::load(const juce::File& file, juce::String& errorMessage) {
+    if (!file.existsAsFile()) {
+        errorMessage = "file-not-found: " + file.getFullPathName();
+        return nullptr;
+    }
+
+    const juce::String path = file.getFullPathName();
+    const juce::int64 fileSize = file.getSize();
+    const juce::int64 modificationTime = file.getLastModificationTime().toMilliseconds();
+
+    {
+        const juce::ScopedLock sl(lock);
+        if (auto sample = findLocked(path, fileSize, modificationTime)) {
+            ++hits;
+            return sample;
+        }
+        ++misses;
+    }
+
+    // Map or decode without holding the lock; if another thread got there first its copy wins
+    if (auto mappedReader = createMappedReader(file)) {
+        if (std::shared_ptr<const BeatSample> sample = mapSample(std::move(mappedReader))) {
+            const juce::ScopedLock sl(lock);
+            if (auto existing = findLocked(path, fileSize, modificationTime)) return existing;
+
+            entries.push_front({path, fileSize, modificationTime, sample, 0, true});
+            index[path] = entries.begin();
+            ++mappedEntries;
+            evictLocked();
+            return sample;
+        }
+    }
+
+    std::unique_ptr<juce::AudioFormatReader> reader(formatManager.createReaderFor(file));
+    if (!reader) {
+        errorMessage = "unsupported-format";
+        return nullptr;
+    }
+
+    const int numSamples = static_cast<int>(reader->lengthInSamples);
+    auto decoded = std::make_shared<BeatSample>();
+    decoded->sampleRate = reader->sampleRate;
+    decoded->buffer.setSize(static_cast<int>(reader->numChannels), juce::jmax(1, numSamples));
+    reader->read(&decoded->buffer, 0, numSamples, 0, true, true);
+
+    std::shared_ptr<const BeatSample> sample = std::move(decoded);
+    const juce::int64 bytes = bytesFor(sample->buffer.getNumChannels(), sample->buffer.getNumSamples());
+    if (!shouldCache(bytes)) return sample;
+
+    const juce::ScopedLock sl(lock);
+    if (auto existing = findLocked(path, fileSize, modificationTime)) return existing;
+
+    entries.push_front({path, fileSize, modificationTime, sample, bytes, false});
+    index[path] = entries.begin();
+    totalBytes += bytes;
+    evictLocked();
+    return sample;
+}
+
+std::shared_ptr<const BeatSample> SampleCache::find(const juce::File& file) {
+    if (!file.existsAsFile()) return nullptr;
+
+    const juce::ScopedLock sl(lock);
+    auto sample = findLocked(file.getFullPathName(), file.getSize(), file.getLastModificationTime().toMilliseconds());
+    if (sample) ++hits;
+    return sample;
+}
+
+std::shared_ptr<const BeatSample> SampleCache::findLocked(const juce::String& path, juce::int64 fileSize,
+                                                          juce::int64 modificationTime) {
+    auto it = index.find(path);
+    if (it == index.end()) return nullptr;
+
+    auto entry = it->second;
+    if (entry->fileSize != fileSize || entry->modificationTime != modificationTime) {
+        // The file changed on disk; holders of the old buffer keep it until they let go
+        eraseLocked(entry);
+        return nullptr;
+    }
+
+    entries.splice(entries.begin(), entries, entry);
+    return entry->sample;
+}
+
+SampleCache::EntryList::iterator SampleCache::eraseLocked(EntryList::iterator entry) {
+    totalBytes -= entry->bytes;
+    if (entry->mapped) --mappedEntries;
+    index.erase(entry->path);
+    return entries.erase(entry);
+}
+
+void SampleCache::evictLocked() {
+    // Entries still held elsewhere free nothing when dropped, so only idle ones are evicted
+    for (auto it = entries.end(); (totalBytes > memoryLimit || mappedEntries > maxMappedFiles) && it != entries.begin();) {
+        --it;
+        if (it->sample.use_count() > 1) continue;
+        // Dropping a mapping frees no heap, and dropping a decoded buffer closes no file
+        const bool helps = it->mapped ? mappedEntries > maxMappedFiles : totalBytes > memoryLimit;
+        if (!helps) continue;
+
+        it = eraseLocked(it);
+        ++evictions;
+    }
+}
+
+SampleCache::Stats SampleCache::getStats() const {
+    const juce::ScopedLock sl(lock);
+    Stats stats;
+    stats.entries = (int)entries.size();
+    stats.bytes = totalBytes;
+    for (const auto& entry : entries) {
+        if (entry.sample.use_count() > 1) stats.bytesInUse += entry.bytes;
+        if (entry.mapped) stats.mappedBytes += entry.fileSize;
+    }
+    stats.mappedEntries = mappedEntries;
+    stats.memoryLimit = memoryLimit;
+    stats.hits = hits;
+    stats.misses = misses;
+    stats.evictions = evictions;
+    return stats;
+}
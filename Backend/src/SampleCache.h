@@ -0,0 +1,95 @@
+#pragma once
+
+#include "BackendHost.h"
+#include <atomic>
+#include <list>
+#include <map>
+#include <memory>
+
+// Process-wide store of decoded samples, keyed by file identity (path, size and modification
+// time). Beat rows, sampler tracks and offline renders that use the same file share one
+// immutable buffer, and reloading or re-exporting an unchanged file skips the disk entirely.
+// Entries nobody else holds are evicted least recently used first once the cache is over its
+// memory cap. Thread-safe; decoding happens outside the lock.
+//
+// With mapping on, large WAV and AIFF files are memory mapped instead of decoded: loading one only
+// reads its header, and voices convert the rest to float as they play it, so the OS pages it in and out. Mapped files cost no heap and don't count
+// against the memory cap. A mapped file must not be rewritten in place while it is loaded.
+class SampleCache {
+public:
+    static constexpr juce::int64 defaultMemoryLimit = 512 * 1024 * 1024;
+    static constexpr juce::int64 defaultMapThreshold = 1024 * 1024; // file size
+    // Every mapping keeps its file open, so idle ones beyond this are dropped
+    static constexpr int maxMappedFiles = 128;
+
+    explicit SampleCache(juce::AudioFormatManager& formatManager, juce::int64 memoryLimitBytes = defaultMemoryLimit);
+
+    // Returns the decoded file, reading it only if no current copy is cached. Returns nullptr
+    // and fills errorMessage if the file is missing or can't be decoded.
+    std::shared_ptr<const BeatSample> load(const juce::File& file, juce::String& errorMessage);
+
+    // Returns the cached copy of file if it is current, without reading it
+    std::shared_ptr<const BeatSample> find(const juce::File& file);
+
+    // Whether a decoded buffer of this size is worth caching (a quarter of the cap at most), so a
+    // single long clip can't flush everything else
+    bool shouldCache(juce::int64 bytes) const;
+
+    // Maps files of at least minFileBytes from now on (their format permitting). Off by default;
+    // samples already loaded keep their storage.
+    void setMapping(bool enabled, juce::int64 minFileBytes = defaultMapThreshold);
+    bool isMappingEnabled() const { return mappingEnabled.load(); }
+    juce::int64 getMapThreshold() const { return mapThreshold.load(); }
+
+    // Whether load() would map file rather than decode it
+    bool shouldMap(const juce::File& file) const;
+
+    struct Stats {
+        int entries = 0;
+        juce::int64 bytes = 0;
+        juce::int64 bytesInUse = 0; // held by tracks or renders, so not evictable
+        juce::int64 memoryLimit = 0;
+        juce::int64 hits = 0;
+        juce::int64 misses = 0;
+        juce::int64 evictions = 0;
+        int mappedEntries = 0;
+        juce::int64 mappedBytes = 0; // file sizes; resident only as far as the OS paged them in
+    };
+    Stats getStats() const;
+
+    static juce::int64 bytesFor(int numChannels, juce::int64 numSamples);
+
+private:
+    struct Entry {
+        juce::String path;
+        juce::int64 fileSize = 0;
+        juce::int64 modificationTime = 0;
+        std::shared_ptr<const BeatSample> sample;
+        juce::int64 bytes = 0; // decoded size; 0 when mapped
+        bool mapped = false;
+    };
+    using EntryList = std::list<Entry>; // most recently used first
+
+    // Under lock: the entry for file if it still matches the file on disk, moved to the front
+    std::shared_ptr<const BeatSample> findLocked(const juce::String& path, juce::int64 fileSize,
+                                                 juce::int64 modificationTime);
+    EntryList::iterator eraseLocked(EntryList::iterator entry);
+    void evictLocked();
+
+    // A reader for file if it should be mapped, not mapped yet
+    std::unique_ptr<juce::MemoryMappedAudioFormatReader> createMappedReader(const juce::File& file) const;
+    // Maps the whole file; nullptr if that fails
+    std::shared_ptr<BeatSample> mapSample(std::unique_ptr<juce::MemoryMappedAudioFormatReader> reader);
+
+    juce::AudioFormatManager& formatManager;
+    const juce::int64 memoryLimit;
+    std::atomic<bool> mappingEnabled { false };
+    std::atomic<juce::int64> mapThreshold { defaultMapThreshold };
+
+    mutable juce::CriticalSection lock;
+    EntryList entries;
+    std::map<juce::String, EntryList::iterator> index; // path -> entry
+    juce::int64 totalBytes = 0;
+    int mappedEntries = 0;
+    juce::int64 hits = 0, misses = 0, evictions = 0;
+};
@@ -0,0 +1,101 @@
+#include "SamplerVoices.h"
+
+#include <cmath>
+
+namespace SamplerVoices {
+
+namespace {
+
+int toFrames(double sampleRate, double seconds) {
+    return juce::jmax(1, (int)std::lround(seconds * sampleRate));
+}
+
+} // namespace
+
+void Envelope::start(double sampleRate) {
+    stage = Stage::attack;
+    level = 0.0f;
+    framesLeft = toFrames(sampleRate, attackSeconds);
+    step = 1.0f / (float)framesLeft;
+}
+
+void Envelope::release(double sampleRate, double seconds) {
+    if (stage == Stage::finished) return;
+
+    const int frames = toFrames(sampleRate, seconds);
+    if (stage == Stage::release && framesLeft <= frames) return;
+
+    stage = Stage::release;
+    framesLeft = frames;
+    step = -level / (float)frames;
+}
+
+int Envelope::runLength(int maxFrames) const {
+    switch (stage) {
+        case Stage::sustain:
+            return maxFrames;
+        case Stage::finished:
+            return 0;
+        case Stage::attack:
+        case Stage::release:
+            break;
+    }
+    return juce::jmin(maxFrames, framesLeft);
+}
+
+void Envelope::advance(int numFrames) {
+    if (stage != Stage::attack && stage != Stage::release) return;
+
+    framesLeft -= numFrames;
+    if (framesLeft > 0) {
+        level += step * (float)numFrames;
+        return;
+    }
+
+    // Land exactly on the stage's target so rounding never leaves a voice hanging
+    if (stage == Stage::attack) {
+        stage = Stage::sustain;
+        level = 1.0f;
+    } else {
+        stage = Stage::finished;
+        level = 0.0f;
+    }
+    step = 0.0f;
+    framesLeft = 0;
+}
+
+int mix(const Resampler::Source& source, double& position, double ratio, Envelope& envelope, float gain,
+        juce::AudioBuffer<float>& dest, int destStartSample, int numFrames, juce::AudioBuffer<float>& scratch,
+        Resampler::Quality quality) {
+    const int numChannels = juce::jmin(dest.getNumChannels(), scratch.getNumChannels());
+    int written = 0;
+
+    while (written < numFrames && !envelope.isFinished()) {
+        const int run = envelope.runLength(numFrames - written);
+        const float startLevel = envelope.getLevel();
+
+        int got = 0;
+        if (envelope.isSustaining()) {
+            // Sustained: straight into the output, like an unenveloped voice
+            juce::AudioBuffer<float> view(dest.getArrayOfWritePointers(), numChannels, destStartSample + written, run);
+            got = Resampler::mix(source, position, ratio, view.getArrayOfWritePointers(), numChannels, run,
+                                 gain * startLevel, quality);
+            envelope.advance(got);
+        } else {
+            scratch.clear(0, run);
+            got = Resampler::mix(source, position, ratio, scratch.getArrayOfWritePointers(), numChannels, run, 1.0f,
+                                 quality);
+            envelope.advance(got);
+            for (int ch = 0; ch < numChannels; ++ch) {
+                dest.addFromWithRamp(ch, destStartSample + written, scratch.getReadPointer(ch), got,
+                                     gain * startLevel, gain * envelope.getLevel());
+            }
+        }
+
+        written += got;
+        if (got < run) break; // the sample ran out
+    }
+    return written;
+}
+
+} // namespace SamplerVoices
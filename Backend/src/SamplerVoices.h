@@ -0,0 +1,93 @@
+#pragma once
+
+#include "Resampler.h"
+#include "SoundFontBank.h"
+
+// Voice budget and envelopes of the sampler engine, shared by live playback and offline bounces
+// so an exported sampler track fades and steals exactly like it plays.
+//
+// The voice limit counts held notes only. A released or stolen voice fades out over a few
+// milliseconds in one of releaseHeadroom extra pool slots, so the CPU cost stays bounded at
+// maxVoices + releaseHeadroom voices while nothing ever stops with a click.
+namespace SamplerVoices {
+
+constexpr int maxVoices = 64;        // largest per-track voice limit
+constexpr int releaseHeadroom = 16;  // pool slots for voices that are fading out
+constexpr int poolSize = maxVoices + releaseHeadroom;
+
+constexpr double attackSeconds = 0.002;
+constexpr double releaseSeconds = 0.030; // note-off
+constexpr double stealSeconds = 0.005;   // stolen voices and stop-all
+
+// Linear attack / sustain / release amplitude envelope, advanced in runs of frames
+class Envelope {
+public:
+    void start(double sampleRate);
+
+    // Fades from the current level to silence over seconds. A voice already fading faster keeps
+    // its own release.
+    void release(double sampleRate, double seconds = releaseSeconds);
+
+    bool isSustaining() const { return stage == Stage::sustain; }
+    bool isReleasing() const { return stage == Stage::release || stage == Stage::finished; }
+    bool isFinished() const { return stage == Stage::finished; }
+    float getLevel() const { return level; }
+
+    // Frames until the envelope changes stage, at most maxFrames; the level ramps linearly
+    // across them
+    int runLength(int maxFrames) const;
+    void advance(int numFrames);
+
+private:
+    enum class Stage { attack, sustain, release, finished };
+
+    Stage stage = Stage::finished;
+    float level = 0.0f;
+    float step = 0.0f; // level change per frame, signed
+    int framesLeft = 0; // in the current attack or release
+};
+
+// Mixes up to numFrames of source into dest from destStartSample like Resampler::mix, scaled by
+// gain and shaped by envelope; advances position and the envelope. Ramped runs are resampled into
+// scratch first, which must hold numFrames frames. Returns the frames written, fewer than
+// numFrames once the sample has run out or the envelope has finished.
+int mix(const Resampler::Source& source, double& position, double ratio, Envelope& envelope, float gain,
+        juce::AudioBuffer<float>& dest, int destStartSample, int numFrames, juce::AudioBuffer<float>& scratch,
+        Resampler::Quality quality = Resampler::Quality::linear);
+
+// For a note-on: the index of the held voice the policy gives up, or -1 if the note should be
+// dropped instead (releasing). Voice needs envelope, gain and startOrder members.
+template <typename Voice>
+int findVoiceToSteal(const Voice* voices, int numVoices, SoundFontBank::VoiceStealing policy) {
+    if (policy == SoundFontBank::VoiceStealing::releasing) return -1;
+
+    int victim = -1;
+    for (int v = 0; v < numVoices; ++v) {
+        const auto& voice = voices[v];
+        if (voice.envelope.isReleasing()) continue;
+        if (victim < 0) {
+            victim = v;
+        } else if (policy == SoundFontBank::VoiceStealing::oldest) {
+            if (voice.startOrder < voices[victim].startOrder) victim = v;
+        } else if (voice.gain * voice.envelope.getLevel() < voices[victim].gain * voices[victim].envelope.getLevel()) {
+            victim = v;
+        }
+    }
+    return victim;
+}
+
+// For a note-on into a full pool: the quietest voice that is fading out, which is cut outright
+template <typename Voice>
+int findVoiceToCut(const Voice* voices, int numVoices) {
+    int victim = -1;
+    for (int v = 0; v < numVoices; ++v) {
+        const auto& voice = voices[v];
+        if (!voice.envelope.isReleasing()) continue;
+        if (victim < 0 || voice.gain * voice.envelope.getLevel() < voices[victim].gain * voices[victim].envelope.getLevel()) {
+            victim = v;
+        }
+    }
+    return victim;
+}
+
+} // namespace SamplerVoices
@@ -0,0 +1,164 @@
+#include "SessionFile.h"
+
+namespace SessionFile {
+
+namespace {
+
+constexpr int magic = 0x4e534b4d; // "MKSN"
+constexpr int currentVersion = 1;
+constexpr int maxTracks = 1 << 16;  // counts beyond these are corruption
+constexpr int maxBeatRows = 1 << 16;
+constexpr juce::int64 stateChunkBytes = 1 << 20;
+
+void writeFile(juce::OutputStream& out, const juce::File& file) {
+    out.writeString(file == juce::File() ? juce::String() : file.getFullPathName());
+}
+
+juce::File readFile(juce::InputStream& in) {
+    const juce::String path = in.readString();
+    return juce::File::isAbsolutePath(path) ? juce::File(path) : juce::File();
+}
+
+void writeTrack(juce::OutputStream& out, const SessionTrack& track) {
+    out.writeString(track.trackId);
+    out.writeFloat(track.gainLinear);
+    out.writeBool(track.muted);
+    out.writeBool(track.soloed);
+
+    out.writeByte((char)track.instrument);
+    writeFile(out, track.instrumentFile);
+    out.writeInt64((juce::int64)track.pluginState.getSize());
+    out.write(track.pluginState.getData(), track.pluginState.getSize());
+    out.writeInt(track.sf2Bank);
+    out.writeInt(track.sf2Preset);
+    out.writeInt(track.sf2VoiceLimit);
+    out.writeByte((char)track.sf2VoiceStealing);
+
+    writeFile(out, track.samplerFile);
+    out.writeInt(track.samplerVoiceLimit);
+    out.writeByte((char)track.samplerVoiceStealing);
+
+    out.writeInt((int)track.beatRows.size());
+    for (const auto& [rowId, file] : track.beatRows) {
+        out.writeString(rowId);
+        writeFile(out, file);
+    }
+}
+
+SoundFontBank::VoiceStealing readPolicy(juce::InputStream& in, SoundFontBank::VoiceStealing fallback) {
+    const int value = in.readByte();
+    return value >= 0 && value <= (int)SoundFontBank::VoiceStealing::quietest ? (SoundFontBank::VoiceStealing)value
+                                                                             : fallback;
+}
+
+// Reads size bytes a chunk at a time, so a corrupt size fails where the data ends instead of
+// allocating it all up front (the decompressed stream can't tell how much is left)
+bool readBlock(juce::InputStream& in, juce::MemoryBlock& block, juce::int64 size) {
+    const juce::int64 remaining = in.getNumBytesRemaining(); // -1 when unknown
+    if (size < 0 || (remaining >= 0 && size > remaining)) return false;
+    block.setSize(0);
+    while ((juce::int64)block.getSize() < size) {
+        const size_t offset = block.getSize();
+        const int chunk = (int)juce::jmin(stateChunkBytes, size - (juce::int64)offset);
+        block.setSize(offset + (size_t)chunk);
+        if (in.read(static_cast<char*>(block.getData()) + offset, chunk) != chunk) return false;
+    }
+    return true;
+}
+
+bool readTrack(juce::InputStream& in, SessionTrack& track) {
+    track.trackId = in.readString();
+    track.gainLinear = in.readFloat();
+    track.muted = in.readBool();
+    track.soloed = in.readBool();
+
+    const int instrument = in.readByte();
+    if (instrument < 0 || instrument > (int)SessionTrack::Instrument::sf2) return false;
+    track.instrument = (SessionTrack::Instrument)instrument;
+    track.instrumentFile = readFile(in);
+    if (!readBlock(in, track.pluginState, in.readInt64())) return false;
+    track.sf2Bank = in.readInt();
+    track.sf2Preset = in.readInt();
+    track.sf2VoiceLimit = in.readInt();
+    track.sf2VoiceStealing = readPolicy(in, SoundFontBank::VoiceStealing::releasing);
+
+    track.samplerFile = readFile(in);
+    track.samplerVoiceLimit = in.readInt();
+    track.samplerVoiceStealing = readPolicy(in, SoundFontBank::VoiceStealing::oldest);
+
+    const int numRows = in.readInt();
+    if (numRows < 0 || numRows > maxBeatRows) return false;
+    for (int i = 0; i < numRows; ++i) {
+        if (in.isExhausted()) return false;
+        const juce::String rowId = in.readString();
+        track.beatRows[rowId] = readFile(in);
+    }
+    return track.trackId.isNotEmpty();
+}
+
+} // namespace
+
+bool write(const Session& session, const juce::File& file, juce::String& errorMessage) {
+    juce::TemporaryFile temp(file);
+    {
+        std::unique_ptr<juce::FileOutputStream> fileStream(temp.getFile().createOutputStream());
+        if (fileStream == nullptr || fileStream->failedToOpen()) {
+            errorMessage = "Failed to create session file: " + file.getFullPathName();
+            return false;
+        }
+        fileStream->writeInt(magic);
+        fileStream->writeInt(currentVersion);
+
+        juce::GZIPCompressorOutputStream out(*fileStream);
+        out.writeInt((int)session.tracks.size());
+        for (const auto& track : session.tracks) writeTrack(out, track);
+        out.flush(); // also ends the compressed stream
+        fileStream->flush();
+        if (fileStream->getStatus().failed()) {
+            errorMessage = "Failed to write session file: " + fileStream->getStatus().getErrorMessage();
+            return false;
+        }
+    }
+
+    if (!temp.overwriteTargetFileWithTemporary()) {
+        errorMessage = "Failed to write session file: " + file.getFullPathName();
+        return false;
+    }
+    return true;
+}
+
+bool read(const juce::File& file, Session& session, juce::String& errorMessage) {
+    std::unique_ptr<juce::FileInputStream> fileStream(file.createInputStream());
+    if (fileStream == nullptr || fileStream->failedToOpen()) {
+        errorMessage = "Failed to open session file: " + file.getFullPathName();
+        return false;
+    }
+    if (fileStream->readInt() != magic) {
+        errorMessage = "Not a session file: " + file.getFullPathName();
+        return false;
+    }
+    if (fileStream->readInt() > currentVersion) {
+        errorMessage = "Session file is from a newer version: " + file.getFullPathName();
+        return false;
+    }
+
+    juce::GZIPDecompressorInputStream in(*fileStream);
+    const int numTracks = in.readInt();
+    if (numTracks < 0 || numTracks > maxTracks) {
+        errorMessage = "Corrupt session file: " + file.getFullPathName();
+        return false;
+    }
+
+    session.tracks.clear();
+    for (int i = 0; i < numTracks; ++i) {
+        SessionTrack track;
+        if (in.isExhausted() || !readTrack(in, track)) {
+            errorMessage = "Corrupt session file: " + file.getFullPathName();
+            return false;
+        }
+        session.tracks.push_back(std::move(track));
+    }
+    return true;
+}
+
+} // namespace SessionFile
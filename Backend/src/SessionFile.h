@@ -0,0 +1,48 @@
+#pragma once
+
+#include "SoundFontBank.h"
+
+#include <juce_core/juce_core.h>
+#include <map>
+#include <vector>
+
+// Every track's live state in one compressed binary file, for SAVE_SESSION and LOAD_SESSION:
+// plugin state blobs travel as raw bytes instead of base64 lines through the pipe. Files and
+// samples are referenced by path, not embedded.
+struct SessionTrack {
+    enum class Instrument { none, plugin, sf2 };
+
+    juce::String trackId;
+    float gainLinear = 1.0f;
+    bool muted = false;
+    bool soloed = false;
+
+    Instrument instrument = Instrument::none;
+    juce::File instrumentFile;     // plugin bundle or .sf2
+    juce::MemoryBlock pluginState; // getStateInformation
+    int sf2Bank = 0;
+    int sf2Preset = 0;
+    int sf2VoiceLimit = SoundFontBank::maxVoices;
+    SoundFontBank::VoiceStealing sf2VoiceStealing = SoundFontBank::VoiceStealing::releasing;
+
+    juce::File samplerFile; // none if the track has no sampler
+    int samplerVoiceLimit = 0;
+    SoundFontBank::VoiceStealing samplerVoiceStealing = SoundFontBank::VoiceStealing::oldest;
+
+    std::map<juce::String, juce::File> beatRows; // rowId -> sample
+};
+
+struct Session {
+    std::vector<SessionTrack> tracks;
+};
+
+namespace SessionFile {
+
+// Writes session to a temporary file next to file (gzip, after a short uncompressed header) and
+// swaps it in once complete. Any thread.
+bool write(const Session& session, const juce::File& file, juce::String& errorMessage);
+
+// Any thread. Fails for files that aren't sessions or come from a newer version.
+bool read(const juce::File& file, Session& session, juce::String& errorMessage);
+
+} // namespace SessionFile
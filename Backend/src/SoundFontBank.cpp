@@ -0,0 +1,190 @@
+#define TSF_IMPLEMENTATION
+#include "../TinySoundFont/tsf.h"
+
+#include "SoundFontBank.h"
+
+#include <list>
+#include <map>
+
+namespace SoundFontBank {
+
+namespace {
+
+struct Font {
+    juce::String path;
+    juce::int64 fileSize = 0;
+    juce::int64 modificationTime = 0;
+    tsf* master = nullptr; // never rendered, only copied
+    int instances = 0;
+};
+
+struct Registry {
+    juce::CriticalSection lock;
+    std::list<Font> fonts; // a changed file can briefly have two entries: the old one until released
+    std::map<tsf*, std::list<Font>::iterator> instances;
+
+    // Under lock
+    tsf* copyFrom(std::list<Font>::iterator font) {
+        tsf* instance = tsf_copy(font->master);
+        if (instance == nullptr) return nullptr;
+        if (!tsf_set_max_voices(instance, maxVoices)) {
+            tsf_close(instance);
+            return nullptr;
+        }
+        ++font->instances;
+        instances[instance] = font;
+        return instance;
+    }
+
+    std::list<Font>::iterator find(const juce::String& path, juce::int64 fileSize, juce::int64 modificationTime) {
+        for (auto it = fonts.begin(); it != fonts.end(); ++it) {
+            if (it->path == path && it->fileSize == fileSize && it->modificationTime == modificationTime) return it;
+        }
+        return fonts.end();
+    }
+};
+
+Registry& getRegistry() {
+    static Registry registry;
+    return registry;
+}
+
+} // namespace
+
+tsf* acquire(const juce::File& file, juce::String& errorMessage) {
+    if (!file.existsAsFile()) {
+        errorMessage = "SF2 file not found: " + file.getFullPathName();
+        return nullptr;
+    }
+
+    auto& registry = getRegistry();
+    const juce::String path = file.getFullPathName();
+    const juce::int64 fileSize = file.getSize();
+    const juce::int64 modificationTime = file.getLastModificationTime().toMilliseconds();
+
+    {
+        const juce::ScopedLock sl(registry.lock);
+        auto font = registry.find(path, fileSize, modificationTime);
+        if (font != registry.fonts.end()) return registry.copyFrom(font);
+    }
+
+    // Parse without holding the lock; if another thread loaded the same file meanwhile, use theirs
+    tsf* master = tsf_load_filename(path.toRawUTF8());
+    if (master == nullptr) {
+        errorMessage = "Failed to load SF2 file (invalid format or corrupted)";
+        return nullptr;
+    }
+
+    const juce::ScopedLock sl(registry.lock);
+    auto font = registry.find(path, fileSize, modificationTime);
+    if (font != registry.fonts.end()) {
+        tsf_close(master);
+    } else {
+        font = registry.fonts.insert(registry.fonts.end(), {path, fileSize, modificationTime, master, 0});
+    }
+
+    tsf* instance = registry.copyFrom(font);
+    if (instance == nullptr) errorMessage = "Out of memory copying SF2 instance";
+    return instance;
+}
+
+tsf* copy(tsf* instance) {
+    if (instance == nullptr) return nullptr;
+
+    auto& registry = getRegistry();
+    const juce::ScopedLock sl(registry.lock);
+    auto it = registry.instances.find(instance);
+    if (it == registry.instances.end()) { // not from the registry
+        tsf* other = tsf_copy(instance);
+        if (other != nullptr) tsf_set_max_voices(other, maxVoices);
+        return other;
+    }
+    return registry.copyFrom(it->second);
+}
+
+void release(tsf* instance) {
+    if (instance == nullptr) return;
+
+    auto& registry = getRegistry();
+    const juce::ScopedLock sl(registry.lock);
+    auto it = registry.instances.find(instance);
+    tsf_close(instance);
+    if (it == registry.instances.end()) return;
+
+    auto font = it->second;
+    registry.instances.erase(it);
+    if (--font->instances == 0) {
+        tsf_close(font->master);
+        registry.fonts.erase(font);
+    }
+}
+
+bool parseVoiceStealing(const juce::String& name, VoiceStealing& policy) {
+    if (name == "releasing") policy = VoiceStealing::releasing;
+    else if (name == "oldest") policy = VoiceStealing::oldest;
+    else if (name == "quietest") policy = VoiceStealing::quietest;
+    else return false;
+    return true;
+}
+
+juce::String getVoiceStealingName(VoiceStealing policy) {
+    switch (policy) {
+        case VoiceStealing::oldest: return "oldest";
+        case VoiceStealing::quietest: return "quietest";
+        case VoiceStealing::releasing: break;
+    }
+    return "releasing";
+}
+
+void enforceVoiceLimit(tsf* instance, int voiceLimit, VoiceStealing policy) {
+    if (instance == nullptr) return;
+    voiceLimit = juce::jlimit(1, maxVoices, voiceLimit);
+
+    for (;;) {
+        // All voices of one note-on share a play index; the highest belongs to the note just started
+        int playing = 0;
+        unsigned int newest = 0;
+        for (int i = 0; i < instance->voiceNum; ++i) {
+            const auto& voice = instance->voices[i];
+            if (voice.playingPreset == -1) continue;
+            ++playing;
+            newest = juce::jmax(newest, voice.playIndex);
+        }
+        if (playing <= voiceLimit) return;
+
+        struct tsf_voice* releasing = nullptr;
+        struct tsf_voice* held = nullptr;
+        struct tsf_voice* fresh = nullptr;
+        for (int i = 0; i < instance->voiceNum; ++i) {
+            auto* voice = &instance->voices[i];
+            if (voice->playingPreset == -1) continue;
+
+            if (voice->ampenv.segment == TSF_SEGMENT_RELEASE) {
+                if (releasing == nullptr || voice->ampenv.level < releasing->ampenv.level) releasing = voice;
+            } else if (voice->playIndex == newest) {
+                if (fresh == nullptr) fresh = voice;
+            } else if (held == nullptr
+                       || (policy == VoiceStealing::oldest ? voice->playIndex < held->playIndex
+                                                           : voice->ampenv.level < held->ampenv.level)) {
+                held = voice;
+            }
+        }
+
+        struct tsf_voice* victim = releasing;
+        if (victim == nullptr) victim = policy == VoiceStealing::releasing ? fresh : held;
+        if (victim == nullptr) victim = fresh != nullptr ? fresh : held;
+        if (victim == nullptr) return;
+        tsf_voice_kill(victim);
+    }
+}
+
+Stats getStats() {
+    auto& registry = getRegistry();
+    const juce::ScopedLock sl(registry.lock);
+    Stats stats;
+    stats.fonts = (int)registry.fonts.size();
+    stats.instances = (int)registry.instances.size();
+    return stats;
+}
+
+} // namespace SoundFontBank
@@ -0,0 +1,46 @@
+#pragma once
+
+#include <juce_core/juce_core.h>
+
+typedef struct tsf tsf;
+
+// Process-wide registry of parsed SoundFonts. Each .sf2 file (by path, size and modification time)
+// is parsed once; every track, and every render of a track, gets its own lightweight tsf_copy over
+// the shared presets and sample pool. The font is freed when its last instance is released.
+// Thread-safe: TinySoundFont's own reference count is not atomic, so instances of registry fonts
+// must be copied and closed through here rather than with tsf_copy/tsf_close.
+namespace SoundFontBank {
+
+// A new instance over file's font, parsing the file only if it isn't loaded already. Returns
+// nullptr and fills errorMessage on failure.
+tsf* acquire(const juce::File& file, juce::String& errorMessage);
+
+// Another instance over the same font as instance (voices and channel state are not copied)
+tsf* copy(tsf* instance);
+
+// Closes an instance from acquire or copy. Safe to call with nullptr.
+void release(tsf* instance);
+
+// Voices preallocated in every instance, so note-ons never allocate on the audio thread. Also the
+// largest per-track voice limit.
+constexpr int maxVoices = 256;
+
+// How a note-on that takes an instance over its voice limit makes room. Voices that are already
+// releasing go first (the quietest of them); when none is left, releasing drops the new note,
+// oldest stops the longest-playing note and quietest the voice at the lowest envelope level.
+enum class VoiceStealing { releasing, oldest, quietest };
+
+bool parseVoiceStealing(const juce::String& name, VoiceStealing& policy);
+juce::String getVoiceStealingName(VoiceStealing policy);
+
+// Call right after a note-on: stops voices until no more than voiceLimit are playing. Doesn't
+// allocate or lock, so it is safe on the audio thread.
+void enforceVoiceLimit(tsf* instance, int voiceLimit, VoiceStealing policy);
+
+struct Stats {
+    int fonts = 0;     // files held in memory
+    int instances = 0; // live track and render instances over them
+};
+Stats getStats();
+
+} // namespace SoundFontBank
@@ -0,0 +1,57 @@
+#include "StemCache.h"
+
+#include <algorithm>
+
+StemCache::StemCache(const juce::File& directoryToUse, juce::int64 sizeLimitBytes)
+    : directory(directoryToUse), sizeLimit(sizeLimitBytes) {}
+
+juce::File StemCache::defaultDirectory() {
+    return juce::File::getSpecialLocation(juce::File::userApplicationDataDirectory)
+        .getChildFile("MelodyKit")
+        .getChildFile("Stems");
+}
+
+StemCache::Key& StemCache::Key::add(const void* data, size_t numBytes) {
+    const auto* bytes = static_cast<const juce::uint8*>(data);
+    for (size_t i = 0; i < numBytes; ++i) {
+        hash = (hash ^ bytes[i]) * 1099511628211ull;
+    }
+    return *this;
+}
+
+StemCache::Key& StemCache::Key::add(const juce::String& text) {
+    // Length first so ("ab", "c") and ("a", "bc") differ
+    const auto utf8 = text.toUTF8();
+    const auto numBytes = (juce::int64)utf8.sizeInBytes();
+    add(numBytes);
+    return add(utf8.getAddress(), (size_t)numBytes);
+}
+
+juce::File StemCache::getStemFile(const Key& key) const {
+    directory.createDirectory();
+    return directory.getChildFile(key.toString() + ".wav");
+}
+
+juce::File StemCache::find(const Key& key) const {
+    const auto file = directory.getChildFile(key.toString() + ".wav");
+    if (!file.existsAsFile()) return {};
+
+    file.setLastAccessTime(juce::Time::getCurrentTime());
+    return file;
+}
+
+void StemCache::trim() const {
+    auto files = directory.findChildFiles(juce::File::findFiles, false, "*.wav");
+    juce::int64 total = 0;
+    for (const auto& file : files) total += file.getSize();
+    if (total <= sizeLimit) return;
+
+    std::sort(files.begin(), files.end(), [](const juce::File& a, const juce::File& b) {
+        return a.getLastAccessTime() < b.getLastAccessTime();
+    });
+    for (const auto& file : files) {
+        if (total <= sizeLimit) break;
+        const auto size = file.getSize();
+        if (file.deleteFile()) total -= size; // a stem that is playing may refuse (Windows)
+    }
+}
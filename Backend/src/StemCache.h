@@ -0,0 +1,44 @@
+#pragma once
+
+#include <juce_core/juce_core.h>
+
+// Rendered stems kept on disk and named by a hash of everything that determines their audio, so
+// a track whose notes and instrument haven't changed is never rendered twice. Files live in
+// <user app data>/MelodyKit/Stems; the least recently used ones are deleted once the folder
+// grows past its size cap. Thread-safe (it only touches the file system).
+class StemCache {
+public:
+    static constexpr juce::int64 defaultSizeLimit = (juce::int64)4 * 1024 * 1024 * 1024;
+
+    explicit StemCache(const juce::File& directory = defaultDirectory(), juce::int64 sizeLimitBytes = defaultSizeLimit);
+
+    static juce::File defaultDirectory();
+
+    // 64-bit FNV-1a over the values added, in order
+    class Key {
+    public:
+        Key& add(const void* data, size_t numBytes);
+        Key& add(const juce::String& text);
+        Key& add(const juce::MemoryBlock& block) { return add(block.getData(), block.getSize()); }
+        Key& add(juce::int64 value) { return add(&value, sizeof(value)); }
+        Key& add(double value) { return add(&value, sizeof(value)); }
+
+        juce::String toString() const { return juce::String::toHexString((juce::int64)hash).paddedLeft('0', 16); }
+
+    private:
+        juce::uint64 hash = 14695981039346656037ull;
+    };
+
+    // Where the stem for key is (or would be) stored
+    juce::File getStemFile(const Key& key) const;
+
+    // The stem for key if it has been rendered, marked as just used; otherwise File()
+    juce::File find(const Key& key) const;
+
+    // Deletes least recently used stems until the folder fits the size cap
+    void trim() const;
+
+private:
+    const juce::File directory;
+    const juce::int64 sizeLimit;
+};
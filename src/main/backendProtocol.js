@@ -0,0 +1,113 @@
+// Encoder for the backend's framed binary stdin protocol (Backend/src/BinaryProtocol.h).
+// Enabled by spawning the backend with --protocol=binary.
+
+const FRAME_VERSION = 1
+const TEXT_FRAME = 1
+const EVENTS_FRAME = 2
+const HEADER_SIZE = 8
+const RECORD_SIZE = 24
+const MAX_STRINGS = 255
+const MAX_EVENTS = 0xffff
+
+export const EVENT_KIND = {
+  note: 1,
+  beat: 2,
+  samplerNote: 3,
+  samplerOff: 4,
+  panic: 5
+}
+
+const ALL_TRACKS = 0xff
+
+const frameHeader = (type, payloadSize) => {
+  const header = Buffer.alloc(HEADER_SIZE)
+  header.write('MK', 0, 'latin1')
+  header.writeUInt8(FRAME_VERSION, 2)
+  header.writeUInt8(type, 3)
+  header.writeUInt32LE(payloadSize, 4)
+  return header
+}
+
+// One or more newline-separated text commands in a single frame
+export const encodeTextFrame = (lines) => {
+  const text = Array.isArray(lines) ? lines.join('\n') : String(lines)
+  const payload = Buffer.from(text, 'utf8')
+  return Buffer.concat([frameHeader(TEXT_FRAME, payload.length), payload])
+}
+
+const toVelocity127 = (velocity) => {
+  const v = Number(velocity)
+  if (!Number.isFinite(v)) return 102
+  // Accept 0..1 or 0..127 like the text NOTE_ON command
+  return Math.max(0, Math.min(127, Math.round(v <= 1 ? v * 127 : v)))
+}
+
+// Encodes events shaped like { kind, trackId, rowId, note, velocity, gain, durationMs, channel, atMs }
+// into as many events frames as needed (each frame holds at most 255 distinct ids).
+export const encodeEventFrames = (events) => {
+  const frames = []
+  let strings = []
+  let indexOf = new Map()
+  let records = []
+
+  const flushFrame = () => {
+    if (records.length === 0) return
+    const stringBytes = strings.map((s) => Buffer.from(s, 'utf8').subarray(0, 255))
+    const tableSize = stringBytes.reduce((n, b) => n + 1 + b.length, 1)
+    const payload = Buffer.alloc(tableSize + 2 + records.length * RECORD_SIZE)
+    let pos = 0
+    payload.writeUInt8(strings.length, pos++)
+    for (const b of stringBytes) {
+      payload.writeUInt8(b.length, pos++)
+      b.copy(payload, pos)
+      pos += b.length
+    }
+    payload.writeUInt16LE(records.length, pos)
+    pos += 2
+    for (const r of records) {
+      r.copy(payload, pos)
+      pos += RECORD_SIZE
+    }
+    frames.push(Buffer.concat([frameHeader(EVENTS_FRAME, payload.length), payload]))
+    strings = []
+    indexOf = new Map()
+    records = []
+  }
+
+  const encodeRecord = (ev, trackIndex, rowIndex) => {
+    const r = Buffer.alloc(RECORD_SIZE)
+    r.writeUInt8(EVENT_KIND[ev.kind] || 0, 0)
+    r.writeUInt8(trackIndex, 1)
+    r.writeUInt8(rowIndex, 2)
+    r.writeUInt8(Math.max(1, Math.min(16, Number(ev.channel) || 1)), 3)
+    r.writeUInt8(Math.max(0, Math.min(127, Math.round(Number(ev.note) || 0))), 4)
+    r.writeUInt8(toVelocity127(ev.velocity ?? 0.8), 5)
+    r.writeFloatLE(Number.isFinite(Number(ev.gain)) ? Number(ev.gain) : 1, 8)
+    r.writeUInt32LE(Math.max(0, Math.min(0xffffffff, Math.round(Number(ev.durationMs) || 0))), 12)
+    const at = Number(ev.atMs)
+    r.writeDoubleLE(Number.isFinite(at) && at > 0 ? at : 0, 16)
+    return r
+  }
+
+  for (const ev of events || []) {
+    if (!ev || !EVENT_KIND[ev.kind]) continue
+    const ids = []
+    if (ev.trackId) ids.push(String(ev.trackId))
+    if (ev.kind === 'beat' && ev.rowId) ids.push(String(ev.rowId))
+    const newIds = ids.filter((id) => !indexOf.has(id))
+    if (strings.length + newIds.length > MAX_STRINGS || records.length >= MAX_EVENTS) flushFrame()
+
+    const intern = (id) => {
+      if (!indexOf.has(id)) {
+        indexOf.set(id, strings.length)
+        strings.push(id)
+      }
+      return indexOf.get(id)
+    }
+    const trackIndex = ev.trackId ? intern(String(ev.trackId)) : ALL_TRACKS
+    const rowIndex = ev.kind === 'beat' && ev.rowId ? intern(String(ev.rowId)) : 0
+    records.push(encodeRecord(ev, trackIndex, rowIndex))
+  }
+  flushFrame()
+  return frames
+}
@@ -5,6 +5,7 @@ import icon from '../../resources/icon.png?asset'
 import fs from 'fs'
 import path from 'path'
 import { pathToFileURL } from 'url'
+import { encodeTextFrame, encodeEventFrames } from './backendProtocol'
 
 // Unified helper for resolving files in the resources directory
 // Handles asar/unpacked and asar=false layouts
@@ -135,6 +136,8 @@ app.whenReady().then(() => {
 
   // Backend process bridge
   let backendProc = null
+  // MELODYKIT_BACKEND_PROTOCOL=binary switches stdin to framed binary commands (Backend/README.md)
+  const backendBinaryProtocol = process.env.MELODYKIT_BACKEND_PROTOCOL === 'binary'
   const spawnBackendIfAvailable = () => {
     if (backendProc) return backendProc
     const candidates = []
@@ -158,7 +161,7 @@ app.whenReady().then(() => {
     }
 
     const { spawn } = require('child_process')
-    backendProc = spawn(exe, [], { stdio: ['pipe', 'pipe', 'pipe'] })
+    backendProc = spawn(exe, backendBinaryProtocol ? ['--protocol=binary'] : [], { stdio: ['pipe', 'pipe', 'pipe'] })
 
     // Buffer for accumulating incomplete lines
     let stdoutBuffer = ''
@@ -200,17 +203,29 @@ app.whenReady().then(() => {
     return backendProc
   }
 
+  // Writes one command line to the backend, framed when the binary protocol is active
+  const writeBackendLine = (proc, line) => {
+    if (backendBinaryProtocol) proc.stdin.write(encodeTextFrame(line))
+    else proc.stdin.write(line + '\n')
+  }
+
   const sendToBackend = (line) => {
     const p = spawnBackendIfAvailable()
     if (!p) return { ok: false, error: 'backend-not-found' }
     try {
-      p.stdin.write(line + '\n')
+      writeBackendLine(p, line)
       return { ok: true }
     } catch (e) {
       return { ok: false, error: String(e) }
     }
   }
 
+  // Optional ` at=<ms>` suffix for notes scheduled ahead on the engine clock
+  const scheduledSuffix = (atMs) => {
+    const t = Number(atMs)
+    return Number.isFinite(t) && t > 0 ? ` at=${t.toFixed(3)}` : ''
+  }
+
   ipcMain.handle('backend:send', async (event, line) => {
     return sendToBackend(line)
   })
@@ -265,18 +280,52 @@ app.whenReady().then(() => {
     }
   })
 
-  ipcMain.handle('backend:note-on', async (event, { trackId, note = 60, velocity = 0.8, durationMs = 500, channel = 1 } = {}) => {
+  ipcMain.handle('backend:note-on', async (event, { trackId, note = 60, velocity = 0.8, durationMs = 500, channel = 1, atMs } = {}) => {
     try {
       if (!trackId) {
         return { ok: false, error: 'missing-track-id' }
       }
-      const line = `NOTE_ON ${trackId} ${note} ${velocity} ${durationMs} ${channel}`
+      const line = `NOTE_ON ${trackId} ${note} ${velocity} ${durationMs} ${channel}${scheduledSuffix(atMs)}`
       return sendToBackend(line)
     } catch (e) {
       return { ok: false, error: String(e) }
     }
   })
 
+  // Sends a batch of realtime events in one write: a single events frame in binary mode,
+  // otherwise the equivalent text commands joined into one chunk
+  ipcMain.handle('backend:note-batch', async (event, events = []) => {
+    try {
+      if (!Array.isArray(events) || events.length === 0) return { ok: true }
+      const p = spawnBackendIfAvailable()
+      if (!p) return { ok: false, error: 'backend-not-found' }
+      if (backendBinaryProtocol) {
+        for (const frame of encodeEventFrames(events)) p.stdin.write(frame)
+        return { ok: true }
+      }
+      const lines = []
+      for (const ev of events) {
+        if (!ev) continue
+        const at = scheduledSuffix(ev.atMs)
+        if (ev.kind === 'note' && ev.trackId) {
+          lines.push(`NOTE_ON ${ev.trackId} ${ev.note ?? 60} ${ev.velocity ?? 0.8} ${ev.durationMs ?? 500} ${ev.channel ?? 1}${at}`)
+        } else if (ev.kind === 'beat' && ev.trackId && ev.rowId) {
+          lines.push(`TRIGGER_BEAT ${ev.trackId} ${ev.rowId} ${ev.gain ?? 1}${at}`)
+        } else if (ev.kind === 'samplerNote' && ev.trackId) {
+          lines.push(`TRIGGER_SAMPLER ${ev.trackId} ${ev.note} ${ev.velocity ?? 0.8} ${ev.durationMs ?? 0}${at}`)
+        } else if (ev.kind === 'samplerOff' && ev.trackId) {
+          lines.push(`STOP_SAMPLER_NOTE ${ev.trackId} ${ev.note}${at}`)
+        } else if (ev.kind === 'panic') {
+          lines.push(`PANIC ${ev.trackId || ''}`)
+        }
+      }
+      if (lines.length > 0) p.stdin.write(lines.join('\n') + '\n')
+      return { ok: true }
+    } catch (e) {
+      return { ok: false, error: String(e) }
+    }
+  })
+
   ipcMain.handle('backend:load-beat-sample', async (event, { trackId, rowId, path: samplePath }) => {
     try {
       if (!trackId || !rowId || !samplePath) {
@@ -290,11 +339,11 @@ app.whenReady().then(() => {
     }
   })
 
-  ipcMain.handle('backend:trigger-beat', async (event, { trackId, rowId, gain = 1.0 }) => {
+  ipcMain.handle('backend:trigger-beat', async (event, { trackId, rowId, gain = 1.0, atMs }) => {
     try {
       if (!trackId || !rowId) return { ok: false, error: 'missing-track-or-row' }
       const g = Math.max(0, Math.min(4, Number(gain) || 1))
-      return sendToBackend(`TRIGGER_BEAT ${trackId} ${rowId} ${g}`)
+      return sendToBackend(`TRIGGER_BEAT ${trackId} ${rowId} ${g}${scheduledSuffix(atMs)}`)
     } catch (e) {
       return { ok: false, error: String(e) }
     }
@@ -323,12 +372,12 @@ app.whenReady().then(() => {
     }
   })
 
-  ipcMain.handle('backend:trigger-sampler', async (event, { trackId, note, velocity = 0.8, durationMs = 0 }) => {
+  ipcMain.handle('backend:trigger-sampler', async (event, { trackId, note, velocity = 0.8, durationMs = 0, atMs }) => {
     try {
       if (!trackId || note === undefined) return { ok: false, error: 'missing-track-or-note' }
       const vel = Math.max(0, Math.min(1, Number(velocity) || 0.8))
       const dur = Math.max(0, Number(durationMs) || 0)
-      return sendToBackend(`TRIGGER_SAMPLER ${trackId} ${note} ${vel} ${dur}`)
+      return sendToBackend(`TRIGGER_SAMPLER ${trackId} ${note} ${vel} ${dur}${scheduledSuffix(atMs)}`)
     } catch (e) {
       return { ok: false, error: String(e) }
     }
@@ -380,6 +429,15 @@ app.whenReady().then(() => {
     }
   })
 
+  // Requests the engine clock; the reply arrives as `EVENT CLOCK <ms>`
+  ipcMain.handle('backend:clock', async () => {
+    try {
+      return sendToBackend('CLOCK')
+    } catch (e) {
+      return { ok: false, error: String(e) }
+    }
+  })
+
   ipcMain.handle('backend:scan-vsts', async () => {
     try {
       const vsts = []
@@ -560,7 +618,7 @@ app.whenReady().then(() => {
       }
 
       // Send command
-      proc.stdin.write(command + '\n')
+      writeBackendLine(proc, command)
 
       // Wait for render to complete or error
       return new Promise((resolve) => {
@@ -576,7 +634,8 @@ app.whenReady().then(() => {
           const msg = data.toString().trim()
           console.log('[backend render]', msg)
           
-          if (msg.includes('EVENT RENDER_COMPLETE')) {
+          // Renders are queued, so only the completion for this file resolves the request
+          if (msg.includes(`EVENT RENDER_COMPLETE ${filePath}`)) {
             if (!resolved) {
               resolved = true
               clearTimeout(timeout)
@@ -600,6 +659,15 @@ app.whenReady().then(() => {
     }
   })
 
+  // Cancels an in-flight render (all renders when outputPath is empty)
+  ipcMain.handle('backend:cancel-render', async (event, outputPath = '') => {
+    try {
+      return sendToBackend(outputPath ? `CANCEL_RENDER "${outputPath}"` : 'CANCEL_RENDER')
+    } catch (e) {
+      return { ok: false, error: String(e) }
+    }
+  })
+
   // Render MIDI notes to temporary WAV file (no dialog, for mixing)
   ipcMain.handle('backend:render-wav-temp', async (event, { payload, notes, beats, audio, audioClips, sampleRate = 44100, bitDepth = 24 } = {}) => {
     try {
@@ -633,7 +701,7 @@ app.whenReady().then(() => {
       }
 
       // Send command
-      proc.stdin.write(command + '\n')
+      writeBackendLine(proc, command)
 
       // Wait for render to complete or error
       return new Promise((resolve) => {
@@ -649,7 +717,8 @@ app.whenReady().then(() => {
           const msg = data.toString().trim()
           console.log('[backend render temp]', msg)
           
-          if (msg.includes('EVENT RENDER_COMPLETE')) {
+          // Renders are queued, so only the completion for this file resolves the request
+          if (msg.includes(`EVENT RENDER_COMPLETE ${filePath}`)) {
             if (!resolved) {
               resolved = true
               clearTimeout(timeout)
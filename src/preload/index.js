@@ -45,16 +45,20 @@ api.backend = {
   setVolume: (trackId, volume, channel) => ipcRenderer.invoke('backend:set-volume', { trackId, volume, channel }),
   // beat sampler controls
   loadBeatSample: (trackId, rowId, path) => ipcRenderer.invoke('backend:load-beat-sample', { trackId, rowId, path }),
-  triggerBeat: (trackId, rowId, gain) => ipcRenderer.invoke('backend:trigger-beat', { trackId, rowId, gain }),
+  triggerBeat: (trackId, rowId, gain, atMs) => ipcRenderer.invoke('backend:trigger-beat', { trackId, rowId, gain, atMs }),
   clearBeat: (trackId, rowId) => ipcRenderer.invoke('backend:clear-beat', { trackId, rowId }),
   // sampler controls
   loadSamplerSample: (trackId, path) => ipcRenderer.invoke('backend:load-sampler-sample', { trackId, path }),
-  triggerSampler: (trackId, note, velocity, durationMs) => ipcRenderer.invoke('backend:trigger-sampler', { trackId, note, velocity, durationMs }),
+  triggerSampler: (trackId, note, velocity, durationMs, atMs) => ipcRenderer.invoke('backend:trigger-sampler', { trackId, note, velocity, durationMs, atMs }),
   stopSamplerNote: (trackId, note) => ipcRenderer.invoke('backend:stop-sampler-note', { trackId, note }),
   clearSampler: (trackId) => ipcRenderer.invoke('backend:clear-sampler', { trackId }),
+  // send many note/beat/sampler events at once: [{ kind: 'note'|'beat'|'samplerNote'|'samplerOff'|'panic', trackId, ... }]
+  noteBatch: (events) => ipcRenderer.invoke('backend:note-batch', events),
   // optional helpers
   panic: (trackId) => ipcRenderer.invoke('backend:panic', trackId),
   status: () => ipcRenderer.invoke('backend:status'),
+  // ask for the engine clock used by scheduled (atMs) notes
+  clock: () => ipcRenderer.invoke('backend:clock'),
   openEditor: (trackId) => ipcRenderer.invoke('backend:open-editor', trackId),
   closeEditor: (trackId) => ipcRenderer.invoke('backend:close-editor', trackId),
   // render current state for durationMs (legacy stub)
@@ -63,6 +67,8 @@ api.backend = {
   renderWav: (payload, sampleRate, bitDepth) => ipcRenderer.invoke('backend:render-wav', { payload, sampleRate, bitDepth }),
   // Render to temporary WAV file (no dialog, for internal mixing)
   renderWavTemp: (payload, sampleRate, bitDepth) => ipcRenderer.invoke('backend:render-wav-temp', { payload, sampleRate, bitDepth }),
+  // cancel a running render; progress arrives as `EVENT RENDER_PROGRESS <percent> <path>`
+  cancelRender: (outputPath) => ipcRenderer.invoke('backend:cancel-render', outputPath),
   // Get VST plugin preset state (base64-encoded binary data)
   getVSTState: (trackId) => ipcRenderer.invoke('backend:get-vst-state', trackId),
   // Set VST plugin preset state (from base64-encoded binary data)
@@ -4,7 +4,7 @@ import InstrumentSelector from './InstrumentSelector'
 import VSTSelector from './VSTSelector'
 import { getSf2NoteRange, getSf2KeyLabels } from '@renderer/utils/spessaSf2'
 import { getSharedAudioContext } from '@renderer/utils/audioContext'
-import { playBackendNote, noteNameToMidi, backendPanic, openVSTEditor, loadSF2, setSF2Preset } from '@renderer/utils/vstBackend'
+import { playBackendNote, noteNameToMidi, backendPanic, openVSTEditor, loadSF2, setSF2Preset, syncBackendClock, backendTimeAt, sendBackendBatch } from '@renderer/utils/vstBackend'
 
 const NOTES = ['C', 'C#', 'D', 'D#', 'E', 'F', 'F#', 'G', 'G#', 'A', 'A#', 'B']
 const OCTAVES = [2, 3, 4, 5, 6, 7]
@@ -148,6 +148,8 @@ function PianoRoll({ trackId, trackName, trackColor, trackType, notes, onNotesCh
   // Playback scheduler worker and scheduled timeouts
   const playbackWorkerRef = useRef(null)
   const scheduledTimeoutsRef = useRef(new Set())
+  // True while notes are queued ahead in the backend (cancelled with a panic on stop)
+  const backendScheduledRef = useRef(false)
   const schedulerReadyRef = useRef(false)
   const lookaheadSecRef = useRef(0.5)
   const schedulerTickSecRef = useRef(0.02)
@@ -1110,15 +1112,28 @@ function PianoRoll({ trackId, trackName, trackColor, trackType, notes, onNotesCh
     }
   }
   // Schedule a note at absolute AudioContext time (seconds)
-  const scheduleNoteAt = (noteName, whenSec, durationSec, velocity = 80) => {
+  // With a batch array, backend-scheduled notes are collected there and sent together by the caller
+  const scheduleNoteAt = (noteName, whenSec, durationSec, velocity = 80, batch = null) => {
     const ctx = audioContextRef.current
     if (!ctx) return
     const now = ctx.currentTime
     const inSec = Math.max(0, whenSec - now)
     const sessionId = playbackSessionRef.current
     
+    // Backend notes are sent right away and started by the backend on its own clock,
+    // so timing no longer depends on setTimeout jitter
+    const atMs = inSec > 0 ? backendTimeAt(performance.now() + inSec * 1000) : null
+
     // Route to sampler backend if this is a sampler track
     if (trackType === 'sampler') {
+      if (atMs !== null) {
+        const midiNote = noteNameToMidi(noteName)
+        backendScheduledRef.current = true
+        const durationMs = Math.floor((durationSec || 0.3) * 1000)
+        if (batch) batch.push({ kind: 'samplerNote', trackId: String(trackId), note: midiNote, velocity: velocity / 127.0, durationMs, atMs })
+        else window.api.backend.triggerSampler(String(trackId), midiNote, velocity / 127.0, durationMs, atMs)
+        return
+      }
       const id = setTimeout(() => {
         if (playbackSessionRef.current === sessionId) {
           const midiNote = noteNameToMidi(noteName)
@@ -1133,6 +1148,13 @@ function PianoRoll({ trackId, trackName, trackColor, trackType, notes, onNotesCh
     
     // Route to backend if VST or SF2 is loaded (use ref for immediate state)
     if (useVSTBackendRef.current || spessaInstrumentRef.current) {
+      if (atMs !== null) {
+        backendScheduledRef.current = true
+        const durationMs = Math.floor((durationSec || 0.3) * 1000)
+        if (batch) batch.push({ kind: 'note', trackId: String(trackId), note: noteNameToMidi(noteName), velocity: velocity / 127.0, durationMs, channel: 1, atMs })
+        else playBackendNote(trackId, noteNameToMidi(noteName), velocity / 127.0, durationMs, 1, atMs)
+        return
+      }
       const id = setTimeout(() => {
         if (playbackSessionRef.current === sessionId) {
           const midiNote = noteNameToMidi(noteName)
@@ -1597,6 +1619,10 @@ function PianoRoll({ trackId, trackName, trackColor, trackType, notes, onNotesCh
       try { playbackWorkerRef.current?.postMessage({ type: 'stop' }) } catch {}
       for (const id of scheduledTimeoutsRef.current) { try { clearTimeout(id) } catch {} }
       scheduledTimeoutsRef.current.clear()
+      if (backendScheduledRef.current) {
+        backendScheduledRef.current = false
+        backendPanic(String(trackId))
+      }
       if (playbackAnimationRef.current) {
         cancelAnimationFrame(playbackAnimationRef.current)
         playbackAnimationRef.current = null
@@ -1639,6 +1665,10 @@ function PianoRoll({ trackId, trackName, trackColor, trackType, notes, onNotesCh
       try { playbackWorkerRef.current?.postMessage({ type: 'stop' }) } catch {}
       for (const id of scheduledTimeoutsRef.current) { try { clearTimeout(id) } catch {} }
       scheduledTimeoutsRef.current.clear()
+      if (backendScheduledRef.current) {
+        backendScheduledRef.current = false
+        backendPanic(String(trackId))
+      }
     } else {
       // Only allow starting playback in Play mode for performance
       if (modeRef.current !== 'play') return
@@ -1667,6 +1697,8 @@ function PianoRoll({ trackId, trackName, trackColor, trackType, notes, onNotesCh
       if (ctx) {
         try { if (ctx.state === 'suspended') ctx.resume() } catch {}
         const baseAudioTime = ctx.currentTime
+        // Refresh the backend clock offset so notes can be scheduled ahead
+        syncBackendClock()
   // No need to pass main-thread performance.now to worker; it uses its own clock
         if (!playbackWorkerRef.current) {
           try {
@@ -1677,10 +1709,12 @@ function PianoRoll({ trackId, trackName, trackColor, trackType, notes, onNotesCh
               if (type === 'ready') {
                 schedulerReadyRef.current = true
               } else if (type === 'events' && Array.isArray(events)) {
+                const batch = []
                 for (let i = 0; i < events.length; i++) {
                   const ev = events[i]
-                  scheduleNoteAt(ev.note, ev.audioTime, ev.durationSec, 80)
+                  scheduleNoteAt(ev.note, ev.audioTime, ev.durationSec, 80, batch)
                 }
+                if (batch.length > 0) sendBackendBatch(batch)
               } else if (type === 'ended') {
                 // Auto-stop when scheduler is done
                 setIsPlaying(false)
@@ -1751,6 +1785,10 @@ function PianoRoll({ trackId, trackName, trackColor, trackType, notes, onNotesCh
       // Clear any previously scheduled note callbacks
       for (const id of scheduledTimeoutsRef.current) { try { clearTimeout(id) } catch {} }
       scheduledTimeoutsRef.current.clear()
+      if (backendScheduledRef.current) {
+        backendScheduledRef.current = false
+        backendPanic(String(trackId))
+      }
       if (!playbackAnimationRef.current) {
         playbackAnimationRef.current = requestAnimationFrame(playbackLoop)
       }
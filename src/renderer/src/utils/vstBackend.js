@@ -2,6 +2,8 @@
 
 let backendReady = false
 let backendEventUnsubscribe = null
+// Engine clock minus performance.now(), learned from `EVENT CLOCK`; null until synced
+let engineClockOffsetMs = null
 
 // Initialize backend listener for event stream
 export function initBackend() {
@@ -14,12 +16,29 @@ export function initBackend() {
       backendReady = true
     } else if (line.startsWith('EVENT READY_SF2') || line.startsWith('EVENT LOADED_SF2')) {
       backendReady = true
+    } else if (line.startsWith('EVENT CLOCK')) {
+      const engineMs = parseFloat(line.split(' ')[2])
+      if (Number.isFinite(engineMs)) engineClockOffsetMs = engineMs - performance.now()
     } else if (line.startsWith('ERROR')) {
       console.error('[Backend]', line)
     }
   })
 }
 
+// Ask the backend for its engine clock so notes can be scheduled ahead (see backendTimeAt)
+export async function syncBackendClock() {
+  try {
+    await window.api.backend.clock()
+  } catch (e) {
+    console.warn('Backend clock sync failed:', e)
+  }
+}
+
+// Converts a performance.now() timestamp to backend engine time (ms), or null if not synced yet
+export function backendTimeAt(perfMs) {
+  return engineClockOffsetMs === null ? null : perfMs + engineClockOffsetMs
+}
+
 // Load a VST plugin by absolute path for a specific track
 export async function loadVST(trackId, pluginPath) {
   try {
@@ -96,9 +115,10 @@ export async function unloadVST(trackId) {
   }
 }
 
-// Play a note via the backend (trackId, note, velocity, durationMs, channel)
+// Play a note via the backend (trackId, note, velocity, durationMs, channel, atMs)
+// atMs is an optional engine time from backendTimeAt(); the backend starts the note sample-accurately then
 // Returns immediately; note plays asynchronously in the backend
-export async function playBackendNote(trackId, midiNote, velocity = 0.8, durationMs = 500, channel = 1) {
+export async function playBackendNote(trackId, midiNote, velocity = 0.8, durationMs = 500, channel = 1, atMs = undefined) {
   if (!backendReady) {
     console.warn('Backend not ready; skipping note')
     return false
@@ -110,7 +130,8 @@ export async function playBackendNote(trackId, midiNote, velocity = 0.8, duratio
       note: midiNote, 
       velocity, 
       durationMs, 
-      channel 
+      channel,
+      atMs
     })
     if (!res.ok) {
       console.error(`Backend note failed for track ${trackId}:`, res.error)
@@ -123,6 +144,23 @@ export async function playBackendNote(trackId, midiNote, velocity = 0.8, duratio
   }
 }
 
+// Send several scheduled events in one IPC call / backend write
+// events: [{ kind: 'note'|'beat'|'samplerNote'|'samplerOff'|'panic', trackId, note, velocity, durationMs, channel, rowId, gain, atMs }]
+export async function sendBackendBatch(events) {
+  if (!backendReady || !events || events.length === 0) return false
+  try {
+    const res = await window.api.backend.noteBatch(events)
+    if (!res.ok) {
+      console.error('Backend event batch failed:', res.error)
+      return false
+    }
+    return true
+  } catch (e) {
+    console.error('Error sending backend event batch:', e)
+    return false
+  }
+}
+
 // All notes off (panic) for a specific track or all tracks
 export async function backendPanic(trackId = '') {
   try {
@@ -2,6 +2,8 @@
   Playback scheduler worker
   - Runs a lookahead timer to batch upcoming note events based on BPM and current beat
   - Posts messages to main thread with absolute audioTime for each note
+  - Backend tracks forward each note immediately with an engine timestamp (NOTE_ON at=),
+    so the whole lookahead window is queued in the backend instead of on setTimeout
 */
 
 let bpm = 120